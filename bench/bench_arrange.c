@@ -0,0 +1,115 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Cost of the arrange after a transaction, on a headless compositor with
+// a growing number of floating containers: moving a single floater, which
+// only re-arranges its own subtree, against marking the whole workspace.
+// Scene mutations are the ones counted for the
+// wsm_arrange_scene_mutations metric.
+
+#include "bench_server.h"
+#include "wsm_server.h"
+#include "wsm_output.h"
+#include "wsm_metrics.h"
+#include "wsm_container.h"
+#include "wsm_workspace.h"
+#include "wsm_transaction.h"
+#include "node/wsm_node.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROUNDS 2000
+
+static uint64_t scene_mutations(void) {
+    return atomic_load_explicit(&wsm_metrics.arrange_scene_mutations.sum,
+                                memory_order_relaxed);
+}
+
+static void bench(const char *name, struct wsm_workspace *ws,
+                  struct wsm_container **floaters, int length, bool move) {
+    uint64_t mutations = scene_mutations();
+    uint64_t full = wsm_metric_get(&wsm_metrics.full_arranges);
+    double start = bench_now_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        if (move) {
+            struct wsm_container *con = floaters[rand() % length];
+            container_floating_translate(con, i & 1 ? -1 : 1, 0);
+        } else {
+            node_set_dirty(&ws->node);
+        }
+        transaction_commit_dirty();
+    }
+    double elapsed = bench_now_ns() - start;
+
+    printf("%-10s %5d floaters: %9.1f ns/transaction  %7.1f scene mutations/transaction"
+           "  %llu full arranges\n", name, length, elapsed / ROUNDS,
+           (double)(scene_mutations() - mutations) / ROUNDS,
+           (unsigned long long)(wsm_metric_get(&wsm_metrics.full_arranges) - full));
+}
+
+int main(void) {
+    struct wsm_output *output = bench_server_create(1920, 1080);
+    if (!output) {
+        return EXIT_FAILURE;
+    }
+    struct wsm_workspace *ws = output_get_active_workspace(output);
+
+    int lengths[] = { 16, 128, 1024 };
+    int max_length = lengths[sizeof(lengths) / sizeof(lengths[0]) - 1];
+    struct wsm_container **floaters = calloc(max_length, sizeof(struct wsm_container *));
+    if (!floaters) {
+        fprintf(stderr, "allocation failed\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    int length = 0;
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        for (; length < lengths[i]; length++) {
+            struct wsm_container *con = container_create(NULL);
+            if (!con) {
+                fprintf(stderr, "allocation failed\n");
+                return EXIT_FAILURE;
+            }
+            con->pending.x = (length * 13) % 1600;
+            con->pending.y = (length * 7) % 800;
+            con->pending.width = 300;
+            con->pending.height = 200;
+            workspace_add_floating(ws, con);
+            floaters[length] = con;
+        }
+        transaction_commit_dirty();
+        bench_server_dispatch();
+
+        bench("move", ws, floaters, length, true);
+        bench("workspace", ws, floaters, length, false);
+    }
+
+    free(floaters);
+    bench_server_destroy();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Microbenchmark of scene descriptor lookups, the descriptor table against
+// the addon per descriptor it replaced. Buffers of a scene full of windows
+// are walked up like the cursor hit test looking for a container, and like
+// frame done looking up the view of a buffer.
+
+#include "node/wsm_node_descriptor.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <wlr/util/addon.h>
+#include <wlr/types/wlr_scene.h>
+
+#define LOOKUPS 1000000
+
+// A descriptor as it used to be, one addon per type, owned by the type
+struct addon_descriptor {
+    struct wlr_addon addon;
+    void *data;
+};
+
+static char addon_owners[WSM_SCENE_DESC_COUNT];
+
+static void addon_descriptor_destroy(struct wlr_addon *addon) {
+    struct addon_descriptor *desc = wl_container_of(addon, desc, addon);
+    wlr_addon_finish(&desc->addon);
+    free(desc);
+}
+
+static const struct wlr_addon_interface addon_descriptor_impl = {
+    .name = "bench_addon_descriptor",
+    .destroy = addon_descriptor_destroy,
+};
+
+static void addon_assign(struct wlr_scene_node *node,
+                         enum wsm_scene_descriptor_type type, void *data) {
+    struct addon_descriptor *desc = calloc(1, sizeof(*desc));
+    if (!desc) {
+        fprintf(stderr, "allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    desc->data = data;
+    wlr_addon_init(&desc->addon, &node->addons, &addon_owners[type], &addon_descriptor_impl);
+}
+
+static void *addon_try_get(struct wlr_scene_node *node, enum wsm_scene_descriptor_type type) {
+    struct wlr_addon *addon = wlr_addon_find(&node->addons, &addon_owners[type],
+                                             &addon_descriptor_impl);
+    if (!addon) {
+        return NULL;
+    }
+    struct addon_descriptor *desc = wl_container_of(addon, desc, addon);
+    return desc->data;
+}
+
+static void table_assign(struct wlr_scene_node *node,
+                         enum wsm_scene_descriptor_type type, void *data) {
+    if (!wsm_scene_descriptor_assign(node, type, data)) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+struct bench_scene {
+    struct wlr_scene *scene;
+    struct wlr_scene_node **buffers;
+    int buffers_len;
+};
+
+static struct wlr_scene_tree *tree_create(struct wlr_scene_tree *parent) {
+    struct wlr_scene_tree *tree = wlr_scene_tree_create(parent);
+    if (!tree) {
+        fprintf(stderr, "allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return tree;
+}
+
+static void add_buffer(struct bench_scene *bench, struct wlr_scene_tree *parent) {
+    struct wlr_scene_buffer *buffer = wlr_scene_buffer_create(parent, NULL);
+    if (!buffer) {
+        fprintf(stderr, "allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    bench->buffers[bench->buffers_len++] = &buffer->node;
+}
+
+#define WINDOW_BUFFERS 5
+
+// Laid out like a tiled window: the container holds a title bar and the
+// view, the view a surface with three subsurfaces
+static void bench_scene_init(struct bench_scene *bench, int windows,
+                             void (*assign)(struct wlr_scene_node *node,
+                                            enum wsm_scene_descriptor_type type, void *data)) {
+    bench->scene = wlr_scene_create();
+    bench->buffers = calloc(windows * WINDOW_BUFFERS, sizeof(struct wlr_scene_node *));
+    if (!bench->scene || !bench->buffers) {
+        fprintf(stderr, "allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    bench->buffers_len = 0;
+
+    struct wlr_scene_tree *tiling = tree_create(tree_create(&bench->scene->tree));
+    for (int i = 0; i < windows; i++) {
+        struct wlr_scene_tree *con = tree_create(tiling);
+        assign(&con->node, WSM_SCENE_DESC_CONTAINER, bench);
+        add_buffer(bench, tree_create(tree_create(con)));
+
+        struct wlr_scene_tree *view = tree_create(tree_create(con));
+        assign(&view->node, WSM_SCENE_DESC_VIEW, bench);
+        struct wlr_scene_tree *surface = tree_create(tree_create(view));
+        add_buffer(bench, surface);
+        for (int j = 0; j < WINDOW_BUFFERS - 2; j++) {
+            add_buffer(bench, tree_create(surface));
+        }
+    }
+}
+
+static void bench_scene_finish(struct bench_scene *bench) {
+    wlr_scene_node_destroy(&bench->scene->tree.node);
+    free(bench->buffers);
+}
+
+// The hit test checks every descriptor a level may carry, the table skips
+// levels without any
+static bool table_hit_test(struct wlr_scene_node *node) {
+    for (struct wlr_scene_node *current = node; ; current = &current->parent->node) {
+        if (wsm_scene_descriptor_mask(current)) {
+            if (wsm_scene_descriptor_try_get(current, WSM_SCENE_DESC_CONTAINER) ||
+                wsm_scene_descriptor_try_get(current, WSM_SCENE_DESC_VIEW) ||
+                wsm_scene_descriptor_try_get(current, WSM_SCENE_DESC_POPUP)) {
+                return true;
+            }
+            if (wsm_scene_descriptor_try_get(current, WSM_SCENE_DESC_LAYER_SHELL)) {
+                return false;
+            }
+        }
+        if (!current->parent) {
+            return false;
+        }
+    }
+}
+
+static bool addon_hit_test(struct wlr_scene_node *node) {
+    for (struct wlr_scene_node *current = node; ; current = &current->parent->node) {
+        if (addon_try_get(current, WSM_SCENE_DESC_CONTAINER) ||
+            addon_try_get(current, WSM_SCENE_DESC_VIEW) ||
+            addon_try_get(current, WSM_SCENE_DESC_POPUP)) {
+            return true;
+        }
+        if (addon_try_get(current, WSM_SCENE_DESC_LAYER_SHELL)) {
+            return false;
+        }
+        if (!current->parent) {
+            return false;
+        }
+    }
+}
+
+static bool table_find_view(struct wlr_scene_node *node) {
+    for (struct wlr_scene_node *current = node; ; current = &current->parent->node) {
+        if (wsm_scene_descriptor_try_get(current, WSM_SCENE_DESC_VIEW)) {
+            return true;
+        }
+        if (!current->parent) {
+            return false;
+        }
+    }
+}
+
+static bool addon_find_view(struct wlr_scene_node *node) {
+    for (struct wlr_scene_node *current = node; ; current = &current->parent->node) {
+        if (addon_try_get(current, WSM_SCENE_DESC_VIEW)) {
+            return true;
+        }
+        if (!current->parent) {
+            return false;
+        }
+    }
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench_walk(struct bench_scene *bench, bool (*walk)(struct wlr_scene_node *node),
+                         int expected) {
+    int rounds = LOOKUPS / bench->buffers_len + 1;
+    int found = 0;
+    double start = now_ns();
+    for (int i = 0; i < rounds; i++) {
+        for (int j = 0; j < bench->buffers_len; j++) {
+            found += walk(bench->buffers[j]);
+        }
+    }
+    double elapsed = now_ns() - start;
+    if (found != expected * rounds) {
+        fprintf(stderr, "descriptor lookups found %d of %d\n", found, expected * rounds);
+        exit(EXIT_FAILURE);
+    }
+    return elapsed / ((double)rounds * bench->buffers_len);
+}
+
+static void bench(const char *name, int windows,
+                  void (*assign)(struct wlr_scene_node *node,
+                                 enum wsm_scene_descriptor_type type, void *data),
+                  bool (*hit_test)(struct wlr_scene_node *node),
+                  bool (*find_view)(struct wlr_scene_node *node)) {
+    struct bench_scene bench;
+    bench_scene_init(&bench, windows, assign);
+    // Every buffer hits its container, title bars are outside of the view
+    double hit = bench_walk(&bench, hit_test, bench.buffers_len);
+    double view = bench_walk(&bench, find_view, windows * (WINDOW_BUFFERS - 1));
+    printf("%-6s %5d windows: hit test %6.1f  frame done view %6.1f ns/buffer\n",
+           name, windows, hit, view);
+    bench_scene_finish(&bench);
+}
+
+int main(void) {
+    int windows[] = { 4, 64, 1024 };
+    for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+        bench("addon", windows[i], addon_assign, addon_hit_test, addon_find_view);
+        bench("table", windows[i], table_assign, table_hit_test, table_find_view);
+    }
+    return EXIT_SUCCESS;
+}
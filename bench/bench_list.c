@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Microbenchmark of wsm_list, plain against indexed, with the access
+// patterns of large workspaces: focus changes moving a child to the end,
+// containers detached from the middle of a layout.
+
+#include "wsm_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(const char *name, bool indexed, int length, int rounds) {
+    void **items = calloc(length, sizeof(void *));
+    int *order = calloc(rounds, sizeof(int));
+    if (!items || !order) {
+        fprintf(stderr, "allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < length; i++) {
+        items[i] = malloc(16);
+    }
+    srand(1);
+    for (int i = 0; i < rounds; i++) {
+        order[i] = rand() % length;
+    }
+
+    struct wsm_list *list = indexed ? create_indexed_list() : create_list();
+    double start = now_ns();
+    for (int i = 0; i < length; i++) {
+        list_add(list, items[i]);
+    }
+    double add = now_ns() - start;
+
+    start = now_ns();
+    int found = 0;
+    for (int i = 0; i < rounds; i++) {
+        found += list_find(list, items[order[i]]) >= 0;
+    }
+    double find = now_ns() - start;
+    if (found != rounds) {
+        fprintf(stderr, "%s: items missing from the list\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    start = now_ns();
+    for (int i = 0; i < rounds; i++) {
+        list_move_to_end(list, items[order[i]]);
+    }
+    double move = now_ns() - start;
+
+    // Detach and reattach, as moving a container across workspaces does
+    start = now_ns();
+    for (int i = 0; i < rounds; i++) {
+        int index = list_find(list, items[order[i]]);
+        list_del(list, index);
+        list_insert(list, index / 2, items[order[i]]);
+    }
+    double del = now_ns() - start;
+
+    printf("%-8s %6d items: add %6.1f  find %8.1f  move_to_end %9.1f  del+insert %9.1f ns/op\n",
+           name, length, add / length, find / rounds, move / rounds, del / rounds);
+
+    list_free(list);
+    for (int i = 0; i < length; i++) {
+        free(items[i]);
+    }
+    free(items);
+    free(order);
+}
+
+int main(void) {
+    int lengths[] = { 16, 256, 4096, 65536 };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        bench("plain", false, lengths[i], 10000);
+        bench("indexed", true, lengths[i], 10000);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Microbenchmark of wsm_log as seen by the calling thread, writing to
+// stderr directly against queueing for the writer thread. Messages come in
+// bursts of half a ring, the writer drains between bursts.
+
+#include "wsm_log.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BURST 256
+#define BURSTS 400
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Time spent in the log calls only, and with the flushes after each burst
+static void bench(const char *name, bool flush) {
+    double logging = 0, start_all = now_ns();
+    for (int i = 0; i < BURSTS; i++) {
+        double start = now_ns();
+        for (int j = 0; j < BURST; j++) {
+            wsm_log(WSM_DEBUG, "Committing transaction %d of %d with %d instructions",
+                    i, BURSTS, j);
+        }
+        logging += now_ns() - start;
+        if (flush) {
+            wsm_log_flush();
+        }
+    }
+    double total = now_ns() - start_all;
+    printf("%-6s %9.1f ns/message in the caller  %9.1f ns/message written\n",
+           name, logging / (BURST * BURSTS), total / (BURST * BURSTS));
+}
+
+int main(void) {
+    // Measure the logging, not the terminal
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0 || dup2(null_fd, STDERR_FILENO) < 0) {
+        perror("Could not redirect stderr");
+        return EXIT_FAILURE;
+    }
+    close(null_fd);
+
+    // Without the writer thread, as before wsm_log_init() and after
+    // wsm_log_finish()
+    _wsm_log_importance = WSM_DEBUG;
+    bench("sync", false);
+
+    wsm_log_init(WSM_DEBUG, NULL);
+    bench("async", true);
+    wsm_log_finish();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "bench_server.h"
+#include "wsm_log.h"
+#include "wsm_server.h"
+#include "wsm_output.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+
+struct wsm_server global_server = {0};
+
+static void find_headless(struct wlr_backend *backend, void *data) {
+    struct wlr_backend **headless = data;
+    if (wlr_backend_is_headless(backend)) {
+        *headless = backend;
+    }
+}
+
+void bench_server_dispatch(void) {
+    // output configuration and the like go through idle sources
+    for (int i = 0; i < 16; i++) {
+        wl_event_loop_dispatch(global_server.wl_event_loop, 0);
+    }
+}
+
+struct wsm_output *bench_server_create(int width, int height) {
+    setenv("WLR_BACKENDS", "headless", true);
+    setenv("WLR_RENDERER", "pixman", true);
+    setenv("WLR_LIBINPUT_NO_DEVICES", "1", true);
+    wsm_log_init(WSM_ERROR, NULL);
+
+    if (!wsm_server_init(&global_server) ||
+        !wlr_backend_start(global_server.backend)) {
+        wsm_log(WSM_ERROR, "Unable to start the headless compositor");
+        return NULL;
+    }
+
+    struct wlr_backend *headless = NULL;
+    wlr_multi_for_each_backend(global_server.backend, find_headless, &headless);
+    if (!headless) {
+        wsm_log(WSM_ERROR, "No headless backend");
+        return NULL;
+    }
+    struct wlr_output *wlr_output = wlr_headless_add_output(headless, width, height);
+    if (!wlr_output) {
+        return NULL;
+    }
+    bench_server_dispatch();
+
+    struct wsm_output *output = wsm_output_from_wlr_output(wlr_output);
+    if (!output || !output_get_active_workspace(output)) {
+        wsm_log(WSM_ERROR, "The headless output was not enabled");
+        return NULL;
+    }
+    return output;
+}
+
+void bench_server_destroy(void) {
+    server_finish(&global_server);
+}
+
+double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "wsm_common.h"
 #include "wsm_desktop.h"
 #include "wsm_pango.h"
+#include "wsm_startup.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,6 +40,10 @@ THE SOFTWARE.
 #define SYSTEM_ICONS "/usr/share/icons/"
 #define SYSTEM_APPLICATIONS "/usr/share/applications/"
 
+static void measure_font(void *data) {
+    update_font_height(data);
+}
+
 struct wsm_desktop_interface *wsm_desktop_interface_create() {
     struct wsm_desktop_interface *desktop = calloc(1, sizeof(struct wsm_desktop_interface));
     if (!wsm_assert(desktop, "Could not create wsm_desktop_interface: allocation failed!")) {
@@ -90,11 +95,14 @@ struct wsm_desktop_interface *wsm_desktop_interface_create() {
     }
 
     desktop->font_description = font_description;
-    update_font_height(desktop);
+    // The first pango context loads the fontconfig configuration and cache,
+    // nothing needs the metrics before the first title bar.
+    desktop->font_task = wsm_init_task_start("font metrics", measure_font, desktop);
     return desktop;
 }
 
 void wsm_desktop_interface_destory(struct wsm_desktop_interface *desktop) {
+    wsm_init_task_join(&desktop->font_task);
     wl_signal_emit_mutable(&desktop->events.destroy, desktop);
     g_object_ref(desktop->settings);
     free(desktop);
@@ -104,6 +112,10 @@ void update_font_height(struct wsm_desktop_interface *desktop) {
     get_text_metrics(desktop->font_description, &desktop->font_height, &desktop->font_baseline);
 }
 
+void wsm_desktop_interface_wait_fonts(struct wsm_desktop_interface *desktop) {
+    wsm_init_task_join(&desktop->font_task);
+}
+
 void set_icon_theme(struct wsm_desktop_interface *desktop, char *icon_theme) {
     if (strcmp(desktop->icon_theme, icon_theme) == 0) {
         return;
@@ -120,6 +132,7 @@ void set_icon_theme(struct wsm_desktop_interface *desktop, char *icon_theme) {
 }
 
 void set_font_name(struct wsm_desktop_interface *desktop, char *font_name) {
+    wsm_desktop_interface_wait_fonts(desktop);
     if (strcmp(desktop->font_name, font_name) == 0) {
         return;
     }
@@ -35,8 +35,12 @@ enum wsm_color_scheme {
     Dark,
 };
 
+struct wsm_init_task;
+
 struct wsm_desktop_interface {
     PangoFontDescription *font_description;
+    // Measures the font in the background, see wsm_desktop_interface_wait_fonts()
+    struct wsm_init_task *font_task;
     GSettings *settings;
 
     char *style_name;
@@ -62,6 +66,11 @@ struct wsm_desktop_interface {
 struct wsm_desktop_interface *wsm_desktop_interface_create();
 void wsm_desktop_interface_destory(struct wsm_desktop_interface *desktop);
 void update_font_height(struct wsm_desktop_interface *desktop);
+/**
+ * @brief wait for the startup font measurement, needed before reading
+ * font_height or font_baseline or using font_description.
+ */
+void wsm_desktop_interface_wait_fonts(struct wsm_desktop_interface *desktop);
 void set_icon_theme(struct wsm_desktop_interface *desktop, char *icon_theme);
 void set_font_name(struct wsm_desktop_interface *desktop, char *font_name);
 void set_cursor_size(struct wsm_desktop_interface *desktop, int cursor_size);
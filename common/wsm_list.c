@@ -25,10 +25,143 @@ THE SOFTWARE.
 #include "wsm_list.h"
 #include "wsm_log.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Open addressing with linear probing, each item maps to its position in
+// the list. slot_of maps positions back to slots. Inserting or deleting
+// only moves slot_of along with the items, the positions kept in the slots
+// are repaired from it when a lookup needs them.
+struct index_slot {
+    const void *item; // NULL if empty
+    int pos;
+};
+
+struct wsm_list_index {
+    int capacity; // power of two
+    int count;
+    struct index_slot *slots;
+    int *slot_of; // as long as the items of the list
+    int exact; // items before it have the right position in their slot
+};
+
+static unsigned int index_hash(const struct wsm_list_index *index, const void *item) {
+    uint64_t key = (uintptr_t)item >> 4;
+    return (unsigned int)((key * 0x9e3779b97f4a7c15ull) >> 32) & (index->capacity - 1);
+}
+
+static struct index_slot *index_lookup(struct wsm_list_index *index, const void *item) {
+    unsigned int i = index_hash(index, item);
+    while (index->slots[i].item) {
+        if (index->slots[i].item == item) {
+            return &index->slots[i];
+        }
+        i = (i + 1) & (index->capacity - 1);
+    }
+    return NULL;
+}
+
+static void index_put(struct wsm_list_index *index, const void *item, int pos) {
+    unsigned int i = index_hash(index, item);
+    while (index->slots[i].item && index->slots[i].item != item) {
+        i = (i + 1) & (index->capacity - 1);
+    }
+    if (!index->slots[i].item) {
+        index->count++;
+    }
+    index->slots[i] = (struct index_slot){ .item = item, .pos = pos };
+    index->slot_of[pos] = i;
+}
+
+// Position of the item of @slot, repairing positions up to it. An item
+// with a stale position is never before index->exact, items only move when
+// something at or before them is inserted or deleted.
+static int index_position(struct wsm_list *list, struct index_slot *slot) {
+    struct wsm_list_index *index = list->index;
+    int pos = slot->pos;
+    if (pos < list->length && index->slots + index->slot_of[pos] == slot) {
+        return pos;
+    }
+    for (pos = index->exact; pos < list->length; pos++) {
+        struct index_slot *repaired = &index->slots[index->slot_of[pos]];
+        repaired->pos = pos;
+        if (repaired == slot) {
+            index->exact = pos + 1;
+            return pos;
+        }
+    }
+    index->exact = list->length;
+    wsm_assert(false, "Item %p indexed but not in list", slot->item);
+    return -1;
+}
+
+static void list_index_rebuild(struct wsm_list *list) {
+    struct wsm_list_index *index = list->index;
+    memset(index->slots, 0, sizeof(struct index_slot) * index->capacity);
+    index->count = 0;
+    for (int i = 0; i < list->length; i++) {
+        index_put(index, list->items[i], i);
+    }
+    index->exact = list->length;
+}
+
+// Make room for one more item, false if that failed
+static bool list_index_reserve(struct wsm_list *list) {
+    struct wsm_list_index *index = list->index;
+    if ((index->count + 1) * 2 <= index->capacity) {
+        return true;
+    }
+
+    int capacity = index->capacity ? index->capacity * 2 : 16;
+    struct index_slot *slots = calloc(capacity, sizeof(struct index_slot));
+    if (!slots) {
+        return false;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->capacity = capacity;
+    list_index_rebuild(list);
+    return true;
+}
+
+static void list_index_remove(struct wsm_list *list, const void *item) {
+    struct wsm_list_index *index = list->index;
+    struct index_slot *slot = index_lookup(index, item);
+    if (!slot) {
+        return;
+    }
+
+    // Shift the following entries back, so no lookup stops early
+    unsigned int mask = index->capacity - 1;
+    unsigned int hole = slot - index->slots;
+    unsigned int i = (hole + 1) & mask;
+    while (index->slots[i].item) {
+        unsigned int home = index_hash(index, index->slots[i].item);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            int pos = index_position(list, &index->slots[i]);
+            index->slots[hole] = index->slots[i];
+            index->slot_of[pos] = hole;
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+    index->slots[hole].item = NULL;
+    index->count--;
+}
+
+// The items from @from on moved by @delta positions
+static void list_index_shift(struct wsm_list *list, int from, int delta) {
+    struct wsm_list_index *index = list->index;
+    memmove(&index->slot_of[from + delta], &index->slot_of[from],
+            sizeof(int) * (list->length - from));
+    int moved = delta < 0 ? from + delta : from;
+    if (index->exact > moved) {
+        index->exact = moved;
+    }
+}
+
 struct wsm_list *create_list(void) {
     struct wsm_list *list = malloc(sizeof(struct wsm_list));
     if (!list) {
@@ -37,39 +170,98 @@ struct wsm_list *create_list(void) {
     list->capacity = 10;
     list->length = 0;
     list->items = malloc(sizeof(void*) * list->capacity);
+    list->index = NULL;
     return list;
 }
 
-static void list_resize(struct wsm_list *list) {
-    if (list->length == list->capacity) {
-        list->capacity *= 2;
-        list->items = realloc(list->items, sizeof(void*) * list->capacity);
+struct wsm_list *create_indexed_list(void) {
+    struct wsm_list *list = create_list();
+    if (!list) {
+        return NULL;
+    }
+    list->index = calloc(1, sizeof(struct wsm_list_index));
+    if (!list->index) {
+        list_free(list);
+        return NULL;
+    }
+    list->index->slot_of = malloc(sizeof(int) * list->capacity);
+    if (!list->index->slot_of || !list_index_reserve(list)) {
+        list_free(list);
+        return NULL;
+    }
+    return list;
+}
+
+static bool list_resize(struct wsm_list *list) {
+    if (list->length < list->capacity) {
+        return true;
+    }
+
+    int capacity = list->capacity * 2;
+    void **items = realloc(list->items, sizeof(void*) * capacity);
+    if (!items) {
+        return false;
+    }
+    list->items = items;
+    if (list->index) {
+        int *slot_of = realloc(list->index->slot_of, sizeof(int) * capacity);
+        if (!slot_of) {
+            return false;
+        }
+        list->index->slot_of = slot_of;
     }
+    list->capacity = capacity;
+    return true;
 }
 
 void list_free(struct wsm_list *list) {
     if (list == NULL) {
         return;
     }
+    if (list->index) {
+        free(list->index->slot_of);
+        free(list->index->slots);
+        free(list->index);
+    }
     free(list->items);
     free(list);
 }
 
-void list_add(struct wsm_list *list, void *item) {
-    list_resize(list);
-    list->items[list->length++] = item;
+bool list_add(struct wsm_list *list, void *item) {
+    return list_insert(list, list->length, item);
 }
 
-void list_insert(struct wsm_list *list, int index, void *item) {
-    list_resize(list);
+bool list_insert(struct wsm_list *list, int index, void *item) {
+    if (!list_resize(list) || (list->index && !list_index_reserve(list))) {
+        wsm_log(WSM_ERROR, "Could not add item to list: allocation failed!");
+        return false;
+    }
+    if (list->index) {
+        struct wsm_list_index *list_index = list->index;
+        bool exact = list_index->exact == list->length;
+        list_index_shift(list, index, 1);
+        index_put(list_index, item, index);
+        if (exact && index == list->length) {
+            list_index->exact++;
+        }
+    }
     memmove(&list->items[index + 1], &list->items[index], sizeof(void*) * (list->length - index));
     list->length++;
     list->items[index] = item;
+    return true;
 }
 
 void list_del(struct wsm_list *list, int index) {
+    void *item = list->items[index];
+    // No position may lead to the slot of the item while it is removed
+    if (list->index) {
+        list_index_shift(list, index + 1, -1);
+    }
     list->length--;
     memmove(&list->items[index], &list->items[index + 1], sizeof(void*) * (list->length - index));
+    if (list->index) {
+        list_index_remove(list, item);
+    }
 }
 
 void list_cat(struct wsm_list *list, struct wsm_list *source) {
@@ -80,6 +272,9 @@ void list_cat(struct wsm_list *list, struct wsm_list *source) {
 
 void list_qsort(struct wsm_list *list, int compare(const void *left, const void *right)) {
     qsort(list->items, list->length, sizeof(void *), compare);
+    if (list->index) {
+        list_index_rebuild(list);
+    }
 }
 
 int list_seq_find(struct wsm_list *list, int compare(const void *item, const void *data), const void *data) {
@@ -93,6 +288,10 @@ int list_seq_find(struct wsm_list *list, int compare(const void *item, const voi
 }
 
 int list_find(struct wsm_list *list, const void *item) {
+    if (list->index) {
+        struct index_slot *slot = index_lookup(list->index, item);
+        return slot ? index_position(list, slot) : -1;
+    }
     for (int i = 0; i < list->length; i++) {
         if (list->items[i] == item) {
             return i;
@@ -101,20 +300,30 @@ int list_find(struct wsm_list *list, const void *item) {
     return -1;
 }
 
+bool list_contains(struct wsm_list *list, const void *item) {
+    if (list->index) {
+        return index_lookup(list->index, item) != NULL;
+    }
+    return list_find(list, item) != -1;
+}
+
 void list_swap(struct wsm_list *list, int src, int dest) {
     void *tmp = list->items[src];
     list->items[src] = list->items[dest];
     list->items[dest] = tmp;
+    if (list->index) {
+        struct wsm_list_index *index = list->index;
+        int slot = index->slot_of[src];
+        index->slot_of[src] = index->slot_of[dest];
+        index->slot_of[dest] = slot;
+        index->slots[index->slot_of[src]].pos = src;
+        index->slots[index->slot_of[dest]].pos = dest;
+    }
 }
 
 void list_move_to_end(struct wsm_list *list, void *item) {
-    int i;
-    for (i = 0; i < list->length; ++i) {
-        if (list->items[i] == item) {
-            break;
-        }
-    }
-    if (!wsm_assert(i < list->length, "Item not found in list")) {
+    int i = list_find(list, item);
+    if (!wsm_assert(i != -1, "Item not found in list")) {
         return;
     }
     list_del(list, i);
@@ -170,6 +379,9 @@ void list_stable_sort(struct wsm_list *list, int compare(const void *a, const vo
     if (list->length > 1) {
         list_inplace_sort(list, 0, list->length - 1, compare);
     }
+    if (list->index) {
+        list_index_rebuild(list);
+    }
 }
 
 void list_free_items_and_destroy(struct wsm_list *list) {
@@ -25,21 +25,44 @@ THE SOFTWARE.
 #ifndef WSM_LIST_H
 #define WSM_LIST_H
 
+#include <stdbool.h>
+
+struct wsm_list_index;
+
 struct wsm_list {
     int capacity;
     int length;
     void **items;
+    // Set for indexed lists, only kept in sync by the list_* functions
+    struct wsm_list_index *index;
 };
 
 struct wsm_list *create_list(void);
+/**
+ * @brief list with a hash index of its items, for lists searched often
+ * and rarely removed from
+ *
+ * @details list_find(), list_contains() and the lookup of list_move_to_end()
+ * hash the item instead of scanning the list. Positions shifted by an insert
+ * or delete are repaired by the next lookup, only up to the item looked up.
+ * Removing an item still moves the ones after it, and their positions in
+ * the index as well, so lists detached from all the time stay plain lists.
+ * An item may only be in an indexed list once, and the items must not be
+ * written directly.
+ */
+struct wsm_list *create_indexed_list(void);
 void list_free(struct wsm_list *list);
-void list_add(struct wsm_list *list, void *item);
-void list_insert(struct wsm_list *list, int index, void *item);
+/**
+ * @brief false if the item could not be added, the list is unchanged then.
+ */
+bool list_add(struct wsm_list *list, void *item);
+bool list_insert(struct wsm_list *list, int index, void *item);
 void list_del(struct wsm_list *list, int index);
 void list_cat(struct wsm_list *list, struct wsm_list *source);
 void list_qsort(struct wsm_list *list, int compare(const void *left, const void *right));
 int list_seq_find(struct wsm_list *list, int compare(const void *item, const void *cmp_to), const void *cmp_to);
 int list_find(struct wsm_list *list, const void *item);
+bool list_contains(struct wsm_list *list, const void *item);
 void list_stable_sort(struct wsm_list *list, int compare(const void *a, const void *b));
 void list_swap(struct wsm_list *list, int src, int dest);
 void list_move_to_end(struct wsm_list *list, void *item);
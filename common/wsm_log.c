@@ -24,21 +24,75 @@ THE SOFTWARE.
 
 #include "wsm_log.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
+// Records longer than this are truncated
+#define LOG_RECORD_TEXT 488
+// Records per thread. The last LOG_RING_ERROR_RESERVE slots only take
+// errors, so a burst of info and debug records can't crowd them out. A
+// ring that is completely full drops new records of any level.
+#define LOG_RING_SIZE 512
+#define LOG_RING_ERROR_RESERVE 64
+#define LOG_COALESCE_MS 2
+#define LOG_WRITE_BUFFER (64 * 1024)
+#define LOG_JOURNAL_MAGIC "WSMLOG1\n"
+
 static terminate_callback_t log_terminate = exit;
 static const long NSEC_PER_SEC = 1000000000;
 
+struct log_record {
+    struct timespec ts; // since start_time
+    wsm_log_importance_t verbosity;
+    uint16_t len;
+    char text[LOG_RECORD_TEXT];
+};
+
+// Written by one thread, read by the writer thread
+struct log_ring {
+    _Atomic uint32_t head; // next record to write
+    _Atomic uint32_t tail; // next record to read
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t dropped_errors;
+    atomic_bool in_use;
+    struct log_ring *next;
+    struct log_record records[LOG_RING_SIZE];
+};
+
+struct log_writer {
+    pthread_t thread;
+    _Atomic(struct log_ring *) rings;
+    pthread_key_t ring_key;
+    pthread_mutex_t drain_lock; // the writer thread or a flush drains
+    int wake_fds[2];
+    atomic_bool wake_pending;
+    atomic_bool running;
+    int journal_fd;
+    char buffer[LOG_WRITE_BUFFER];
+    size_t buffer_len;
+};
+
+static struct log_writer *writer = NULL;
+static _Thread_local struct log_ring *thread_ring = NULL;
+
+wsm_log_importance_t _wsm_log_importance = WSM_ERROR;
+
 void _wsm_abort(const char *format, ...) {
     va_list args;
     va_start(args, format);
     _wsm_vlog(WSM_ERROR, format, args);
     va_end(args);
+    wsm_log_flush();
     log_terminate(EXIT_FAILURE);
 }
 
@@ -53,6 +107,7 @@ bool _wsm_assert(bool condition, const char *format, ...) {
     va_end(args);
 
 #ifndef NDEBUG
+    wsm_log_flush();
     raise(SIGABRT);
 #endif
 
@@ -60,8 +115,8 @@ bool _wsm_assert(bool condition, const char *format, ...) {
 }
 
 static bool colored = true;
+static bool stderr_tty = false;
 static struct timespec start_time = {-1, -1};
-static wsm_log_importance_t log_importance = WSM_ERROR;
 
 static const char *verbosity_colors[] = {
     [WSM_SILENT] = "",
@@ -92,59 +147,354 @@ static void init_start_time(void) {
         return;
     }
     clock_gettime(CLOCK_MONOTONIC, &start_time);
+    stderr_tty = isatty(STDERR_FILENO);
 }
 
-static void wsm_log_stderr(wsm_log_importance_t verbosity, const char *fmt,
-                            va_list args) {
-    init_start_time();
+static void record_init(struct log_record *record, wsm_log_importance_t verbosity,
+                        const char *fmt, va_list args) {
+    clock_gettime(CLOCK_MONOTONIC, &record->ts);
+    timespec_sub(&record->ts, &record->ts, &start_time);
+    record->verbosity = verbosity;
+
+    int len = vsnprintf(record->text, sizeof(record->text), fmt, args);
+    if (len < 0) {
+        len = 0;
+    } else if ((size_t)len >= sizeof(record->text)) {
+        len = sizeof(record->text) - 1;
+    }
+    record->len = len;
+}
 
-    if (verbosity > log_importance) {
+// Formats the stderr line of @record into @buf, returns its length
+static size_t record_format(const struct log_record *record, char *buf, size_t size) {
+    unsigned c = (record->verbosity < WSM_LOG_IMPORTANCE_LAST) ? record->verbosity :
+                     WSM_LOG_IMPORTANCE_LAST - 1;
+    bool color = colored && stderr_tty;
+    int len = snprintf(buf, size, "%02d:%02d:%02d.%03ld %s%s%.*s%s\n",
+                       (int)(record->ts.tv_sec / 60 / 60),
+                       (int)(record->ts.tv_sec / 60 % 60), (int)(record->ts.tv_sec % 60),
+                       record->ts.tv_nsec / 1000000,
+                       color ? verbosity_colors[c] : verbosity_headers[c],
+                       color ? "" : " ",
+                       (int)record->len, record->text,
+                       color ? "\x1B[0m" : "");
+    if (len < 0) {
+        return 0;
+    }
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
+
+static void write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void writer_flush_buffer(void) {
+    write_all(STDERR_FILENO, writer->buffer, writer->buffer_len);
+    writer->buffer_len = 0;
+}
+
+static void writer_append(const char *data, size_t len) {
+    if (writer->buffer_len + len > sizeof(writer->buffer)) {
+        writer_flush_buffer();
+    }
+    memcpy(writer->buffer + writer->buffer_len, data, len);
+    writer->buffer_len += len;
+}
+
+static void writer_journal(const struct log_record *record) {
+    if (writer->journal_fd < 0) {
         return;
     }
+    struct {
+        uint64_t nsec;
+        uint8_t verbosity;
+        uint8_t pad;
+        uint16_t len;
+    } header = {
+        .nsec = (uint64_t)record->ts.tv_sec * NSEC_PER_SEC + record->ts.tv_nsec,
+        .verbosity = record->verbosity,
+        .len = record->len,
+    };
+    write_all(writer->journal_fd, (const char *)&header, sizeof(header));
+    write_all(writer->journal_fd, record->text, record->len);
+}
 
-    struct timespec ts = {0};
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    timespec_sub(&ts, &ts, &start_time);
+static void writer_drain_ring(struct log_ring *ring) {
+    uint64_t dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+    uint64_t dropped_errors =
+        atomic_exchange_explicit(&ring->dropped_errors, 0, memory_order_relaxed);
+    if (dropped || dropped_errors) {
+        char line[96];
+        int len = snprintf(line, sizeof(line), "[log] dropped %llu messages, %llu of them errors\n",
+                           (unsigned long long)(dropped + dropped_errors),
+                           (unsigned long long)dropped_errors);
+        writer_append(line, len);
+    }
 
-    fprintf(stderr, "%02d:%02d:%02d.%03ld ", (int)(ts.tv_sec / 60 / 60),
-            (int)(ts.tv_sec / 60 % 60), (int)(ts.tv_sec % 60),
-            ts.tv_nsec / 1000000);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    char line[LOG_RECORD_TEXT + 64];
+    for (; tail != head; tail++) {
+        const struct log_record *record = &ring->records[tail % LOG_RING_SIZE];
+        writer_append(line, record_format(record, line, sizeof(line)));
+        writer_journal(record);
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
 
-    unsigned c = (verbosity < WSM_LOG_IMPORTANCE_LAST) ? verbosity :
-                     WSM_LOG_IMPORTANCE_LAST - 1;
+static void writer_drain(void) {
+    pthread_mutex_lock(&writer->drain_lock);
+    struct log_ring *ring = atomic_load_explicit(&writer->rings, memory_order_acquire);
+    for (; ring; ring = ring->next) {
+        writer_drain_ring(ring);
+    }
+    writer_flush_buffer();
+    pthread_mutex_unlock(&writer->drain_lock);
+}
 
-    if (colored && isatty(STDERR_FILENO)) {
-        fprintf(stderr, "%s", verbosity_colors[c]);
-    } else {
-        fprintf(stderr, "%s ", verbosity_headers[c]);
+// Drop the wakeups, one drain covers all of them. True if one of them
+// was urgent.
+static bool writer_read_wakeups(void) {
+    bool urgent = false;
+    char wakeups[64];
+    ssize_t len;
+    while ((len = read(writer->wake_fds[0], wakeups, sizeof(wakeups))) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            urgent |= wakeups[i] != 0;
+        }
     }
+    return urgent;
+}
 
-    vfprintf(stderr, fmt, args);
+static void *writer_thread(void *data) {
+    // Logging must never get the signals meant for the compositor
+    sigset_t set;
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
 
-    if (colored && isatty(STDERR_FILENO)) {
-        fprintf(stderr, "\x1B[0m");
+    struct pollfd pfd = { .fd = writer->wake_fds[0], .events = POLLIN };
+    while (atomic_load(&writer->running)) {
+        if (poll(&pfd, 1, -1) < 0) {
+            continue;
+        }
+        // Give a burst of messages time to queue up behind the first one,
+        // errors and a filling ring don't wait
+        if (!writer_read_wakeups() && poll(&pfd, 1, LOG_COALESCE_MS) > 0) {
+            writer_read_wakeups();
+        }
+        // Messages queued while draining don't wake the writer again. Once
+        // the flag is cleared, the exchange orders their records before
+        // the second drain.
+        writer_drain();
+        atomic_exchange(&writer->wake_pending, false);
+        writer_drain();
     }
-    fprintf(stderr, "\n");
+    writer_drain();
+    return NULL;
+}
+
+// A full pipe already holds a wakeup the writer has yet to read
+static bool writer_send_wakeup(bool urgent) {
+    char c = urgent;
+    ssize_t ret;
+    do {
+        ret = write(writer->wake_fds[1], &c, 1);
+    } while (ret < 0 && errno == EINTR);
+    return ret == 1 || (ret < 0 && errno == EAGAIN);
+}
+
+static void writer_wake(bool urgent) {
+    bool pending = atomic_exchange(&writer->wake_pending, true);
+    if ((!pending || urgent) && !writer_send_wakeup(urgent)) {
+        // Let the next message try again
+        atomic_store(&writer->wake_pending, false);
+    }
+}
+
+// A ring stays in the list when its thread exits, for the next thread
+static void release_thread_ring(void *data) {
+    struct log_ring *ring = data;
+    atomic_store(&ring->in_use, false);
+}
+
+static struct log_ring *get_thread_ring(void) {
+    if (thread_ring) {
+        return thread_ring;
+    }
+
+    struct log_ring *ring = atomic_load(&writer->rings);
+    for (; ring; ring = ring->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&ring->in_use, &expected, true)) {
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = calloc(1, sizeof(struct log_ring));
+        if (!ring) {
+            return NULL;
+        }
+        atomic_init(&ring->in_use, true);
+        struct log_ring *head = atomic_load(&writer->rings);
+        do {
+            ring->next = head;
+        } while (!atomic_compare_exchange_weak(&writer->rings, &head, ring));
+    }
+
+    pthread_setspecific(writer->ring_key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+static void wsm_log_stderr(wsm_log_importance_t verbosity, const char *fmt,
+                            va_list args) {
+    struct log_record record;
+    record_init(&record, verbosity, fmt, args);
+    char line[LOG_RECORD_TEXT + 64];
+    write_all(STDERR_FILENO, line, record_format(&record, line, sizeof(line)));
+}
+
+static void wsm_log_async(wsm_log_importance_t verbosity, const char *fmt,
+                          va_list args) {
+    struct log_ring *ring = get_thread_ring();
+    if (!ring) {
+        wsm_log_stderr(verbosity, fmt, args);
+        return;
+    }
+
+    // Never wait for the writer, it may be blocked on a full stderr
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t used = head - tail;
+    if (used >= LOG_RING_SIZE) {
+        atomic_fetch_add_explicit(verbosity <= WSM_ERROR ? &ring->dropped_errors :
+                                  &ring->dropped, 1, memory_order_relaxed);
+        writer_wake(false);
+        return;
+    }
+    if (verbosity > WSM_ERROR && used >= LOG_RING_SIZE - LOG_RING_ERROR_RESERVE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        writer_wake(false);
+        return;
+    }
+
+    record_init(&ring->records[head % LOG_RING_SIZE], verbosity, fmt, args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    // Errors are written right away, as is a ring filling up before the
+    // writer got to it
+    writer_wake(verbosity <= WSM_ERROR || used + 1 == LOG_RING_SIZE / 2);
+}
+
+static void writer_start(void) {
+    struct log_writer *new_writer = calloc(1, sizeof(struct log_writer));
+    if (!new_writer) {
+        return;
+    }
+    new_writer->journal_fd = -1;
+    atomic_init(&new_writer->running, true);
+    pthread_mutex_init(&new_writer->drain_lock, NULL);
+    if (pipe(new_writer->wake_fds) < 0) {
+        free(new_writer);
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(new_writer->wake_fds[i], F_SETFD, FD_CLOEXEC);
+        fcntl(new_writer->wake_fds[i], F_SETFL, O_NONBLOCK);
+    }
+    pthread_key_create(&new_writer->ring_key, release_thread_ring);
+
+    writer = new_writer;
+    if (pthread_create(&writer->thread, NULL, writer_thread, NULL) != 0) {
+        close(writer->wake_fds[0]);
+        close(writer->wake_fds[1]);
+        free(writer);
+        writer = NULL;
+        return;
+    }
+    atexit(wsm_log_finish);
 }
 
 void wsm_log_init(wsm_log_importance_t verbosity, terminate_callback_t callback) {
     init_start_time();
 
     if (verbosity < WSM_LOG_IMPORTANCE_LAST) {
-        log_importance = verbosity;
+        _wsm_log_importance = verbosity;
     }
     if (callback) {
         log_terminate = callback;
     }
+
+    if (!writer && _wsm_log_importance != WSM_SILENT) {
+        writer_start();
+    }
+}
+
+bool wsm_log_set_journal(const char *path) {
+    if (!writer) {
+        return false;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (lseek(fd, 0, SEEK_END) == 0) {
+        write_all(fd, LOG_JOURNAL_MAGIC, strlen(LOG_JOURNAL_MAGIC));
+    }
+
+    pthread_mutex_lock(&writer->drain_lock);
+    if (writer->journal_fd >= 0) {
+        close(writer->journal_fd);
+    }
+    writer->journal_fd = fd;
+    pthread_mutex_unlock(&writer->drain_lock);
+    return true;
+}
+
+void wsm_log_flush(void) {
+    if (writer) {
+        writer_drain();
+    }
+}
+
+void wsm_log_finish(void) {
+    if (!writer || !atomic_exchange(&writer->running, false)) {
+        return;
+    }
+    if (writer_send_wakeup(true)) {
+        pthread_join(writer->thread, NULL);
+        return;
+    }
+    // The writer never wakes up to exit, drain what is left from here
+    pthread_detach(writer->thread);
+    writer_drain();
 }
 
 void _wsm_vlog(wsm_log_importance_t verbosity, const char *fmt, va_list args) {
-    wsm_log_stderr(verbosity, fmt, args);
+    init_start_time();
+
+    if (verbosity > _wsm_log_importance) {
+        return;
+    }
+
+    if (writer && atomic_load_explicit(&writer->running, memory_order_relaxed)) {
+        wsm_log_async(verbosity, fmt, args);
+    } else {
+        wsm_log_stderr(verbosity, fmt, args);
+    }
 }
 
 void _wsm_log(wsm_log_importance_t verbosity, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    wsm_log_stderr(verbosity, fmt, args);
+    _wsm_vlog(verbosity, fmt, args);
     va_end(args);
 }
@@ -50,10 +50,41 @@ void error_handler(int sig);
 
 typedef void (*terminate_callback_t)(int exit_code);
 
+// Messages above this level are compiled out, release builds lower it
+#ifndef WSM_LOG_MAX_LEVEL
+#define WSM_LOG_MAX_LEVEL 3
+#endif
+
+// Current runtime level, only read by the logging macros
+extern wsm_log_importance_t _wsm_log_importance;
+
 // Will log all messages less than or equal to `verbosity`
 // The `terminate` callback is called by `wsm_abort`
 void wsm_log_init(wsm_log_importance_t verbosity, terminate_callback_t terminate);
 
+/**
+ * @brief also append every message to a binary journal at @path
+ *
+ * @details records are a u64 timestamp in ns, u8 level, u8 padding,
+ * u16 length and the message text. Only available once wsm_log_init()
+ * started the writer thread.
+ */
+bool wsm_log_set_journal(const char *path);
+
+/**
+ * @brief write out every queued message before returning
+ */
+void wsm_log_flush(void);
+
+/**
+ * @brief flush and stop the writer thread, later messages are synchronous
+ */
+void wsm_log_finish(void);
+
+static inline bool wsm_log_enabled(wsm_log_importance_t verbosity) {
+    return verbosity <= WSM_LOG_MAX_LEVEL && verbosity <= _wsm_log_importance;
+}
+
 void timespec_sub(struct timespec *r, const struct timespec *a,
                   const struct timespec *b);
 
@@ -69,11 +100,20 @@ bool _wsm_assert(bool condition, const char* format, ...) ATTRIB_PRINTF(2, 3);
 #define _WSM_FILENAME __FILE__
 #endif
 
+// The arguments are not evaluated for filtered levels
 #define wsm_log(verb, fmt, ...) \
-_wsm_log(verb, "[%s:%d] " fmt, _WSM_FILENAME, __LINE__, ##__VA_ARGS__)
+    do { \
+        if (wsm_log_enabled(verb)) { \
+            _wsm_log(verb, "[%s:%d] " fmt, _WSM_FILENAME, __LINE__, ##__VA_ARGS__); \
+        } \
+    } while (0)
 
 #define wsm_vlog(verb, fmt, args) \
-    _wsm_vlog(verb, "[%s:%d] " fmt, _WSM_FILENAME, __LINE__, args)
+    do { \
+        if (wsm_log_enabled(verb)) { \
+            _wsm_vlog(verb, "[%s:%d] " fmt, _WSM_FILENAME, __LINE__, args); \
+        } \
+    } while (0)
 
 #define wsm_log_errno(verb, fmt, ...) \
     wsm_log(verb, fmt ": %s", ##__VA_ARGS__, strerror(errno))
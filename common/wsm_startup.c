@@ -0,0 +1,178 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_log.h"
+#include "wsm_startup.h"
+#include "wsm_trace.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#define STARTUP_MAX_PHASES 32
+#define STARTUP_MAX_TASKS 8
+
+struct startup_phase {
+    const char *name;
+    uint64_t duration_ns;
+};
+
+struct wsm_init_task {
+    const char *name;
+    wsm_init_task_func_t func;
+    void *data;
+    pthread_t thread;
+    bool threaded;
+
+    uint64_t start_ns;
+    _Atomic uint64_t duration_ns; // 0 until the task is done
+    uint64_t waited_ns; // main thread blocked in the join
+};
+
+// Phases are only marked from the main thread
+static struct {
+    uint64_t begin_ns;
+    uint64_t last_ns;
+    struct startup_phase phases[STARTUP_MAX_PHASES];
+    int phase_count;
+    struct wsm_init_task tasks[STARTUP_MAX_TASKS];
+    int task_count;
+    bool reported;
+} startup;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void wsm_startup_begin(void) {
+    startup.begin_ns = startup.last_ns = now_ns();
+}
+
+void wsm_startup_mark(const char *name) {
+    if (!startup.begin_ns || startup.reported) {
+        return;
+    }
+
+    uint64_t now = now_ns();
+    if (wsm_trace_is_enabled()) {
+        struct wsm_trace_span span = { .name = name, .start_ns = startup.last_ns };
+        _wsm_trace_record(&span);
+    }
+    if (startup.phase_count < STARTUP_MAX_PHASES) {
+        startup.phases[startup.phase_count++] = (struct startup_phase){
+            .name = name,
+            .duration_ns = now - startup.last_ns,
+        };
+    }
+    startup.last_ns = now;
+}
+
+static double to_ms(uint64_t ns) {
+    return ns / 1e6;
+}
+
+void wsm_startup_first_frame(void) {
+    if (!startup.begin_ns || startup.reported) {
+        return;
+    }
+    wsm_startup_mark("first frame");
+    startup.reported = true;
+
+    uint64_t total = startup.last_ns - startup.begin_ns;
+    wsm_log(WSM_INFO, "Startup: first frame after %.1f ms", to_ms(total));
+    for (int i = 0; i < startup.phase_count; ++i) {
+        struct startup_phase *phase = &startup.phases[i];
+        wsm_log(WSM_INFO, "  %-24s %8.1f ms %5.1f%%", phase->name,
+                to_ms(phase->duration_ns),
+                total ? 100.0 * phase->duration_ns / total : 0.0);
+    }
+    for (int i = 0; i < startup.task_count; ++i) {
+        struct wsm_init_task *task = &startup.tasks[i];
+        uint64_t duration = atomic_load(&task->duration_ns);
+        if (duration) {
+            wsm_log(WSM_INFO, "  %-24s %8.1f ms in background, %.1f ms waited",
+                    task->name, to_ms(duration), to_ms(task->waited_ns));
+        } else {
+            wsm_log(WSM_INFO, "  %-24s still running in background", task->name);
+        }
+    }
+}
+
+static void run_task(struct wsm_init_task *task) {
+    WSM_TRACE_BEGIN(span, task->name);
+    task->func(task->data);
+    WSM_TRACE_END(span);
+    uint64_t duration = now_ns() - task->start_ns;
+    atomic_store(&task->duration_ns, duration ? duration : 1);
+}
+
+static void *task_thread(void *data) {
+    run_task(data);
+    return NULL;
+}
+
+struct wsm_init_task *wsm_init_task_start(const char *name,
+                                          wsm_init_task_func_t func, void *data) {
+    if (!wsm_assert(startup.task_count < STARTUP_MAX_TASKS,
+                    "Too many startup tasks")) {
+        func(data);
+        return NULL;
+    }
+
+    struct wsm_init_task *task = &startup.tasks[startup.task_count++];
+    task->name = name;
+    task->func = func;
+    task->data = data;
+    task->start_ns = now_ns();
+    // Signals are for the event loop of the main thread, see
+    // wl_event_loop_add_signal(). The thread starts with all of them blocked.
+    sigset_t set, old;
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    task->threaded = pthread_create(&task->thread, NULL, task_thread, task) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (!task->threaded) {
+        wsm_log(WSM_ERROR, "Unable to start a thread for %s, running it now", name);
+        run_task(task);
+    }
+    return task;
+}
+
+void wsm_init_task_join(struct wsm_init_task **task) {
+    if (!*task) {
+        return;
+    }
+
+    if ((*task)->threaded) {
+        uint64_t start = now_ns();
+        pthread_join((*task)->thread, NULL);
+        (*task)->waited_ns = now_ns() - start;
+        (*task)->threaded = false;
+    }
+    *task = NULL;
+}
@@ -0,0 +1,66 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_STARTUP_H
+#define WSM_STARTUP_H
+
+#include <stdbool.h>
+
+struct wsm_init_task;
+
+typedef void (*wsm_init_task_func_t)(void *data);
+
+/**
+ * @brief start the startup clock, everything before it is not accounted
+ */
+void wsm_startup_begin(void);
+/**
+ * @brief end the startup phase @p name, timed from the previous mark.
+ *
+ * @details @p name has to be a string literal. Phases also show up as
+ * spans in the trace when tracing is enabled.
+ */
+void wsm_startup_mark(const char *name);
+/**
+ * @brief mark the first presented frame and log the startup breakdown,
+ * only the first call does anything
+ */
+void wsm_startup_first_frame(void);
+
+/**
+ * @brief run @p func in a background thread during startup.
+ *
+ * @details the task must only touch state that the main thread leaves
+ * alone until wsm_init_task_join(). Runs @p func synchronously if no
+ * thread can be started.
+ */
+struct wsm_init_task *wsm_init_task_start(const char *name,
+                                          wsm_init_task_func_t func, void *data);
+/**
+ * @brief wait for the task in @p task to finish, then clear the pointer.
+ * Does nothing for a NULL task, so it can guard every first use.
+ */
+void wsm_init_task_join(struct wsm_init_task **task);
+
+#endif
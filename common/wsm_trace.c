@@ -0,0 +1,141 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_trace.h"
+#include "wsm_log.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Spans kept per thread, older ones are overwritten
+#define TRACE_RING_SIZE 16384
+
+struct trace_event {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+};
+
+// Written by its thread, read by wsm_trace_dump()
+struct trace_ring {
+    _Atomic uint64_t head;
+    int tid;
+    struct trace_ring *next;
+    struct trace_event events[TRACE_RING_SIZE];
+};
+
+bool _wsm_trace_enabled = false;
+
+static _Atomic(struct trace_ring *) trace_rings = NULL;
+static atomic_int trace_next_tid = 1;
+static _Thread_local struct trace_ring *thread_ring = NULL;
+
+uint64_t _wsm_trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct trace_ring *get_thread_ring(void) {
+    if (thread_ring) {
+        return thread_ring;
+    }
+
+    struct trace_ring *ring = calloc(1, sizeof(struct trace_ring));
+    if (!ring) {
+        return NULL;
+    }
+    ring->tid = atomic_fetch_add(&trace_next_tid, 1);
+
+    struct trace_ring *head = atomic_load(&trace_rings);
+    do {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak(&trace_rings, &head, ring));
+
+    thread_ring = ring;
+    return ring;
+}
+
+void _wsm_trace_record(const struct wsm_trace_span *span) {
+    struct trace_ring *ring = get_thread_ring();
+    if (!ring) {
+        return;
+    }
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    struct trace_event *event = &ring->events[head % TRACE_RING_SIZE];
+    event->name = span->name;
+    event->start_ns = span->start_ns;
+    event->duration_ns = _wsm_trace_now() - span->start_ns;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void wsm_trace_set_enabled(bool enabled) {
+    _wsm_trace_enabled = enabled;
+}
+
+bool wsm_trace_is_enabled(void) {
+    return _wsm_trace_enabled;
+}
+
+static void dump_ring(FILE *f, struct trace_ring *ring, bool *first) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    // Leave a margin, the oldest slots may be overwritten while we read
+    uint64_t count = head < TRACE_RING_SIZE - 64 ? head : TRACE_RING_SIZE - 64;
+
+    for (uint64_t i = head - count; i < head; i++) {
+        const struct trace_event *event = &ring->events[i % TRACE_RING_SIZE];
+        fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                "\"pid\":%d,\"tid\":%d}", *first ? "" : ",", event->name,
+                event->start_ns / 1000.0, event->duration_ns / 1000.0,
+                (int)getpid(), ring->tid);
+        *first = false;
+    }
+}
+
+bool wsm_trace_dump(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        wsm_log_errno(WSM_ERROR, "Unable to open trace file %s", path);
+        return false;
+    }
+
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    struct trace_ring *ring = atomic_load(&trace_rings);
+    for (; ring; ring = ring->next) {
+        dump_ring(f, ring, &first);
+    }
+    fprintf(f, "\n]}\n");
+
+    if (fclose(f) != 0) {
+        wsm_log_errno(WSM_ERROR, "Unable to write trace file %s", path);
+        return false;
+    }
+    wsm_log(WSM_INFO, "Wrote trace to %s", path);
+    return true;
+}
@@ -0,0 +1,87 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_TRACE_H
+#define WSM_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief a span being measured, lives on the stack of the traced code
+ */
+struct wsm_trace_span {
+    const char *name;
+    uint64_t start_ns;
+};
+
+// Only read by the tracing macros, use wsm_trace_set_enabled()
+extern bool _wsm_trace_enabled;
+
+uint64_t _wsm_trace_now(void);
+void _wsm_trace_record(const struct wsm_trace_span *span);
+
+/**
+ * @brief start or stop recording spans, disabled spans cost one branch
+ */
+void wsm_trace_set_enabled(bool enabled);
+bool wsm_trace_is_enabled(void);
+
+/**
+ * @brief write the recorded spans of every thread as Chrome trace JSON
+ *
+ * @details the file can be opened in ui.perfetto.dev or chrome://tracing.
+ * Each thread keeps only its most recent spans.
+ */
+bool wsm_trace_dump(const char *path);
+
+static inline void wsm_trace_begin(struct wsm_trace_span *span, const char *name) {
+    span->name = name;
+    span->start_ns = _wsm_trace_enabled ? _wsm_trace_now() : 0;
+}
+
+static inline void wsm_trace_end(struct wsm_trace_span *span) {
+    if (span->start_ns) {
+        _wsm_trace_record(span);
+    }
+}
+
+// @name has to be a string literal or otherwise outlive the trace
+#define WSM_TRACE_BEGIN(var, name) \
+    struct wsm_trace_span var; \
+    wsm_trace_begin(&var, name)
+
+#define WSM_TRACE_END(var) wsm_trace_end(&var)
+
+#ifdef __GNUC__
+// Span ending when the enclosing block is left, early returns included
+#define WSM_TRACE_SCOPE(name) \
+    struct wsm_trace_span _wsm_trace_scope \
+        __attribute__((cleanup(wsm_trace_end))); \
+    wsm_trace_begin(&_wsm_trace_scope, name)
+#else
+#define WSM_TRACE_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,451 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_animation.h"
+#include "wsm_log.h"
+#include "wsm_view.h"
+#include "wsm_seat.h"
+#include "wsm_config.h"
+#include "wsm_common.h"
+#include "wsm_output.h"
+#include "wsm_server.h"
+#include "wsm_container.h"
+#include "wsm_workspace.h"
+#include "wsm_list.h"
+#include "wsm_input_manager.h"
+#include "node/wsm_node_descriptor.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+
+// Skip transitions when the measured render time leaves less than this many
+// milliseconds of the output's frame budget.
+#define ANIMATION_MIN_HEADROOM_MS 4
+// Part of the output width the old workspace slides over
+#define ANIMATION_WORKSPACE_SLIDE 0.25
+
+static struct wl_list animations = { &animations, &animations };
+
+static double ease_out_cubic(double t) {
+    double inv = 1.0 - t;
+    return 1.0 - inv * inv * inv;
+}
+
+static double lerp(double from, double to, double t) {
+    return from + (to - from) * t;
+}
+
+static bool output_has_headroom(struct wsm_output *output) {
+    if (!output || !output->enabled) {
+        return false;
+    }
+    if (output->refresh_nsec == 0) {
+        return true;
+    }
+    // With max_render_time set, rendering only starts that long before
+    // the vblank
+    int64_t budget_ns = output->max_render_time ?
+        output->max_render_time * 1000000ll : output->refresh_nsec;
+    return budget_ns - output->render_time_ns >= ANIMATION_MIN_HEADROOM_MS * 1000000ll;
+}
+
+static void animation_finish(struct wsm_animation *animation) {
+    struct wsm_view *view = animation->view;
+    if (view && animation->running) {
+        // a transaction might have frozen the view meanwhile
+        wlr_scene_node_set_enabled(&view->content_tree->node, !view->saved_surface_tree);
+    }
+    wlr_scene_node_destroy(&animation->tree->node);
+}
+
+// The tree goes away either through animation_finish() or together with
+// its parent, free the animation in both cases.
+static void handle_tree_destroy(struct wl_listener *listener, void *data) {
+    struct wsm_animation *animation =
+        wl_container_of(listener, animation, tree_destroy);
+    if (animation->view && animation->view->animation == animation) {
+        animation->view->animation = NULL;
+    }
+    wl_list_remove(&animation->tree_destroy.link);
+    wl_list_remove(&animation->output_disable.link);
+    wl_list_remove(&animation->link);
+    free(animation);
+}
+
+static void handle_output_disable(struct wl_listener *listener, void *data) {
+    struct wsm_animation *animation =
+        wl_container_of(listener, animation, output_disable);
+    animation_finish(animation);
+}
+
+static struct wsm_animation *animation_create(struct wlr_scene_tree *parent,
+                                              struct wsm_output *output) {
+    struct wsm_animation *animation = calloc(1, sizeof(struct wsm_animation));
+    if (!wsm_assert(animation, "Unable to allocate animation")) {
+        return NULL;
+    }
+
+    animation->tree = wlr_scene_tree_create(parent);
+    if (!animation->tree) {
+        free(animation);
+        return NULL;
+    }
+    // output_configure_scene() leaves the opacity of the snapshots to us
+    if (!wsm_scene_descriptor_assign(&animation->tree->node,
+                                     WSM_SCENE_DESC_ANIMATION, animation)) {
+        wlr_scene_node_destroy(&animation->tree->node);
+        free(animation);
+        return NULL;
+    }
+    // shown once the animation runs
+    wlr_scene_node_set_enabled(&animation->tree->node, false);
+
+    animation->output = output;
+    animation->duration_ms = global_config.animation_duration_ms;
+    animation->tree_destroy.notify = handle_tree_destroy;
+    wl_signal_add(&animation->tree->node.events.destroy, &animation->tree_destroy);
+    animation->output_disable.notify = handle_output_disable;
+    wl_signal_add(&output->events.disable, &animation->output_disable);
+    wl_list_insert(&animations, &animation->link);
+    return animation;
+}
+
+static void animation_run(struct wsm_animation *animation) {
+    animation->running = true;
+    clock_gettime(CLOCK_MONOTONIC, &animation->start);
+    wlr_scene_node_set_enabled(&animation->tree->node, true);
+}
+
+// Move the snapshot by dx, dy and return its extents
+static struct wlr_box snapshot_offset(struct wlr_scene_buffer *snapshot, int dx, int dy) {
+    wlr_scene_node_set_position(&snapshot->node, snapshot->node.x + dx, snapshot->node.y + dy);
+    return (struct wlr_box){
+        .x = snapshot->node.x,
+        .y = snapshot->node.y,
+        .width = snapshot->dst_width,
+        .height = snapshot->dst_height,
+    };
+}
+
+// Saved buffers in snapshot mode already are a single texture of the old
+// state, show that one instead of rendering it again
+static struct wlr_scene_buffer *saved_snapshot_reuse(struct wlr_scene_tree *saved,
+                                                     struct wlr_scene_tree *parent) {
+    if (global_config.saved_buffer_mode != SAVED_BUFFER_SNAPSHOT ||
+        wl_list_length(&saved->children) != 1) {
+        return NULL;
+    }
+    struct wlr_scene_node *node =
+        wl_container_of(saved->children.next, node, link);
+    if (node->type != WLR_SCENE_NODE_BUFFER) {
+        return NULL;
+    }
+    struct wlr_scene_buffer *source = wlr_scene_buffer_from_node(node);
+    if (!source->buffer) {
+        return NULL;
+    }
+
+    struct wlr_scene_buffer *snapshot = wlr_scene_buffer_create(parent, source->buffer);
+    if (!snapshot) {
+        return NULL;
+    }
+    wlr_scene_buffer_set_dest_size(snapshot, source->dst_width, source->dst_height);
+    wlr_scene_node_set_position(&snapshot->node, node->x, node->y);
+    return snapshot;
+}
+
+static void snapshot_scale(struct wlr_scene_buffer *snapshot, const struct wlr_box *box,
+                           double scale_x, double scale_y) {
+    wlr_scene_node_set_position(&snapshot->node,
+                                round(box->x * scale_x), round(box->y * scale_y));
+    wlr_scene_buffer_set_dest_size(snapshot,
+                                   MAX(1, round(box->width * scale_x)),
+                                   MAX(1, round(box->height * scale_y)));
+}
+
+static void view_animation_update(struct wsm_animation *animation, double eased) {
+    double x = lerp(animation->from.x, animation->to.x, eased);
+    double y = lerp(animation->from.y, animation->to.y, eased);
+    double width = lerp(animation->from.width, animation->to.width, eased);
+    double height = lerp(animation->from.height, animation->to.height, eased);
+
+    // the tree sits where the content ends up, offset it back to the
+    // interpolated position
+    wlr_scene_node_set_position(&animation->tree->node,
+                                round(x - animation->to.x), round(y - animation->to.y));
+
+    snapshot_scale(animation->snapshot, &animation->snapshot_box,
+                   animation->to.width ? width / animation->to.width : 1.0,
+                   animation->to.height ? height / animation->to.height : 1.0);
+    wlr_scene_buffer_set_opacity(animation->snapshot,
+                                 lerp(animation->from_alpha, animation->to_alpha, eased));
+
+    // the old state fades out on top of the new one
+    if (animation->old_snapshot) {
+        snapshot_scale(animation->old_snapshot, &animation->old_snapshot_box,
+                       animation->from.width ? width / animation->from.width : 1.0,
+                       animation->from.height ? height / animation->from.height : 1.0);
+        wlr_scene_buffer_set_opacity(animation->old_snapshot, 1.0 - eased);
+    }
+}
+
+static void workspace_animation_update(struct wsm_animation *animation, double eased) {
+    int width, height;
+    wlr_output_effective_resolution(animation->output->wlr_output, &width, &height);
+    wlr_scene_node_set_position(&animation->tree->node,
+                                round(animation->direction * eased * width * ANIMATION_WORKSPACE_SLIDE), 0);
+
+    struct wlr_scene_node *node;
+    wl_list_for_each(node, &animation->tree->children, link) {
+        wlr_scene_buffer_set_opacity(wlr_scene_buffer_from_node(node), 1.0 - eased);
+    }
+}
+
+static void animation_update(struct wsm_animation *animation, double t) {
+    double eased = ease_out_cubic(t);
+    if (animation->view) {
+        view_animation_update(animation, eased);
+    } else {
+        workspace_animation_update(animation, eased);
+    }
+}
+
+static bool view_can_animate(struct wsm_view *view, struct wsm_output *output) {
+    if (global_config.animation_duration_ms == 0 || !view->surface ||
+        !view_is_visible(view)) {
+        return false;
+    }
+
+    // interactive move and resize already follow the pointer
+    struct wsm_seat *seat = input_manager_current_seat();
+    if (!seatop_allows_set_cursor(seat)) {
+        return false;
+    }
+
+    return output_has_headroom(output);
+}
+
+static struct wsm_output *view_output(struct wsm_view *view) {
+    struct wsm_workspace *ws = view->container->current.workspace;
+    return ws ? ws->output : NULL;
+}
+
+void wsm_animation_save(struct wsm_view *view) {
+    wsm_animation_finish(view);
+
+    struct wsm_output *output = view_output(view);
+    if (!view->saved_surface_tree || !view_can_animate(view, output)) {
+        return;
+    }
+
+    struct wsm_animation *animation = animation_create(view->scene_tree, output);
+    if (!animation) {
+        return;
+    }
+    animation->view = view;
+    view->animation = animation;
+
+    struct wlr_scene_node *saved = &view->saved_surface_tree->node;
+    animation->old_snapshot = saved_snapshot_reuse(view->saved_surface_tree, animation->tree);
+    if (!animation->old_snapshot) {
+        animation->old_snapshot = scene_node_snapshot_create(saved, animation->tree);
+    }
+    if (!animation->old_snapshot) {
+        animation_finish(animation);
+        return;
+    }
+    animation->old_snapshot_box = snapshot_offset(animation->old_snapshot, saved->x, saved->y);
+}
+
+void wsm_animation_start(struct wsm_view *view, const struct wlr_box *from) {
+    // only the state saved while applying the transaction is picked up
+    struct wsm_animation *animation = view->animation;
+    if (animation && animation->running) {
+        wsm_animation_finish(view);
+        animation = NULL;
+    }
+
+    struct wsm_container *con = view->container;
+    struct wsm_output *output = view_output(view);
+    struct wlr_box to = {
+        .x = con->current.content_x,
+        .y = con->current.content_y,
+        .width = con->current.content_width,
+        .height = con->current.content_height,
+    };
+    if (view->saved_surface_tree || !view_can_animate(view, output) ||
+        wlr_box_empty(&to) || wlr_box_equal(from, &to)) {
+        wsm_animation_finish(view);
+        return;
+    }
+
+    if (!animation) {
+        animation = animation_create(view->scene_tree, output);
+        if (!animation) {
+            return;
+        }
+        animation->view = view;
+        view->animation = animation;
+    }
+
+    animation->snapshot = view_snapshot_create(view, animation->tree);
+    if (!animation->snapshot) {
+        animation_finish(animation);
+        return;
+    }
+    // the snapshot is in content tree coordinates, which may be offset
+    // within the view, e.g. to center floating views
+    animation->snapshot_box = snapshot_offset(animation->snapshot,
+                                              view->content_tree->node.x,
+                                              view->content_tree->node.y);
+    if (animation->old_snapshot) {
+        wlr_scene_node_raise_to_top(&animation->old_snapshot->node);
+    }
+
+    animation->to = to;
+    animation->to_alpha = 1.0f;
+    if (wlr_box_empty(from)) {
+        // newly mapped, fade in at the final geometry
+        animation->from = to;
+        animation->from_alpha = 0.0f;
+    } else {
+        animation->from = *from;
+        animation->from_alpha = 1.0f;
+    }
+
+    wlr_scene_node_set_enabled(&view->content_tree->node, false);
+    animation_run(animation);
+    animation_update(animation, 0.0);
+}
+
+void wsm_animation_finish(struct wsm_view *view) {
+    if (view->animation) {
+        animation_finish(view->animation);
+    }
+}
+
+static struct wsm_animation *output_workspace_animation(struct wsm_output *output) {
+    struct wsm_animation *animation;
+    wl_list_for_each(animation, &animations, link) {
+        if (!animation->view && animation->output == output) {
+            return animation;
+        }
+    }
+    return NULL;
+}
+
+static void workspace_snapshot_add(struct wsm_animation *animation,
+                                   struct wlr_scene_node *source, int x, int y) {
+    struct wlr_scene_buffer *snapshot = scene_node_snapshot_create(source, animation->tree);
+    if (snapshot) {
+        snapshot_offset(snapshot, x, y);
+    }
+}
+
+void wsm_animation_save_workspace(struct wsm_output *output, struct wsm_workspace *to) {
+    struct wsm_workspace *from = output->current.active_workspace;
+    if (global_config.animation_duration_ms == 0 || !from || from == to) {
+        return;
+    }
+
+    // a switch during a switch starts over from what is shown now
+    struct wsm_animation *animation = output_workspace_animation(output);
+    if (animation) {
+        animation_finish(animation);
+    }
+    if (!output_has_headroom(output)) {
+        return;
+    }
+
+    animation = animation_create(output->layers.tiling, output);
+    if (!animation) {
+        return;
+    }
+
+    // Both trees of the workspace sit at the output's origin, the
+    // floaters are in layout coordinates
+    struct wlr_scene_node *tiling = &from->layers.non_fullscreen->node;
+    struct wlr_scene_node *fullscreen = &from->layers.fullscreen->node;
+    workspace_snapshot_add(animation, tiling, tiling->x, tiling->y);
+    workspace_snapshot_add(animation, fullscreen, fullscreen->x, fullscreen->y);
+    for (int i = 0; i < from->current.floating->length; ++i) {
+        struct wsm_container *floater = from->current.floating->items[i];
+        struct wlr_scene_node *node = &floater->scene_tree->node;
+        workspace_snapshot_add(animation, node, node->x - output->lx, node->y - output->ly);
+    }
+    if (wl_list_empty(&animation->tree->children)) {
+        animation_finish(animation);
+        return;
+    }
+
+    // slide towards where the old workspace sits in the list
+    int from_index = list_find(output->workspaces, from);
+    int to_index = list_find(output->workspaces, to);
+    animation->direction = to_index >= 0 && to_index < from_index ? 1 : -1;
+}
+
+void wsm_animation_start_workspace(struct wsm_output *output) {
+    struct wsm_animation *animation = output_workspace_animation(output);
+    if (!animation || animation->running) {
+        return;
+    }
+
+    // arranging raised the new workspace above it
+    wlr_scene_node_raise_to_top(&animation->tree->node);
+    animation_run(animation);
+    animation_update(animation, 0.0);
+}
+
+/**
+ * Animations are time based, each one advances with the frames of the
+ * output it runs on.
+ */
+void wsm_animations_tick(struct wsm_output *output) {
+    if (wl_list_empty(&animations)) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    bool headroom = output_has_headroom(output);
+
+    struct wsm_animation *animation, *tmp;
+    wl_list_for_each_safe(animation, tmp, &animations, link) {
+        if (!animation->running || animation->output != output) {
+            continue;
+        }
+        double elapsed_ms = (now.tv_sec - animation->start.tv_sec) * 1000.0 +
+                            (now.tv_nsec - animation->start.tv_nsec) / 1000000.0;
+        double t = elapsed_ms / animation->duration_ms;
+        if (!headroom || t >= 1.0) {
+            animation_finish(animation);
+            continue;
+        }
+        animation_update(animation, t);
+    }
+}
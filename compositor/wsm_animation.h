@@ -0,0 +1,102 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_ANIMATION_H
+#define WSM_ANIMATION_H
+
+#include <time.h>
+#include <stdbool.h>
+
+#include <wayland-server-core.h>
+
+#include <wlr/util/box.h>
+
+/**
+ * Layout transitions run entirely on the compositor side.
+ *
+ * While a transaction is applied, the state the view showed until then is
+ * rendered from its saved buffers into one snapshot. Once applied, the
+ * client has already drawn its final size and the new content goes into a
+ * second snapshot. Both are moved and scaled from the old geometry to the
+ * new one while the old state fades out on top. The client is configured
+ * only once, by the transaction itself.
+ *
+ * Workspace switches keep a snapshot of the workspace left behind, which
+ * slides out and fades over the new one.
+ *
+ * Every animation is advanced from the frame events of the output it
+ * started on.
+ */
+
+struct wsm_view;
+struct wsm_output;
+struct wsm_workspace;
+struct wlr_scene_tree;
+struct wlr_scene_buffer;
+
+struct wsm_animation {
+    struct wsm_view *view;       // NULL for workspace switches
+    struct wsm_output *output;
+    struct wlr_scene_tree *tree;
+    struct wlr_scene_buffer *snapshot;
+    struct wlr_box snapshot_box; // snapshot extents at the final size
+    struct wlr_scene_buffer *old_snapshot;
+    struct wlr_box old_snapshot_box; // extents at the old size
+
+    struct wlr_box from, to;     // content geometry in layout coordinates
+    float from_alpha, to_alpha;
+    int direction;               // workspace switches, -1 or 1
+    bool running;
+
+    struct timespec start;
+    uint32_t duration_ms;
+
+    struct wl_listener tree_destroy;
+    struct wl_listener output_disable;
+    struct wl_list link;
+};
+
+/**
+ * @brief keep what the view shows before a transaction is applied
+ *
+ * @details must be called while the view still has its saved buffers,
+ * wsm_animation_start() then crossfades from it.
+ */
+void wsm_animation_save(struct wsm_view *view);
+/**
+ * @brief start a transition of the view from its old content geometry
+ *
+ * @details the view must already be arranged at its new geometry. Does
+ * nothing if animations are disabled or the output has no time to spare.
+ */
+void wsm_animation_start(struct wsm_view *view, const struct wlr_box *from);
+void wsm_animation_finish(struct wsm_view *view);
+/**
+ * @brief keep the workspace @p output shows before switching to @p to
+ */
+void wsm_animation_save_workspace(struct wsm_output *output, struct wsm_workspace *to);
+void wsm_animation_start_workspace(struct wsm_output *output);
+void wsm_animations_tick(struct wsm_output *output);
+
+#endif
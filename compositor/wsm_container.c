@@ -42,6 +42,7 @@ THE SOFTWARE.
 #include "wsm_xdg_decoration.h"
 #include "node/wsm_node_descriptor.h"
 #include "node/wsm_image_node.h"
+#include "wsm_layer_cache.h"
 
 #include <stdlib.h>
 #include <float.h>
@@ -174,6 +175,9 @@ struct wsm_container *container_create(struct wsm_view *view) {
     c->title_bar = wsm_titlebar_create();
     c->title_bar->tree = alloc_scene_tree(c->scene_tree, &failed);
     c->title_bar->background = alloc_rect_node(c->title_bar->tree, &failed);
+    if (!failed) {
+        wsm_layer_cache_set_enabled(c->title_bar->tree, true);
+    }
 
     c->sensing.tree = alloc_scene_tree(c->scene_tree, &failed);
     c->content_tree = alloc_scene_tree(c->sensing.tree, &failed);
@@ -212,6 +216,13 @@ struct wsm_container *container_create(struct wsm_view *view) {
         return NULL;
     }
 
+    if (view) {
+        // Kept for the container's lifetime, container_update() only
+        // bypasses it while the window is focused or floating
+        wsm_layer_cache_set_enabled(c->scene_tree, true);
+        wsm_layer_cache_set_bypassed(c->scene_tree, true);
+    }
+
     if (!view) {
         c->pending.children = create_list();
         c->current.children = create_list();
@@ -358,7 +369,7 @@ bool container_is_floating_or_child(struct wsm_container *container) {
 
 bool container_is_floating(struct wsm_container *container) {
     if (!container->pending.parent && container->pending.workspace &&
-        list_find(container->pending.workspace->floating, container) != -1) {
+        list_contains(container->pending.workspace->floating, container)) {
         return true;
     }
     if (container->scratchpad) {
@@ -377,7 +388,8 @@ void container_raise_floating(struct wsm_container *con) {
         wlr_scene_node_raise_to_top(&floater->scene_tree->node);
 
         list_move_to_end(floater->pending.workspace->floating, floater);
-        node_set_dirty(&floater->pending.workspace->node);
+        node_set_dirty_changes(&floater->pending.workspace->node,
+                               WSM_NODE_CHANGE_CHILDREN);
     }
 }
 
@@ -534,6 +546,89 @@ void container_floating_translate(struct wsm_container *con,
     node_set_dirty(&con->node);
 }
 
+// A container can be moved without a transaction only if none of its nodes
+// has state queued or in flight, so pending and current stay in sync.
+static bool container_is_settled(struct wsm_container *con) {
+    if (con->node.dirty || con->node.ntxnrefs > 0 || con->node.destroying) {
+        return false;
+    }
+    if (con->pending.x != con->current.x || con->pending.y != con->current.y ||
+        con->pending.width != con->current.width ||
+        con->pending.height != con->current.height) {
+        return false;
+    }
+    if (con->current.children) {
+        for (int i = 0; i < con->current.children->length; ++i) {
+            struct wsm_container *child = con->current.children->items[i];
+            if (!container_is_settled(child)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void container_translate_settled(struct wsm_container *con,
+                                        double x_amount, double y_amount) {
+    con->pending.x += x_amount;
+    con->pending.y += y_amount;
+    con->pending.content_x += x_amount;
+    con->pending.content_y += y_amount;
+    con->current.x = con->pending.x;
+    con->current.y = con->pending.y;
+    con->current.content_x = con->pending.content_x;
+    con->current.content_y = con->pending.content_y;
+
+    if (con->current.children) {
+        for (int i = 0; i < con->current.children->length; ++i) {
+            struct wsm_container *child = con->current.children->items[i];
+            container_translate_settled(child, x_amount, y_amount);
+        }
+    }
+}
+
+bool container_floating_move_to_settled(struct wsm_container *con,
+                                        double lx, double ly) {
+    if (!container_is_floating(con) || container_is_scratchpad_hidden(con) ||
+        con->current.fullscreen_mode != FULLSCREEN_NONE ||
+        !container_is_settled(con)) {
+        return false;
+    }
+
+    double x_amount = lx - con->pending.x;
+    double y_amount = ly - con->pending.y;
+    if (x_amount == 0 && y_amount == 0) {
+        return true;
+    }
+
+    // Crossing into another workspace needs the full tree update
+    struct wsm_workspace *ws = con->pending.workspace;
+    double center_x = lx + con->pending.width / 2;
+    double center_y = ly + con->pending.height / 2;
+    if (!ws || !ws->output) {
+        return false;
+    }
+    struct wlr_box output_box;
+    output_get_box(ws->output, &output_box);
+    if (!wlr_box_contains_point(&output_box, center_x, center_y)) {
+        return false;
+    }
+
+    container_translate_settled(con, x_amount, y_amount);
+    wlr_scene_node_set_position(&con->scene_tree->node,
+                                con->current.x, con->current.y);
+
+#if HAVE_XWAYLAND
+    // Xwayland views are position-aware, but the size is unchanged so there
+    // is nothing to wait for.
+    if (con->view && con->view->type == WSM_VIEW_XWAYLAND) {
+        view_configure(con->view, con->current.content_x, con->current.content_y,
+                       con->current.content_width, con->current.content_height);
+    }
+#endif
+    return true;
+}
+
 static void floating_natural_resize(struct wsm_container *con) {
     int min_width = 100, max_width = INT_MAX, min_height = 100, max_height = INT_MAX;
 
@@ -681,7 +776,7 @@ struct wsm_list *container_get_siblings(struct wsm_container *container) {
     if (!container->pending.workspace) {
         return NULL;
     }
-    if (list_find(container->pending.workspace->tiling, container) != -1) {
+    if (list_contains(container->pending.workspace->tiling, container)) {
         return container->pending.workspace->tiling;
     }
     return container->pending.workspace->floating;
@@ -1105,6 +1200,12 @@ void container_update(struct wsm_container *con) {
         wsm_text_node_set_color(con->title_bar->title_text, colors->text);
         wsm_text_node_set_background(con->title_bar->title_text, global_config.text_background_color);
     }
+
+    // Inactive tiled windows rarely change, let the scene flatten them
+    if (con->view) {
+        wsm_layer_cache_set_bypassed(con->scene_tree,
+                                     container_is_floating(con) || con->current.focused);
+    }
 }
 
 void container_update_itself_and_parents(struct wsm_container *con) {
@@ -1201,12 +1302,12 @@ struct wsm_container *container_obstructing_fullscreen_container(struct wsm_cont
 
 void disable_container(struct wsm_container *con) {
     if (con->view) {
-        wlr_scene_node_reparent(&con->view->scene_tree->node, con->content_tree);
+        wsm_scene_node_reparent(&con->view->scene_tree->node, con->content_tree);
     } else {
         for (int i = 0; i < con->current.children->length; i++) {
             struct wsm_container *child = con->current.children->items[i];
 
-            wlr_scene_node_reparent(&child->scene_tree->node, con->content_tree);
+            wsm_scene_node_reparent(&child->scene_tree->node, con->content_tree);
 
             disable_container(child);
         }
@@ -288,6 +288,16 @@ void container_raise_floating(struct wsm_container *con);
 void container_fullscreen_disable(struct wsm_container *con);
 void container_floating_move_to(struct wsm_container *con,
                                 double lx, double ly);
+/**
+ * @brief move a floating container without going through a transaction
+ *
+ * @details only a position change is applied, directly to the pending and
+ * current state and to the scene node. Returns false if the container has
+ * state in flight or leaves its workspace, callers then have to fall back
+ * to container_floating_move_to() and a transaction.
+ */
+bool container_floating_move_to_settled(struct wsm_container *con,
+                                        double lx, double ly);
 void container_floating_move_to_center(struct wsm_container *con);
 void container_floating_translate(struct wsm_container *con,
                                   double x_amount, double y_amount);
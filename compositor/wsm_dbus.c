@@ -0,0 +1,234 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_dbus.h"
+#include "wsm_log.h"
+#include "wsm_timer.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <systemd/sd-bus.h>
+
+#include <wayland-server-core.h>
+
+#define STARTUP_SERVICE "org.lychee.Startup"
+#define STARTUP_PATH "/Startup"
+#define STARTUP_INTERFACE "org.lychee.Startup"
+
+#define REGISTER_CALL_TIMEOUT_USEC (5 * 1000 * 1000)
+#define REGISTER_RETRY_MIN_MS 500
+#define REGISTER_RETRY_MAX_MS 30000
+#define REGISTER_MAX_ATTEMPTS 10
+
+struct wsm_dbus {
+    sd_bus *bus;
+    struct wl_event_source *source;
+    struct wsm_timer *bus_timeout; // sd-bus internal timeouts
+
+    sd_bus_slot *register_slot;
+    struct wsm_timer *register_retry;
+    int register_attempts;
+    int register_delay_ms;
+};
+
+static void dbus_update_events(struct wsm_dbus *dbus);
+
+static void dbus_disconnect(struct wsm_dbus *dbus) {
+    if (dbus->source) {
+        wl_event_source_remove(dbus->source);
+        dbus->source = NULL;
+    }
+    wsm_timer_update(dbus->bus_timeout, 0);
+    wsm_timer_update(dbus->register_retry, 0);
+}
+
+static void dbus_dispatch(struct wsm_dbus *dbus) {
+    int ret;
+    do {
+        ret = sd_bus_process(dbus->bus, NULL);
+    } while (ret > 0);
+
+    if (ret < 0) {
+        wsm_log(WSM_ERROR, "Lost the session bus: %s", strerror(-ret));
+        dbus_disconnect(dbus);
+        return;
+    }
+    dbus_update_events(dbus);
+}
+
+static int handle_bus_fd(int fd, uint32_t mask, void *data) {
+    dbus_dispatch(data);
+    return 0;
+}
+
+static int handle_bus_timeout(void *data) {
+    dbus_dispatch(data);
+    return 0;
+}
+
+static void dbus_update_events(struct wsm_dbus *dbus) {
+    if (!dbus->source) {
+        return;
+    }
+
+    int events = sd_bus_get_events(dbus->bus);
+    uint32_t mask = 0;
+    if (events > 0 && (events & POLLIN)) {
+        mask |= WL_EVENT_READABLE;
+    }
+    if (events > 0 && (events & POLLOUT)) {
+        mask |= WL_EVENT_WRITABLE;
+    }
+    wl_event_source_fd_update(dbus->source, mask);
+
+    uint64_t until;
+    if (sd_bus_get_timeout(dbus->bus, &until) < 0 || until == UINT64_MAX) {
+        wsm_timer_update(dbus->bus_timeout, 0);
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_usec = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    uint64_t delay_ms = until > now_usec ? (until - now_usec + 999) / 1000 : 0;
+    // 0 would disarm the timer, an already passed timeout is due right away
+    wsm_timer_update(dbus->bus_timeout,
+                     delay_ms < 1 ? 1 : delay_ms > INT_MAX ? INT_MAX : (int)delay_ms);
+}
+
+static int send_register(struct wsm_dbus *dbus);
+
+static int handle_register_retry(void *data) {
+    struct wsm_dbus *dbus = data;
+    if (send_register(dbus) < 0) {
+        // Nothing can be sent on this connection anymore
+        return 0;
+    }
+    dbus_update_events(dbus);
+    return 0;
+}
+
+static int handle_register_reply(sd_bus_message *reply, void *data,
+                                 sd_bus_error *ret_error) {
+    struct wsm_dbus *dbus = data;
+    dbus->register_slot = sd_bus_slot_unref(dbus->register_slot);
+
+    const sd_bus_error *error = sd_bus_message_get_error(reply);
+    if (!error) {
+        wsm_log(WSM_INFO, "registerComponent successfully");
+        return 0;
+    }
+
+    if (dbus->register_attempts >= REGISTER_MAX_ATTEMPTS) {
+        wsm_log(WSM_ERROR, "Failed to call D-Bus method: %s, giving up after %d attempts",
+                error->message, dbus->register_attempts);
+        return 0;
+    }
+
+    wsm_log(WSM_DEBUG, "Failed to call D-Bus method: %s, retrying in %d ms",
+            error->message, dbus->register_delay_ms);
+    wsm_timer_update(dbus->register_retry, dbus->register_delay_ms);
+    dbus->register_delay_ms *= 2;
+    if (dbus->register_delay_ms > REGISTER_RETRY_MAX_MS) {
+        dbus->register_delay_ms = REGISTER_RETRY_MAX_MS;
+    }
+    return 0;
+}
+
+static int send_register(struct wsm_dbus *dbus) {
+    sd_bus_message *msg = NULL;
+    int ret = sd_bus_message_new_method_call(dbus->bus, &msg, STARTUP_SERVICE,
+                                             STARTUP_PATH, STARTUP_INTERFACE,
+                                             "registerComponent");
+    if (ret < 0) {
+        wsm_log(WSM_ERROR, "Failed to create D-Bus message: %s", strerror(-ret));
+        return ret;
+    }
+
+    const char *param = "wsm";
+    ret = sd_bus_message_append(msg, "s", param);
+    if (ret < 0) {
+        wsm_log(WSM_ERROR, "Failed to append string parameter: %s", strerror(-ret));
+        sd_bus_message_unref(msg);
+        return ret;
+    }
+
+    ret = sd_bus_call_async(dbus->bus, &dbus->register_slot, msg,
+                            handle_register_reply, dbus, REGISTER_CALL_TIMEOUT_USEC);
+    sd_bus_message_unref(msg);
+    if (ret < 0) {
+        wsm_log(WSM_ERROR, "Failed to call D-Bus method: %s", strerror(-ret));
+        return ret;
+    }
+    dbus->register_attempts++;
+    return 0;
+}
+
+struct wsm_dbus *wsm_dbus_create(struct wl_event_loop *loop) {
+    sd_bus *bus = NULL;
+    // Only connects the socket, the handshake runs from the event loop
+    int ret = sd_bus_open_user(&bus);
+    if (ret < 0) {
+        wsm_log(WSM_ERROR, "Failed to connect to session bus: %s", strerror(-ret));
+        return NULL;
+    }
+
+    struct wsm_dbus *dbus = calloc(1, sizeof(struct wsm_dbus));
+    if (!wsm_assert(dbus, "Could not create wsm_dbus: allocation failed!")) {
+        sd_bus_unref(bus);
+        return NULL;
+    }
+    dbus->bus = bus;
+    dbus->register_delay_ms = REGISTER_RETRY_MIN_MS;
+    dbus->bus_timeout = wsm_timer_create(handle_bus_timeout, dbus);
+    dbus->register_retry = wsm_timer_create(handle_register_retry, dbus);
+    dbus->source = wl_event_loop_add_fd(loop, sd_bus_get_fd(bus), 0,
+                                        handle_bus_fd, dbus);
+    if (!dbus->source) {
+        wsm_log(WSM_ERROR, "Failed to watch the session bus");
+        wsm_dbus_destroy(dbus);
+        return NULL;
+    }
+
+    send_register(dbus);
+    dbus_update_events(dbus);
+    return dbus;
+}
+
+void wsm_dbus_destroy(struct wsm_dbus *dbus) {
+    if (!dbus) {
+        return;
+    }
+
+    dbus_disconnect(dbus);
+    sd_bus_slot_unref(dbus->register_slot);
+    wsm_timer_destroy(dbus->register_retry);
+    wsm_timer_destroy(dbus->bus_timeout);
+    sd_bus_close_unref(dbus->bus);
+    free(dbus);
+}
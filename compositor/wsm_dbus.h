@@ -0,0 +1,42 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_DBUS_H
+#define WSM_DBUS_H
+
+struct wl_event_loop;
+struct wsm_dbus;
+
+/**
+ * @brief connect to the session bus from the compositor event loop.
+ *
+ * @details the bus fd is dispatched by @p loop, so nothing here blocks.
+ * Registration with org.lychee.Startup is sent asynchronously and retried
+ * with a backoff while the service is missing. The connection stays open
+ * until wsm_dbus_destroy(). Returns NULL if the bus can't be opened.
+ */
+struct wsm_dbus *wsm_dbus_create(struct wl_event_loop *loop);
+void wsm_dbus_destroy(struct wsm_dbus *dbus);
+
+#endif
@@ -0,0 +1,137 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_frame_throttle.h"
+#include "wsm_view.h"
+#include "wsm_config.h"
+#include "wsm_timer.h"
+#include "wsm_container.h"
+#include "wsm_workspace.h"
+#include "effects/shadow/wsm_shadow.h"
+
+#include <time.h>
+
+#include <wlr/types/wlr_scene.h>
+
+static struct wl_list hidden_views = { &hidden_views, &hidden_views };
+static struct wsm_timer *throttle_timer = NULL;
+
+static void visible_buffer_iterator(struct wlr_scene_buffer *buffer,
+                                    int sx, int sy, void *data) {
+    bool *visible = data;
+    // a shadow sticks out from under windows covering its own
+    if (buffer->primary_output && !wsm_shadow_buffer_is_slice(buffer)) {
+        *visible = true;
+    }
+}
+
+// Disabled nodes are skipped, the primary output of a buffer is only set
+// while some of it is visible
+static bool view_has_visible_buffer(struct wsm_view *view) {
+    bool visible = false;
+    wlr_scene_node_for_each_buffer(&view->scene_tree->node,
+                                   visible_buffer_iterator, &visible);
+    return visible;
+}
+
+static void view_set_hidden(struct wsm_view *view, bool hidden) {
+    if (view->hidden == hidden) {
+        return;
+    }
+    view->hidden = hidden;
+    view_set_suspended(view, hidden);
+
+    if (hidden) {
+        wl_list_insert(&hidden_views, &view->hidden_link);
+    } else {
+        wl_list_remove(&view->hidden_link);
+        wl_list_init(&view->hidden_link);
+        // The client may have waited for a callback up to a second
+        view_send_frame_done(view);
+    }
+}
+
+static void update_container_iterator(struct wsm_container *con, void *data) {
+    struct wsm_view *view = con->view;
+    if (!view || !view->surface || con->node.destroying) {
+        return;
+    }
+
+    view_set_hidden(view, !view_has_visible_buffer(view));
+    if (view->hidden) {
+        view_send_frame_done_unthrottled(view);
+    }
+}
+
+static int throttle_rate_ms(void) {
+    return 1000 / global_config.hidden_frame_rate;
+}
+
+static int handle_throttle_timer(void *data) {
+    if (global_config.hidden_frame_rate > 0) {
+        root_for_each_container(update_container_iterator, NULL);
+        wsm_timer_update(throttle_timer, throttle_rate_ms());
+    } else {
+        // Throttling got disabled, resume everything
+        struct wsm_view *view, *tmp;
+        wl_list_for_each_safe(view, tmp, &hidden_views, hidden_link) {
+            view_set_hidden(view, false);
+        }
+        wsm_timer_destroy(throttle_timer);
+        throttle_timer = NULL;
+    }
+    return 0;
+}
+
+void wsm_frame_throttle_output_frame(void) {
+    if (!throttle_timer) {
+        if (global_config.hidden_frame_rate <= 0) {
+            return;
+        }
+        throttle_timer = wsm_timer_create(handle_throttle_timer, NULL);
+        if (!throttle_timer) {
+            return;
+        }
+        wsm_timer_update(throttle_timer, throttle_rate_ms());
+    }
+
+    struct wsm_view *view, *tmp;
+    wl_list_for_each_safe(view, tmp, &hidden_views, hidden_link) {
+        if (view_has_visible_buffer(view)) {
+            view_set_hidden(view, false);
+        }
+    }
+}
+
+bool wsm_frame_throttle_view_is_throttled(struct wsm_view *view) {
+    return view->hidden && global_config.hidden_frame_rate > 0;
+}
+
+void wsm_frame_throttle_view_unmap(struct wsm_view *view) {
+    if (view->hidden) {
+        view->hidden = false;
+        wl_list_remove(&view->hidden_link);
+        wl_list_init(&view->hidden_link);
+    }
+}
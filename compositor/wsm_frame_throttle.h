@@ -0,0 +1,52 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_FRAME_THROTTLE_H
+#define WSM_FRAME_THROTTLE_H
+
+#include <stdbool.h>
+
+/**
+ * Frame callbacks of views that are not visible on any output, like views
+ * on hidden workspaces, in the hidden scratchpad or fully covered ones.
+ *
+ * Such views are marked hidden and suspended, and only get frame callbacks
+ * at hidden_frame_rate. A hidden view is checked for exposure on every
+ * output frame and resumes right away, visible views are checked for
+ * being hidden at the throttled rate.
+ */
+
+struct wsm_view;
+
+/**
+ * @brief resume the hidden views which got exposed, from output frames.
+ */
+void wsm_frame_throttle_output_frame(void);
+/**
+ * @brief whether frame callbacks of @p view are throttled.
+ */
+bool wsm_frame_throttle_view_is_throttled(struct wsm_view *view);
+void wsm_frame_throttle_view_unmap(struct wsm_view *view);
+
+#endif
@@ -0,0 +1,578 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_metrics.h"
+#include "wsm_log.h"
+#include "wsm_common.h"
+#include "wsm_server.h"
+#include "wsm_scene.h"
+#include "wsm_timer.h"
+#include "wsm_damage.h"
+#include "wsm_layer_cache.h"
+#include "node/wsm_text_node.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_scene.h>
+
+// A client has this long to send its request and read the response
+#define METRICS_CONNECTION_TIMEOUT_MS 5000
+
+static const uint64_t latency_bounds[] = {
+    1000000, 2000000, 4000000, 8000000, 16000000, 33000000,
+    50000000, 100000000, 200000000, 500000000, 1000000000,
+};
+
+static const uint64_t mutation_bounds[] = {
+    0, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024,
+};
+
+struct wsm_metrics wsm_metrics = {
+    .transactions = {
+        .type = WSM_METRIC_COUNTER,
+        .name = "wsm_transactions_total",
+        .help = "Committed layout transactions",
+    },
+    .transaction_timeouts = {
+        .type = WSM_METRIC_COUNTER,
+        .name = "wsm_transaction_timeouts_total",
+        .help = "Transactions applied before every view was ready",
+    },
+    .transaction_apply_latency = {
+        .type = WSM_METRIC_HISTOGRAM,
+        .name = "wsm_transaction_apply_latency_seconds",
+        .help = "Time from committing a transaction to applying it",
+        .bounds = latency_bounds,
+        .bucket_count = ARRAY_LENGTH(latency_bounds),
+        .scale = 1e-9,
+    },
+    .views = {
+        .type = WSM_METRIC_GAUGE,
+        .name = "wsm_views",
+        .help = "Mapped views",
+    },
+    .input_events = {
+        .type = WSM_METRIC_COUNTER,
+        .name = "wsm_input_events_total",
+        .help = "Input events from every seat",
+    },
+    .resize_configures_suppressed = {
+        .type = WSM_METRIC_COUNTER,
+        .name = "wsm_resize_configures_suppressed_total",
+        .help = "Configures skipped during interactive resizes",
+    },
+    .arrange_scene_mutations = {
+        .type = WSM_METRIC_HISTOGRAM,
+        .name = "wsm_arrange_scene_mutations",
+        .help = "Scene node updates made by arranging one transaction",
+        .bounds = mutation_bounds,
+        .bucket_count = ARRAY_LENGTH(mutation_bounds),
+        .scale = 1,
+    },
+    .full_arranges = {
+        .type = WSM_METRIC_COUNTER,
+        .name = "wsm_arrange_full_total",
+        .help = "Transactions that re-arranged the whole scene",
+    },
+};
+
+struct wsm_metrics_server {
+    int fd;
+    char *path;
+    struct wl_event_loop *loop;
+    struct wl_event_source *source;
+    struct wl_list connections; // metrics_connection::link
+};
+
+struct metrics_connection {
+    struct wsm_metrics_server *server;
+    int fd;
+    struct wl_event_source *source;
+    struct wsm_timer *timeout;
+
+    char *response;
+    size_t response_len;
+    size_t written;
+
+    struct wl_list link;
+};
+
+// Summed per process: Xwayland and clients with several connections
+// would otherwise export series with the same labels
+struct client_buffers {
+    pid_t pid;
+    uint64_t bytes;
+};
+
+struct scene_counts {
+    int trees, rects, buffers;
+    struct client_buffers *clients;
+    int clients_len, clients_cap;
+};
+
+static struct wl_list metrics_registry;
+static bool registry_ready = false;
+
+static void metric_register(struct wsm_metric *metric) {
+    if (!registry_ready) {
+        wl_list_init(&metrics_registry);
+        registry_ready = true;
+    }
+    wl_list_insert(metrics_registry.prev, &metric->link);
+    metric->registered = true;
+}
+
+void wsm_metrics_init(void) {
+    metric_register(&wsm_metrics.transactions);
+    metric_register(&wsm_metrics.transaction_timeouts);
+    metric_register(&wsm_metrics.transaction_apply_latency);
+    metric_register(&wsm_metrics.views);
+    metric_register(&wsm_metrics.input_events);
+    metric_register(&wsm_metrics.resize_configures_suppressed);
+    metric_register(&wsm_metrics.arrange_scene_mutations);
+    metric_register(&wsm_metrics.full_arranges);
+}
+
+struct wsm_metric *wsm_metric_create(enum wsm_metric_type type, const char *name,
+                                     const char *help, const char *labels) {
+    struct wsm_metric *metric = calloc(1, sizeof(struct wsm_metric));
+    if (!wsm_assert(metric, "Could not create wsm_metric: allocation failed!")) {
+        return NULL;
+    }
+
+    metric->type = type;
+    metric->name = name;
+    metric->help = help;
+    metric->labels = labels ? strdup(labels) : NULL;
+    metric_register(metric);
+    return metric;
+}
+
+struct wsm_metric *wsm_metric_histogram_create(const char *name, const char *help,
+                                               const char *labels, const uint64_t *bounds, int count, double scale) {
+    if (!wsm_assert(count <= WSM_METRIC_MAX_BUCKETS, "Too many buckets for %s", name)) {
+        count = WSM_METRIC_MAX_BUCKETS;
+    }
+
+    struct wsm_metric *metric = wsm_metric_create(WSM_METRIC_HISTOGRAM, name, help, labels);
+    if (!metric) {
+        return NULL;
+    }
+    metric->bounds = bounds;
+    metric->bucket_count = count;
+    metric->scale = scale;
+    return metric;
+}
+
+void wsm_metric_destroy(struct wsm_metric *metric) {
+    if (!metric) {
+        return;
+    }
+    if (metric->registered) {
+        wl_list_remove(&metric->link);
+    }
+    free(metric->labels);
+    free(metric);
+}
+
+void wsm_metric_observe(struct wsm_metric *metric, uint64_t value) {
+    int bucket = 0;
+    while (bucket < metric->bucket_count && value > metric->bounds[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&metric->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metric->sum, value, memory_order_relaxed);
+}
+
+static void write_family(FILE *f, const char *name, const char *help, const char *type) {
+    fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void write_series(FILE *f, const char *name, const char *suffix,
+                         const char *labels, const char *extra_label) {
+    bool braces = labels || extra_label;
+    fprintf(f, "%s%s%s%s%s%s%s ", name, suffix, braces ? "{" : "",
+            labels ? labels : "", labels && extra_label ? "," : "",
+            extra_label ? extra_label : "", braces ? "}" : "");
+}
+
+static void write_metric(FILE *f, struct wsm_metric *metric) {
+    switch (metric->type) {
+    case WSM_METRIC_COUNTER:
+        write_series(f, metric->name, "", metric->labels, NULL);
+        fprintf(f, "%llu\n", (unsigned long long)wsm_metric_get(metric));
+        break;
+    case WSM_METRIC_GAUGE:
+        write_series(f, metric->name, "", metric->labels, NULL);
+        fprintf(f, "%lld\n", (long long)(int64_t)wsm_metric_get(metric));
+        break;
+    case WSM_METRIC_HISTOGRAM:;
+        uint64_t count = 0;
+        char le[64];
+        for (int i = 0; i <= metric->bucket_count; i++) {
+            count += atomic_load_explicit(&metric->buckets[i], memory_order_relaxed);
+            if (i < metric->bucket_count) {
+                snprintf(le, sizeof(le), "le=\"%g\"", metric->bounds[i] * metric->scale);
+            } else {
+                snprintf(le, sizeof(le), "le=\"+Inf\"");
+            }
+            write_series(f, metric->name, "_bucket", metric->labels, le);
+            fprintf(f, "%llu\n", (unsigned long long)count);
+        }
+        write_series(f, metric->name, "_sum", metric->labels, NULL);
+        fprintf(f, "%g\n", atomic_load_explicit(&metric->sum, memory_order_relaxed) * metric->scale);
+        write_series(f, metric->name, "_count", metric->labels, NULL);
+        fprintf(f, "%llu\n", (unsigned long long)count);
+        break;
+    }
+}
+
+static void write_registry(FILE *f) {
+    static const char *type_names[] = {
+        [WSM_METRIC_COUNTER] = "counter",
+        [WSM_METRIC_GAUGE] = "gauge",
+        [WSM_METRIC_HISTOGRAM] = "histogram",
+    };
+
+    // Series of one family have to be grouped under a single header
+    struct wsm_metric *metric;
+    wl_list_for_each(metric, &metrics_registry, link) {
+        bool seen = false;
+        struct wsm_metric *prev;
+        wl_list_for_each(prev, &metrics_registry, link) {
+            if (prev == metric) {
+                break;
+            }
+            if (strcmp(prev->name, metric->name) == 0) {
+                seen = true;
+                break;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+
+        write_family(f, metric->name, metric->help, type_names[metric->type]);
+        struct wsm_metric *series = metric;
+        wl_list_for_each_from(series, &metrics_registry, link) {
+            if (strcmp(series->name, metric->name) == 0) {
+                write_metric(f, series);
+            }
+        }
+    }
+}
+
+static struct client_buffers *client_buffers_get(struct scene_counts *counts,
+                                                 struct wl_client *client) {
+    pid_t pid = 0;
+    wl_client_get_credentials(client, &pid, NULL, NULL);
+    for (int i = 0; i < counts->clients_len; i++) {
+        if (counts->clients[i].pid == pid) {
+            return &counts->clients[i];
+        }
+    }
+    if (counts->clients_len == counts->clients_cap) {
+        int cap = counts->clients_cap ? counts->clients_cap * 2 : 16;
+        struct client_buffers *clients = realloc(counts->clients, cap * sizeof(*clients));
+        if (!clients) {
+            return NULL;
+        }
+        counts->clients = clients;
+        counts->clients_cap = cap;
+    }
+    struct client_buffers *entry = &counts->clients[counts->clients_len++];
+    *entry = (struct client_buffers){ .pid = pid };
+    return entry;
+}
+
+static uint64_t buffer_size(struct wlr_buffer *buffer) {
+    struct wlr_shm_attributes shm;
+    if (wlr_buffer_get_shm(buffer, &shm)) {
+        return (uint64_t)shm.stride * buffer->height;
+    }
+    struct wlr_dmabuf_attributes dmabuf;
+    if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+        uint64_t size = 0;
+        for (int i = 0; i < dmabuf.n_planes; i++) {
+            size += (uint64_t)dmabuf.stride[i] * buffer->height;
+        }
+        return size;
+    }
+    return (uint64_t)buffer->width * buffer->height * 4;
+}
+
+static void count_scene_node(struct scene_counts *counts, struct wlr_scene_node *node) {
+    switch (node->type) {
+    case WLR_SCENE_NODE_TREE:;
+        counts->trees++;
+        struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+        struct wlr_scene_node *child;
+        wl_list_for_each(child, &tree->children, link) {
+            count_scene_node(counts, child);
+        }
+        break;
+    case WLR_SCENE_NODE_RECT:
+        counts->rects++;
+        break;
+    case WLR_SCENE_NODE_BUFFER:;
+        counts->buffers++;
+        struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+        struct wlr_scene_surface *scene_surface =
+            wlr_scene_surface_try_from_buffer(scene_buffer);
+        if (!scene_buffer->buffer || !scene_surface) {
+            break;
+        }
+        struct wl_client *client =
+            wl_resource_get_client(scene_surface->surface->resource);
+        struct client_buffers *entry = client_buffers_get(counts, client);
+        if (entry) {
+            entry->bytes += buffer_size(scene_buffer->buffer);
+        }
+        break;
+    }
+}
+
+static void write_scene(FILE *f) {
+    struct scene_counts counts = {0};
+    count_scene_node(&counts, &global_server.wsm_scene->root_scene->tree.node);
+
+    write_family(f, "wsm_scene_nodes", "Nodes in the scene graph", "gauge");
+    fprintf(f, "wsm_scene_nodes{type=\"tree\"} %d\n", counts.trees);
+    fprintf(f, "wsm_scene_nodes{type=\"rect\"} %d\n", counts.rects);
+    fprintf(f, "wsm_scene_nodes{type=\"buffer\"} %d\n", counts.buffers);
+
+    write_family(f, "wsm_client_buffer_bytes",
+                 "Memory of the client buffers held by the scene", "gauge");
+    for (int i = 0; i < counts.clients_len; i++) {
+        fprintf(f, "wsm_client_buffer_bytes{pid=\"%d\"} %llu\n", (int)counts.clients[i].pid,
+                (unsigned long long)counts.clients[i].bytes);
+    }
+    free(counts.clients);
+
+    int clients = 0;
+    struct wl_client *client;
+    wl_client_for_each(client, wl_display_get_client_list(global_server.wl_display)) {
+        clients++;
+    }
+    write_family(f, "wsm_clients", "Connected Wayland clients", "gauge");
+    fprintf(f, "wsm_clients %d\n", clients);
+}
+
+static void write_caches(FILE *f) {
+    const struct wsm_text_node_stats *text = wsm_text_node_get_stats();
+    const struct wsm_layer_cache_stats *layer = wsm_layer_cache_get_stats();
+    write_family(f, "wsm_cache_lookups_total",
+                 "Cache lookups, a miss means the contents were rendered again", "counter");
+    fprintf(f, "wsm_cache_lookups_total{cache=\"text\",result=\"hit\"} %llu\n",
+            (unsigned long long)text->hits);
+    fprintf(f, "wsm_cache_lookups_total{cache=\"text\",result=\"miss\"} %llu\n",
+            (unsigned long long)text->misses);
+    fprintf(f, "wsm_cache_lookups_total{cache=\"layer\",result=\"hit\"} %llu\n",
+            (unsigned long long)layer->hits);
+    fprintf(f, "wsm_cache_lookups_total{cache=\"layer\",result=\"miss\"} %llu\n",
+            (unsigned long long)layer->misses);
+
+    const struct wsm_damage_stats *damage = wsm_damage_get_stats();
+    write_family(f, "wsm_damage_regions_total", "Damage regions seen by the simplifier", "counter");
+    fprintf(f, "wsm_damage_regions_total %llu\n", (unsigned long long)damage->regions);
+    write_family(f, "wsm_damage_simplified_total", "Damage regions over the rectangle budget", "counter");
+    fprintf(f, "wsm_damage_simplified_total %llu\n", (unsigned long long)damage->simplified);
+
+    const struct wsm_timer_stats *timers = wsm_timer_get_stats();
+    write_family(f, "wsm_timers", "Compositor timers", "gauge");
+    fprintf(f, "wsm_timers{state=\"created\"} %d\n", timers->timers);
+    fprintf(f, "wsm_timers{state=\"armed\"} %d\n", timers->armed);
+    write_family(f, "wsm_timers_fired_total", "Compositor timers that fired", "counter");
+    fprintf(f, "wsm_timers_fired_total %llu\n", (unsigned long long)timers->fired);
+}
+
+static bool build_response(struct metrics_connection *conn) {
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *f = open_memstream(&body, &body_len);
+    if (!f) {
+        return false;
+    }
+
+    // Only monotonic counters, rates are left to rate() on the scraper side
+    // so that several scrapers don't disturb each other
+    if (registry_ready) {
+        write_registry(f);
+    }
+    write_scene(f);
+    write_caches(f);
+    fclose(f);
+
+    f = open_memstream(&conn->response, &conn->response_len);
+    if (!f) {
+        free(body);
+        return false;
+    }
+    fprintf(f, "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n\r\n", body_len);
+    fwrite(body, 1, body_len, f);
+    fclose(f);
+    free(body);
+    return true;
+}
+
+static void connection_destroy(struct metrics_connection *conn) {
+    wl_list_remove(&conn->link);
+    wl_event_source_remove(conn->source);
+    wsm_timer_destroy(conn->timeout);
+    close(conn->fd);
+    free(conn->response);
+    free(conn);
+}
+
+static int handle_connection_timeout(void *data) {
+    struct metrics_connection *conn = data;
+    wsm_log(WSM_DEBUG, "Metrics client timed out");
+    connection_destroy(conn);
+    return 0;
+}
+
+static int handle_connection(int fd, uint32_t mask, void *data) {
+    struct metrics_connection *conn = data;
+    if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+        connection_destroy(conn);
+        return 0;
+    }
+
+    if (!conn->response && (mask & WL_EVENT_READABLE)) {
+        // The request itself does not matter, any of it asks for the metrics
+        char request[1024];
+        ssize_t n = read(fd, request, sizeof(request));
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return 0;
+        }
+        if (!build_response(conn)) {
+            connection_destroy(conn);
+            return 0;
+        }
+        wl_event_source_fd_update(conn->source, WL_EVENT_WRITABLE);
+    }
+
+    if (conn->response && (mask & WL_EVENT_WRITABLE)) {
+        ssize_t n = write(fd, conn->response + conn->written,
+                          conn->response_len - conn->written);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return 0;
+        }
+        if (n < 0 || (conn->written += n) == conn->response_len) {
+            connection_destroy(conn);
+        }
+    }
+    return 0;
+}
+
+static int handle_accept(int fd, uint32_t mask, void *data) {
+    struct wsm_metrics_server *server = data;
+    int client_fd = accept(fd, NULL, NULL);
+    if (client_fd < 0) {
+        wsm_log_errno(WSM_ERROR, "Unable to accept metrics connection");
+        return 0;
+    }
+    fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(client_fd, F_SETFL, O_NONBLOCK);
+
+    struct metrics_connection *conn = calloc(1, sizeof(struct metrics_connection));
+    if (!wsm_assert(conn, "Could not create metrics_connection: allocation failed!")) {
+        close(client_fd);
+        return 0;
+    }
+    conn->server = server;
+    conn->fd = client_fd;
+    conn->source = wl_event_loop_add_fd(server->loop, client_fd,
+                                        WL_EVENT_READABLE, handle_connection, conn);
+    conn->timeout = wsm_timer_create(handle_connection_timeout, conn);
+    wsm_timer_update(conn->timeout, METRICS_CONNECTION_TIMEOUT_MS);
+    wl_list_insert(&server->connections, &conn->link);
+    return 0;
+}
+
+struct wsm_metrics_server *wsm_metrics_server_create(struct wl_event_loop *loop,
+                                                     const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        wsm_log(WSM_ERROR, "Metrics socket path too long: %s", path);
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        wsm_log_errno(WSM_ERROR, "Unable to create metrics socket");
+        return NULL;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        wsm_log_errno(WSM_ERROR, "Unable to listen on metrics socket %s", path);
+        close(fd);
+        return NULL;
+    }
+
+    struct wsm_metrics_server *server = calloc(1, sizeof(struct wsm_metrics_server));
+    if (!wsm_assert(server, "Could not create wsm_metrics_server: allocation failed!")) {
+        close(fd);
+        return NULL;
+    }
+    server->fd = fd;
+    server->path = strdup(path);
+    server->loop = loop;
+    wl_list_init(&server->connections);
+    server->source = wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE, handle_accept, server);
+
+    wsm_log(WSM_INFO, "Serving metrics on %s", path);
+    return server;
+}
+
+void wsm_metrics_server_destroy(struct wsm_metrics_server *server) {
+    if (!server) {
+        return;
+    }
+
+    struct metrics_connection *conn, *tmp;
+    wl_list_for_each_safe(conn, tmp, &server->connections, link) {
+        connection_destroy(conn);
+    }
+    wl_event_source_remove(server->source);
+    close(server->fd);
+    unlink(server->path);
+    free(server->path);
+    free(server);
+}
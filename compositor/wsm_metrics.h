@@ -0,0 +1,121 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_METRICS_H
+#define WSM_METRICS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <wayland-server-core.h>
+
+#define WSM_METRIC_MAX_BUCKETS 16
+
+struct wl_event_loop;
+struct wsm_metrics_server;
+
+enum wsm_metric_type {
+    WSM_METRIC_COUNTER,
+    WSM_METRIC_GAUGE,
+    WSM_METRIC_HISTOGRAM,
+};
+
+/**
+ * @brief one time series, updated with relaxed atomics from any thread
+ */
+struct wsm_metric {
+    enum wsm_metric_type type;
+    const char *name;
+    const char *help;
+    char *labels; // label list without braces, may be NULL
+
+    _Atomic uint64_t value; // gauges store an int64_t
+
+    // Histograms: upper bounds in the observed unit, exported times scale
+    const uint64_t *bounds;
+    int bucket_count;
+    double scale;
+    _Atomic uint64_t buckets[WSM_METRIC_MAX_BUCKETS + 1];
+    _Atomic uint64_t sum;
+
+    struct wl_list link; // wsm_metrics registry
+    bool registered;
+};
+
+/**
+ * @brief metrics that exist for the whole lifetime of the compositor
+ */
+struct wsm_metrics {
+    struct wsm_metric transactions;
+    struct wsm_metric transaction_timeouts;
+    struct wsm_metric transaction_apply_latency; // ns
+    struct wsm_metric views;
+    struct wsm_metric input_events;
+    struct wsm_metric resize_configures_suppressed;
+    struct wsm_metric arrange_scene_mutations; // per arranged transaction
+    struct wsm_metric full_arranges;
+};
+
+extern struct wsm_metrics wsm_metrics;
+
+/**
+ * @brief register the global metrics, needed before they are exported
+ */
+void wsm_metrics_init(void);
+
+struct wsm_metric *wsm_metric_create(enum wsm_metric_type type, const char *name,
+                                     const char *help, const char *labels);
+/**
+ * @brief create a histogram, @p bounds has to outlive it
+ */
+struct wsm_metric *wsm_metric_histogram_create(const char *name, const char *help,
+                                               const char *labels, const uint64_t *bounds, int count, double scale);
+void wsm_metric_destroy(struct wsm_metric *metric);
+
+void wsm_metric_observe(struct wsm_metric *metric, uint64_t value);
+
+static inline void wsm_metric_add(struct wsm_metric *metric, int64_t value) {
+    atomic_fetch_add_explicit(&metric->value, (uint64_t)value, memory_order_relaxed);
+}
+
+static inline void wsm_metric_set(struct wsm_metric *metric, int64_t value) {
+    atomic_store_explicit(&metric->value, (uint64_t)value, memory_order_relaxed);
+}
+
+static inline uint64_t wsm_metric_get(struct wsm_metric *metric) {
+    return atomic_load_explicit(&metric->value, memory_order_relaxed);
+}
+
+/**
+ * @brief serve the metrics in Prometheus text format on a unix socket
+ *
+ * @details every connection gets one HTTP/1.0 response after sending its
+ * request, e.g. curl --unix-socket @p path http://localhost/metrics.
+ */
+struct wsm_metrics_server *wsm_metrics_server_create(struct wl_event_loop *loop,
+                                                     const char *path);
+void wsm_metrics_server_destroy(struct wsm_metrics_server *server);
+
+#endif
@@ -31,6 +31,7 @@ THE SOFTWARE.
 #include "wsm_input_manager.h"
 #include "wsm_output_manager.h"
 #include "wsm_server_decoration_manager.h"
+#include "effects/wsm_surface_effect.h"
 #include "wsm_xdg_decoration_manager.h"
 #include "wsm_layer_shell.h"
 #include "wsm_output.h"
@@ -40,6 +41,9 @@ THE SOFTWARE.
 #include "wsm_cursor.h"
 #include "wsm_session_lock.h"
 #include "wsm_desktop.h"
+#include "wsm_metrics.h"
+#include "wsm_startup.h"
+#include "wsm_keyboard.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -98,7 +102,7 @@ THE SOFTWARE.
 #include <wlr/types/wlr_input_method_v2.h>
 #include <wlr/types/wlr_text_input_v3.h>
 
-#define WSM_XDG_SHELL_VERSION 5
+#define WSM_XDG_SHELL_VERSION 6
 #define WSM_LAYER_SHELL_VERSION 4
 #define WSM_WLR_FRACTIONAL_SCALE_V1_VERSION 1
 #define WSM_FOREIGN_TOPLEVEL_LIST_VERSION 1
@@ -241,6 +245,13 @@ static void detect_proprietary(struct wlr_backend *backend, void *data) {
     drmFreeVersion(version);
 }
 
+static void load_xcursor_theme(void *data) {
+    struct wlr_xcursor_manager *manager = data;
+    if (!wlr_xcursor_manager_load(manager, 1)) {
+        wsm_log(WSM_ERROR, "Failed to load cursor theme");
+    }
+}
+
 /**
  * @brief wsm_server_init initialize the wayland compositor core
  * @param server
@@ -248,8 +259,12 @@ static void detect_proprietary(struct wlr_backend *backend, void *data) {
  */
 bool wsm_server_init(struct wsm_server *server)
 {
+    // Independent of everything below, these run while the backend starts
+    wsm_keyboard_prepare_default_keymap();
     server->desktop_interface = wsm_desktop_interface_create();
     wsm_config_init();
+    wsm_metrics_init();
+    wsm_startup_mark("desktop settings");
 
     server->wl_display = wl_display_create();
     server->wl_event_loop = wl_display_get_event_loop(server->wl_display);
@@ -263,12 +278,14 @@ bool wsm_server_init(struct wsm_server *server)
     }
 
     wlr_multi_for_each_backend(server->backend, detect_proprietary, NULL);
+    wsm_startup_mark("backend");
 
     server->wlr_renderer = wlr_renderer_autocreate(server->backend);
     if (!server->wlr_renderer) {
         wsm_log(WSM_ERROR, "Failed to create renderer");
         return false;
     }
+    wsm_startup_mark("renderer");
 
     wlr_renderer_init_wl_shm(server->wlr_renderer, server->wl_display);
 
@@ -283,6 +300,7 @@ bool wsm_server_init(struct wsm_server *server)
         wsm_log(WSM_ERROR, "Failed to create allocator");
         return false;
     }
+    wsm_startup_mark("allocator");
 
     server->wlr_compositor = wlr_compositor_create(server->wl_display, 6,
                                                server->wlr_renderer);
@@ -290,6 +308,9 @@ bool wsm_server_init(struct wsm_server *server)
     server->wsm_scene = wsm_scene_create(server);
 
     server->xcursor_manager = wlr_xcursor_manager_create(NULL, 24);
+    // Nothing uses the manager before the first cursor image is set
+    server->xcursor_task = wsm_init_task_start("cursor theme", load_xcursor_theme,
+                                               server->xcursor_manager);
     server->data_device_manager = wlr_data_device_manager_create(server->wl_display);
     server->wsm_output_manager = wsm_output_manager_create(server);
 
@@ -300,6 +321,7 @@ bool wsm_server_init(struct wsm_server *server)
     server->idle_notifier_v1 = wlr_idle_notifier_v1_create(server->wl_display);
     server->wsm_server_decoration_manager = wsm_server_decoration_manager_create(server);
     server->wsm_xdg_decoration_manager = xdg_decoration_manager_create(server);
+    server->wsm_effects_manager = wsm_effects_manager_create(server);
     server->wlr_relative_pointer_manager =
         wlr_relative_pointer_manager_v1_create(server->wl_display);
 
@@ -345,6 +367,7 @@ bool wsm_server_init(struct wsm_server *server)
         wlr_xdg_foreign_registry_create(server->wl_display);
     wlr_xdg_foreign_v1_create(server->wl_display, foreign_registry);
     wlr_xdg_foreign_v2_create(server->wl_display, foreign_registry);
+    wsm_startup_mark("protocol globals");
 
     char name_candidate[16];
     for (unsigned int i = 1; i <= 32; ++i) {
@@ -374,6 +397,7 @@ bool wsm_server_init(struct wsm_server *server)
         wlr_headless_add_output(server->headless_backend, 800, 600);
     wlr_output_set_name(wlr_output, "FALLBACK");
     server->wsm_scene->fallback_output = wsm_ouput_create(wlr_output);
+    wsm_startup_mark("fallback output");
 
     if (!server->txn_timeout_ms) {
         server->txn_timeout_ms = 200;
@@ -386,6 +410,7 @@ bool wsm_server_init(struct wsm_server *server)
 
     if (global_config.primary_selection)
         wlr_primary_selection_v1_device_manager_create(server->wl_display);
+    wsm_startup_mark("input manager");
 
     return true;
 }
@@ -397,5 +422,6 @@ void server_finish(struct wsm_server *server) {
     wl_display_destroy_clients(server->wl_display);
     wlr_backend_destroy(server->backend);
     wl_display_destroy(server->wl_display);
+    wsm_scene_finish();
     list_free(server->dirty_nodes);
 }
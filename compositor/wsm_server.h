@@ -52,6 +52,7 @@ struct wlr_output_layout;
 struct wlr_session_lock_v1;
 struct wlr_linux_dmabuf_v1;
 struct wlr_xcursor_manager;
+struct wsm_init_task;
 struct wlr_idle_notifier_v1;
 struct wlr_output_manager_v1;
 struct wlr_data_device_manager;
@@ -84,6 +85,8 @@ struct wsm_output_manager;
 struct wsm_desktop_interface;
 struct wsm_xdg_decoration_manager;
 struct wsm_server_decoration_manager;
+struct wsm_effects_manager;
+struct wsm_timer;
 
 /**
  * @brief server global server object
@@ -141,6 +144,7 @@ struct wsm_server {
     struct wl_listener xwayland_surface;
     struct wl_listener xwayland_ready;
     struct wlr_xcursor_manager *xcursor_manager;
+    struct wsm_init_task *xcursor_task; // loads the theme, join before use
 #endif
 
     struct wsm_scene *wsm_scene;
@@ -150,6 +154,7 @@ struct wsm_server {
     struct wsm_output_manager *wsm_output_manager;
     struct wsm_server_decoration_manager *wsm_server_decoration_manager;
     struct wsm_xdg_decoration_manager *wsm_xdg_decoration_manager;
+    struct wsm_effects_manager *wsm_effects_manager;
     struct wsm_idle_inhibit_manager_v1 wsm_idle_inhibit_manager_v1;
 
     struct wsm_desktop_interface *desktop_interface;
@@ -172,7 +177,7 @@ struct wsm_server {
 
     struct wsm_list *dirty_nodes;
 
-    struct wl_event_source *delayed_modeset;
+    struct wsm_timer *delayed_modeset;
 
     bool xwayland_enabled;
 };
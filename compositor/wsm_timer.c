@@ -0,0 +1,256 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_timer.h"
+#include "wsm_log.h"
+#include "wsm_server.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+// About four and a half hours, later timers wait in the last level and
+// get placed again when it cascades
+#define WHEEL_RANGE ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+struct timer_wheel {
+    struct wl_list slots[WHEEL_LEVELS][WHEEL_SIZE];
+    uint64_t current; // last tick processed
+    uint64_t start_ms; // monotonic time of tick 0
+    struct wl_event_source *source;
+    uint64_t source_expires; // tick the source is armed for, 0 if disarmed
+    bool dispatching;
+};
+
+static struct timer_wheel *wheel = NULL;
+static struct wsm_timer_stats timer_stats = {0};
+
+static uint64_t get_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static uint64_t wheel_now(void) {
+    return get_now_ms() - wheel->start_ms;
+}
+
+static void wheel_insert(struct wsm_timer *timer) {
+    uint64_t expires = timer->expires;
+    uint64_t delta = expires - wheel->current;
+    if (delta >= WHEEL_RANGE) {
+        expires = wheel->current + WHEEL_RANGE - 1;
+        delta = WHEEL_RANGE - 1;
+    }
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (uint64_t)1 << (WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    int slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    wl_list_insert(wheel->slots[level][slot].prev, &timer->link);
+}
+
+// Tick of the next cascade or expiry, 0 if the wheel is empty
+static uint64_t wheel_next_expiry(void) {
+    uint64_t next = 0;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        uint64_t base = wheel->current >> shift;
+        for (int i = 1; i <= WHEEL_SIZE; i++) {
+            if (!wl_list_empty(&wheel->slots[level][(base + i) & WHEEL_MASK])) {
+                uint64_t tick = (base + i) << shift;
+                if (next == 0 || tick < next) {
+                    next = tick;
+                }
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+static void wheel_set_source(uint64_t expires) {
+    wheel->source_expires = expires;
+
+    int delay = 0;
+    if (expires) {
+        uint64_t now = wheel_now();
+        delay = expires > now ? expires - now : 1;
+    }
+    wl_event_source_timer_update(wheel->source, delay);
+    timer_stats.source_updates++;
+}
+
+static void wheel_cascade(int level) {
+    int slot = (wheel->current >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    struct wl_list *list = &wheel->slots[level][slot];
+    struct wl_list pending;
+    wl_list_init(&pending);
+    wl_list_insert_list(&pending, list);
+    wl_list_init(list);
+
+    struct wsm_timer *timer, *tmp;
+    wl_list_for_each_safe(timer, tmp, &pending, link) {
+        wl_list_remove(&timer->link);
+        wheel_insert(timer);
+    }
+}
+
+static void wheel_run_slot(void) {
+    struct wl_list *list = &wheel->slots[0][wheel->current & WHEEL_MASK];
+    // Functions may arm, disarm or destroy any timer, including this one
+    while (!wl_list_empty(list)) {
+        struct wsm_timer *timer = wl_container_of(list->next, timer, link);
+        wl_list_remove(&timer->link);
+        wl_list_init(&timer->link);
+        timer->armed = false;
+        timer_stats.armed--;
+        timer_stats.fired++;
+        timer->func(timer->data);
+    }
+}
+
+// Jumps from one tick with work to the next, empty slots are skipped
+static void wheel_advance(uint64_t now) {
+    while (wheel->current < now) {
+        uint64_t next = timer_stats.armed > 0 ? wheel_next_expiry() : 0;
+        if (next == 0 || next > now) {
+            wheel->current = now;
+            break;
+        }
+
+        wheel->current = next;
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((next & (((uint64_t)1 << (WHEEL_BITS * level)) - 1)) == 0) {
+                wheel_cascade(level);
+            }
+        }
+        wheel_run_slot();
+    }
+}
+
+static int handle_wheel_source(void *data) {
+    wheel->source_expires = 0;
+    wheel->dispatching = true;
+    wheel_advance(wheel_now());
+    wheel->dispatching = false;
+
+    uint64_t next = timer_stats.armed > 0 ? wheel_next_expiry() : 0;
+    if (next) {
+        wheel_set_source(next);
+    }
+    return 0;
+}
+
+static bool wheel_init(void) {
+    if (wheel) {
+        return true;
+    }
+
+    wheel = calloc(1, sizeof(struct timer_wheel));
+    if (!wsm_assert(wheel, "Could not create timer wheel: allocation failed!")) {
+        return false;
+    }
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SIZE; slot++) {
+            wl_list_init(&wheel->slots[level][slot]);
+        }
+    }
+    wheel->start_ms = get_now_ms();
+    wheel->source = wl_event_loop_add_timer(global_server.wl_event_loop,
+                                            handle_wheel_source, NULL);
+    if (!wheel->source) {
+        wsm_log(WSM_ERROR, "Unable to create the timer wheel source");
+        free(wheel);
+        wheel = NULL;
+        return false;
+    }
+    return true;
+}
+
+struct wsm_timer *wsm_timer_create(wsm_timer_func_t func, void *data) {
+    if (!wheel_init()) {
+        return NULL;
+    }
+
+    struct wsm_timer *timer = calloc(1, sizeof(struct wsm_timer));
+    if (!wsm_assert(timer, "Could not create wsm_timer: allocation failed!")) {
+        return NULL;
+    }
+    timer->func = func;
+    timer->data = data;
+    wl_list_init(&timer->link);
+    timer_stats.timers++;
+    return timer;
+}
+
+static void timer_disarm(struct wsm_timer *timer) {
+    if (!timer->armed) {
+        return;
+    }
+    wl_list_remove(&timer->link);
+    wl_list_init(&timer->link);
+    timer->armed = false;
+    timer_stats.armed--;
+}
+
+void wsm_timer_destroy(struct wsm_timer *timer) {
+    if (!timer) {
+        return;
+    }
+    timer_disarm(timer);
+    timer_stats.timers--;
+    free(timer);
+}
+
+void wsm_timer_update(struct wsm_timer *timer, int ms_delay) {
+    timer_stats.updates++;
+    // The shared source is left as it is, firing early only costs a
+    // wakeup finding nothing to do
+    timer_disarm(timer);
+    if (ms_delay <= 0) {
+        return;
+    }
+
+    // A timer armed while the wheel is behind is placed relative to the
+    // last processed tick, its expiry stays correct
+    uint64_t now = wheel_now();
+    timer->expires = (now > wheel->current ? now : wheel->current) + ms_delay;
+    timer->armed = true;
+    timer_stats.armed++;
+    wheel_insert(timer);
+
+    if (!wheel->dispatching &&
+        (wheel->source_expires == 0 || timer->expires < wheel->source_expires)) {
+        wheel_set_source(timer->expires);
+    }
+}
+
+const struct wsm_timer_stats *wsm_timer_get_stats(void) {
+    return &timer_stats;
+}
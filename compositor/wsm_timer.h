@@ -0,0 +1,73 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_TIMER_H
+#define WSM_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <wayland-server-core.h>
+
+/**
+ * Compositor timers, kept in a hierarchical timer wheel with millisecond
+ * ticks. All of them share a single timer source of the event loop, armed
+ * for the earliest slot holding a timer. Arming, rearming and cancelling
+ * a timer only moves it between slot lists.
+ */
+
+typedef int (*wsm_timer_func_t)(void *data);
+
+struct wsm_timer {
+    wsm_timer_func_t func;
+    void *data;
+
+    uint64_t expires; // tick the timer fires at
+    bool armed;
+    struct wl_list link; // slot of the wheel
+};
+
+struct wsm_timer_stats {
+    int timers; // existing timers
+    int armed;
+    uint64_t updates; // wsm_timer_update() calls
+    uint64_t fired;
+    uint64_t source_updates; // updates of the shared event loop timer
+};
+
+/**
+ * @brief create a disarmed timer, calling @p func with @p data when it fires.
+ */
+struct wsm_timer *wsm_timer_create(wsm_timer_func_t func, void *data);
+void wsm_timer_destroy(struct wsm_timer *timer);
+/**
+ * @brief fire @p timer in @p ms_delay milliseconds, 0 disarms it.
+ *
+ * @details same semantics as wl_event_source_timer_update(). A timer is
+ * disarmed by the time its function runs, which may arm it again.
+ */
+void wsm_timer_update(struct wsm_timer *timer, int ms_delay);
+const struct wsm_timer_stats *wsm_timer_get_stats(void);
+
+#endif
@@ -24,6 +24,7 @@ THE SOFTWARE.
 
 #include "wsm_transaction.h"
 #include "wsm_log.h"
+#include "wsm_trace.h"
 #include "wsm_list.h"
 #include "wsm_seat.h"
 #include "wsm_view.h"
@@ -36,21 +37,33 @@ THE SOFTWARE.
 #include "wsm_server.h"
 #include "wsm_scene.h"
 #include "wsm_arrange.h"
+#include "wsm_animation.h"
 #include "wsm_input_manager.h"
 #include "wsm_idle_inhibit_v1.h"
 #include "wsm_workspace_manager.h"
+#include "wsm_timer.h"
+#include "wsm_metrics.h"
 #include "node/wsm_node_descriptor.h"
 
 #include <stdlib.h>
+#include <time.h>
 
 #include <wlr/types/wlr_scene.h>
 
 struct wsm_transaction {
-    struct wl_event_source *timer;
+    uint64_t generation; // never 0, nodes start out with no transaction
+    struct wsm_timer *timer;
     struct wsm_list *instructions;   // struct wsm_transaction_instruction *
     size_t num_waiting;
     size_t num_configures;
     struct timespec commit_time;
+
+    // Parts of the tree touched by transaction_apply(), only these get
+    // re-arranged once the transaction is applied
+    struct wsm_list *dirty_outputs;      // struct wsm_output *
+    struct wsm_list *dirty_workspaces;   // struct wsm_workspace *
+    struct wsm_list *dirty_containers;   // floating struct wsm_container *
+    bool arrange_all;
 };
 
 struct wsm_transaction_instruction {
@@ -62,8 +75,10 @@ struct wsm_transaction_instruction {
         struct wsm_container_state container_state;
     };
     uint32_t serial;
+    uint32_t changes; // enum wsm_node_change, accumulated over every add
     bool server_request;
     bool waiting;
+    struct wlr_box animate_from; // content geometry before the apply
 };
 
 static struct wsm_transaction *transaction_create(void) {
@@ -72,7 +87,12 @@ static struct wsm_transaction *transaction_create(void) {
     if (!wsm_assert(transaction, "Unable to allocate transaction")) {
         return NULL;
     }
+    static uint64_t next_generation = 1;
+    transaction->generation = next_generation++;
     transaction->instructions = create_list();
+    transaction->dirty_outputs = create_indexed_list();
+    transaction->dirty_workspaces = create_indexed_list();
+    transaction->dirty_containers = create_indexed_list();
     return transaction;
 }
 
@@ -85,6 +105,9 @@ static void transaction_destroy(struct wsm_transaction *transaction) {
         if (node->instruction == instruction) {
             node->instruction = NULL;
         }
+        if (node->txn_instruction == instruction) {
+            node->txn_instruction = NULL;
+        }
         if (node->destroying && node->ntxnrefs == 0) {
             switch (node->type) {
             case N_ROOT:
@@ -104,28 +127,69 @@ static void transaction_destroy(struct wsm_transaction *transaction) {
         free(instruction);
     }
     list_free(transaction->instructions);
+    list_free(transaction->dirty_outputs);
+    list_free(transaction->dirty_workspaces);
+    list_free(transaction->dirty_containers);
 
-    if (transaction->timer) {
-        wl_event_source_remove(transaction->timer);
-    }
+    wsm_timer_destroy(transaction->timer);
     free(transaction);
 }
 
+/**
+ * Start a new instruction from the state the node will have once everything
+ * before it has been applied. Lists are left NULL, which tells
+ * apply_*_state() to keep the current ones, so the parts a node was not
+ * marked for never have to be copied.
+ */
+static void seed_instruction_state(struct wsm_node *node,
+                                   struct wsm_transaction_instruction *instruction) {
+    struct wsm_transaction_instruction *in_flight = node->instruction;
+
+    switch (node->type) {
+    case N_ROOT:
+        break;
+    case N_OUTPUT:
+        instruction->output_state = in_flight ?
+            in_flight->output_state : node->wsm_output->current;
+        instruction->output_state.workspaces = NULL;
+        break;
+    case N_WORKSPACE:
+        instruction->workspace_state = in_flight ?
+            in_flight->workspace_state : node->wsm_workspace->current;
+        instruction->workspace_state.floating = NULL;
+        instruction->workspace_state.tiling = NULL;
+        break;
+    case N_CONTAINER:
+        instruction->container_state = in_flight ?
+            in_flight->container_state : node->wsm_container->current;
+        instruction->container_state.children = NULL;
+        break;
+    }
+}
+
 static void copy_output_state(struct wsm_output *output,
-                              struct wsm_transaction_instruction *instruction) {
+                              struct wsm_transaction_instruction *instruction,
+                              uint32_t changes) {
     struct wsm_output_state *state = &instruction->output_state;
-    if (state->workspaces) {
-        state->workspaces->length = 0;
-    } else {
-        state->workspaces = create_list();
+    // An output which was never committed has no list to keep
+    if ((changes & WSM_NODE_CHANGE_CHILDREN) ||
+        (!state->workspaces && !output->current.workspaces)) {
+        if (state->workspaces) {
+            state->workspaces->length = 0;
+        } else {
+            state->workspaces = create_list();
+        }
+        list_cat(state->workspaces, output->workspaces);
     }
-    list_cat(state->workspaces, output->workspaces);
 
-    state->active_workspace = output_get_active_workspace(output);
+    if (changes & (WSM_NODE_CHANGE_CHILDREN | WSM_NODE_CHANGE_FOCUS)) {
+        state->active_workspace = output_get_active_workspace(output);
+    }
 }
 
 static void copy_workspace_state(struct wsm_workspace *ws,
-                                 struct wsm_transaction_instruction *instruction) {
+                                 struct wsm_transaction_instruction *instruction,
+                                 uint32_t changes) {
     struct wsm_workspace_state *state = &instruction->workspace_state;
 
     state->fullscreen = ws->fullscreen;
@@ -136,18 +200,25 @@ static void copy_workspace_state(struct wsm_workspace *ws,
     state->layout = ws->layout;
 
     state->output = ws->output;
-    if (state->floating) {
-        state->floating->length = 0;
-    } else {
-        state->floating = create_list();
+    if ((changes & WSM_NODE_CHANGE_CHILDREN) ||
+        (!state->tiling && !ws->current.tiling)) {
+        if (state->floating) {
+            state->floating->length = 0;
+        } else {
+            state->floating = create_list();
+        }
+        if (state->tiling) {
+            state->tiling->length = 0;
+        } else {
+            state->tiling = create_list();
+        }
+        list_cat(state->floating, ws->floating);
+        list_cat(state->tiling, ws->tiling);
     }
-    if (state->tiling) {
-        state->tiling->length = 0;
-    } else {
-        state->tiling = create_list();
+
+    if (!(changes & (WSM_NODE_CHANGE_CHILDREN | WSM_NODE_CHANGE_FOCUS))) {
+        return;
     }
-    list_cat(state->floating, ws->floating);
-    list_cat(state->tiling, ws->tiling);
 
     struct wsm_seat *seat = input_manager_current_seat();
     state->focused = seat_get_focus(seat) == &ws->node;
@@ -163,22 +234,34 @@ static void copy_workspace_state(struct wsm_workspace *ws,
 }
 
 static void copy_container_state(struct wsm_container *container,
-                                 struct wsm_transaction_instruction *instruction) {
+                                 struct wsm_transaction_instruction *instruction,
+                                 uint32_t changes) {
     struct wsm_container_state *state = &instruction->container_state;
 
-    if (state->children) {
-        list_free(state->children);
-    }
+    // The pending state has no focus and shares its child list with the
+    // container, so carry over what this instruction already holds.
+    struct wsm_list *children = state->children;
+    struct wsm_container *focused_inactive_child = state->focused_inactive_child;
+    bool focused = state->focused;
 
     memcpy(state, &container->pending, sizeof(struct wsm_container_state));
+    state->children = children;
+    state->focused_inactive_child = focused_inactive_child;
+    state->focused = focused;
 
-    if (!container->view) {
+    if (!container->view && ((changes & WSM_NODE_CHANGE_CHILDREN) ||
+                             (!children && !container->current.children))) {
         // We store a copy of the child list to avoid having it mutated after
         // we copy the state.
+        if (state->children) {
+            list_free(state->children);
+        }
         state->children = create_list();
         list_cat(state->children, container->pending.children);
-    } else {
-        state->children = NULL;
+    }
+
+    if (!(changes & (WSM_NODE_CHANGE_CHILDREN | WSM_NODE_CHANGE_FOCUS))) {
+        return;
     }
 
     struct wsm_seat *seat = input_manager_current_seat();
@@ -192,20 +275,15 @@ static void copy_container_state(struct wsm_container *container,
 }
 
 static void transaction_add_node(struct wsm_transaction *transaction,
-                                 struct wsm_node *node, bool server_request) {
+                                 struct wsm_node *node, uint32_t changes,
+                                 bool server_request) {
     struct wsm_transaction_instruction *instruction = NULL;
 
     // Check if we have an instruction for this node already, in which case we
-    // update that instead of creating a new one.
-    if (node->ntxnrefs > 0) {
-        for (int idx = 0; idx < transaction->instructions->length; idx++) {
-            struct wsm_transaction_instruction *other =
-                transaction->instructions->items[idx];
-            if (other->node == node) {
-                instruction = other;
-                break;
-            }
-        }
+    // update that instead of creating a new one. Nodes only referenced by the
+    // transaction in flight have an older generation.
+    if (node->txn_generation == transaction->generation) {
+        instruction = node->txn_instruction;
     }
 
     if (!instruction) {
@@ -216,38 +294,52 @@ static void transaction_add_node(struct wsm_transaction *transaction,
         instruction->transaction = transaction;
         instruction->node = node;
         instruction->server_request = server_request;
+        seed_instruction_state(node, instruction);
 
         list_add(transaction->instructions, instruction);
         node->ntxnrefs++;
+        node->txn_generation = transaction->generation;
+        node->txn_instruction = instruction;
     } else if (server_request) {
         instruction->server_request = true;
     }
+    instruction->changes |= changes;
 
     switch (node->type) {
     case N_ROOT:
         break;
     case N_OUTPUT:
-        copy_output_state(node->wsm_output, instruction);
+        copy_output_state(node->wsm_output, instruction, changes);
         break;
     case N_WORKSPACE:
-        copy_workspace_state(node->wsm_workspace, instruction);
+        copy_workspace_state(node->wsm_workspace, instruction, changes);
         break;
     case N_CONTAINER:
-        copy_container_state(node->wsm_container, instruction);
+        copy_container_state(node->wsm_container, instruction, changes);
         break;
     }
 }
 
 static void apply_output_state(struct wsm_output *output,
                                struct wsm_output_state *state) {
-    list_free(output->current.workspaces);
+    // A NULL list was not part of the instruction, keep the current one
+    if (state->workspaces) {
+        list_free(output->current.workspaces);
+    } else {
+        state->workspaces = output->current.workspaces;
+    }
     memcpy(&output->current, state, sizeof(struct wsm_output_state));
 }
 
 static void apply_workspace_state(struct wsm_workspace *ws,
                                   struct wsm_workspace_state *state) {
-    list_free(ws->current.floating);
-    list_free(ws->current.tiling);
+    if (state->tiling) {
+        list_free(ws->current.floating);
+        list_free(ws->current.tiling);
+    } else {
+        state->floating = ws->current.floating;
+        state->tiling = ws->current.tiling;
+    }
     memcpy(&ws->current, state, sizeof(struct wsm_workspace_state));
 }
 
@@ -258,8 +350,13 @@ static void apply_container_state(struct wsm_container *container,
     // container's current state and the container's pending state
     // (ie. con->children). The list itself needs to be freed here.
     // Any child containers which are being deleted will be cleaned up in
-    // transaction_destroy().
-    list_free(container->current.children);
+    // transaction_destroy(). Without a list of its own the instruction did
+    // not touch the children, and the current list stays.
+    if (state->children) {
+        list_free(container->current.children);
+    } else {
+        state->children = container->current.children;
+    }
 
     memcpy(&container->current, state, sizeof(struct wsm_container_state));
 
@@ -279,10 +376,80 @@ static void apply_container_state(struct wsm_container *container,
     }
 }
 
+static void mark_output_dirty(struct wsm_transaction *transaction,
+                              struct wsm_output *output) {
+    if (output && !list_contains(transaction->dirty_outputs, output)) {
+        list_add(transaction->dirty_outputs, output);
+    }
+}
+
+static void mark_workspace_dirty(struct wsm_transaction *transaction,
+                                 struct wsm_workspace *ws) {
+    if (ws && !list_contains(transaction->dirty_workspaces, ws)) {
+        list_add(transaction->dirty_workspaces, ws);
+    }
+}
+
+// Toplevel floating container of @con in the current state, NULL for
+// tiled containers. Changing between floating and tiling also changes the
+// lists of the workspace, whose own instruction then covers both.
+static struct wsm_container *current_floater(struct wsm_container *con) {
+    while (con->current.parent) {
+        con = con->current.parent;
+    }
+    struct wsm_workspace *ws = con->current.workspace;
+    if (!ws || !ws->current.floating || !list_contains(ws->current.floating, con)) {
+        return NULL;
+    }
+    return con;
+}
+
+/**
+ * Record which outputs, workspaces and floating containers have to be
+ * re-arranged for the given instruction. Called twice, before and after the
+ * state has been applied, so that both the old and the new location of a
+ * node get refreshed.
+ */
+static void transaction_mark_dirty(struct wsm_transaction *transaction,
+                                   struct wsm_transaction_instruction *instruction) {
+    struct wsm_node *node = instruction->node;
+
+    switch (node->type) {
+    case N_ROOT:
+        transaction->arrange_all = true;
+        break;
+    case N_OUTPUT:
+        mark_output_dirty(transaction, node->wsm_output);
+        break;
+    case N_WORKSPACE:
+        mark_output_dirty(transaction, node->wsm_workspace->current.output);
+        break;
+    case N_CONTAINER: {
+        struct wsm_container_state *state = &node->wsm_container->current;
+        if (state->fullscreen_mode != instruction->container_state.fullscreen_mode) {
+            // fullscreen changes move floaters between the root layers
+            transaction->arrange_all = true;
+        }
+        // a floating container only affects its own subtree, unless it is
+        // fullscreen and arranged together with the workspace
+        struct wsm_container *floater = current_floater(node->wsm_container);
+        if (floater && floater->current.fullscreen_mode == FULLSCREEN_NONE) {
+            if (!list_contains(transaction->dirty_containers, floater)) {
+                list_add(transaction->dirty_containers, floater);
+            }
+            break;
+        }
+        mark_workspace_dirty(transaction, state->workspace);
+        break;
+    }
+    }
+}
+
 /**
  * Apply a transaction to the "current" state of the tree.
  */
 static void transaction_apply(struct wsm_transaction *transaction) {
+    WSM_TRACE_SCOPE("transaction_apply");
     wsm_log(WSM_DEBUG, "Applying transaction %p", transaction);
 
     // Apply the instruction state to the node's current state
@@ -291,26 +458,96 @@ static void transaction_apply(struct wsm_transaction *transaction) {
             transaction->instructions->items[i];
         struct wsm_node *node = instruction->node;
 
+        transaction_mark_dirty(transaction, instruction);
+
         switch (node->type) {
         case N_ROOT:
             break;
-        case N_OUTPUT:
-            apply_output_state(node->wsm_output, &instruction->output_state);
+        case N_OUTPUT: {
+            struct wsm_output *output = node->wsm_output;
+            if (!node->destroying) {
+                wsm_animation_save_workspace(output,
+                                             instruction->output_state.active_workspace);
+            }
+            apply_output_state(output, &instruction->output_state);
             break;
+        }
         case N_WORKSPACE:
             apply_workspace_state(node->wsm_workspace,
                                   &instruction->workspace_state);
             break;
-        case N_CONTAINER:
+        case N_CONTAINER: {
+            struct wsm_container_state *current = &node->wsm_container->current;
+            struct wsm_container_state *state = &instruction->container_state;
+            instruction->animate_from = (struct wlr_box){
+                .x = current->content_x,
+                .y = current->content_y,
+                .width = current->content_width,
+                .height = current->content_height,
+            };
+            struct wlr_box to = {
+                .x = state->content_x,
+                .y = state->content_y,
+                .width = state->content_width,
+                .height = state->content_height,
+            };
+            // the saved buffers go away with the apply, keep them to
+            // crossfade from
+            if (node_is_view(node) && !node->destroying &&
+                !wlr_box_equal(&instruction->animate_from, &to)) {
+                wsm_animation_save(node->wsm_container->view);
+            }
             apply_container_state(node->wsm_container,
                                   &instruction->container_state);
             break;
         }
+        }
 
+        transaction_mark_dirty(transaction, instruction);
         node->instruction = NULL;
     }
 }
 
+static void transaction_arrange(struct wsm_transaction *transaction) {
+    struct wsm_scene *root = global_server.wsm_scene;
+    // title bar updates and the like arrange outside of transactions, do
+    // not bill those to this one
+    arrange_take_scene_mutations();
+
+    if (transaction->arrange_all) {
+        arrange_root_scene(root);
+        wsm_metric_add(&wsm_metrics.full_arranges, 1);
+    } else {
+        arrange_root_scene_dirty(root, transaction->dirty_outputs,
+                                 transaction->dirty_workspaces, transaction->dirty_containers);
+    }
+
+    size_t mutations = arrange_take_scene_mutations();
+    wsm_metric_observe(&wsm_metrics.arrange_scene_mutations, mutations);
+    wsm_log(WSM_DEBUG, "Transaction %p arranged %s: %zu scene mutations "
+            "(%i outputs, %i workspaces, %i containers)", transaction,
+            transaction->arrange_all ? "fully" : "incrementally",
+            mutations, transaction->dirty_outputs->length,
+            transaction->dirty_workspaces->length, transaction->dirty_containers->length);
+}
+
+static void transaction_animate(struct wsm_transaction *transaction) {
+    for (int i = 0; i < transaction->instructions->length; ++i) {
+        struct wsm_transaction_instruction *instruction =
+            transaction->instructions->items[i];
+        struct wsm_node *node = instruction->node;
+        if (node->destroying) {
+            continue;
+        }
+        if (node->type == N_OUTPUT) {
+            wsm_animation_start_workspace(node->wsm_output);
+        } else if (node_is_view(node)) {
+            wsm_animation_start(node->wsm_container->view,
+                                &instruction->animate_from);
+        }
+    }
+}
+
 static void transaction_commit_pending(void);
 
 static void transaction_progress(void) {
@@ -320,8 +557,16 @@ static void transaction_progress(void) {
     if (global_server.queued_transaction->num_waiting > 0) {
         return;
     }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct timespec *commit_time = &global_server.queued_transaction->commit_time;
+    wsm_metric_observe(&wsm_metrics.transaction_apply_latency,
+                       (now.tv_sec - commit_time->tv_sec) * 1000000000ll +
+                           (now.tv_nsec - commit_time->tv_nsec));
+
     transaction_apply(global_server.queued_transaction);
-    arrange_root_scene(global_server.wsm_scene);
+    transaction_arrange(global_server.queued_transaction);
+    transaction_animate(global_server.queued_transaction);
     cursor_rebase_all();
     transaction_destroy(global_server.queued_transaction);
     global_server.queued_transaction = NULL;
@@ -338,6 +583,7 @@ static int handle_timeout(void *data) {
     struct wsm_transaction *transaction = data;
     wsm_log(WSM_DEBUG, "Transaction %p timed out (%zi waiting)",
              transaction, transaction->num_waiting);
+    wsm_metric_add(&wsm_metrics.transaction_timeouts, 1);
     transaction->num_waiting = 0;
     transaction_progress();
     return 0;
@@ -354,6 +600,11 @@ static bool should_configure(struct wsm_node *node,
     if (!instruction->server_request) {
         return false;
     }
+    // Nothing the client is told about has changed
+    if (!(instruction->changes &
+          (WSM_NODE_CHANGE_GEOMETRY | WSM_NODE_CHANGE_FULLSCREEN))) {
+        return false;
+    }
     struct wsm_container_state *cstate = &node->wsm_container->current;
     struct wsm_container_state *istate = &instruction->container_state;
 #if HAVE_XWAYLAND
@@ -378,8 +629,11 @@ static bool should_configure(struct wsm_node *node,
 }
 
 static void transaction_commit(struct wsm_transaction *transaction) {
+    WSM_TRACE_SCOPE("transaction_commit");
     wsm_log(WSM_DEBUG, "Transaction %p committing with %i instructions",
              transaction, transaction->instructions->length);
+    wsm_metric_add(&wsm_metrics.transactions, 1);
+    clock_gettime(CLOCK_MONOTONIC, &transaction->commit_time);
     transaction->num_waiting = 0;
     for (int i = 0; i < transaction->instructions->length; ++i) {
         struct wsm_transaction_instruction *instruction =
@@ -402,6 +656,7 @@ static void transaction_commit(struct wsm_transaction *transaction) {
         }
         if (!hidden && node_is_view(node) &&
             !node->wsm_container->view->saved_surface_tree) {
+            wsm_animation_finish(node->wsm_container->view);
             view_save_buffer(node->wsm_container->view);
         }
         node->instruction = instruction;
@@ -410,11 +665,9 @@ static void transaction_commit(struct wsm_transaction *transaction) {
 
     if (transaction->num_waiting) {
         // Set up a timer which the views must respond within
-        transaction->timer = wl_event_loop_add_timer(global_server.wl_event_loop,
-                                                     handle_timeout, transaction);
+        transaction->timer = wsm_timer_create(handle_timeout, transaction);
         if (transaction->timer) {
-            wl_event_source_timer_update(transaction->timer,
-                                         global_server.txn_timeout_ms);
+            wsm_timer_update(transaction->timer, global_server.txn_timeout_ms);
         } else {
             wsm_log_errno(WSM_ERROR, "Unable to create transaction timer "
                                        "(some imperfect frames might be rendered)");
@@ -442,7 +695,7 @@ static void set_instruction_ready(
     if (instruction->waiting && transaction->num_waiting > 0 &&
         --transaction->num_waiting == 0) {
         wsm_log(WSM_DEBUG, "Transaction %p is ready", transaction);
-        wl_event_source_timer_update(transaction->timer, 0);
+        wsm_timer_update(transaction->timer, 0);
     }
 
     instruction->node->instruction = NULL;
@@ -475,6 +728,34 @@ bool transaction_notify_view_ready_by_geometry(struct wsm_view *view,
     return false;
 }
 
+// Distance of @node from the root, containers counted through their
+// pending parents
+static int node_depth(struct wsm_node *node) {
+    switch (node->type) {
+    case N_ROOT:
+        return 0;
+    case N_OUTPUT:
+        return 1;
+    case N_WORKSPACE:
+        return 2;
+    case N_CONTAINER:
+        break;
+    }
+    int depth = 3;
+    for (struct wsm_container *con = node->wsm_container->pending.parent;
+         con; con = con->pending.parent) {
+        depth++;
+    }
+    return depth;
+}
+
+static void transaction_add_dirty_node(struct wsm_node *node, bool server_request) {
+    transaction_add_node(global_server.pending_transaction, node,
+                         node->dirty_changes, server_request);
+    node->dirty = false;
+    node->dirty_changes = 0;
+}
+
 static void _transaction_commit_dirty(bool server_request) {
     if (!global_server.dirty_nodes->length) {
         return;
@@ -487,12 +768,28 @@ static void _transaction_commit_dirty(bool server_request) {
         }
     }
 
-    for (int i = 0; i < global_server.dirty_nodes->length; ++i) {
-        struct wsm_node *node = global_server.dirty_nodes->items[i];
-        transaction_add_node(global_server.pending_transaction, node, server_request);
-        node->dirty = false;
+    // Parents first, so applying an instruction never sees the state its
+    // parent had before the transaction. Nodes of the same depth keep the
+    // order they were marked in.
+    struct wsm_list *dirty = global_server.dirty_nodes;
+    int *depths = malloc(dirty->length * sizeof(int));
+    wsm_assert(depths, "Could not order dirty nodes: allocation failed!");
+    int max_depth = 0;
+    for (int i = 0; depths && i < dirty->length; ++i) {
+        depths[i] = node_depth(dirty->items[i]);
+        if (depths[i] > max_depth) {
+            max_depth = depths[i];
+        }
+    }
+    for (int depth = 0; depth <= max_depth; ++depth) {
+        for (int i = 0; i < dirty->length; ++i) {
+            if (!depths || depths[i] == depth) {
+                transaction_add_dirty_node(dirty->items[i], server_request);
+            }
+        }
     }
-    global_server.dirty_nodes->length = 0;
+    free(depths);
+    dirty->length = 0;
 
     transaction_commit_pending();
 }
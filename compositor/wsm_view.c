@@ -38,16 +38,23 @@ THE SOFTWARE.
 #include "wsm_workspace.h"
 #include "wsm_xdg_shell.h"
 #include "wsm_transaction.h"
+#include "wsm_frame_throttle.h"
 #include "node/wsm_node_descriptor.h"
+#include "effects/wsm_surface_effect.h"
 #include "node/wsm_text_node.h"
 #include "wsm_idle_inhibit_v1.h"
 #include "wsm_input_manager.h"
 #include "wsm_xdg_decoration.h"
 #include "wsm_arrange.h"
+#include "wsm_timer.h"
+#include "wsm_metrics.h"
 
+#include <math.h>
 #include <float.h>
 #include <stdlib.h>
 
+#include <drm_fourcc.h>
+
 #include <wayland-server.h>
 
 #if HAVE_XWAYLAND
@@ -56,7 +63,11 @@ THE SOFTWARE.
 #include <wlr/xwayland/xwayland.h>
 #endif
 #include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
 #include <wlr/types/wlr_subcompositor.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
@@ -85,6 +96,7 @@ bool view_init(struct wsm_view *view, enum wsm_view_type type,
     view->impl = impl;
     view->allow_request_urgent = true;
     view->enabled = true;
+    wl_list_init(&view->hidden_link);
     wl_signal_init(&view->events.unmap);
     return true;
 }
@@ -311,6 +323,12 @@ void view_set_activated(struct wsm_view *view, bool activated) {
     }
 }
 
+void view_set_suspended(struct wsm_view *view, bool suspended) {
+    if (view->impl->set_suspended) {
+        view->impl->set_suspended(view, suspended);
+    }
+}
+
 void view_request_activate(struct wsm_view *view, struct wsm_seat *seat) {
     struct wsm_workspace *ws = view->container->pending.workspace;
     if (!seat) {
@@ -561,6 +579,7 @@ void view_map(struct wsm_view *view, struct wlr_surface *wlr_surface,
         return;
     }
     view->surface = wlr_surface;
+    wsm_metric_add(&wsm_metrics.views, 1);
     view_populate_pid(view);
     view->container = container_create(view);
 
@@ -711,11 +730,11 @@ void view_map(struct wsm_view *view, struct wlr_surface *wlr_surface,
 
 void view_unmap(struct wsm_view *view) {
     wl_signal_emit_mutable(&view->events.unmap, view);
+    wsm_frame_throttle_view_unmap(view);
+    wsm_metric_add(&wsm_metrics.views, -1);
 
-    if (view->urgent_timer) {
-        wl_event_source_remove(view->urgent_timer);
-        view->urgent_timer = NULL;
-    }
+    wsm_timer_destroy(view->urgent_timer);
+    view->urgent_timer = NULL;
 
     if (view->foreign_toplevel) {
         wlr_foreign_toplevel_handle_v1_destroy(view->foreign_toplevel);
@@ -786,6 +805,21 @@ void view_center_and_clip_surface(struct wsm_view *view) {
         }
         wlr_scene_subsurface_tree_set_clip(&con->view->content_tree->node, &clip);
     }
+
+    view_update_shadow(view);
+}
+
+void view_update_shadow(struct wsm_view *view) {
+    struct wsm_container *con = view->container;
+    if (!view->surface || !con) {
+        return;
+    }
+
+    struct wlr_box box = {
+        .width = con->current.content_width,
+        .height = con->current.content_height,
+    };
+    wsm_surface_effect_update_shadow(view->surface, view->scene_tree, &box);
 }
 
 struct wsm_view *view_from_wlr_surface(struct wlr_surface *wlr_surface) {
@@ -993,10 +1027,8 @@ void view_set_urgent(struct wsm_view *view, bool enable) {
         container_update_itself_and_parents(view->container);
     } else {
         view->urgent = (struct timespec){ 0 };
-        if (view->urgent_timer) {
-            wl_event_source_remove(view->urgent_timer);
-            view->urgent_timer = NULL;
-        }
+        wsm_timer_destroy(view->urgent_timer);
+        view->urgent_timer = NULL;
     }
 
     if (!container_is_scratchpad_hidden(view->container)) {
@@ -1037,6 +1069,158 @@ static void view_save_buffer_iterator(struct wlr_scene_buffer *buffer,
     wlr_scene_buffer_set_buffer(sbuf, buffer->buffer);
 }
 
+struct view_snapshot_data {
+    struct wlr_box box;         // extents of all buffers, in content tree coords
+    float scale;
+    struct wlr_render_pass *pass;
+    struct wlr_renderer *renderer;
+};
+
+// Size of a scene buffer in layout coords, as the scene graph sizes it
+static void snapshot_buffer_size(struct wlr_scene_buffer *buffer, int *width, int *height) {
+    if (buffer->dst_width > 0 && buffer->dst_height > 0) {
+        *width = buffer->dst_width;
+        *height = buffer->dst_height;
+        return;
+    }
+    *width = buffer->buffer->width;
+    *height = buffer->buffer->height;
+    wlr_output_transform_coords(buffer->transform, width, height);
+}
+
+static void view_snapshot_extents_iterator(struct wlr_scene_buffer *buffer,
+                                           int sx, int sy, void *data) {
+    struct view_snapshot_data *snapshot = data;
+    if (!buffer->buffer || !buffer->node.enabled) {
+        return;
+    }
+
+    if (buffer->primary_output &&
+        buffer->primary_output->output->scale > snapshot->scale) {
+        snapshot->scale = buffer->primary_output->output->scale;
+    }
+
+    int width, height;
+    snapshot_buffer_size(buffer, &width, &height);
+    struct wlr_box box = { sx, sy, width, height };
+    if (wlr_box_empty(&snapshot->box)) {
+        snapshot->box = box;
+    } else {
+        int x1 = MIN(snapshot->box.x, box.x);
+        int y1 = MIN(snapshot->box.y, box.y);
+        int x2 = MAX(snapshot->box.x + snapshot->box.width, box.x + box.width);
+        int y2 = MAX(snapshot->box.y + snapshot->box.height, box.y + box.height);
+        snapshot->box = (struct wlr_box){ x1, y1, x2 - x1, y2 - y1 };
+    }
+}
+
+static void view_snapshot_render_iterator(struct wlr_scene_buffer *buffer,
+                                          int sx, int sy, void *data) {
+    struct view_snapshot_data *snapshot = data;
+    if (!buffer->buffer || !buffer->node.enabled) {
+        return;
+    }
+
+    // Same lookup as the scene renderer, client buffers already carry a texture
+    struct wlr_texture *texture = buffer->texture;
+    bool own_texture = false;
+    if (!texture) {
+        struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(buffer->buffer);
+        if (client_buffer) {
+            texture = client_buffer->texture;
+        }
+    }
+    if (!texture) {
+        texture = wlr_texture_from_buffer(snapshot->renderer, buffer->buffer);
+        own_texture = true;
+    }
+    if (!texture) {
+        return;
+    }
+
+    int width, height;
+    snapshot_buffer_size(buffer, &width, &height);
+    struct wlr_box dst_box = {
+        .x = round((sx - snapshot->box.x) * snapshot->scale),
+        .y = round((sy - snapshot->box.y) * snapshot->scale),
+        .width = round(width * snapshot->scale),
+        .height = round(height * snapshot->scale),
+    };
+
+    wlr_render_pass_add_texture(snapshot->pass, &(struct wlr_render_texture_options){
+        .texture = texture,
+        .src_box = buffer->src_box,
+        .dst_box = dst_box,
+        .transform = buffer->transform,
+        .alpha = &buffer->opacity,
+        .filter_mode = WLR_SCALE_FILTER_BILINEAR,
+        .blend_mode = WLR_RENDER_BLEND_MODE_PREMULTIPLIED,
+    });
+
+    if (own_texture) {
+        wlr_texture_destroy(texture);
+    }
+}
+
+struct wlr_scene_buffer *view_snapshot_create(struct wsm_view *view,
+                                              struct wlr_scene_tree *parent) {
+    return scene_node_snapshot_create(&view->content_tree->node, parent);
+}
+
+struct wlr_scene_buffer *scene_node_snapshot_create(struct wlr_scene_node *source,
+                                                    struct wlr_scene_tree *parent) {
+    struct view_snapshot_data snapshot = {
+        .scale = 1.0f,
+        .renderer = global_server.wlr_renderer,
+    };
+    wlr_scene_node_for_each_buffer(source, view_snapshot_extents_iterator, &snapshot);
+    if (wlr_box_empty(&snapshot.box)) {
+        return NULL;
+    }
+
+    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    struct wlr_drm_format format = {
+        .format = DRM_FORMAT_ARGB8888,
+        .len = 1,
+        .capacity = 1,
+        .modifiers = &modifier,
+    };
+    struct wlr_buffer *buffer = wlr_allocator_create_buffer(global_server.wlr_allocator,
+                                                            round(snapshot.box.width * snapshot.scale),
+                                                            round(snapshot.box.height * snapshot.scale), &format);
+    if (!buffer) {
+        wsm_log(WSM_DEBUG, "Could not allocate a snapshot buffer");
+        return NULL;
+    }
+
+    snapshot.pass = wlr_renderer_begin_buffer_pass(global_server.wlr_renderer, buffer, NULL);
+    if (!snapshot.pass) {
+        wlr_buffer_drop(buffer);
+        return NULL;
+    }
+
+    wlr_render_pass_add_rect(snapshot.pass, &(struct wlr_render_rect_options){
+        .box = { .width = buffer->width, .height = buffer->height },
+        .color = { 0, 0, 0, 0 },
+        .blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+    });
+    wlr_scene_node_for_each_buffer(source, view_snapshot_render_iterator, &snapshot);
+    if (!wlr_render_pass_submit(snapshot.pass)) {
+        wlr_buffer_drop(buffer);
+        return NULL;
+    }
+
+    struct wlr_scene_buffer *sbuf = wlr_scene_buffer_create(parent, buffer);
+    wlr_buffer_drop(buffer);
+    if (!sbuf) {
+        wsm_log(WSM_ERROR, "Could not allocate a scene buffer for a snapshot");
+        return NULL;
+    }
+    wlr_scene_buffer_set_dest_size(sbuf, snapshot.box.width, snapshot.box.height);
+    wlr_scene_node_set_position(&sbuf->node, snapshot.box.x, snapshot.box.y);
+    return sbuf;
+}
+
 void view_save_buffer(struct wsm_view *view) {
     if (!wsm_assert(!view->saved_surface_tree, "Didn't expect saved buffer")) {
         view_remove_saved_buffer(view);
@@ -1052,8 +1236,11 @@ void view_save_buffer(struct wsm_view *view) {
     // the tree. This will prevent over damaging or other weirdness.
     wlr_scene_node_set_enabled(&view->saved_surface_tree->node, false);
 
-    wlr_scene_node_for_each_buffer(&view->content_tree->node,
-                                   view_save_buffer_iterator, view->saved_surface_tree);
+    if (global_config.saved_buffer_mode != SAVED_BUFFER_SNAPSHOT ||
+        !view_snapshot_create(view, view->saved_surface_tree)) {
+        wlr_scene_node_for_each_buffer(&view->content_tree->node,
+                                       view_save_buffer_iterator, view->saved_surface_tree);
+    }
 
     wlr_scene_node_set_enabled(&view->content_tree->node, false);
     wlr_scene_node_set_enabled(&view->saved_surface_tree->node, true);
@@ -1072,6 +1259,13 @@ static void send_frame_done_iterator(struct wlr_scene_buffer *scene_buffer,
 }
 
 void view_send_frame_done(struct wsm_view *view) {
+    if (wsm_frame_throttle_view_is_throttled(view)) {
+        return;
+    }
+    view_send_frame_done_unthrottled(view);
+}
+
+void view_send_frame_done_unthrottled(struct wsm_view *view) {
     struct timespec when;
     clock_gettime(CLOCK_MONOTONIC, &when);
 
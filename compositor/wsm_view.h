@@ -33,6 +33,7 @@ THE SOFTWARE.
 
 struct wlr_scene_node;
 struct wlr_scene_tree;
+struct wlr_scene_buffer;
 struct wlr_xdg_surface;
 struct wlr_foreign_toplevel_handle_v1;
 
@@ -41,7 +42,9 @@ struct wsm_view;
 struct wsm_output;
 struct wsm_container;
 struct wsm_workspace;
+struct wsm_animation;
 struct wsm_xdg_decoration;
+struct wsm_timer;
 
 enum wsm_view_type {
     WSM_VIEW_XDG_SHELL,
@@ -75,6 +78,7 @@ struct wsm_view_impl {
     void (*set_tiled)(struct wsm_view *view, bool tiled);
     void (*set_fullscreen)(struct wsm_view *view, bool fullscreen);
     void (*set_resizing)(struct wsm_view *view, bool resizing);
+    void (*set_suspended)(struct wsm_view *view, bool suspended);
     bool (*wants_floating)(struct wsm_view *view);
     bool (*is_transient_for)(struct wsm_view *child,
                              struct wsm_view *ancestor);
@@ -109,7 +113,7 @@ struct wsm_view {
 
     struct timespec urgent;
     bool allow_request_urgent;
-    struct wl_event_source *urgent_timer;
+    struct wsm_timer *urgent_timer;
 
     // The geometry for whatever the client is committing, regardless of
     // transaction state. Updated on every commit.
@@ -138,6 +142,17 @@ struct wsm_view {
 
     int max_render_time; // In milliseconds
     bool enabled;
+
+    // Not visible on any output, see wsm_frame_throttle
+    bool hidden;
+    struct wl_list hidden_link;
+
+    // Configures skipped during interactive resizes because the client had
+    // not acked the previous one yet
+    size_t resize_configures_suppressed;
+
+    // Layout transition currently running on this view, if any
+    struct wsm_animation *animation;
 };
 
 struct wsm_xdg_shell_view {
@@ -229,6 +244,7 @@ uint32_t view_configure(struct wsm_view *view, double lx, double ly, int width,
 bool view_inhibit_idle(struct wsm_view *view);
 void view_autoconfigure(struct wsm_view *view);
 void view_set_activated(struct wsm_view *view, bool activated);
+void view_set_suspended(struct wsm_view *view, bool suspended);
 void view_request_activate(struct wsm_view *view, struct wsm_seat *seat);
 void view_request_urgent(struct wsm_view *view);
 void view_set_csd_from_server(struct wsm_view *view, bool enabled);
@@ -244,6 +260,7 @@ void view_map(struct wsm_view *view, struct wlr_surface *wlr_surface,
 void view_unmap(struct wsm_view *view);
 void view_update_size(struct wsm_view *view);
 void view_center_and_clip_surface(struct wsm_view *view);
+void view_update_shadow(struct wsm_view *view);
 struct wsm_view *view_from_wlr_surface(struct wlr_surface *surface);
 void view_update_app_id(struct wsm_view *view);
 void view_update_title(struct wsm_view *view, bool force);
@@ -252,7 +269,26 @@ void view_set_urgent(struct wsm_view *view, bool enable);
 bool view_is_urgent(struct wsm_view *view);
 void view_remove_saved_buffer(struct wsm_view *view);
 void view_save_buffer(struct wsm_view *view);
+/**
+ * @brief render the view's content tree into a single scene buffer
+ *
+ * @details the buffer is created under parent, positioned and sized in
+ * the coordinate space of the content tree. Returns NULL on failure.
+ */
+struct wlr_scene_buffer *view_snapshot_create(struct wsm_view *view,
+                                              struct wlr_scene_tree *parent);
+/**
+ * @brief render the buffers below @p source into a single scene buffer,
+ * in the coordinate space of @p source.
+ */
+struct wlr_scene_buffer *scene_node_snapshot_create(struct wlr_scene_node *source,
+                                                    struct wlr_scene_tree *parent);
 bool view_is_transient_for(struct wsm_view *child, struct wsm_view *ancestor);
+/**
+ * @brief send frame done to the surfaces of the view, unless the frame
+ * throttle holds them back because the view is hidden.
+ */
 void view_send_frame_done(struct wsm_view *view);
+void view_send_frame_done_unthrottled(struct wsm_view *view);
 
 #endif
@@ -32,6 +32,7 @@ THE SOFTWARE.
 #include "wsm_input_manager.h"
 #include "wsm_workspace_manager.h"
 #include "wsm_output_config.h"
+#include "node/wsm_node_descriptor.h"
 
 #include <stdlib.h>
 #include <strings.h>
@@ -443,13 +444,13 @@ void disable_workspace(struct wsm_workspace *ws) {
     for (int i = 0; i < ws->current.tiling->length; i++) {
         struct wsm_container *child = ws->current.tiling->items[i];
 
-        wlr_scene_node_reparent(&child->scene_tree->node, ws->layers.non_fullscreen);
+        wsm_scene_node_reparent(&child->scene_tree->node, ws->layers.non_fullscreen);
         disable_container(child);
     }
 
     for (int i = 0; i < ws->current.floating->length; i++) {
         struct wsm_container *floater = ws->current.floating->items[i];
-        wlr_scene_node_reparent(&floater->scene_tree->node, global_server.wsm_scene->layers.floating);
+        wsm_scene_node_reparent(&floater->scene_tree->node, global_server.wsm_scene->layers.floating);
         disable_container(floater);
         wlr_scene_node_set_enabled(&floater->scene_tree->node, false);
     }
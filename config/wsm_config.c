@@ -96,4 +96,10 @@ void wsm_config_init() {
     color_to_rgba(global_config.sensing_border_color, 0x00000000);
 
     global_config.primary_selection = true;
+    global_config.saved_buffer_mode = SAVED_BUFFER_CLONE;
+    global_config.animation_duration_ms = 150;
+    global_config.cpu_render_threads = 0;
+    global_config.damage_max_rects = 32;
+    global_config.damage_merge_waste = 0.25f;
+    global_config.hidden_frame_rate = 1;
 }
@@ -54,6 +54,11 @@ enum wsm_fowa {
     FOWA_NONE,
 };
 
+enum wsm_saved_buffer_mode {
+    SAVED_BUFFER_CLONE,    // clone every scene buffer of the view
+    SAVED_BUFFER_SNAPSHOT, // render the view into a single texture
+};
+
 enum seat_keyboard_grouping {
     KEYBOARD_GROUP_DEFAULT, // the default is currently smart
     KEYBOARD_GROUP_NONE,
@@ -107,6 +112,26 @@ struct wsm_config {
     enum wsm_popup_during_fullscreen popup_during_fullscreen;
 
     bool primary_selection;
+
+    // how views are frozen while a transaction waits for them, a snapshot
+    // that can't be rendered falls back to cloning
+    enum wsm_saved_buffer_mode saved_buffer_mode;
+
+    // duration of layout transitions, 0 disables them
+    uint32_t animation_duration_ms;
+
+    // threads compositing outputs of the pixman renderer in bands, 0 keeps
+    // the single-threaded render pass, -1 uses one per core
+    int cpu_render_threads;
+
+    // rectangles the damage of a frame is merged into, 0 keeps it as is
+    int damage_max_rects;
+    // share of a merged rectangle that may be outside the damage
+    float damage_merge_waste;
+
+    // frame callbacks per second of views not visible on any output, 0
+    // keeps sending them like to visible views
+    int hidden_frame_rate;
 };
 
 void wsm_config_init();
@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "wsm_server.h"
 #include "wsm_seat.h"
 #include "wsm_log.h"
+#include "wsm_trace.h"
 #include "wsm_view.h"
 #include "wsm_tablet.h"
 #include "wsm_common.h"
@@ -36,6 +37,8 @@ THE SOFTWARE.
 #include "wsm_output_manager.h"
 #include "wsm_input_manager.h"
 #include "wsm_seatop_default.h"
+#include "wsm_timer.h"
+#include "wsm_startup.h"
 #include "node/wsm_node_descriptor.h"
 
 #include <stdlib.h>
@@ -596,8 +599,7 @@ struct wsm_cursor *wsm_cursor_create(const struct wsm_server* server, struct wsm
     wl_signal_add(&cursor_shape_manager->events.request_set_shape,
                   &cursor->request_set_shape);
 
-    cursor->hide_source = wl_event_loop_add_timer(server->wl_event_loop,
-                                                  hide_notify, cursor);
+    cursor->hide_source = wsm_timer_create(hide_notify, cursor);
 
     wl_list_init(&cursor->image_surface_destroy.link);
     cursor->image_surface_destroy.notify = handle_image_surface_destroy;
@@ -687,7 +689,7 @@ void wsm_cursor_destroy(struct wsm_cursor *cursor) {
         return;
     }
 
-    wl_event_source_remove(cursor->hide_source);
+    wsm_timer_destroy(cursor->hide_source);
 
     wl_list_remove(&cursor->image_surface_destroy.link);
     wl_list_remove(&cursor->hold_begin.link);
@@ -713,6 +715,7 @@ void wsm_cursor_destroy(struct wsm_cursor *cursor) {
     wl_list_remove(&cursor->tool_button.link);
     wl_list_remove(&cursor->request_set_cursor.link);
 
+    wsm_init_task_join(&global_server.xcursor_task);
     wlr_xcursor_manager_destroy(global_server.xcursor_manager);
     global_server.xcursor_manager = NULL;
 
@@ -762,6 +765,7 @@ void cursor_set_image(struct wsm_cursor *cursor, const char *image,
         wlr_cursor_unset_image(cursor->wlr_cursor);
     } else if (!current_image || strcmp(current_image, image) != 0) {
         wlr_cursor_unset_image(cursor->wlr_cursor);
+        wsm_init_task_join(&global_server.xcursor_task);
         wlr_cursor_set_xcursor(cursor->wlr_cursor, global_server.xcursor_manager, image);
     }
 }
@@ -992,6 +996,7 @@ void warp_to_constraint_cursor_hint(struct wsm_cursor *cursor) {
 struct wsm_node *node_at_coords(
     struct wsm_seat *seat, double lx, double ly,
     struct wlr_surface **surface, double *sx, double *sy) {
+    WSM_TRACE_SCOPE("node_at_coords");
     struct wlr_scene_node *scene_node = NULL;
 
     struct wlr_scene_node *node;
@@ -1026,6 +1031,15 @@ struct wsm_node *node_at_coords(
         // determine what container we clicked on
         struct wlr_scene_node *current = scene_node;
         while (true) {
+            // Most levels are plain trees and surfaces
+            if (!wsm_scene_descriptor_mask(current)) {
+                if (!current->parent) {
+                    break;
+                }
+                current = &current->parent->node;
+                continue;
+            }
+
             struct wsm_container *con = wsm_scene_descriptor_try_get(current,
                                                                   WSM_SCENE_DESC_CONTAINER);
 
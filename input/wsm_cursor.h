@@ -53,6 +53,7 @@ struct wsm_node;
 struct wsm_server;
 struct wsm_container;
 struct wsm_workspace;
+struct wsm_timer;
 
 enum wsm_cursor_mode {
     WSM_CURSOR_PASSTHROUGH,
@@ -126,7 +127,7 @@ struct wsm_cursor {
 
     struct wl_listener constraint_commit;
 
-    struct wl_event_source *hide_source;
+    struct wsm_timer *hide_source;
     bool hidden;
     enum seat_config_hide_cursor_when_typing hide_when_typing;
 
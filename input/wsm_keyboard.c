@@ -23,6 +23,7 @@ THE SOFTWARE.
 */
 
 #include "wsm_log.h"
+#include "wsm_trace.h"
 #include "wsm_seat.h"
 #include "wsm_server.h"
 #include "wsm_config.h"
@@ -30,6 +31,8 @@ THE SOFTWARE.
 #include "wsm_keyboard.h"
 #include "wsm_text_input.h"
 #include "wsm_input_manager.h"
+#include "wsm_timer.h"
+#include "wsm_startup.h"
 
 #include <stdlib.h>
 #include <strings.h>
@@ -321,9 +324,7 @@ void wsm_keyboard_disarm_key_repeat(struct wsm_keyboard *keyboard) {
         return;
     }
     keyboard->repeat_binding = NULL;
-    if (wl_event_source_timer_update(keyboard->key_repeat_source, 0) < 0) {
-        wsm_log(WSM_DEBUG, "failed to disarm key repeat timer");
-    }
+    wsm_timer_update(keyboard->key_repeat_source, 0);
 }
 
 struct key_info {
@@ -385,6 +386,7 @@ static struct wlr_input_method_keyboard_grab_v2 *keyboard_get_im_grab(
 
 static void handle_key_event(struct wsm_keyboard *keyboard,
                              struct wlr_keyboard_key_event *event) {
+    WSM_TRACE_SCOPE("handle_key_event");
     struct wsm_seat *seat = keyboard->seat_device->wsm_seat;
     struct wlr_seat *wlr_seat = seat->wlr_seat;
     struct wlr_input_device *wlr_device =
@@ -458,10 +460,8 @@ static void handle_key_event(struct wsm_keyboard *keyboard,
     if (binding && !(binding->flags & BINDING_NOREPEAT) &&
         keyboard->wlr->repeat_info.delay > 0) {
         keyboard->repeat_binding = binding;
-        if (wl_event_source_timer_update(keyboard->key_repeat_source,
-                                         keyboard->wlr->repeat_info.delay) < 0) {
-            wsm_log(WSM_DEBUG, "failed to set key repeat timer");
-        }
+        wsm_timer_update(keyboard->key_repeat_source,
+                         keyboard->wlr->repeat_info.delay);
     } else if (keyboard->repeat_binding) {
         wsm_keyboard_disarm_key_repeat(keyboard);
     }
@@ -601,10 +601,8 @@ static int handle_keyboard_repeat(void *data) {
     if (keyboard->repeat_binding) {
         if (keyboard->wlr->repeat_info.rate > 0) {
             // We queue the next event first, as the command might cancel it
-            if (wl_event_source_timer_update(keyboard->key_repeat_source,
-                                             1000 / keyboard->wlr->repeat_info.rate) < 0) {
-                wsm_log(WSM_DEBUG, "failed to update key repeat timer");
-            }
+            wsm_timer_update(keyboard->key_repeat_source,
+                             1000 / keyboard->wlr->repeat_info.rate);
         }
 
         // seat_execute_command(keyboard->seat_device->wsm_seat,
@@ -663,8 +661,7 @@ struct wsm_keyboard *wsm_keyboard_create(struct wsm_seat *seat,
     wl_list_init(&keyboard->keyboard_key.link);
     wl_list_init(&keyboard->keyboard_modifiers.link);
 
-    keyboard->key_repeat_source = wl_event_loop_add_timer(global_server.wl_event_loop,
-                                                          handle_keyboard_repeat, keyboard);
+    keyboard->key_repeat_source = wsm_timer_create(handle_keyboard_repeat, keyboard);
 
     return keyboard;
 }
@@ -726,8 +723,8 @@ static char *format_str(const char *fmt, ...) {
     return str;
 }
 
-struct xkb_keymap *wsm_keyboard_compile_keymap(struct input_config *ic,
-                                                char **error) {
+static struct xkb_keymap *compile_keymap(struct input_config *ic,
+                                         char **error) {
     struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_SECURE_GETENV);
     if (!wsm_assert(context, "cannot create XKB context")) {
         return NULL;
@@ -770,6 +767,37 @@ cleanup:
     return keymap;
 }
 
+// Compiled from the XKB_DEFAULT_* environment, which does not change
+static struct xkb_keymap *default_keymap = NULL;
+static struct wsm_init_task *default_keymap_task = NULL;
+
+static void compile_default_keymap(void *data) {
+    default_keymap = compile_keymap(NULL, NULL);
+}
+
+void wsm_keyboard_prepare_default_keymap(void) {
+    default_keymap_task = wsm_init_task_start("default keymap",
+                                              compile_default_keymap, NULL);
+}
+
+static bool input_config_has_xkb(struct input_config *ic) {
+    return ic && (ic->xkb_file || ic->xkb_layout || ic->xkb_model ||
+                  ic->xkb_options || ic->xkb_rules || ic->xkb_variant);
+}
+
+struct xkb_keymap *wsm_keyboard_compile_keymap(struct input_config *ic,
+                                                char **error) {
+    if (input_config_has_xkb(ic)) {
+        return compile_keymap(ic, error);
+    }
+
+    wsm_init_task_join(&default_keymap_task);
+    if (!default_keymap) {
+        default_keymap = compile_keymap(NULL, error);
+    }
+    return default_keymap ? xkb_keymap_ref(default_keymap) : NULL;
+}
+
 static bool repeat_info_match(struct wsm_keyboard *a, struct wlr_keyboard *b) {
     return a->repeat_rate == b->repeat_info.rate &&
            a->repeat_delay == b->repeat_info.delay;
@@ -1064,7 +1092,7 @@ void wsm_keyboard_destroy(struct wsm_keyboard *keyboard) {
     wl_list_remove(&keyboard->keyboard_key.link);
     wl_list_remove(&keyboard->keyboard_modifiers.link);
     wsm_keyboard_disarm_key_repeat(keyboard);
-    wl_event_source_remove(keyboard->key_repeat_source);
+    wsm_timer_destroy(keyboard->key_repeat_source);
     free(keyboard);
 }
 
@@ -36,6 +36,7 @@ struct wlr_keyboard_group;
 struct wlr_keyboard_shortcuts_inhibitor_v1;
 
 struct xkb_keymap;
+struct wsm_timer;
 
 struct wsm_seat;
 struct wsm_list;
@@ -103,7 +104,7 @@ struct wsm_keyboard {
     struct wsm_shortcut_state state_pressed_sent;
     struct wsm_binding *held_binding;
 
-    struct wl_event_source *key_repeat_source;
+    struct wsm_timer *key_repeat_source;
     struct wsm_binding *repeat_binding;
 };
 
@@ -128,6 +129,11 @@ struct wsm_keyboard_shortcuts_inhibitor {
 struct wsm_keyboard *wsm_keyboard_create(struct wsm_seat *seat,
                                            struct wsm_seat_device *device);
 void wsm_keyboard_configure(struct wsm_keyboard *keyboard);
+/**
+ * @brief compile the keymap of an unconfigured keyboard in the background,
+ * keyboards without xkb settings share it once it is ready
+ */
+void wsm_keyboard_prepare_default_keymap(void);
 void wsm_keyboard_destroy(struct wsm_keyboard *keyboard);
 void wsm_keyboard_disarm_key_repeat(struct wsm_keyboard *keyboard);
 struct wsm_keyboard *wsm_keyboard_for_wlr_keyboard(
@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "wsm_server.h"
 #include "wsm_scene.h"
 #include "wsm_log.h"
+#include "wsm_metrics.h"
 #include "wsm_list.h"
 #include "wsm_view.h"
 #include "wsm_switch.h"
@@ -605,6 +606,7 @@ void seat_remove_device(struct wsm_seat *seat,
 
 void seat_idle_notify_activity(struct wsm_seat *seat,
                                enum wlr_input_device_type source) {
+    wsm_metric_add(&wsm_metrics.input_events, 1);
     if ((source & seat->idle_inhibit_sources) == 0) {
         return;
     }
@@ -1006,10 +1008,10 @@ static void seat_set_workspace_focus(struct wsm_seat *seat, struct wsm_node *nod
     // Unfocus the previous focus
     if (last_focus) {
         seat_send_unfocus(last_focus, seat);
-        node_set_dirty(last_focus);
+        node_set_dirty_changes(last_focus, WSM_NODE_CHANGE_FOCUS);
         struct wsm_node *parent = node_get_parent(last_focus);
         if (parent) {
-            node_set_dirty(parent);
+            node_set_dirty_changes(parent, WSM_NODE_CHANGE_FOCUS);
         }
     }
 
@@ -1176,7 +1178,7 @@ struct wsm_node *seat_get_active_tiling_child(struct wsm_seat *seat,
         if (parent->type == N_WORKSPACE) {
             // Only consider tiling children
             struct wsm_workspace *ws = parent->wsm_workspace;
-            if (list_find(ws->tiling, node->wsm_container) == -1) {
+            if (!list_contains(ws->tiling, node->wsm_container)) {
                 continue;
             }
         }
@@ -1189,11 +1191,11 @@ void seat_set_raw_focus(struct wsm_seat *seat, struct wsm_node *node) {
     struct wsm_seat_node *seat_node = seat_node_from_node(seat, node);
     wl_list_remove(&seat_node->link);
     wl_list_insert(&seat->focus_stack, &seat_node->link);
-    node_set_dirty(node);
+    node_set_dirty_changes(node, WSM_NODE_CHANGE_FOCUS);
 
     struct wsm_node *parent = node_get_parent(node);
     if (parent) {
-        node_set_dirty(parent);
+        node_set_dirty_changes(parent, WSM_NODE_CHANGE_FOCUS);
     }
 }
 
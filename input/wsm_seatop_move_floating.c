@@ -66,7 +66,14 @@ static void handle_tablet_tool_tip(struct wsm_seat *seat,
 static void handle_pointer_motion(struct wsm_seat *seat, uint32_t time_msec) {
     struct seatop_move_floating_event *e = seat->seatop_data;
     struct wlr_cursor *cursor = seat->wsm_cursor->wlr_cursor;
-    container_floating_move_to(e->con, cursor->x - e->dx, cursor->y - e->dy);
+    double lx = cursor->x - e->dx;
+    double ly = cursor->y - e->dy;
+    // Dragging doesn't change the size, so skip the transaction unless the
+    // container is still busy with one or moves to another workspace.
+    if (container_floating_move_to_settled(e->con, lx, ly)) {
+        return;
+    }
+    container_floating_move_to(e->con, lx, ly);
     transaction_commit_dirty();
 }
 
@@ -30,6 +30,8 @@ THE SOFTWARE.
 #include "wsm_arrange.h"
 #include "wsm_container.h"
 #include "wsm_transaction.h"
+#include "wsm_log.h"
+#include "wsm_metrics.h"
 
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_cursor.h>
@@ -43,8 +45,15 @@ struct seatop_resize_floating_event {
     double ref_lx, ref_ly;         // cursor's x/y at start of op
     double ref_width, ref_height;  // container's size at start of op
     double ref_con_lx, ref_con_ly; // container's x/y at start of op
+    bool deferred;                 // pending geometry not sent to the client yet
 };
 
+static void resize_commit(struct seatop_resize_floating_event *e) {
+    e->deferred = false;
+    wsm_arrange_container_auto(e->con);
+    transaction_commit_dirty();
+}
+
 static void handle_button(struct wsm_seat *seat, uint32_t time_msec,
                           struct wlr_input_device *device, uint32_t button,
                           enum wl_pointer_button_state state) {
@@ -53,8 +62,11 @@ static void handle_button(struct wsm_seat *seat, uint32_t time_msec,
 
     if (seat->wsm_cursor->pressed_button_count == 0) {
         container_set_resizing(con, false);
-        wsm_arrange_container_auto(con); // Send configure w/o resizing hint
-        transaction_commit_dirty();
+        if (con->view && con->view->resize_configures_suppressed) {
+            wsm_log(WSM_DEBUG, "Suppressed %zu configures while resizing",
+                    con->view->resize_configures_suppressed);
+        }
+        resize_commit(e); // Send configure w/o resizing hint
         seatop_begin_default(seat);
     }
 }
@@ -166,8 +178,26 @@ static void handle_pointer_motion(struct wsm_seat *seat, uint32_t time_msec) {
     con->pending.content_width += relative_grow_width;
     con->pending.content_height += relative_grow_height;
 
-    wsm_arrange_container_auto(con);
-    transaction_commit_dirty();
+    // Keep at most one configure in flight. The saved buffer stays on screen
+    // until the client acks, then handle_rebase() sends the latest size.
+    if (con->node.instruction) {
+        if (con->view) {
+            con->view->resize_configures_suppressed++;
+        }
+        wsm_metric_add(&wsm_metrics.resize_configures_suppressed, 1);
+        e->deferred = true;
+        return;
+    }
+
+    resize_commit(e);
+}
+
+static void handle_rebase(struct wsm_seat *seat, uint32_t time_msec) {
+    struct seatop_resize_floating_event *e = seat->seatop_data;
+    // Called once a transaction has been applied
+    if (e->deferred && !e->con->node.instruction) {
+        resize_commit(e);
+    }
 }
 
 static void handle_unref(struct wsm_seat *seat, struct wsm_container *con) {
@@ -180,6 +210,7 @@ static void handle_unref(struct wsm_seat *seat, struct wsm_container *con) {
 static const struct wsm_seatop_impl seatop_impl = {
     .button = handle_button,
     .pointer_motion = handle_pointer_motion,
+    .rebase = handle_rebase,
     .unref = handle_unref,
 };
 
@@ -205,6 +236,9 @@ void seatop_begin_resize_floating(struct wsm_seat *seat,
     e->ref_con_ly = con->pending.y;
     e->ref_width = con->pending.width;
     e->ref_height = con->pending.height;
+    if (con->view) {
+        con->view->resize_configures_suppressed = 0;
+    }
 
     seat->seatop_impl = &seatop_impl;
     seat->seatop_data = e;
@@ -23,77 +23,31 @@ THE SOFTWARE.
 */
 
 #include "wsm_log.h"
+#include "wsm_trace.h"
+#include "wsm_startup.h"
 #include "config.h"
+#include "wsm_config.h"
 #include "common/wsm_common.h"
 #include "compositor/wsm_server.h"
+#include "compositor/wsm_metrics.h"
+#include "compositor/wsm_dbus.h"
 #include "common/wsm_parser.h"
 #include "xwl/wsm_xwayland.h"
 
 #include <getopt.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
-#include <systemd/sd-bus.h>
 
 #include <wlr/util/log.h>
 #include <wlr/backend.h>
 
 struct wsm_server global_server = {0};
 
-/**
- * @brief registerDbusComponent call dbus to notify other components that wsm is ready,
- * now wayland client can start connecting
- */
-void registerDbusComponent() {
-    int ret = 0;
-    sd_bus *bus = NULL;
-    ret = sd_bus_open_user(&bus);
-    if (ret < 0) {
-        wsm_log(WSM_ERROR, "Failed to connect to system bus: %s", strerror(-ret));
-        return;
-    }
-
-    sd_bus_message *msg = NULL;
-    ret = sd_bus_message_new_method_call(bus, &msg,
-                                         "org.lychee.Startup",
-                                         "/Startup",
-                                         "org.lychee.Startup",
-                                         "registerComponent");
-    if (ret < 0) {
-        wsm_log(WSM_ERROR, "Failed to create D-Bus message: %s", strerror(-ret));
-        sd_bus_unref(bus);
-        return;
-    }
-
-    const char *param = "wsm";
-    ret = sd_bus_message_append(msg, "s", param);
-    if (ret < 0) {
-        wsm_log(WSM_ERROR, "Failed to append string parameter: %s", strerror(-ret));
-        sd_bus_message_unref(msg);
-        sd_bus_unref(bus);
-        return;
-    }
-
-    sd_bus_message *reply = NULL;
-    ret = sd_bus_call(bus, msg, 0, NULL, &reply);
-    if (ret < 0) {
-        wsm_log(WSM_ERROR, "Failed to call D-Bus method: %s", strerror(-ret));
-        sd_bus_message_unref(msg);
-        sd_bus_unref(bus);
-        return;
-    }
-
-    if (ret >= 0)
-        wsm_log(WSM_INFO, "registerComponent successfully");
-
-    // Clean up resources
-    sd_bus_message_unref(reply);
-    sd_bus_message_unref(msg);
-    sd_bus_unref(bus);
-}
-
 /**
  * @brief usage printf help information,understand the command options of wsm
  * @param error_code
@@ -111,6 +65,14 @@ static void usage(int error_code) {
             "  --xwayland\t\tLoad the xwayland module\n"
 #endif
             "  -l, --log-level\tSet log output level, default value is 1 only ERROR logs, 3 output all logs, 0 disabled log\n"
+            "  --trace\t\tRecord frame timing spans, SIGUSR1 dumps them to\n"
+            "\t\t\t$XDG_RUNTIME_DIR/wsm-trace-<pid>-<n>.json, SIGUSR2 toggles recording\n"
+            "  --log-journal\tAlso write log messages to a binary journal file\n"
+            "  --metrics-socket\tServe Prometheus metrics on this unix socket\n"
+            "  --saved-buffer-mode\tHow views are frozen during transactions,\n"
+            "\t\t\tclone (default) or snapshot\n"
+            "  --cpu-render-threads\tThreads compositing pixman outputs, 0 (default)\n"
+            "\t\t\trenders on the main thread only, -1 uses one per core\n"
             "  -h, --help\t\tThis help message\n\n");
     exit(error_code);
 }
@@ -133,6 +95,22 @@ static char *copy_command_line(int argc, char * const argv[]) {
     return str;
 }
 
+static int handle_trace_dump(int signal, void *data) {
+    static unsigned int dumps = 0;
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/wsm-trace-%d-%u.json",
+             dir ? dir : "/tmp", (int)getpid(), dumps++);
+    wsm_trace_dump(path);
+    return 0;
+}
+
+static int handle_trace_toggle(int signal, void *data) {
+    wsm_trace_set_enabled(!wsm_trace_is_enabled());
+    wsm_log(WSM_INFO, "Tracing %s", wsm_trace_is_enabled() ? "enabled" : "disabled");
+    return 0;
+}
+
 void wsm_terminate(int exit_code) {
     if (!global_server.wl_display) {
         exit(exit_code);
@@ -150,14 +128,26 @@ int main(int argc, char **argv) {
     char *startup_cmd = NULL;
     char *cmdline = NULL;
     bool xwayland = false;
+    bool trace = false;
     bool help = 0;
     int32_t log_level = WSM_ERROR;
+    char *log_journal = NULL;
+    char *metrics_socket = NULL;
+    char *saved_buffer_mode = NULL;
+    int32_t cpu_render_threads = 0;
+
+    wsm_startup_begin();
 
     const struct wsm_option core_options[] = {
 #if HAVE_XWAYLAND
         { WSM_OPTION_BOOLEAN, "xwayland", 0, &xwayland },
 #endif
         { WSM_OPTION_INTEGER, "log-level", 'l', &log_level },
+        { WSM_OPTION_STRING, "log-journal", 0, &log_journal },
+        { WSM_OPTION_BOOLEAN, "trace", 0, &trace },
+        { WSM_OPTION_STRING, "metrics-socket", 0, &metrics_socket },
+        { WSM_OPTION_STRING, "saved-buffer-mode", 0, &saved_buffer_mode },
+        { WSM_OPTION_INTEGER, "cpu-render-threads", 0, &cpu_render_threads },
         { WSM_OPTION_BOOLEAN, "help", 'h', &help },
     };
 
@@ -174,6 +164,12 @@ int main(int argc, char **argv) {
 
     wlr_log_init(log_level, NULL);
     wsm_log_init(log_level, NULL);
+    if (log_journal) {
+        if (!wsm_log_set_journal(log_journal)) {
+            wsm_log(WSM_ERROR, "Unable to open log journal %s", log_journal);
+        }
+        free(log_journal);
+    }
 
     int c;
     while ((c = getopt(argc, argv, "s:")) != -1) {
@@ -200,8 +196,37 @@ int main(int argc, char **argv) {
 
     // prevent ipc from crashing
     signal(SIGPIPE, SIG_IGN);
+    // Before the server, so that the startup phases get traced
+    wsm_trace_set_enabled(trace);
+    wsm_startup_mark("options");
     wsm_server_init(&global_server);
 
+    // Command line options override the defaults set by wsm_server_init()
+    if (saved_buffer_mode) {
+        if (strcmp(saved_buffer_mode, "clone") == 0) {
+            global_config.saved_buffer_mode = SAVED_BUFFER_CLONE;
+        } else if (strcmp(saved_buffer_mode, "snapshot") == 0) {
+            global_config.saved_buffer_mode = SAVED_BUFFER_SNAPSHOT;
+        } else {
+            wsm_log(WSM_ERROR, "Unknown saved buffer mode %s, using clone",
+                    saved_buffer_mode);
+        }
+        free(saved_buffer_mode);
+    }
+    global_config.cpu_render_threads = cpu_render_threads;
+
+    wl_event_loop_add_signal(global_server.wl_event_loop, SIGUSR1,
+                             handle_trace_dump, NULL);
+    wl_event_loop_add_signal(global_server.wl_event_loop, SIGUSR2,
+                             handle_trace_toggle, NULL);
+
+    struct wsm_metrics_server *metrics_server = NULL;
+    if (metrics_socket) {
+        metrics_server = wsm_metrics_server_create(global_server.wl_event_loop,
+                                                   metrics_socket);
+        free(metrics_socket);
+    }
+
     const char *socket = wl_display_add_socket_auto(global_server.wl_display);
     if (!socket) {
         wl_display_destroy(global_server.wl_display);
@@ -218,6 +243,7 @@ int main(int argc, char **argv) {
             wsm_log(WSM_ERROR, "xwayland start failed!");
             goto shutdown;
         }
+        wsm_startup_mark("xwayland");
     }
 #endif
 
@@ -226,21 +252,33 @@ int main(int argc, char **argv) {
         wsm_log(WSM_ERROR, "backend start failed!");
         goto shutdown;
     }
+    // Includes the modeset of every output found
+    wsm_startup_mark("backend start");
 
     setenv("WAYLAND_DISPLAY", socket, true);
     if (startup_cmd != NULL) {
         if (fork() == 0) {
+            // The event loop blocks the signals it handles and SIGPIPE is
+            // ignored, neither may leak into the session's clients
+            sigset_t set;
+            sigemptyset(&set);
+            sigprocmask(SIG_SETMASK, &set, NULL);
+            signal(SIGPIPE, SIG_DFL);
             execl("/bin/sh", "/bin/sh", "-c", startup_cmd, (void *)NULL);
+            _exit(EXIT_FAILURE);
         }
     }
 
     wsm_log(WSM_INFO, "Running Wayland compositor on WAYLAND_DISPLAY=%s",socket);
 
-    registerDbusComponent();
+    // Registration completes from the event loop, the first frame must not
+    // wait for the session bus
+    struct wsm_dbus *dbus = wsm_dbus_create(global_server.wl_event_loop);
 
     wl_display_run(global_server.wl_display);
-    wl_display_destroy_clients(global_server.wl_display);
-    wl_display_destroy(global_server.wl_display);
+    wsm_dbus_destroy(dbus);
+    wsm_metrics_server_destroy(metrics_server);
+    server_finish(&global_server);
     return EXIT_SUCCESS;
 
 shutdown:
@@ -23,6 +23,7 @@ THE SOFTWARE.
 */
 
 #include "wsm_log.h"
+#include "wsm_trace.h"
 #include "wsm_seat.h"
 #include "wsm_cursor.h"
 #include "wsm_server.h"
@@ -32,6 +33,8 @@ THE SOFTWARE.
 #include "wsm_common.h"
 #include "wsm_output.h"
 #include "wsm_arrange.h"
+#include "wsm_animation.h"
+#include "wsm_frame_throttle.h"
 #include "wsm_workspace.h"
 #include "wsm_transaction.h"
 #include "wsm_input_manager.h"
@@ -39,7 +42,11 @@ THE SOFTWARE.
 #include "wsm_workspace_manager.h"
 #include "wsm_layer_shell.h"
 #include "wsm_output_config.h"
+#include "wsm_timer.h"
+#include "wsm_metrics.h"
+#include "wsm_startup.h"
 #include "node/wsm_node_descriptor.h"
+#include "effects/wsm_effect.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -64,11 +71,31 @@ struct send_frame_done_data {
     struct wsm_output *output;
 };
 
-struct buffer_timer {
+// Frame done state of a scene buffer, created the first time the buffer
+// is rendered
+struct buffer_frame {
+    struct wlr_scene_buffer *buffer;
     struct wl_listener destroy;
-    struct wl_event_source *frame_done_timer;
+    struct wsm_timer *frame_done_timer;
+    // View the buffer belongs to, looked up again once the buffer may
+    // have been moved to another view
+    struct wsm_view *view;
+    uint64_t view_generation;
+
+    struct wsm_output *output; // NULL if not listed
+    struct wl_list link; // wsm_output::frame_buffers
 };
 
+static void buffer_frame_set_output(struct buffer_frame *frame, struct wsm_output *output) {
+    wl_list_remove(&frame->link);
+    if (output) {
+        wl_list_insert(&output->frame_buffers, &frame->link);
+    } else {
+        wl_list_init(&frame->link);
+    }
+    frame->output = output;
+}
+
 static void begin_destroy(struct wsm_output *output) {
     if (output->enabled) {
         output_disable(output);
@@ -85,6 +112,11 @@ static void begin_destroy(struct wsm_output *output) {
     wl_list_remove(&output->frame.link);
     wl_list_remove(&output->request_state.link);
 
+    struct buffer_frame *frame, *tmp;
+    wl_list_for_each_safe(frame, tmp, &output->frame_buffers, link) {
+        buffer_frame_set_output(frame, NULL);
+    }
+
     wlr_scene_output_destroy(output->scene_output);
     output->scene_output = NULL;
     output->wlr_output->data = NULL;
@@ -138,6 +170,10 @@ static void handle_present(struct wl_listener *listener, void *data) {
 
     output->last_presentation = *output_event->when;
     output->refresh_nsec = output_event->refresh;
+    wsm_metric_add(output->metrics.frames, 1);
+    if (output != global_server.wsm_scene->fallback_output) {
+        wsm_startup_first_frame();
+    }
 }
 
 static int handle_buffer_timer(void *data) {
@@ -149,79 +185,105 @@ static int handle_buffer_timer(void *data) {
     return 0;
 }
 
-static void handle_buffer_timer_destroy(struct wl_listener *listener,
-                                        void *data) {
-    struct buffer_timer *timer = wl_container_of(listener, timer, destroy);
+static void handle_buffer_frame_destroy(struct wl_listener *listener,
+                                       void *data) {
+    struct buffer_frame *frame = wl_container_of(listener, frame, destroy);
+
+    wl_list_remove(&frame->destroy.link);
+    wl_list_remove(&frame->link);
+    wsm_timer_destroy(frame->frame_done_timer);
+    free(frame);
+}
+
+static struct wsm_view *buffer_find_view(struct wlr_scene_buffer *buffer) {
+    struct wlr_scene_node *current = &buffer->node;
+    while (true) {
+        struct wsm_view *view = wsm_scene_descriptor_try_get(current,
+                                                          WSM_SCENE_DESC_VIEW);
+        if (view) {
+            return view;
+        }
+
+        if (!current->parent) {
+            return NULL;
+        }
 
-    wl_list_remove(&timer->destroy.link);
-    wl_event_source_remove(timer->frame_done_timer);
-    free(timer);
+        current = &current->parent->node;
+    }
 }
 
-static struct buffer_timer *buffer_timer_get_or_create(struct wlr_scene_buffer *buffer) {
-    struct buffer_timer *timer =
-        wsm_scene_descriptor_try_get(&buffer->node, WSM_SCENE_DESC_BUFFER_TIMER);
-    if (timer) {
-        return timer;
+static struct buffer_frame *buffer_frame_get_or_create(struct wlr_scene_buffer *buffer) {
+    struct buffer_frame *frame =
+        wsm_scene_descriptor_try_get(&buffer->node, WSM_SCENE_DESC_BUFFER_FRAME);
+    if (frame) {
+        return frame;
     }
 
-    timer = calloc(1, sizeof(struct buffer_timer));
-    if (!timer) {
+    frame = calloc(1, sizeof(struct buffer_frame));
+    if (!frame) {
         return NULL;
     }
 
-    timer->frame_done_timer = wl_event_loop_add_timer(global_server.wl_event_loop,
-                                                      handle_buffer_timer, buffer);
-    if (!timer->frame_done_timer) {
-        free(timer);
+    if (!wsm_scene_descriptor_assign(&buffer->node, WSM_SCENE_DESC_BUFFER_FRAME, frame)) {
+        free(frame);
         return NULL;
     }
 
-    wsm_scene_descriptor_assign(&buffer->node, WSM_SCENE_DESC_BUFFER_TIMER, timer);
+    frame->buffer = buffer;
+    wl_list_init(&frame->link);
+    frame->destroy.notify = handle_buffer_frame_destroy;
+    wl_signal_add(&buffer->node.events.destroy, &frame->destroy);
 
-    timer->destroy.notify = handle_buffer_timer_destroy;
-    wl_signal_add(&buffer->node.events.destroy, &timer->destroy);
-
-    return timer;
+    return frame;
 }
 
-static void send_frame_done_iterator(struct wlr_scene_buffer *buffer,
-                                     int x, int y, void *user_data) {
-    struct send_frame_done_data *data = user_data;
-    struct wsm_output *output = data->output;
-    int view_max_render_time = 0;
+static struct wsm_view *buffer_frame_get_view(struct buffer_frame *frame) {
+    uint64_t generation = wsm_scene_view_generation();
+    if (frame->view_generation != generation) {
+        frame->view = buffer_find_view(frame->buffer);
+        frame->view_generation = generation;
+    }
+    return frame->view;
+}
 
-    if (buffer->primary_output != data->output->scene_output) {
+void wsm_output_track_buffer(struct wlr_scene_buffer *buffer) {
+    if (!buffer->primary_output) {
         return;
     }
+    struct wsm_output *output = buffer->primary_output->output->data;
+    struct buffer_frame *frame = buffer_frame_get_or_create(buffer);
+    if (output && frame && frame->output != output) {
+        buffer_frame_set_output(frame, output);
+    }
+}
 
-    struct wlr_scene_node *current = &buffer->node;
-    while (true) {
-        struct wsm_view *view = wsm_scene_descriptor_try_get(current,
-                                                          WSM_SCENE_DESC_VIEW);
-        if (view) {
-            view_max_render_time = view->max_render_time;
-            break;
-        }
+static bool buffer_frame_ensure_timer(struct buffer_frame *frame,
+                                      struct wlr_scene_buffer *buffer) {
+    if (!frame->frame_done_timer) {
+        frame->frame_done_timer = wsm_timer_create(handle_buffer_timer, buffer);
+    }
+    return frame->frame_done_timer != NULL;
+}
 
-        if (!current->parent) {
-            break;
-        }
+static void send_frame_done(struct buffer_frame *frame, struct send_frame_done_data *data) {
+    struct wlr_scene_buffer *buffer = frame->buffer;
+    struct wsm_output *output = data->output;
 
-        current = &current->parent->node;
+    // Without a render time budget on the output, view budgets don't
+    // matter either
+    if (output->max_render_time == 0) {
+        wlr_scene_buffer_send_frame_done(buffer, &data->when);
+        return;
     }
 
+    struct wsm_view *view = buffer_frame_get_view(frame);
+    int view_max_render_time = view ? view->max_render_time : 0;
     int delay = data->msec_until_refresh - output->max_render_time
                 - view_max_render_time;
 
-    struct buffer_timer *timer = NULL;
-
-    if (output->max_render_time != 0 && view_max_render_time != 0 && delay > 0) {
-        timer = buffer_timer_get_or_create(buffer);
-    }
-
-    if (timer) {
-        wl_event_source_timer_update(timer->frame_done_timer, delay);
+    if (view_max_render_time != 0 && delay > 0 &&
+        buffer_frame_ensure_timer(frame, buffer)) {
+        wsm_timer_update(frame->frame_done_timer, delay);
     } else {
         wlr_scene_buffer_send_frame_done(buffer, &data->when);
     }
@@ -249,6 +311,10 @@ static void output_configure_scene(struct wsm_output *output,
     if (!node->enabled) {
         return;
     }
+    // animations set the opacity of their snapshots themselves
+    if (wsm_scene_descriptor_try_get(node, WSM_SCENE_DESC_ANIMATION)) {
+        return;
+    }
 
     struct wsm_container *con =
         wsm_scene_descriptor_try_get(node, WSM_SCENE_DESC_CONTAINER);
@@ -274,13 +340,7 @@ static void output_configure_scene(struct wsm_output *output,
     }
 }
 
-static int output_repaint_timer_handler(void *data) {
-    struct wsm_output *output = data;
-
-    if (!output->enabled) {
-        return 0;
-    }
-
+static void output_repaint(struct wsm_output *output) {
     output->wlr_output->frame_pending = false;
 
     output_configure_scene(output, &global_server.wsm_scene->root_scene->tree.node, 1.0f);
@@ -289,7 +349,7 @@ static int output_repaint_timer_handler(void *data) {
         struct wlr_output_state pending;
         wlr_output_state_init(&pending);
         if (!wsm_scene_output_build_state(output->scene_output, &pending, NULL)) {
-            return 0;
+            return;
         }
 
         output->gamma_lut_changed = false;
@@ -298,25 +358,62 @@ static int output_repaint_timer_handler(void *data) {
             global_server.wsm_output_manager->wlr_gamma_control_manager_v1, output->wlr_output);
         if (!wlr_gamma_control_v1_apply(gamma_control, &pending)) {
             wlr_output_state_finish(&pending);
-            return 0;
+            return;
         }
 
         if (!wlr_output_commit_state(output->wlr_output, &pending)) {
             wlr_gamma_control_v1_send_failed_and_destroy(gamma_control);
             wlr_output_state_finish(&pending);
-            return 0;
+            return;
         }
 
         wlr_output_state_finish(&pending);
-        return 0;
+        return;
     }
 
     // TODO: Need to refactor for post effect
     wsm_scene_output_commit(output->scene_output, NULL);
+}
+
+static int64_t timespec_to_nsec(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int output_repaint_timer_handler(void *data) {
+    WSM_TRACE_SCOPE("output_repaint_timer_handler");
+    struct wsm_output *output = data;
+
+    if (!output->enabled) {
+        return 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    output_repaint(output);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int64_t start_ns = timespec_to_nsec(&start);
+    int64_t end_ns = timespec_to_nsec(&end);
+    wsm_metric_observe(output->metrics.render_time, end_ns - start_ns);
+    struct wsm_effect_output *effect_output = wsm_effect_output_get(output->wlr_output);
+    if (effect_output) {
+        wsm_metric_observe(output->metrics.effect_time,
+            wsm_effect_output_last_frame_ns(effect_output));
+    }
+    output->render_time_ns = output->render_time_ns ?
+        (output->render_time_ns * 7 + (end_ns - start_ns)) / 8 : end_ns - start_ns;
+
+    // Started within the current refresh cycle but only done after the
+    // next vblank, the frame is shown one refresh late
+    int64_t vblank_ns = timespec_to_nsec(&output->last_presentation) + output->refresh_nsec;
+    if (output->refresh_nsec && start_ns < vblank_ns && end_ns > vblank_ns) {
+        wsm_metric_add(output->metrics.missed_frames, 1);
+    }
     return 0;
 }
 
 static void handle_frame(struct wl_listener *listener, void *user_data) {
+    WSM_TRACE_SCOPE("handle_frame");
     struct wsm_output *output =
         wl_container_of(listener, output, frame);
     if (!output->enabled || !output->wlr_output->enabled) {
@@ -361,6 +458,10 @@ static void handle_frame(struct wl_listener *listener, void *user_data) {
         }
     }
 
+    // Advance layout transitions before this frame gets rendered
+    wsm_animations_tick(output);
+    wsm_frame_throttle_output_frame();
+
     int delay = msec_until_refresh - output->max_render_time;
 
     // If the delay is less than 1 millisecond (which is the least we can wait)
@@ -369,7 +470,7 @@ static void handle_frame(struct wl_listener *listener, void *user_data) {
         output_repaint_timer_handler(output);
     } else {
         output->wlr_output->frame_pending = true;
-        wl_event_source_timer_update(output->repaint_timer, delay);
+        wsm_timer_update(output->repaint_timer, delay);
     }
 
     // Send frame done to all visible surfaces
@@ -377,7 +478,16 @@ static void handle_frame(struct wl_listener *listener, void *user_data) {
     clock_gettime(CLOCK_MONOTONIC, &data.when);
     data.msec_until_refresh = msec_until_refresh;
     data.output = output;
-    wlr_scene_output_for_each_buffer(output->scene_output, send_frame_done_iterator, &data);
+    struct buffer_frame *frame, *tmp;
+    wl_list_for_each_safe(frame, tmp, &output->frame_buffers, link) {
+        struct wlr_scene_output *primary = frame->buffer->primary_output;
+        if (primary != output->scene_output) {
+            // Hidden or moved since it was rendered here
+            buffer_frame_set_output(frame, primary ? primary->output->data : NULL);
+            continue;
+        }
+        send_frame_done(frame, &data);
+    }
 }
 
 static void handle_request_state(struct wl_listener *listener, void *data) {
@@ -406,6 +516,11 @@ static void destroy_scene_layers(struct wsm_output *output) {
 
 static unsigned int last_headless_num = 0;
 
+static const uint64_t render_time_bounds[] = {
+    500000, 1000000, 2000000, 4000000, 8000000,
+    12000000, 16000000, 25000000, 33000000, 50000000,
+};
+
 struct wsm_output *wsm_ouput_create(struct wlr_output *wlr_output) {
     struct wsm_output *output = calloc(1, sizeof(struct wsm_output));
     if (!wsm_assert(output, "Could not create wsm_output: allocation failed!")) {
@@ -461,10 +576,11 @@ struct wsm_output *wsm_ouput_create(struct wlr_output *wlr_output) {
 
     output->wlr_output = wlr_output;
     wlr_output->data = output;
+    wl_list_init(&output->frame_buffers);
     output->detected_subpixel = wlr_output->subpixel;
     output->scale_filter = SCALE_FILTER_NEAREST;
 
-    output->workspaces = create_list();
+    output->workspaces = create_indexed_list();
     output->current.workspaces = create_list();
 
     wl_signal_init(&output->events.disable);
@@ -489,8 +605,20 @@ struct wsm_output *wsm_ouput_create(struct wlr_output *wlr_output) {
     output->request_state.notify = handle_request_state;
     wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
-    output->repaint_timer = wl_event_loop_add_timer(global_server.wl_event_loop,
-                                                    output_repaint_timer_handler, output);
+    output->repaint_timer = wsm_timer_create(output_repaint_timer_handler, output);
+
+    char labels[128];
+    snprintf(labels, sizeof(labels), "output=\"%s\"", wlr_output->name);
+    output->metrics.frames = wsm_metric_create(WSM_METRIC_COUNTER,
+        "wsm_output_frames_total", "Presented frames", labels);
+    output->metrics.missed_frames = wsm_metric_create(WSM_METRIC_COUNTER,
+        "wsm_output_missed_frames_total", "Frames rendered after their vblank", labels);
+    output->metrics.render_time = wsm_metric_histogram_create(
+        "wsm_output_render_seconds", "Time spent building and committing a frame",
+        labels, render_time_bounds, ARRAY_LENGTH(render_time_bounds), 1e-9);
+    output->metrics.effect_time = wsm_metric_histogram_create(
+        "wsm_output_effect_seconds", "Time spent in effects during a frame",
+        labels, render_time_bounds, ARRAY_LENGTH(render_time_bounds), 1e-9);
 
     return output;
 
@@ -518,7 +646,11 @@ void wsm_output_destroy(struct wsm_output *output) {
     destroy_scene_layers(output);
     list_free(output->workspaces);
     list_free(output->current.workspaces);
-    wl_event_source_remove(output->repaint_timer);
+    wsm_timer_destroy(output->repaint_timer);
+    wsm_metric_destroy(output->metrics.frames);
+    wsm_metric_destroy(output->metrics.missed_frames);
+    wsm_metric_destroy(output->metrics.render_time);
+    wsm_metric_destroy(output->metrics.effect_time);
     free(output);
 }
 
@@ -801,7 +933,7 @@ void output_for_each_container(struct wsm_output *output,
 
 static int timer_modeset_handle(void *data) {
     struct wsm_server *server = data;
-    wl_event_source_remove(server->delayed_modeset);
+    wsm_timer_destroy(server->delayed_modeset);
     server->delayed_modeset = NULL;
 
     apply_all_output_configs();
@@ -813,9 +945,10 @@ static int timer_modeset_handle(void *data) {
 
 void request_modeset() {
     if (global_server.delayed_modeset == NULL) {
-        global_server.delayed_modeset = wl_event_loop_add_timer(global_server.wl_event_loop,
-                                                          timer_modeset_handle, &global_server);
-        wl_event_source_timer_update(global_server.delayed_modeset, 10);
+        global_server.delayed_modeset = wsm_timer_create(timer_modeset_handle, &global_server);
+        if (global_server.delayed_modeset) {
+            wsm_timer_update(global_server.delayed_modeset, 10);
+        }
     }
 }
 
@@ -40,11 +40,14 @@ struct wlr_output;
 struct wlr_scene_rect;
 struct wlr_output_mode;
 struct wlr_scene_output;
+struct wlr_scene_buffer;
 struct wlr_drm_connector;
 struct wlr_output_power_v1_set_mode_event;
 
 struct wsm_workspace;
 struct wsm_workspace_manager;
+struct wsm_timer;
+struct wsm_metric;
 
 enum scale_filter_mode {
     SCALE_FILTER_DEFAULT, // the default is currently smart
@@ -82,6 +85,9 @@ struct wsm_output {
     struct wlr_output *wlr_output;
     struct wlr_scene_output *scene_output;
     struct wl_list link;
+    // Buffers last seen with this output as their primary output, the
+    // ones frame done is sent to
+    struct wl_list frame_buffers;
 
     struct wlr_box usable_area;
 
@@ -111,7 +117,16 @@ struct wsm_output {
     struct timespec last_presentation;
     uint32_t refresh_nsec;
     int max_render_time; // In milliseconds
-    struct wl_event_source *repaint_timer;
+    int64_t render_time_ns; // moving average of output_repaint()
+    struct wsm_timer *repaint_timer;
+
+    struct {
+        struct wsm_metric *frames;
+        struct wsm_metric *missed_frames;
+        struct wsm_metric *render_time; // ns
+        struct wsm_metric *effect_time; // ns
+    } metrics;
+
     bool gamma_lut_changed;
     bool leased;
 };
@@ -163,5 +178,12 @@ struct udev_device *wsm_output_get_device_handle(struct wsm_output *output);
 struct wsm_output *output_by_name_or_id(const char *name_or_id);
 void output_for_each_workspace(struct wsm_output *output,
                                void (*f)(struct wsm_workspace *ws, void *data), void *data);
+/**
+ * @brief have frame done sent to @p buffer by its primary output.
+ *
+ * @details called for every buffer rendered, a buffer only becomes visible
+ * on an output through damage making the output render it.
+ */
+void wsm_output_track_buffer(struct wlr_scene_buffer *buffer);
 
 #endif
@@ -92,6 +92,7 @@ static void handle_new_output(struct wl_listener *listener, void *data) {
     }
 
     output->scene_output = scene_output;
+    wsm_scene_output_add_effects(wlr_output);
 
     if (global_server.session_lock.lock) {
         wsm_session_lock_add_output(global_server.session_lock.lock, output);
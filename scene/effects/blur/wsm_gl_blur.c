@@ -21,3 +21,493 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+
+#include "wsm_gl_blur.h"
+#include "wsm_gl_blur_base.h"
+#include "wsm_log.h"
+#include "effects/wsm_effect.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drm_fourcc.h>
+
+#include <wlr/util/box.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/region.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_buffer.h>
+
+struct blur_level {
+    struct wlr_buffer *buffer;
+    struct wlr_texture *texture;
+};
+
+// Blurred background of one node on one output
+struct blur_cache_entry {
+    struct blur_output *blur_output;
+    struct wlr_scene_node *node;
+
+    struct wlr_box damage_box; // sampled area, damage ring coordinates
+    struct wlr_box box; // sampled area, buffer coordinates
+
+    // Full size blurred result, the CPU path keeps a texture and no buffer
+    struct blur_level result;
+
+    bool dirty;
+    uint64_t frame;
+
+    struct wl_listener node_destroy;
+    struct wl_list link; // blur_output::entries
+};
+
+struct blur_output {
+    struct wlr_output *output;
+    struct wlr_addon addon;
+
+    struct wsm_blur_params params;
+    int radius;
+
+    struct wl_list entries;
+    uint64_t frame;
+};
+
+static void blur_level_finish(struct blur_level *level) {
+    if (level->texture) {
+        wlr_texture_destroy(level->texture);
+    }
+    if (level->buffer) {
+        wlr_buffer_drop(level->buffer);
+    }
+    *level = (struct blur_level){0};
+}
+
+static bool blur_level_ensure(struct blur_level *level, struct wlr_output *output,
+                              int width, int height) {
+    if (level->buffer && level->buffer->width == width &&
+        level->buffer->height == height) {
+        return true;
+    }
+    blur_level_finish(level);
+
+    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    struct wlr_drm_format format = {
+        .format = DRM_FORMAT_ARGB8888,
+        .len = 1,
+        .capacity = 1,
+        .modifiers = &modifier,
+    };
+    level->buffer = wlr_allocator_create_buffer(output->allocator, width, height, &format);
+    if (!level->buffer) {
+        wsm_log(WSM_DEBUG, "Could not allocate a %dx%d blur buffer", width, height);
+        return false;
+    }
+    level->texture = wlr_texture_from_buffer(output->renderer, level->buffer);
+    if (!level->texture) {
+        blur_level_finish(level);
+        return false;
+    }
+    return true;
+}
+
+static void blur_cache_entry_destroy(struct blur_cache_entry *entry) {
+    wl_list_remove(&entry->node_destroy.link);
+    wl_list_remove(&entry->link);
+    blur_level_finish(&entry->result);
+    free(entry);
+}
+
+static void handle_node_destroy(struct wl_listener *listener, void *data) {
+    struct blur_cache_entry *entry = wl_container_of(listener, entry, node_destroy);
+    blur_cache_entry_destroy(entry);
+}
+
+static void blur_output_destroy(struct blur_output *blur_output) {
+    struct blur_cache_entry *entry, *tmp;
+    wl_list_for_each_safe(entry, tmp, &blur_output->entries, link) {
+        blur_cache_entry_destroy(entry);
+    }
+    wlr_addon_finish(&blur_output->addon);
+    free(blur_output);
+}
+
+static void output_addon_destroy(struct wlr_addon *addon) {
+    struct blur_output *blur_output = wl_container_of(addon, blur_output, addon);
+    blur_output_destroy(blur_output);
+}
+
+static const struct wlr_addon_interface output_addon_impl = {
+    .name = "wsm_blur_output",
+    .destroy = output_addon_destroy,
+};
+
+static struct blur_output *blur_output_get(struct wlr_output *output, bool create) {
+    struct wlr_addon *addon = wlr_addon_find(&output->addons, &output_addon_impl,
+                                             &output_addon_impl);
+    if (addon) {
+        struct blur_output *blur_output = wl_container_of(addon, blur_output, addon);
+        return blur_output;
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    struct blur_output *blur_output = calloc(1, sizeof(struct blur_output));
+    if (!wsm_assert(blur_output, "Could not create blur_output: allocation failed!")) {
+        return NULL;
+    }
+    blur_output->output = output;
+    wsm_blur_params_default(&blur_output->params);
+    blur_output->radius = wsm_blur_kernel_radius(&blur_output->params);
+    wl_list_init(&blur_output->entries);
+    wlr_addon_init(&blur_output->addon, &output->addons, &output_addon_impl,
+                   &output_addon_impl);
+    return blur_output;
+}
+
+static struct blur_cache_entry *blur_cache_entry_get(struct blur_output *blur_output,
+                                                     struct wlr_scene_node *node, bool create) {
+    struct blur_cache_entry *entry;
+    wl_list_for_each(entry, &blur_output->entries, link) {
+        if (entry->node == node) {
+            return entry;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    entry = calloc(1, sizeof(struct blur_cache_entry));
+    if (!wsm_assert(entry, "Could not create blur_cache_entry: allocation failed!")) {
+        return NULL;
+    }
+    entry->blur_output = blur_output;
+    entry->node = node;
+    entry->dirty = true;
+    entry->node_destroy.notify = handle_node_destroy;
+    wl_signal_add(&node->events.destroy, &entry->node_destroy);
+    wl_list_insert(&blur_output->entries, &entry->link);
+    return entry;
+}
+
+void wsm_blur_begin_frame(struct wlr_scene_output *scene_output) {
+    struct blur_output *blur_output = blur_output_get(scene_output->output, false);
+    if (!blur_output) {
+        return;
+    }
+
+    struct blur_cache_entry *entry, *tmp;
+    wl_list_for_each_safe(entry, tmp, &blur_output->entries, link) {
+        if (entry->frame != blur_output->frame) {
+            blur_cache_entry_destroy(entry);
+        }
+    }
+    blur_output->frame++;
+}
+
+void wsm_blur_expand_damage(struct wlr_scene_output *scene_output,
+                            struct wlr_scene_node *node, const pixman_region32_t *region,
+                            const pixman_region32_t *own_damage) {
+    struct blur_output *blur_output = blur_output_get(scene_output->output, true);
+    if (!blur_output) {
+        return;
+    }
+    struct blur_cache_entry *entry = blur_cache_entry_get(blur_output, node, true);
+    if (!entry) {
+        return;
+    }
+    entry->frame = blur_output->frame;
+
+    struct wlr_damage_ring *ring = &scene_output->damage_ring;
+    pixman_region32_t sampled;
+    pixman_region32_init(&sampled);
+    wlr_region_expand(&sampled, region, blur_output->radius);
+    pixman_region32_intersect_rect(&sampled, &sampled, 0, 0, ring->width, ring->height);
+
+    pixman_box32_t *extents = pixman_region32_extents(&sampled);
+    struct wlr_box box = {
+        .x = extents->x1,
+        .y = extents->y1,
+        .width = extents->x2 - extents->x1,
+        .height = extents->y2 - extents->y1,
+    };
+
+    if (!wlr_box_equal(&box, &entry->damage_box)) {
+        entry->damage_box = box;
+        entry->dirty = true;
+    } else if (!entry->dirty) {
+        // Updates of the node itself do not change what is below it
+        pixman_region32_t foreign;
+        pixman_region32_init(&foreign);
+        pixman_region32_intersect(&foreign, &ring->current, &sampled);
+        pixman_region32_subtract(&foreign, &foreign, own_damage);
+        entry->dirty = pixman_region32_not_empty(&foreign);
+        pixman_region32_fini(&foreign);
+    }
+
+    // The buffer holds last frame's blurred result below the node, so
+    // everything sampled has to be drawn again before it is read back.
+    if (entry->dirty) {
+        wlr_damage_ring_add(ring, &sampled);
+    }
+    pixman_region32_fini(&sampled);
+}
+
+// Draw @tex shifted by (@dx, @dy) source pixels into a @width x @height
+// target. Shifts are clamped to @bounds which only approximates
+// clamp-to-edge sampling, but stays within what the renderer accepts.
+static void blur_add_tap(struct wlr_render_pass *pass, struct wlr_texture *tex,
+                         const struct wlr_fbox *src, const struct wlr_fbox *bounds,
+                         double dx, double dy, int width, int height, float alpha, bool first) {
+    double x1 = fmax(src->x + dx, bounds->x);
+    double y1 = fmax(src->y + dy, bounds->y);
+    double x2 = fmin(src->x + src->width + dx, bounds->x + bounds->width);
+    double y2 = fmin(src->y + src->height + dy, bounds->y + bounds->height);
+
+    wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+        .texture = tex,
+        .src_box = { .x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1 },
+        .dst_box = { .width = width, .height = height },
+        .alpha = &alpha,
+        .filter_mode = WLR_SCALE_FILTER_BILINEAR,
+        .blend_mode = first ? WLR_RENDER_BLEND_MODE_NONE : WLR_RENDER_BLEND_MODE_PREMULTIPLIED,
+    });
+}
+
+// Dual-Kawase taps have no shader here, each tap is one textured draw and
+// the weighted sum is built by blending every draw with its share of the
+// weights accumulated so far. Premultiplied blending keeps
+// (1 - alpha * src_alpha) of the sum so far, which is the intended
+// (1 - alpha) only for opaque samples. The scene pass starts from an opaque
+// background, so what is read back below a node and every level blurred
+// from it are opaque and the sum is exact.
+struct blur_tap {
+    double dx, dy;
+    float weight;
+};
+
+static void blur_add_taps(struct wlr_render_pass *pass, struct wlr_texture *tex,
+                          const struct wlr_fbox *src, const struct wlr_fbox *bounds,
+                          const struct blur_tap *taps, int ntaps, double offset, int width, int height) {
+    float total = 0.0f;
+    for (int i = 0; i < ntaps; i++) {
+        total += taps[i].weight;
+        blur_add_tap(pass, tex, src, bounds, taps[i].dx * offset, taps[i].dy * offset,
+                     width, height, taps[i].weight / total, i == 0);
+    }
+}
+
+static const struct blur_tap downsample_taps[] = {
+    { -1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 },
+    { 0, 0, 4 },
+};
+
+static const struct blur_tap upsample_taps[] = {
+    { -1, 0, 1 }, { 1, 0, 1 }, { 0, -1, 1 }, { 0, 1, 1 },
+    { -0.5, -0.5, 2 }, { 0.5, -0.5, 2 }, { -0.5, 0.5, 2 }, { 0.5, 0.5, 2 },
+};
+
+static bool blur_render_level(struct wlr_renderer *renderer, struct wlr_buffer *target,
+                              struct wlr_texture *tex, const struct wlr_fbox *src, const struct wlr_fbox *bounds,
+                              const struct blur_tap *taps, int ntaps, double offset, int width, int height) {
+    struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(renderer, target, NULL);
+    if (!pass) {
+        return false;
+    }
+    blur_add_taps(pass, tex, src, bounds, taps, ntaps, offset, width, height);
+    return wlr_render_pass_submit(pass);
+}
+
+static bool blur_render_gpu(struct blur_cache_entry *entry, struct wlr_buffer *buffer) {
+    struct blur_output *blur_output = entry->blur_output;
+    struct wlr_output *output = blur_output->output;
+    const struct wsm_blur_params *params = &blur_output->params;
+    int passes = params->passes < WSM_BLUR_MAX_PASSES ? params->passes : WSM_BLUR_MAX_PASSES;
+
+    if (!blur_level_ensure(&entry->result, output, entry->box.width, entry->box.height)) {
+        return false;
+    }
+
+    // The downsampled levels are only needed while blurring, they are
+    // borrowed from the effect buffer pool. Sized for the whole output, so
+    // every blurred node can reuse them.
+    struct blur_level levels[WSM_BLUR_MAX_PASSES] = {0};
+    struct wsm_effect_buffer *borrowed[WSM_BLUR_MAX_PASSES] = {0};
+    int width, height;
+    bool ok = true;
+    for (int i = 0; i < passes && ok; i++) {
+        wsm_blur_level_size(i, buffer->width, buffer->height, &width, &height);
+        borrowed[i] = wsm_effect_buffer_acquire(output, width, height);
+        ok = borrowed[i] != NULL;
+        if (ok) {
+            levels[i] = (struct blur_level){
+                .buffer = borrowed[i]->buffer,
+                .texture = borrowed[i]->texture,
+            };
+        }
+    }
+
+    struct wlr_texture *src = ok ? wlr_texture_from_buffer(output->renderer, buffer) : NULL;
+    if (!src) {
+        for (int i = 0; i < passes; i++) {
+            wsm_effect_buffer_release(borrowed[i]);
+        }
+        return false;
+    }
+
+    struct wlr_texture *tex = src;
+    struct wlr_fbox src_box = {
+        .x = entry->box.x,
+        .y = entry->box.y,
+        .width = entry->box.width,
+        .height = entry->box.height,
+    };
+    struct wlr_fbox bounds = { .width = buffer->width, .height = buffer->height };
+
+    for (int i = 0; i < passes && ok; i++) {
+        struct blur_level *level = &levels[i];
+        wsm_blur_level_size(i, entry->box.width, entry->box.height, &width, &height);
+        ok = blur_render_level(output->renderer, level->buffer, tex, &src_box, &bounds,
+                               downsample_taps, sizeof(downsample_taps) / sizeof(downsample_taps[0]),
+                               params->offset, width, height);
+        tex = level->texture;
+        src_box = bounds = (struct wlr_fbox){ .width = width, .height = height };
+    }
+
+    for (int i = passes - 2; i >= 0 && ok; i--) {
+        struct blur_level *level = &levels[i];
+        wsm_blur_level_size(i, entry->box.width, entry->box.height, &width, &height);
+        ok = blur_render_level(output->renderer, level->buffer, tex, &src_box, &bounds,
+                               upsample_taps, sizeof(upsample_taps) / sizeof(upsample_taps[0]),
+                               params->offset, width, height);
+        tex = level->texture;
+        src_box = bounds = (struct wlr_fbox){ .width = width, .height = height };
+    }
+
+    // Back up from half resolution, so the result is drawn 1:1
+    if (ok) {
+        ok = blur_render_level(output->renderer, entry->result.buffer, tex, &src_box, &bounds,
+                               upsample_taps, sizeof(upsample_taps) / sizeof(upsample_taps[0]),
+                               params->offset, entry->box.width, entry->box.height);
+    }
+
+    wlr_texture_destroy(src);
+    for (int i = 0; i < passes; i++) {
+        wsm_effect_buffer_release(borrowed[i]);
+    }
+    return ok;
+}
+
+static bool blur_render_cpu(struct blur_cache_entry *entry, struct wlr_buffer *buffer) {
+    struct wlr_output *output = entry->blur_output->output;
+    const struct wlr_box *box = &entry->box;
+
+    void *data;
+    uint32_t format;
+    size_t stride;
+    if (!wlr_buffer_begin_data_ptr_access(buffer, WLR_BUFFER_DATA_PTR_ACCESS_READ,
+                                          &data, &format, &stride)) {
+        return false;
+    }
+    if (format != DRM_FORMAT_XRGB8888 && format != DRM_FORMAT_ARGB8888 &&
+        format != DRM_FORMAT_XBGR8888 && format != DRM_FORMAT_ABGR8888) {
+        wlr_buffer_end_data_ptr_access(buffer);
+        return false;
+    }
+
+    size_t row = box->width * sizeof(uint32_t);
+    uint32_t *pixels = malloc(row * box->height);
+    if (!pixels) {
+        wlr_buffer_end_data_ptr_access(buffer);
+        return false;
+    }
+    for (int y = 0; y < box->height; y++) {
+        memcpy((char *)pixels + y * row,
+               (char *)data + (box->y + y) * stride + box->x * sizeof(uint32_t), row);
+    }
+    wlr_buffer_end_data_ptr_access(buffer);
+
+    wsm_blur_box_pixels(pixels, row, box->width, box->height,
+                        entry->blur_output->radius / 2);
+
+    blur_level_finish(&entry->result);
+    entry->result.texture = wlr_texture_from_pixels(output->renderer, format, row,
+                                                    box->width, box->height, pixels);
+    free(pixels);
+    return entry->result.texture != NULL;
+}
+
+bool wsm_blur_render(struct wsm_blur_render_data *data,
+                     struct wlr_scene_node *node, const pixman_region32_t *region,
+                     const pixman_region32_t *clip) {
+    struct wlr_output *output = data->output->output;
+    struct blur_output *blur_output = blur_output_get(output, false);
+    if (!blur_output) {
+        return true;
+    }
+    struct blur_cache_entry *entry = blur_cache_entry_get(blur_output, node, false);
+    if (!entry) {
+        return true;
+    }
+
+    pixman_region32_t sampled;
+    pixman_region32_init(&sampled);
+    wlr_region_expand(&sampled, region, blur_output->radius);
+    pixman_region32_intersect_rect(&sampled, &sampled, 0, 0,
+                                   data->buffer->width, data->buffer->height);
+    pixman_box32_t *extents = pixman_region32_extents(&sampled);
+    struct wlr_box box = {
+        .x = extents->x1,
+        .y = extents->y1,
+        .width = extents->x2 - extents->x1,
+        .height = extents->y2 - extents->y1,
+    };
+    pixman_region32_fini(&sampled);
+    if (wlr_box_empty(&box)) {
+        return true;
+    }
+
+    if (entry->dirty || !entry->result.texture || !wlr_box_equal(&box, &entry->box)) {
+        entry->box = box;
+
+        // Read back what has been drawn below the node so far
+        if (!wlr_render_pass_submit(data->pass)) {
+            wsm_log(WSM_DEBUG, "Could not submit the render pass before blurring");
+        }
+        bool ok = wlr_renderer_is_pixman(output->renderer) ?
+                      blur_render_cpu(entry, data->buffer) : blur_render_gpu(entry, data->buffer);
+        if (ok) {
+            entry->dirty = false;
+        } else {
+            blur_level_finish(&entry->result);
+        }
+
+        data->pass = wlr_renderer_begin_buffer_pass(output->renderer, data->buffer,
+                                                    data->pass_options);
+        if (!data->pass) {
+            return false;
+        }
+    }
+
+    if (!entry->result.texture) {
+        return true;
+    }
+
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    pixman_region32_intersect(&damage, region, clip);
+    wlr_render_pass_add_texture(data->pass, &(struct wlr_render_texture_options){
+        .texture = entry->result.texture,
+        .dst_box = entry->box,
+        .clip = &damage,
+        .filter_mode = WLR_SCALE_FILTER_BILINEAR,
+        .blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+    });
+    pixman_region32_fini(&damage);
+    return true;
+}
@@ -21,3 +21,60 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+
+#ifndef WSM_GL_BLUR_H
+#define WSM_GL_BLUR_H
+
+#include <stdbool.h>
+
+#include <pixman.h>
+
+struct wlr_buffer;
+struct wlr_buffer_pass_options;
+struct wlr_render_pass;
+struct wlr_scene_node;
+struct wlr_scene_output;
+
+/**
+ * @brief state of the output frame a blurred background is drawn into.
+ */
+struct wsm_blur_render_data {
+    struct wlr_scene_output *output;
+    struct wlr_buffer *buffer;
+    // The pass drawing into buffer. Blurring has to read back what was drawn
+    // so far, it submits the pass and starts a new one, NULL on failure.
+    struct wlr_render_pass *pass;
+    // Options pass was started with, the new pass is started with them too
+    const struct wlr_buffer_pass_options *pass_options;
+};
+
+/**
+ * @brief start a new frame of @p scene_output.
+ *
+ * @details cached backgrounds of nodes not blurred in the previous frame are
+ * released.
+ */
+void wsm_blur_begin_frame(struct wlr_scene_output *scene_output);
+/**
+ * @brief invalidate the cached background of @p node if needed.
+ *
+ * @details @p region is the blurred region and @p own_damage the damage of
+ * the node itself, both in damage ring coordinates. When anything else is
+ * damaged within the kernel radius of the region, the cache is invalidated
+ * and the whole sampled area is added to the damage ring, so it is drawn
+ * afresh before being read back.
+ */
+void wsm_blur_expand_damage(struct wlr_scene_output *scene_output,
+                            struct wlr_scene_node *node, const pixman_region32_t *region,
+                            const pixman_region32_t *own_damage);
+/**
+ * @brief draw the blurred background of @p node.
+ *
+ * @details @p region and @p clip are in buffer coordinates. Returns false if
+ * the render pass could not be restarted, data->pass is NULL then.
+ */
+bool wsm_blur_render(struct wsm_blur_render_data *data,
+                     struct wlr_scene_node *node, const pixman_region32_t *region,
+                     const pixman_region32_t *clip);
+
+#endif
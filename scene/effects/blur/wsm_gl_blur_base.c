@@ -21,3 +21,96 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+
+#include "wsm_gl_blur_base.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BLUR_DEFAULT_PASSES 3
+#define BLUR_DEFAULT_OFFSET 2.5f
+#define BOX_BLUR_ITERATIONS 3
+
+// One pixel, one 8 bit channel per lane. Sums of a row fit in 32 bits for
+// any radius we use, so sliding window updates stay in one vector op.
+typedef uint32_t pixel_vec __attribute__((vector_size(16)));
+
+void wsm_blur_params_default(struct wsm_blur_params *params) {
+    params->passes = BLUR_DEFAULT_PASSES;
+    params->offset = BLUR_DEFAULT_OFFSET;
+}
+
+int wsm_blur_kernel_radius(const struct wsm_blur_params *params) {
+    return (1 << (params->passes + 1)) * params->offset;
+}
+
+void wsm_blur_level_size(int level, int width, int height,
+                         int *level_width, int *level_height) {
+    int w = width >> (level + 1);
+    int h = height >> (level + 1);
+    *level_width = w > 0 ? w : 1;
+    *level_height = h > 0 ? h : 1;
+}
+
+static inline pixel_vec unpack_pixel(uint32_t pixel) {
+    return (pixel_vec){ pixel & 0xff, (pixel >> 8) & 0xff,
+                       (pixel >> 16) & 0xff, pixel >> 24 };
+}
+
+static inline uint32_t pack_pixel(pixel_vec sum, uint32_t div) {
+    pixel_vec v = (sum + div / 2) / div;
+    return v[0] | v[1] << 8 | v[2] << 16 | v[3] << 24;
+}
+
+// Sliding window box blur of @count pixels @step apart, edges are clamped
+static void box_blur_line(uint32_t *line, size_t step, int count, int radius,
+                          uint32_t *scratch) {
+    for (int i = 0; i < count; i++) {
+        scratch[i] = line[i * step];
+    }
+
+    uint32_t div = radius * 2 + 1;
+    pixel_vec sum = unpack_pixel(scratch[0]) * (uint32_t)(radius + 1);
+    for (int i = 1; i <= radius; i++) {
+        sum += unpack_pixel(scratch[i < count ? i : count - 1]);
+    }
+
+    for (int i = 0; i < count; i++) {
+        line[i * step] = pack_pixel(sum, div);
+        int add = i + radius + 1;
+        int sub = i - radius;
+        sum += unpack_pixel(scratch[add < count ? add : count - 1]);
+        sum -= unpack_pixel(scratch[sub > 0 ? sub : 0]);
+    }
+}
+
+void wsm_blur_box_pixels(uint32_t *data, int stride, int width, int height,
+                         int radius) {
+    if (radius <= 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    uint32_t *scratch = malloc(sizeof(uint32_t) * (width > height ? width : height));
+    if (!scratch) {
+        return;
+    }
+
+    // Three box blurs of a third of the radius each are close enough to a
+    // gaussian of the full radius.
+    int box_radius = radius / BOX_BLUR_ITERATIONS;
+    if (box_radius < 1) {
+        box_radius = 1;
+    }
+
+    size_t row = stride / sizeof(uint32_t);
+    for (int n = 0; n < BOX_BLUR_ITERATIONS; n++) {
+        for (int y = 0; y < height; y++) {
+            box_blur_line(data + y * row, 1, width, box_radius, scratch);
+        }
+        for (int x = 0; x < width; x++) {
+            box_blur_line(data + x, row, height, box_radius, scratch);
+        }
+    }
+
+    free(scratch);
+}
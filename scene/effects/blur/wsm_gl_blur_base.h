@@ -21,3 +21,44 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+
+#ifndef WSM_GL_BLUR_BASE_H
+#define WSM_GL_BLUR_BASE_H
+
+#include <stdint.h>
+
+#define WSM_BLUR_MAX_PASSES 6
+
+/**
+ * @brief dual-Kawase blur parameters.
+ *
+ * @details every pass halves the image on the way down and doubles it on
+ * the way back up, offset is the tap distance in source pixels.
+ */
+struct wsm_blur_params {
+    int passes;
+    float offset;
+};
+
+void wsm_blur_params_default(struct wsm_blur_params *params);
+/**
+ * @brief distance in buffer pixels a blurred pixel is influenced from.
+ *
+ * @details damage below a blurred region has to be expanded by this much.
+ */
+int wsm_blur_kernel_radius(const struct wsm_blur_params *params);
+/**
+ * @brief size of intermediate level @p level for a @p width x @p height input.
+ */
+void wsm_blur_level_size(int level, int width, int height,
+                         int *level_width, int *level_height);
+/**
+ * @brief approximate a gaussian with three box blurs, in place.
+ *
+ * @details CPU path for renderers without render-to-texture support. Works
+ * on any 32bpp format with four 8 bit channels.
+ */
+void wsm_blur_box_pixels(uint32_t *data, int stride, int width, int height,
+                         int radius);
+
+#endif
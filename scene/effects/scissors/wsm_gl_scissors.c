@@ -0,0 +1,103 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_gl_scissors.h"
+#include "wsm_gl_scissors_base.h"
+
+#include <math.h>
+
+#include <wlr/util/box.h>
+
+static void corner_tile_origin(enum wsm_corner corner, int size,
+                               const struct wlr_box *box, int *x, int *y) {
+    bool right = corner == WSM_CORNER_TOP_RIGHT || corner == WSM_CORNER_BOTTOM_RIGHT;
+    bool bottom = corner == WSM_CORNER_BOTTOM_LEFT || corner == WSM_CORNER_BOTTOM_RIGHT;
+    *x = right ? box->x + box->width - size : box->x;
+    *y = bottom ? box->y + box->height - size : box->y;
+}
+
+void wsm_corner_mask_cut_box(const struct wsm_corner_mask *mask,
+                             const struct wlr_box *box, pixman_region32_t *cut) {
+    pixman_region32_clear(cut);
+
+    pixman_region32_t tile;
+    pixman_region32_init(&tile);
+    for (int corner = 0; corner < WSM_CORNER_COUNT; corner++) {
+        if (!(mask->corners & 1 << corner)) {
+            continue;
+        }
+        int x, y;
+        corner_tile_origin(corner, mask->size, box, &x, &y);
+        pixman_region32_copy(&tile, &mask->cut[corner]);
+        pixman_region32_translate(&tile, x, y);
+        pixman_region32_union(cut, cut, &tile);
+    }
+    pixman_region32_fini(&tile);
+}
+
+void wsm_corner_mask_for_each_band(const struct wsm_corner_mask *mask,
+                                   const struct wlr_box *box, const pixman_region32_t *damage,
+                                   wsm_corner_band_func_t func, void *data) {
+    pixman_region32_t band;
+    pixman_region32_init(&band);
+    for (int corner = 0; corner < WSM_CORNER_COUNT; corner++) {
+        if (!(mask->corners & 1 << corner)) {
+            continue;
+        }
+        int x, y;
+        corner_tile_origin(corner, mask->size, box, &x, &y);
+        if (!pixman_region32_contains_rectangle((pixman_region32_t *)damage,
+                                                &(pixman_box32_t){ x, y, x + mask->size, y + mask->size })) {
+            continue;
+        }
+
+        for (int level = 0; level < WSM_CORNER_MASK_LEVELS; level++) {
+            pixman_region32_copy(&band, &mask->bands[corner][level]);
+            pixman_region32_translate(&band, x, y);
+            pixman_region32_intersect(&band, &band, damage);
+            if (pixman_region32_not_empty(&band)) {
+                func(&band, wsm_corner_mask_band_alpha(level), data);
+            }
+        }
+    }
+    pixman_region32_fini(&band);
+}
+
+void wsm_corner_subtract_opaque(float radius, uint32_t flags,
+                                int width, int height, pixman_region32_t *opaque) {
+    uint32_t corners = wsm_corner_mask_corners(flags);
+    int size = ceilf(radius);
+    for (int corner = 0; corner < WSM_CORNER_COUNT; corner++) {
+        if (!(corners & 1 << corner)) {
+            continue;
+        }
+        int x, y;
+        corner_tile_origin(corner, size, &(struct wlr_box){ .width = width, .height = height },
+                           &x, &y);
+        pixman_region32_t tile;
+        pixman_region32_init_rect(&tile, x, y, size, size);
+        pixman_region32_subtract(opaque, opaque, &tile);
+        pixman_region32_fini(&tile);
+    }
+}
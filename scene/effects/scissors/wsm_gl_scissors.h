@@ -0,0 +1,58 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_GL_SCISSORS_H
+#define WSM_GL_SCISSORS_H
+
+#include <stdint.h>
+
+#include <pixman.h>
+
+struct wlr_box;
+struct wsm_corner_mask;
+
+typedef void (*wsm_corner_band_func_t)(const pixman_region32_t *region,
+                                       float alpha, void *data);
+
+/**
+ * @brief pixels of @p box not fully covered once its corners are rounded.
+ */
+void wsm_corner_mask_cut_box(const struct wsm_corner_mask *mask,
+                             const struct wlr_box *box, pixman_region32_t *cut);
+/**
+ * @brief call @p func for every alpha band of the corners of @p box.
+ *
+ * @details bands are clipped to @p damage, empty ones are skipped.
+ */
+void wsm_corner_mask_for_each_band(const struct wsm_corner_mask *mask,
+                                   const struct wlr_box *box, const pixman_region32_t *damage,
+                                   wsm_corner_band_func_t func, void *data);
+/**
+ * @brief remove the corner tiles from the opaque region of a
+ * @p width x @p height surface, in surface local coordinates.
+ */
+void wsm_corner_subtract_opaque(float radius, uint32_t flags,
+                                int width, int height, pixman_region32_t *opaque);
+
+#endif
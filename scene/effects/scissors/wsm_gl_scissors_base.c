@@ -21,3 +21,145 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+
+#include "wsm_gl_scissors_base.h"
+#include "wsm_log.h"
+#include "wsm-effects-protocol.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define WSM_CORNER_MASK_CACHE_SIZE 16
+
+static struct wl_list mask_cache = { &mask_cache, &mask_cache };
+static int mask_cache_len = 0;
+
+uint32_t wsm_corner_mask_corners(uint32_t flags) {
+    uint32_t corners = 0;
+    if (flags & (SURFACE_EFFECT_ROUNDED_CORNERS_FLAG_ROUNDED |
+                 SURFACE_EFFECT_ROUNDED_CORNERS_FLAG_UP)) {
+        corners |= 1 << WSM_CORNER_TOP_LEFT | 1 << WSM_CORNER_TOP_RIGHT;
+    }
+    if (flags & (SURFACE_EFFECT_ROUNDED_CORNERS_FLAG_ROUNDED |
+                 SURFACE_EFFECT_ROUNDED_CORNERS_FLAG_DOWN)) {
+        corners |= 1 << WSM_CORNER_BOTTOM_LEFT | 1 << WSM_CORNER_BOTTOM_RIGHT;
+    }
+    return corners;
+}
+
+float wsm_corner_mask_band_alpha(int level) {
+    return (level + 0.5f) / WSM_CORNER_MASK_LEVELS;
+}
+
+// Coverage of pixel (x, y) of a top left corner tile by a circle of
+// @radius centered on the inner corner of the tile
+static float corner_coverage(int x, int y, float radius) {
+    float dx = radius - (x + 0.5f);
+    float dy = radius - (y + 0.5f);
+    if (dx <= 0 || dy <= 0) {
+        return 1.0f;
+    }
+    float coverage = radius + 0.5f - sqrtf(dx * dx + dy * dy);
+    return coverage < 0 ? 0 : coverage > 1 ? 1 : coverage;
+}
+
+static void corner_mask_generate(struct wsm_corner_mask *mask) {
+    float radius = mask->radius * mask->scale;
+    int size = mask->size;
+
+    for (int corner = 0; corner < WSM_CORNER_COUNT; corner++) {
+        if (!(mask->corners & 1 << corner)) {
+            continue;
+        }
+        bool right = corner == WSM_CORNER_TOP_RIGHT || corner == WSM_CORNER_BOTTOM_RIGHT;
+        bool bottom = corner == WSM_CORNER_BOTTOM_LEFT || corner == WSM_CORNER_BOTTOM_RIGHT;
+
+        for (int y = 0; y < size; y++) {
+            int ty = bottom ? size - 1 - y : y;
+            int run_start = 0, run_level = -1;
+            for (int x = 0; x <= size; x++) {
+                // Level of the pixel, -1 when fully covered and
+                // WSM_CORNER_MASK_LEVELS when not covered at all
+                int level = -1;
+                if (x < size) {
+                    int tx = right ? size - 1 - x : x;
+                    float coverage = corner_coverage(tx, ty, radius);
+                    level = coverage * WSM_CORNER_MASK_LEVELS;
+                    if (coverage < 0.5f / WSM_CORNER_MASK_LEVELS) {
+                        level = WSM_CORNER_MASK_LEVELS;
+                    } else if (level >= WSM_CORNER_MASK_LEVELS) {
+                        level = -1;
+                    }
+                }
+                if (level == run_level) {
+                    continue;
+                }
+                if (run_level >= 0) {
+                    pixman_region32_union_rect(&mask->cut[corner], &mask->cut[corner],
+                                               run_start, y, x - run_start, 1);
+                }
+                if (run_level >= 0 && run_level < WSM_CORNER_MASK_LEVELS) {
+                    pixman_region32_t *band = &mask->bands[corner][run_level];
+                    pixman_region32_union_rect(band, band, run_start, y, x - run_start, 1);
+                }
+                run_start = x;
+                run_level = level;
+            }
+        }
+    }
+}
+
+static void corner_mask_destroy(struct wsm_corner_mask *mask) {
+    for (int corner = 0; corner < WSM_CORNER_COUNT; corner++) {
+        pixman_region32_fini(&mask->cut[corner]);
+        for (int level = 0; level < WSM_CORNER_MASK_LEVELS; level++) {
+            pixman_region32_fini(&mask->bands[corner][level]);
+        }
+    }
+    wl_list_remove(&mask->link);
+    mask_cache_len--;
+    free(mask);
+}
+
+struct wsm_corner_mask *wsm_corner_mask_get(float radius, uint32_t flags, float scale) {
+    struct wsm_corner_mask *mask;
+    wl_list_for_each(mask, &mask_cache, link) {
+        if (mask->radius == radius && mask->flags == flags && mask->scale == scale) {
+            // Keep the most recently used masks at the front
+            wl_list_remove(&mask->link);
+            wl_list_insert(&mask_cache, &mask->link);
+            return mask;
+        }
+    }
+
+    uint32_t corners = wsm_corner_mask_corners(flags);
+    int size = ceilf(radius * scale);
+    if (!corners || size <= 0) {
+        return NULL;
+    }
+
+    mask = calloc(1, sizeof(struct wsm_corner_mask));
+    if (!wsm_assert(mask, "Could not create wsm_corner_mask: allocation failed!")) {
+        return NULL;
+    }
+    mask->radius = radius;
+    mask->flags = flags;
+    mask->scale = scale;
+    mask->size = size;
+    mask->corners = corners;
+    for (int corner = 0; corner < WSM_CORNER_COUNT; corner++) {
+        pixman_region32_init(&mask->cut[corner]);
+        for (int level = 0; level < WSM_CORNER_MASK_LEVELS; level++) {
+            pixman_region32_init(&mask->bands[corner][level]);
+        }
+    }
+    corner_mask_generate(mask);
+
+    if (mask_cache_len == WSM_CORNER_MASK_CACHE_SIZE) {
+        struct wsm_corner_mask *oldest = wl_container_of(mask_cache.prev, oldest, link);
+        corner_mask_destroy(oldest);
+    }
+    wl_list_insert(&mask_cache, &mask->link);
+    mask_cache_len++;
+    return mask;
+}
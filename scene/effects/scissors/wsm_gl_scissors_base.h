@@ -21,3 +21,60 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+
+#ifndef WSM_GL_SCISSORS_BASE_H
+#define WSM_GL_SCISSORS_BASE_H
+
+#include <stdint.h>
+
+#include <pixman.h>
+#include <wayland-server-core.h>
+
+// Number of alpha levels the anti-aliased edge of a corner is split into
+#define WSM_CORNER_MASK_LEVELS 8
+
+enum wsm_corner {
+    WSM_CORNER_TOP_LEFT,
+    WSM_CORNER_TOP_RIGHT,
+    WSM_CORNER_BOTTOM_LEFT,
+    WSM_CORNER_BOTTOM_RIGHT,
+    WSM_CORNER_COUNT,
+};
+
+/**
+ * @brief anti-aliased mask of the rounded corners of a window.
+ *
+ * @details the render pass has no mask textures, the partially covered
+ * pixels of a corner are grouped by coverage instead and every group is
+ * drawn with a uniform alpha. Regions are relative to the top left of the
+ * corner tile, in output pixels.
+ */
+struct wsm_corner_mask {
+    float radius;
+    uint32_t flags;
+    float scale;
+
+    int size; // edge of a corner tile in output pixels
+    uint32_t corners; // bitmask of enum wsm_corner
+
+    // Pixels not fully covered, left to the bands below
+    pixman_region32_t cut[WSM_CORNER_COUNT];
+    pixman_region32_t bands[WSM_CORNER_COUNT][WSM_CORNER_MASK_LEVELS];
+
+    struct wl_list link;
+};
+
+/**
+ * @brief corners rounded by the surface_effect rounded_corners_flag @p flags.
+ */
+uint32_t wsm_corner_mask_corners(uint32_t flags);
+/**
+ * @brief shared mask for a corner radius, flags and output scale.
+ *
+ * @details masks are generated once and cached, the pointer stays valid
+ * until WSM_CORNER_MASK_CACHE_SIZE other masks have been looked up.
+ */
+struct wsm_corner_mask *wsm_corner_mask_get(float radius, uint32_t flags, float scale);
+float wsm_corner_mask_band_alpha(int level);
+
+#endif
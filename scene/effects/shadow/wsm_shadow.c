@@ -0,0 +1,315 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_shadow.h"
+#include "wsm_log.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cairo.h>
+#include <drm_fourcc.h>
+
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+
+struct wsm_shadow_buffer {
+    struct wlr_buffer base;
+    cairo_surface_t *surface;
+    struct wlr_texture *texture;
+
+    struct wsm_shadow_params params;
+    int extent; // blur extent in texture pixels, tiles are twice as large
+
+    struct wl_list link; // shadow_buffers
+};
+
+// Buffers live as long as a shadow slice holds them
+static struct wl_list shadow_buffers = { &shadow_buffers, &shadow_buffers };
+
+static const struct wlr_buffer_impl shadow_buffer_impl;
+
+static void shadow_buffer_handle_destroy(struct wlr_buffer *wlr_buffer) {
+    struct wsm_shadow_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+    wl_list_remove(&buffer->link);
+    if (buffer->texture) {
+        wlr_texture_destroy(buffer->texture);
+    }
+    cairo_surface_destroy(buffer->surface);
+    free(buffer);
+}
+
+static bool shadow_buffer_handle_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
+                                                       uint32_t flags, void **data, uint32_t *format, size_t *stride) {
+    struct wsm_shadow_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+    *data = cairo_image_surface_get_data(buffer->surface);
+    *stride = cairo_image_surface_get_stride(buffer->surface);
+    *format = DRM_FORMAT_ARGB8888;
+    return true;
+}
+
+static void shadow_buffer_handle_end_data_ptr_access(struct wlr_buffer *wlr_buffer) {
+}
+
+static const struct wlr_buffer_impl shadow_buffer_impl = {
+    .destroy = shadow_buffer_handle_destroy,
+    .begin_data_ptr_access = shadow_buffer_handle_begin_data_ptr_access,
+    .end_data_ptr_access = shadow_buffer_handle_end_data_ptr_access,
+};
+
+static bool shadow_params_equal(const struct wsm_shadow_params *a,
+                                const struct wsm_shadow_params *b) {
+    return a->radius == b->radius && a->spread == b->spread &&
+           a->scale == b->scale && memcmp(a->color, b->color, sizeof(a->color)) == 0;
+}
+
+// Coverage of texel @i by a gaussian blurred edge sitting @extent texels from
+// the border, mirrored around the middle texel of a @size texture
+static float shadow_profile(int i, int size, int extent) {
+    if (i > size / 2) {
+        i = size - 1 - i;
+    }
+    if (extent == 0) {
+        return 1.0f;
+    }
+    float sigma = extent / 2.0f;
+    float t = i + 0.5f - extent;
+    return 0.5f * (1.0f + erff(t / (sqrtf(2.0f) * sigma)));
+}
+
+static struct wsm_shadow_buffer *shadow_buffer_create(const struct wsm_shadow_params *params) {
+    int extent = ceilf(params->radius * params->scale);
+    if (extent < 1) {
+        extent = 1;
+    }
+    int size = extent * 4 + 1;
+
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        wsm_log(WSM_ERROR, "Could not create a %dx%d shadow surface", size, size);
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    float *profile = malloc(sizeof(float) * size);
+    if (!wsm_assert(profile, "Could not create shadow profile: allocation failed!")) {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+    for (int i = 0; i < size; i++) {
+        profile[i] = shadow_profile(i, size, extent);
+    }
+
+    // The blurred rectangle is separable, every texel is the product of the
+    // horizontal and vertical edge profiles
+    cairo_surface_flush(surface);
+    unsigned char *data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    const float *color = params->color;
+    for (int y = 0; y < size; y++) {
+        uint32_t *row = (uint32_t *)(data + y * stride);
+        for (int x = 0; x < size; x++) {
+            float alpha = color[3] * profile[x] * profile[y];
+            row[x] = (uint32_t)roundf(alpha * 255) << 24 |
+                     (uint32_t)roundf(color[0] * alpha * 255) << 16 |
+                     (uint32_t)roundf(color[1] * alpha * 255) << 8 |
+                     (uint32_t)roundf(color[2] * alpha * 255);
+        }
+    }
+    cairo_surface_mark_dirty(surface);
+    free(profile);
+
+    struct wsm_shadow_buffer *buffer = calloc(1, sizeof(struct wsm_shadow_buffer));
+    if (!wsm_assert(buffer, "Could not create wsm_shadow_buffer: allocation failed!")) {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+    wlr_buffer_init(&buffer->base, &shadow_buffer_impl, size, size);
+    buffer->surface = surface;
+    buffer->params = *params;
+    buffer->extent = extent;
+    wl_list_insert(&shadow_buffers, &buffer->link);
+    return buffer;
+}
+
+struct wlr_texture *wsm_shadow_buffer_get_texture(struct wlr_buffer *wlr_buffer,
+                                                  struct wlr_renderer *renderer) {
+    if (wlr_buffer->impl != &shadow_buffer_impl) {
+        return NULL;
+    }
+    struct wsm_shadow_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+    if (!buffer->texture) {
+        buffer->texture = wlr_texture_from_buffer(renderer, &buffer->base);
+    }
+    return buffer->texture;
+}
+
+static void shadow_update_slices(struct wsm_shadow *shadow) {
+    struct wsm_shadow_buffer *buffer = shadow->buffer;
+    const struct wsm_shadow_params *params = &shadow->params;
+
+    // Outer bounds of the shadow, tiles reach as far into the window
+    int tile = params->radius * 2;
+    struct wlr_box outer = {
+        .x = shadow->box.x - params->spread - params->radius,
+        .y = shadow->box.y - params->spread - params->radius,
+        .width = shadow->box.width + (params->spread + params->radius) * 2,
+        .height = shadow->box.height + (params->spread + params->radius) * 2,
+    };
+    int middle_width = outer.width - tile * 2;
+    int middle_height = outer.height - tile * 2;
+
+    int t = buffer->extent * 2; // tile size in texels
+    struct {
+        struct wlr_box dst;
+        struct wlr_fbox src;
+    } slices[WSM_SHADOW_SLICES] = {
+        { { outer.x, outer.y, tile, tile }, { 0, 0, t, t } },
+        { { outer.x + tile, outer.y, middle_width, tile }, { t, 0, 1, t } },
+        { { outer.x + tile + middle_width, outer.y, tile, tile }, { t + 1, 0, t, t } },
+        { { outer.x, outer.y + tile, tile, middle_height }, { 0, t, t, 1 } },
+        { { outer.x + tile + middle_width, outer.y + tile, tile, middle_height }, { t + 1, t, t, 1 } },
+        { { outer.x, outer.y + tile + middle_height, tile, tile }, { 0, t + 1, t, t } },
+        { { outer.x + tile, outer.y + tile + middle_height, middle_width, tile }, { t, t + 1, 1, t } },
+        { { outer.x + tile + middle_width, outer.y + tile + middle_height, tile, tile }, { t + 1, t + 1, t, t } },
+    };
+
+    for (int i = 0; i < WSM_SHADOW_SLICES; i++) {
+        struct wlr_scene_buffer *slice = shadow->slices[i];
+        bool enabled = !wlr_box_empty(&slices[i].dst);
+        wlr_scene_node_set_enabled(&slice->node, enabled);
+        if (!enabled) {
+            continue;
+        }
+        wlr_scene_buffer_set_source_box(slice, &slices[i].src);
+        wlr_scene_buffer_set_dest_size(slice, slices[i].dst.width, slices[i].dst.height);
+        wlr_scene_node_set_position(&slice->node, slices[i].dst.x, slices[i].dst.y);
+    }
+}
+
+static void shadow_set_buffer(struct wsm_shadow *shadow) {
+    struct wsm_shadow_buffer *buffer, *found = NULL;
+    wl_list_for_each(buffer, &shadow_buffers, link) {
+        if (shadow_params_equal(&buffer->params, &shadow->params)) {
+            found = buffer;
+            break;
+        }
+    }
+
+    bool created = false;
+    if (!found) {
+        found = shadow_buffer_create(&shadow->params);
+        if (!found) {
+            return;
+        }
+        created = true;
+    }
+
+    shadow->buffer = found;
+    for (int i = 0; i < WSM_SHADOW_SLICES; i++) {
+        wlr_scene_buffer_set_buffer(shadow->slices[i], &found->base);
+    }
+    if (created) {
+        // Held by the slices from now on
+        wlr_buffer_drop(&found->base);
+    }
+    shadow_update_slices(shadow);
+}
+
+static void handle_tree_destroy(struct wl_listener *listener, void *data) {
+    struct wsm_shadow *shadow = wl_container_of(listener, shadow, tree_destroy);
+    wl_list_remove(&shadow->tree_destroy.link);
+    free(shadow);
+}
+
+// The shadow is only drawn around the window, clicks go to whatever is below
+static bool slice_point_accepts_input(struct wlr_scene_buffer *buffer, double *sx, double *sy) {
+    return false;
+}
+
+bool wsm_shadow_buffer_is_slice(struct wlr_scene_buffer *buffer) {
+    return buffer->point_accepts_input == slice_point_accepts_input;
+}
+
+struct wsm_shadow *wsm_shadow_create(struct wlr_scene_tree *parent,
+                                     const struct wsm_shadow_params *params) {
+    struct wsm_shadow *shadow = calloc(1, sizeof(struct wsm_shadow));
+    if (!wsm_assert(shadow, "Could not create wsm_shadow: allocation failed!")) {
+        return NULL;
+    }
+
+    shadow->tree = wlr_scene_tree_create(parent);
+    if (!shadow->tree) {
+        free(shadow);
+        return NULL;
+    }
+    wlr_scene_node_lower_to_bottom(&shadow->tree->node);
+
+    for (int i = 0; i < WSM_SHADOW_SLICES; i++) {
+        shadow->slices[i] = wlr_scene_buffer_create(shadow->tree, NULL);
+        if (!shadow->slices[i]) {
+            wlr_scene_node_destroy(&shadow->tree->node);
+            free(shadow);
+            return NULL;
+        }
+        shadow->slices[i]->point_accepts_input = slice_point_accepts_input;
+    }
+
+    shadow->tree_destroy.notify = handle_tree_destroy;
+    wl_signal_add(&shadow->tree->node.events.destroy, &shadow->tree_destroy);
+
+    shadow->params = *params;
+    shadow_set_buffer(shadow);
+    return shadow;
+}
+
+void wsm_shadow_destroy(struct wsm_shadow *shadow) {
+    if (!shadow) {
+        return;
+    }
+    wlr_scene_node_destroy(&shadow->tree->node);
+}
+
+void wsm_shadow_set_params(struct wsm_shadow *shadow,
+                           const struct wsm_shadow_params *params) {
+    if (shadow_params_equal(&shadow->params, params)) {
+        return;
+    }
+    shadow->params = *params;
+    shadow_set_buffer(shadow);
+}
+
+void wsm_shadow_set_box(struct wsm_shadow *shadow, const struct wlr_box *box) {
+    if (wlr_box_equal(&shadow->box, box)) {
+        return;
+    }
+    shadow->box = *box;
+    if (shadow->buffer) {
+        shadow_update_slices(shadow);
+    }
+}
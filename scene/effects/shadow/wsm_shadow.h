@@ -0,0 +1,100 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_SHADOW_H
+#define WSM_SHADOW_H
+
+#include <stdbool.h>
+
+#include <wayland-server-core.h>
+
+#include <wlr/util/box.h>
+
+#define WSM_SHADOW_DEFAULT_RADIUS 16
+#define WSM_SHADOW_DEFAULT_SPREAD 0
+#define WSM_SHADOW_DEFAULT_ALPHA 0.5f
+#define WSM_SHADOW_SLICES 8
+
+struct wlr_buffer;
+struct wlr_renderer;
+struct wlr_texture;
+struct wlr_scene_tree;
+struct wlr_scene_buffer;
+
+struct wsm_shadow_params {
+    int radius; // blur radius, logical pixels
+    int spread; // growth of the shadow beyond the window, logical pixels
+    float color[4]; // not premultiplied
+    float scale;
+};
+
+struct wsm_shadow_buffer;
+
+/**
+ * @brief drop shadow drawn from a nine-slice texture.
+ *
+ * @details the texture is generated once per wsm_shadow_params and shared by
+ * all shadows using them. Corners are drawn as they are and edges are
+ * stretched, the middle is left to the window above. Slices are plain scene
+ * buffers, so damage and occlusion culling work as for any other node.
+ */
+struct wsm_shadow {
+    struct wlr_scene_tree *tree;
+    struct wlr_scene_buffer *slices[WSM_SHADOW_SLICES];
+
+    struct wsm_shadow_params params;
+    struct wsm_shadow_buffer *buffer;
+    struct wlr_box box;
+
+    struct wl_listener tree_destroy;
+};
+
+/**
+ * @brief create a shadow at the bottom of @p parent.
+ */
+struct wsm_shadow *wsm_shadow_create(struct wlr_scene_tree *parent,
+                                     const struct wsm_shadow_params *params);
+/**
+ * @brief destroy the shadow, by destroying its scene tree.
+ */
+void wsm_shadow_destroy(struct wsm_shadow *shadow);
+void wsm_shadow_set_params(struct wsm_shadow *shadow,
+                           const struct wsm_shadow_params *params);
+/**
+ * @brief place the shadow around @p box, in parent coordinates.
+ */
+void wsm_shadow_set_box(struct wsm_shadow *shadow, const struct wlr_box *box);
+/**
+ * @brief whether @p buffer is one of the slices of a shadow.
+ */
+bool wsm_shadow_buffer_is_slice(struct wlr_scene_buffer *buffer);
+/**
+ * @brief texture shared by all slices of shadows using @p buffer.
+ *
+ * @details returns NULL if @p buffer is not a shadow buffer.
+ */
+struct wlr_texture *wsm_shadow_buffer_get_texture(struct wlr_buffer *buffer,
+                                                  struct wlr_renderer *renderer);
+
+#endif
@@ -23,3 +23,439 @@ THE SOFTWARE.
 */
 
 #include "wsm_effect.h"
+#include "wsm_log.h"
+#include "wsm_list.h"
+#include "wsm_common.h"
+#include "node/wsm_node_descriptor.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <drm_fourcc.h>
+
+#include <wlr/util/addon.h>
+#include <wlr/util/region.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_buffer.h>
+
+// Free buffers kept around for the next acquire
+#define EFFECT_BUFFER_POOL_MAX 8
+
+struct wsm_effect_output {
+    struct wlr_output *output;
+    struct wlr_addon addon;
+
+    struct wsm_list *effects;
+    uint32_t mask; // ids of effects
+
+    uint64_t frame_ns;
+    uint64_t last_frame_ns;
+
+    struct wl_list link; // effect_outputs
+};
+
+// Found through the node's descriptor table while building the render
+// list, the addon only ties it to the node's lifetime
+struct effect_window {
+    struct wlr_scene_node *node;
+    struct wlr_addon addon;
+
+    uint32_t mask;
+
+    struct wl_list link; // effect_windows
+};
+
+static uint32_t effect_ids = 0;
+static struct wl_list effect_outputs = { &effect_outputs, &effect_outputs };
+static struct wl_list effect_windows = { &effect_windows, &effect_windows };
+static struct wl_list buffer_pool = { &buffer_pool, &buffer_pool };
+static int buffer_pool_size = 0;
+
+static uint64_t effect_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespec_to_nsec(&now);
+}
+
+struct wsm_effect *wsm_effect_create(const struct wsm_effect_impl *impl, void *data) {
+    if (__builtin_popcount(effect_ids) >= WSM_EFFECT_MAX) {
+        wsm_log(WSM_ERROR, "Could not create effect %s: too many effects",
+                impl->name ? impl->name : "(unnamed)");
+        return NULL;
+    }
+
+    struct wsm_effect *effect = calloc(1, sizeof(struct wsm_effect));
+    if (!wsm_assert(effect, "Could not create wsm_effect: allocation failed!")) {
+        return NULL;
+    }
+    effect->impl = impl;
+    effect->data = data;
+    effect->id = __builtin_ctz(~effect_ids);
+    effect_ids |= 1u << effect->id;
+    return effect;
+}
+
+void wsm_effect_destroy(struct wsm_effect *effect) {
+    if (!effect) {
+        return;
+    }
+
+    struct wsm_effect_output *effect_output, *tmp_output;
+    wl_list_for_each_safe(effect_output, tmp_output, &effect_outputs, link) {
+        wsm_effect_output_remove(effect_output->output, effect);
+    }
+
+    // The id can be handed out again, forget the windows it was enabled for
+    struct effect_window *window, *tmp;
+    wl_list_for_each_safe(window, tmp, &effect_windows, link) {
+        wsm_effect_set_window_enabled(effect, window->node, false);
+    }
+    effect_ids &= ~(1u << effect->id);
+
+    if (effect->impl->destroy) {
+        effect->impl->destroy(effect);
+    }
+    free(effect);
+}
+
+bool wsm_effect_provides_feature(struct wsm_effect *effect, enum wsm_effect_feature feature) {
+    return effect && feature != WSM_EFFECT_NOTHING && effect->impl->feature == feature;
+}
+
+static void effect_output_destroy(struct wsm_effect_output *effect_output) {
+    wl_list_remove(&effect_output->link);
+    wlr_addon_finish(&effect_output->addon);
+    list_free(effect_output->effects);
+    free(effect_output);
+}
+
+static void output_addon_destroy(struct wlr_addon *addon) {
+    struct wsm_effect_output *effect_output = wl_container_of(addon, effect_output, addon);
+    effect_output_destroy(effect_output);
+}
+
+static const struct wlr_addon_interface output_addon_impl = {
+    .name = "wsm_effect_output",
+    .destroy = output_addon_destroy,
+};
+
+struct wsm_effect_output *wsm_effect_output_get(struct wlr_output *output) {
+    struct wlr_addon *addon = wlr_addon_find(&output->addons, &output_addon_impl,
+                                             &output_addon_impl);
+    if (!addon) {
+        return NULL;
+    }
+    struct wsm_effect_output *effect_output = wl_container_of(addon, effect_output, addon);
+    return effect_output;
+}
+
+bool wsm_effect_output_add(struct wlr_output *output, struct wsm_effect *effect) {
+    if (effect->impl->is_supported &&
+        !effect->impl->is_supported(effect, output->renderer)) {
+        wsm_log(WSM_INFO, "Effect %s is not supported on output %s",
+                effect->impl->name ? effect->impl->name : "(unnamed)", output->name);
+        return false;
+    }
+
+    struct wsm_effect_output *effect_output = wsm_effect_output_get(output);
+    if (!effect_output) {
+        effect_output = calloc(1, sizeof(struct wsm_effect_output));
+        if (!wsm_assert(effect_output, "Could not create wsm_effect_output: allocation failed!")) {
+            return false;
+        }
+        effect_output->output = output;
+        effect_output->effects = create_list();
+        wl_list_insert(&effect_outputs, &effect_output->link);
+        wlr_addon_init(&effect_output->addon, &output->addons, &output_addon_impl,
+                       &output_addon_impl);
+    } else if (effect_output->mask & (1u << effect->id)) {
+        return true;
+    }
+
+    list_add(effect_output->effects, effect);
+    effect_output->mask |= 1u << effect->id;
+    wlr_output_schedule_frame(output);
+    return true;
+}
+
+void wsm_effect_output_remove(struct wlr_output *output, struct wsm_effect *effect) {
+    struct wsm_effect_output *effect_output = wsm_effect_output_get(output);
+    if (!effect_output) {
+        return;
+    }
+    int index = list_find(effect_output->effects, effect);
+    if (index < 0) {
+        return;
+    }
+    list_del(effect_output->effects, index);
+    effect_output->mask &= ~(1u << effect->id);
+    wlr_output_schedule_frame(output);
+    // Outputs without effects go back to the plain render path
+    if (effect_output->effects->length == 0) {
+        effect_output_destroy(effect_output);
+    }
+}
+
+static void effect_window_destroy(struct effect_window *window) {
+    wl_list_remove(&window->link);
+    wlr_addon_finish(&window->addon);
+    free(window);
+}
+
+static void window_addon_destroy(struct wlr_addon *addon) {
+    // The descriptor table goes with the node as well
+    struct effect_window *window = wl_container_of(addon, window, addon);
+    effect_window_destroy(window);
+}
+
+static const struct wlr_addon_interface window_addon_impl = {
+    .name = "wsm_effect_window",
+    .destroy = window_addon_destroy,
+};
+
+static struct effect_window *effect_window_get(struct wlr_scene_node *node) {
+    return wsm_scene_descriptor_try_get(node, WSM_SCENE_DESC_EFFECT_WINDOW);
+}
+
+void wsm_effect_set_window_enabled(struct wsm_effect *effect,
+                                   struct wlr_scene_node *node, bool enabled) {
+    struct effect_window *window = effect_window_get(node);
+    if (!window) {
+        if (!enabled) {
+            return;
+        }
+        window = calloc(1, sizeof(struct effect_window));
+        if (!wsm_assert(window, "Could not create effect_window: allocation failed!")) {
+            return;
+        }
+        if (!wsm_scene_descriptor_assign(node, WSM_SCENE_DESC_EFFECT_WINDOW, window)) {
+            free(window);
+            return;
+        }
+        window->node = node;
+        wl_list_insert(&effect_windows, &window->link);
+        wlr_addon_init(&window->addon, &node->addons, &window_addon_impl,
+                       &window_addon_impl);
+    }
+
+    if (enabled) {
+        window->mask |= 1u << effect->id;
+    } else {
+        window->mask &= ~(1u << effect->id);
+        if (window->mask == 0) {
+            wsm_scene_descriptor_destroy(node, WSM_SCENE_DESC_EFFECT_WINDOW);
+            effect_window_destroy(window);
+        }
+    }
+}
+
+uint32_t wsm_effect_node_effects(struct wlr_scene_node *node) {
+    struct effect_window *window = effect_window_get(node);
+    return window ? window->mask : 0;
+}
+
+uint32_t wsm_effect_output_mask(struct wsm_effect_output *effect_output) {
+    return effect_output ? effect_output->mask : 0;
+}
+
+bool wsm_effect_output_has_output_hooks(struct wsm_effect_output *effect_output) {
+    if (!effect_output) {
+        return false;
+    }
+    for (int i = 0; i < effect_output->effects->length; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if (effect->impl->pre_render_output || effect->impl->render_output ||
+            effect->impl->post_render_output) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void wsm_effect_output_expand_damage(struct wsm_effect_output *effect_output,
+                                     uint32_t effects, const struct wlr_box *box, float scale,
+                                     pixman_region32_t *damage) {
+    int distance = 0;
+    for (int i = 0; i < effect_output->effects->length; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if ((effects & (1u << effect->id)) && effect->damage_expansion > distance) {
+            distance = effect->damage_expansion;
+        }
+    }
+    if (distance <= 0) {
+        return;
+    }
+    distance = ceilf(distance * scale);
+
+    // Damage inside the reach of the window spreads by the effect distance,
+    // but never further than the reach itself.
+    pixman_region32_t reach, spread;
+    pixman_region32_init_rect(&reach, box->x - distance, box->y - distance,
+                              box->width + 2 * distance, box->height + 2 * distance);
+    pixman_region32_init(&spread);
+    pixman_region32_intersect(&spread, damage, &reach);
+    if (pixman_region32_not_empty(&spread)) {
+        wlr_region_expand(&spread, &spread, distance);
+        pixman_region32_intersect(&spread, &spread, &reach);
+        pixman_region32_union(damage, damage, &spread);
+    }
+    pixman_region32_fini(&spread);
+    pixman_region32_fini(&reach);
+}
+
+// Every hook call is timed and charged to its effect and the output
+
+#define EFFECT_CALL(effect_output, effect, hook, ...) \
+    do { \
+        uint64_t start = effect_now(); \
+        (effect)->impl->hook(__VA_ARGS__); \
+        uint64_t elapsed = effect_now() - start; \
+        (effect)->frame_ns += elapsed; \
+        (effect_output)->frame_ns += elapsed; \
+    } while (0)
+
+void wsm_effect_output_pre_render(struct wsm_effect_output *effect_output,
+                                  struct wsm_effect_frame *frame) {
+    for (int i = 0; i < effect_output->effects->length && frame->pass; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if (effect->impl->pre_render_output) {
+            EFFECT_CALL(effect_output, effect, pre_render_output, effect, frame);
+        }
+    }
+}
+
+void wsm_effect_output_render(struct wsm_effect_output *effect_output,
+                              struct wsm_effect_frame *frame) {
+    for (int i = 0; i < effect_output->effects->length && frame->pass; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if (effect->impl->render_output) {
+            EFFECT_CALL(effect_output, effect, render_output, effect, frame);
+        }
+    }
+}
+
+void wsm_effect_output_post_render(struct wsm_effect_output *effect_output,
+                                   struct wsm_effect_frame *frame) {
+    for (int i = 0; i < effect_output->effects->length; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if (effect->impl->post_render_output) {
+            EFFECT_CALL(effect_output, effect, post_render_output, effect, frame);
+        }
+
+        effect->stats.frames++;
+        effect->stats.last_frame_ns = effect->frame_ns;
+        effect->stats.total_ns += effect->frame_ns;
+        effect->frame_ns = 0;
+    }
+    effect_output->last_frame_ns = effect_output->frame_ns;
+    effect_output->frame_ns = 0;
+}
+
+void wsm_effect_output_pre_render_window(struct wsm_effect_output *effect_output,
+                                         uint32_t effects, struct wsm_effect_frame *frame,
+                                         struct wsm_effect_window *window) {
+    for (int i = 0; i < effect_output->effects->length && frame->pass; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if ((effects & (1u << effect->id)) && effect->impl->pre_render_window) {
+            EFFECT_CALL(effect_output, effect, pre_render_window, effect, frame, window);
+        }
+    }
+}
+
+void wsm_effect_output_render_window(struct wsm_effect_output *effect_output,
+                                     uint32_t effects, struct wsm_effect_frame *frame,
+                                     struct wsm_effect_window *window) {
+    for (int i = 0; i < effect_output->effects->length && frame->pass; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if ((effects & (1u << effect->id)) && effect->impl->render_window) {
+            EFFECT_CALL(effect_output, effect, render_window, effect, frame, window);
+        }
+    }
+}
+
+void wsm_effect_output_post_render_window(struct wsm_effect_output *effect_output,
+                                          uint32_t effects, struct wsm_effect_frame *frame,
+                                          struct wsm_effect_window *window) {
+    for (int i = 0; i < effect_output->effects->length; i++) {
+        struct wsm_effect *effect = effect_output->effects->items[i];
+        if ((effects & (1u << effect->id)) && effect->impl->post_render_window) {
+            EFFECT_CALL(effect_output, effect, post_render_window, effect, frame, window);
+        }
+    }
+}
+
+uint64_t wsm_effect_output_last_frame_ns(struct wsm_effect_output *effect_output) {
+    return effect_output ? effect_output->last_frame_ns : 0;
+}
+
+static void effect_buffer_destroy(struct wsm_effect_buffer *buffer) {
+    if (buffer->texture) {
+        wlr_texture_destroy(buffer->texture);
+    }
+    if (buffer->buffer) {
+        wlr_buffer_drop(buffer->buffer);
+    }
+    free(buffer);
+}
+
+struct wsm_effect_buffer *wsm_effect_buffer_acquire(struct wlr_output *output,
+                                                    int width, int height) {
+    struct wsm_effect_buffer *buffer;
+    wl_list_for_each(buffer, &buffer_pool, link) {
+        if (buffer->renderer == output->renderer &&
+            buffer->buffer->width == width && buffer->buffer->height == height) {
+            wl_list_remove(&buffer->link);
+            wl_list_init(&buffer->link);
+            buffer_pool_size--;
+            return buffer;
+        }
+    }
+
+    buffer = calloc(1, sizeof(struct wsm_effect_buffer));
+    if (!wsm_assert(buffer, "Could not create wsm_effect_buffer: allocation failed!")) {
+        return NULL;
+    }
+    wl_list_init(&buffer->link);
+    buffer->renderer = output->renderer;
+
+    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    struct wlr_drm_format format = {
+        .format = DRM_FORMAT_ARGB8888,
+        .len = 1,
+        .capacity = 1,
+        .modifiers = &modifier,
+    };
+    buffer->buffer = wlr_allocator_create_buffer(output->allocator, width, height, &format);
+    if (!buffer->buffer) {
+        wsm_log(WSM_DEBUG, "Could not allocate a %dx%d effect buffer", width, height);
+        effect_buffer_destroy(buffer);
+        return NULL;
+    }
+    buffer->texture = wlr_texture_from_buffer(output->renderer, buffer->buffer);
+    if (!buffer->texture) {
+        effect_buffer_destroy(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+void wsm_effect_buffer_release(struct wsm_effect_buffer *buffer) {
+    if (!buffer) {
+        return;
+    }
+    wl_list_insert(&buffer_pool, &buffer->link);
+    buffer_pool_size++;
+
+    // Drop the buffer released the longest time ago
+    if (buffer_pool_size > EFFECT_BUFFER_POOL_MAX) {
+        struct wsm_effect_buffer *oldest =
+            wl_container_of(buffer_pool.prev, oldest, link);
+        wl_list_remove(&oldest->link);
+        buffer_pool_size--;
+        effect_buffer_destroy(oldest);
+    }
+}
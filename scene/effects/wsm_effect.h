@@ -26,6 +26,26 @@ THE SOFTWARE.
 #define WSM_EFFECT_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include <pixman.h>
+#include <wayland-server-protocol.h>
+
+#include <wlr/util/box.h>
+
+#define WSM_EFFECT_MAX 32
+
+struct wlr_buffer;
+struct wlr_buffer_pass_options;
+struct wlr_output;
+struct wlr_texture;
+struct wlr_renderer;
+struct wlr_render_pass;
+struct wlr_scene_node;
+struct wlr_scene_output;
+
+struct wsm_effect;
+struct wsm_effect_output;
 
 /**
  * @brief build-in effects enumeration
@@ -37,49 +57,185 @@ enum wsm_effect_feature {
     WSM_EFFECT_RADIUS,      /**< supprot scissors window radius effect. */
 };
 
+/**
+ * @brief output frame being rendered, handed to every hook.
+ */
+struct wsm_effect_frame {
+    struct wlr_scene_output *output;
+    struct wlr_buffer *buffer;
+    // Hooks reading back the buffer have to submit the pass and begin a new
+    // one with pass_options, leaving NULL here if that failed. NULL in post
+    // render hooks.
+    struct wlr_render_pass *pass;
+    const struct wlr_buffer_pass_options *pass_options;
+    const pixman_region32_t *damage; // buffer coordinates
+    float scale;
+    enum wl_output_transform transform;
+};
+
+/**
+ * @brief window an effect is applied to.
+ *
+ * @details box and clip are in output coordinates before the output
+ * transform, hooks drawing into the pass apply frame->transform.
+ */
+struct wsm_effect_window {
+    struct wlr_scene_node *node;
+    struct wlr_box box;
+    // What is drawn of the window, pre_render_window hooks may remove
+    // parts they draw themselves. NULL in post render hooks.
+    pixman_region32_t *clip;
+};
+
 struct wsm_effect_impl {
+    const char *name;
+    enum wsm_effect_feature feature;
+
     /**
     * @brief Called before starting to render the screen.
     */
-    void (*pre_render_output) ();
+    void (*pre_render_output)(struct wsm_effect *effect, struct wsm_effect_frame *frame);
     /**
     * @brief render something on top of the windows.
     */
-    void (*render_output) ();
+    void (*render_output)(struct wsm_effect *effect, struct wsm_effect_frame *frame);
 
     /**
     * @brief Called after all the render has been finished.
     */
-    void (*post_render_output) ();
+    void (*post_render_output)(struct wsm_effect *effect, struct wsm_effect_frame *frame);
 
     /**
     * @brief Called for every window before the actual render pass.
     */
-    void (*pre_render_window) ();
+    void (*pre_render_window)(struct wsm_effect *effect, struct wsm_effect_frame *frame,
+                              struct wsm_effect_window *window);
 
     /**
     * @brief do various transformations.
     * change opacity、brightness、saturation of the window
     */
-    void (*render_window) ();
+    void (*render_window)(struct wsm_effect *effect, struct wsm_effect_frame *frame,
+                          struct wsm_effect_window *window);
 
     /**
     * @brief Called for every window after all rendering has been finished.
     */
-    void (*post_render_window) ();
+    void (*post_render_window)(struct wsm_effect *effect, struct wsm_effect_frame *frame,
+                               struct wsm_effect_window *window);
 
     /**
     * @brief Whether to support this special effect, distinguish different rendering APIs.
     */
-    bool (*is_supported) ();
+    bool (*is_supported)(struct wsm_effect *effect, struct wlr_renderer *renderer);
+
+    void (*destroy)(struct wsm_effect *effect);
+};
+
+struct wsm_effect_stats {
+    uint64_t frames;
+    uint64_t total_ns;
+    uint64_t last_frame_ns;
 };
 
 struct wsm_effect {
     const struct wsm_effect_impl *impl;
+    void *data;
+
+    int id; // bit of the effect in window masks
+    // Distance in logical pixels damage next to a window reaches into the
+    // window once the effect is applied, and how far the effect draws
+    // outside of the window.
+    int damage_expansion;
+
+    struct wsm_effect_stats stats;
+    uint64_t frame_ns;
 };
 
-struct wsm_effect* wsm_effect_create();
+/**
+ * @brief offscreen buffer borrowed from the shared pool.
+ */
+struct wsm_effect_buffer {
+    struct wlr_buffer *buffer;
+    struct wlr_texture *texture;
+
+    struct wlr_renderer *renderer;
+    struct wl_list link;
+};
+
+struct wsm_effect *wsm_effect_create(const struct wsm_effect_impl *impl, void *data);
 void wsm_effect_destroy(struct wsm_effect* effect);
 bool wsm_effect_provides_feature (struct wsm_effect *effect, enum wsm_effect_feature feature);
+/**
+ * @brief apply @p effect to @p output, in registration order.
+ */
+bool wsm_effect_output_add(struct wlr_output *output, struct wsm_effect *effect);
+void wsm_effect_output_remove(struct wlr_output *output, struct wsm_effect *effect);
+/**
+ * @brief enable the window hooks of @p effect for @p node.
+ *
+ * @details the hooks run for every node rendered below @p node. Windows
+ * without any enabled effect are skipped by the pipeline without calling
+ * into any effect.
+ */
+void wsm_effect_set_window_enabled(struct wsm_effect *effect,
+                                   struct wlr_scene_node *node, bool enabled);
+/**
+ * @brief ids of the effects enabled for @p node itself, not its parents.
+ */
+uint32_t wsm_effect_node_effects(struct wlr_scene_node *node);
+
+/**
+ * @brief borrow a @p width x @p height ARGB8888 buffer for offscreen rendering.
+ *
+ * @details buffers come from a pool shared by all effects and outputs and
+ * must be released before the end of the frame.
+ */
+struct wsm_effect_buffer *wsm_effect_buffer_acquire(struct wlr_output *output,
+                                                    int width, int height);
+void wsm_effect_buffer_release(struct wsm_effect_buffer *buffer);
+
+// Pipeline, driven by the scene renderer
+
+/**
+ * @brief effects of @p output, NULL if it has none.
+ */
+struct wsm_effect_output *wsm_effect_output_get(struct wlr_output *output);
+/**
+ * @brief ids of the effects of @p effect_output.
+ *
+ * @details the renderer gathers the effects of a window while walking the
+ * scene down to it, this masks out those not applied to the output.
+ */
+uint32_t wsm_effect_output_mask(struct wsm_effect_output *effect_output);
+/**
+ * @brief whether an effect of @p effect_output has output hooks.
+ */
+bool wsm_effect_output_has_output_hooks(struct wsm_effect_output *effect_output);
+/**
+ * @brief expand @p damage around a window @p box, both in damage coordinates.
+ */
+void wsm_effect_output_expand_damage(struct wsm_effect_output *effect_output,
+                                     uint32_t effects, const struct wlr_box *box, float scale,
+                                     pixman_region32_t *damage);
+void wsm_effect_output_pre_render(struct wsm_effect_output *effect_output,
+                                  struct wsm_effect_frame *frame);
+void wsm_effect_output_render(struct wsm_effect_output *effect_output,
+                              struct wsm_effect_frame *frame);
+void wsm_effect_output_post_render(struct wsm_effect_output *effect_output,
+                                   struct wsm_effect_frame *frame);
+void wsm_effect_output_pre_render_window(struct wsm_effect_output *effect_output,
+                                         uint32_t effects, struct wsm_effect_frame *frame,
+                                         struct wsm_effect_window *window);
+void wsm_effect_output_render_window(struct wsm_effect_output *effect_output,
+                                     uint32_t effects, struct wsm_effect_frame *frame,
+                                     struct wsm_effect_window *window);
+void wsm_effect_output_post_render_window(struct wsm_effect_output *effect_output,
+                                          uint32_t effects, struct wsm_effect_frame *frame,
+                                          struct wsm_effect_window *window);
+/**
+ * @brief time spent in effects during the last frame of the output.
+ */
+uint64_t wsm_effect_output_last_frame_ns(struct wsm_effect_output *effect_output);
 
 #endif
@@ -0,0 +1,487 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_surface_effect.h"
+#include "wsm_log.h"
+#include "wsm_list.h"
+#include "wsm_server.h"
+#include "wsm_output.h"
+#include "wsm_scene.h"
+#include "wsm-effects-protocol.h"
+#include "scissors/wsm_gl_scissors.h"
+#include "scissors/wsm_gl_scissors_base.h"
+#include "shadow/wsm_shadow.h"
+#include "wsm_view.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_compositor.h>
+
+#define EFFECTS_MANAGER_VERSION 1
+
+static struct wsm_effects_manager *effects_manager = NULL;
+
+static const struct surface_effect_interface surface_effect_impl;
+
+static struct wsm_surface_effect *surface_effect_from_resource(
+    struct wl_resource *resource) {
+    wsm_assert(wl_resource_instance_of(resource, &surface_effect_interface,
+                                       &surface_effect_impl), "Unexpected resource");
+    return wl_resource_get_user_data(resource);
+}
+
+static bool effect_state_has_corners(struct wsm_surface_effect_state *state) {
+    return state->corner_radius > 0 && wsm_corner_mask_corners(state->corner_flags);
+}
+
+static bool effect_state_active(struct wsm_surface_effect_state *state) {
+    return state->blur || state->clip || state->shadow ||
+           effect_state_has_corners(state);
+}
+
+static void effect_state_init(struct wsm_surface_effect_state *state) {
+    pixman_region32_init(&state->blur_region);
+    pixman_region32_init(&state->clip_region);
+}
+
+static void effect_state_finish(struct wsm_surface_effect_state *state) {
+    pixman_region32_fini(&state->blur_region);
+    pixman_region32_fini(&state->clip_region);
+}
+
+static void effect_state_copy(struct wsm_surface_effect_state *dst,
+                              struct wsm_surface_effect_state *src) {
+    dst->blur = src->blur;
+    dst->full_window_blur = src->full_window_blur;
+    pixman_region32_copy(&dst->blur_region, &src->blur_region);
+    dst->corner_radius = src->corner_radius;
+    dst->corner_flags = src->corner_flags;
+    dst->clip = src->clip;
+    pixman_region32_copy(&dst->clip_region, &src->clip_region);
+    dst->shadow = src->shadow;
+    memcpy(dst->shadow_color, src->shadow_color, sizeof(dst->shadow_color));
+}
+
+// Effects change how the whole surface is drawn, damage every output it is on
+static void damage_all_outputs(void) {
+    struct wsm_scene *root = global_server.wsm_scene;
+    for (int i = 0; i < root->outputs->length; i++) {
+        struct wsm_output *output = root->outputs->items[i];
+        if (!output->scene_output) {
+            continue;
+        }
+        wlr_damage_ring_add_whole(&output->scene_output->damage_ring);
+        wlr_output_schedule_frame(output->wlr_output);
+    }
+}
+
+static void surface_effect_destroy(struct wsm_surface_effect *effect) {
+    if (!effect) {
+        return;
+    }
+    // Surfaces can outlive the manager, which goes with the display
+    if (effect_state_active(&effect->current) && effects_manager) {
+        effects_manager->active_effects--;
+        damage_all_outputs();
+    }
+    wl_list_remove(&effect->surface_commit.link);
+    if (effect->shadow) {
+        wl_list_remove(&effect->shadow_destroy.link);
+        wsm_shadow_destroy(effect->shadow);
+    }
+    wlr_addon_finish(&effect->addon);
+    effect_state_finish(&effect->pending);
+    effect_state_finish(&effect->current);
+    pixman_region32_fini(&effect->content_damage);
+    if (effect->resource) {
+        wl_resource_set_user_data(effect->resource, NULL);
+    }
+    free(effect);
+}
+
+static void surface_addon_destroy(struct wlr_addon *addon) {
+    struct wsm_surface_effect *effect = wl_container_of(addon, effect, addon);
+    surface_effect_destroy(effect);
+}
+
+static const struct wlr_addon_interface surface_addon_impl = {
+    .name = "wsm_surface_effect",
+    .destroy = surface_addon_destroy,
+};
+
+static void handle_shadow_destroy(struct wl_listener *listener, void *data) {
+    struct wsm_surface_effect *effect =
+        wl_container_of(listener, effect, shadow_destroy);
+    wl_list_remove(&effect->shadow_destroy.link);
+    effect->shadow = NULL;
+}
+
+static void handle_surface_commit(struct wl_listener *listener, void *data) {
+    struct wsm_surface_effect *effect =
+        wl_container_of(listener, effect, surface_commit);
+    pixman_region32_copy(&effect->content_damage,
+                         &effect->surface->current.surface_damage);
+}
+
+static void surface_effect_handle_commit(struct wl_client *client,
+                                         struct wl_resource *resource) {
+    struct wsm_surface_effect *effect = surface_effect_from_resource(resource);
+    if (!effect) {
+        return;
+    }
+
+    bool was_active = effect_state_active(&effect->current);
+    effect_state_copy(&effect->current, &effect->pending);
+    bool active = effect_state_active(&effect->current);
+    if (effects_manager) {
+        effects_manager->active_effects += active - was_active;
+    }
+
+    if (!effect->current.shadow && effect->shadow) {
+        wsm_shadow_destroy(effect->shadow);
+    } else if (effect->current.shadow) {
+        struct wsm_view *view = view_from_wlr_surface(effect->surface);
+        if (view && view->surface == effect->surface) {
+            view_update_shadow(view);
+        }
+    }
+
+    damage_all_outputs();
+}
+
+static void surface_effect_handle_set_region(struct wl_client *client,
+                                             struct wl_resource *resource, struct wl_resource *region_resource) {
+    struct wsm_surface_effect *effect = surface_effect_from_resource(resource);
+    if (!effect) {
+        return;
+    }
+
+    effect->pending.full_window_blur = false;
+    if (region_resource) {
+        const pixman_region32_t *region = wlr_region_from_resource(region_resource);
+        pixman_region32_copy(&effect->pending.blur_region, region);
+        effect->pending.blur = pixman_region32_not_empty(region);
+    } else {
+        pixman_region32_clear(&effect->pending.blur_region);
+        effect->pending.blur = false;
+    }
+}
+
+static void surface_effect_handle_set_fullwindowblur(struct wl_client *client,
+                                                     struct wl_resource *resource) {
+    struct wsm_surface_effect *effect = surface_effect_from_resource(resource);
+    if (!effect) {
+        return;
+    }
+
+    pixman_region32_clear(&effect->pending.blur_region);
+    effect->pending.full_window_blur = true;
+    effect->pending.blur = true;
+}
+
+static void surface_effect_handle_set_window_rounded_corner(struct wl_client *client,
+                                                            struct wl_resource *resource, wl_fixed_t radius, uint32_t flag) {
+    struct wsm_surface_effect *effect = surface_effect_from_resource(resource);
+    if (!effect) {
+        return;
+    }
+
+    double value = wl_fixed_to_double(radius);
+    effect->pending.corner_radius = value > 0 ? value : 0;
+    effect->pending.corner_flags = flag;
+}
+
+static float color_channel(int32_t value) {
+    return (value < 0 ? 0 : value > 255 ? 255 : value) / 255.0f;
+}
+
+static void surface_effect_handle_set_shadow_color(struct wl_client *client,
+                                                   struct wl_resource *resource, int32_t r, int32_t g, int32_t b) {
+    struct wsm_surface_effect *effect = surface_effect_from_resource(resource);
+    if (!effect) {
+        return;
+    }
+
+    effect->pending.shadow = true;
+    effect->pending.shadow_color[0] = color_channel(r);
+    effect->pending.shadow_color[1] = color_channel(g);
+    effect->pending.shadow_color[2] = color_channel(b);
+    effect->pending.shadow_color[3] = WSM_SHADOW_DEFAULT_ALPHA;
+}
+
+static void surface_effect_handle_set_border_color(struct wl_client *client,
+                                                   struct wl_resource *resource, int32_t r, int32_t g, int32_t b, int32_t a) {
+    wsm_log(WSM_DEBUG, "surface_effect.set_border_color is not supported");
+}
+
+static void surface_effect_handle_set_border_width(struct wl_client *client,
+                                                   struct wl_resource *resource, wl_fixed_t width) {
+    wsm_log(WSM_DEBUG, "surface_effect.set_border_width is not supported");
+}
+
+static void surface_effect_handle_set_clip_region(struct wl_client *client,
+                                                  struct wl_resource *resource, struct wl_resource *region_resource) {
+    struct wsm_surface_effect *effect = surface_effect_from_resource(resource);
+    if (!effect) {
+        return;
+    }
+
+    if (region_resource) {
+        pixman_region32_copy(&effect->pending.clip_region,
+                             wlr_region_from_resource(region_resource));
+        effect->pending.clip = true;
+    } else {
+        pixman_region32_clear(&effect->pending.clip_region);
+        effect->pending.clip = false;
+    }
+}
+
+static void surface_effect_handle_release(struct wl_client *client,
+                                          struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct surface_effect_interface surface_effect_impl = {
+    .commit = surface_effect_handle_commit,
+    .set_region = surface_effect_handle_set_region,
+    .set_fullwindowblur = surface_effect_handle_set_fullwindowblur,
+    .set_window_rounded_corner = surface_effect_handle_set_window_rounded_corner,
+    .set_shadow_color = surface_effect_handle_set_shadow_color,
+    .set_border_color = surface_effect_handle_set_border_color,
+    .set_border_width = surface_effect_handle_set_border_width,
+    .set_clip_region = surface_effect_handle_set_clip_region,
+    .release = surface_effect_handle_release,
+};
+
+static void surface_effect_handle_resource_destroy(struct wl_resource *resource) {
+    struct wsm_surface_effect *effect = wl_resource_get_user_data(resource);
+    if (effect) {
+        effect->resource = NULL;
+        surface_effect_destroy(effect);
+    }
+}
+
+static void effects_manager_handle_create(struct wl_client *client,
+                                          struct wl_resource *resource, uint32_t id, struct wl_resource *surface_resource) {
+    struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+    struct wl_resource *effect_resource = wl_resource_create(client,
+                                                             &surface_effect_interface, wl_resource_get_version(resource), id);
+    if (!effect_resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(effect_resource, &surface_effect_impl,
+                                   NULL, surface_effect_handle_resource_destroy);
+
+    // A new object replaces the previous one of this surface
+    struct wsm_surface_effect *old = wsm_surface_effect_from_surface(surface);
+    if (old) {
+        surface_effect_destroy(old);
+    }
+
+    struct wsm_surface_effect *effect = calloc(1, sizeof(struct wsm_surface_effect));
+    if (!wsm_assert(effect, "Could not create wsm_surface_effect: allocation failed!")) {
+        wl_resource_post_no_memory(resource);
+        return;
+    }
+    effect->resource = effect_resource;
+    effect->surface = surface;
+    effect_state_init(&effect->pending);
+    effect_state_init(&effect->current);
+    pixman_region32_init(&effect->content_damage);
+    wlr_addon_init(&effect->addon, &surface->addons, effects_manager, &surface_addon_impl);
+
+    effect->surface_commit.notify = handle_surface_commit;
+    wl_signal_add(&surface->events.commit, &effect->surface_commit);
+
+    wl_resource_set_user_data(effect_resource, effect);
+}
+
+static void effects_manager_handle_unset(struct wl_client *client,
+                                         struct wl_resource *resource, struct wl_resource *surface_resource) {
+    struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+    surface_effect_destroy(wsm_surface_effect_from_surface(surface));
+}
+
+static const struct effects_manager_interface effects_manager_impl = {
+    .create = effects_manager_handle_create,
+    .unset = effects_manager_handle_unset,
+};
+
+static void effects_manager_bind(struct wl_client *client, void *data,
+                                 uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client,
+                                                      &effects_manager_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &effects_manager_impl, data, NULL);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+    struct wsm_effects_manager *manager =
+        wl_container_of(listener, manager, display_destroy);
+    wl_list_remove(&manager->display_destroy.link);
+    wl_global_destroy(manager->global);
+    effects_manager = NULL;
+    free(manager);
+}
+
+struct wsm_effects_manager *wsm_effects_manager_create(const struct wsm_server *server) {
+    struct wsm_effects_manager *manager = calloc(1, sizeof(struct wsm_effects_manager));
+    if (!wsm_assert(manager, "Could not create wsm_effects_manager: allocation failed!")) {
+        return NULL;
+    }
+
+    manager->global = wl_global_create(server->wl_display, &effects_manager_interface,
+                                       EFFECTS_MANAGER_VERSION, manager, effects_manager_bind);
+    if (!manager->global) {
+        free(manager);
+        return NULL;
+    }
+
+    manager->display_destroy.notify = handle_display_destroy;
+    wl_display_add_destroy_listener(server->wl_display, &manager->display_destroy);
+    effects_manager = manager;
+    return manager;
+}
+
+struct wsm_surface_effect *wsm_surface_effect_from_surface(struct wlr_surface *surface) {
+    if (!effects_manager) {
+        return NULL;
+    }
+    struct wlr_addon *addon = wlr_addon_find(&surface->addons, effects_manager,
+                                             &surface_addon_impl);
+    if (!addon) {
+        return NULL;
+    }
+    struct wsm_surface_effect *effect = wl_container_of(addon, effect, addon);
+    return effect;
+}
+
+bool wsm_surface_effects_active(void) {
+    return effects_manager && effects_manager->active_effects > 0;
+}
+
+bool wsm_surface_effect_is_active(struct wsm_surface_effect *effect) {
+    return effect && effect_state_active(&effect->current);
+}
+
+bool wsm_surface_effect_has_blur(struct wsm_surface_effect *effect) {
+    return effect && effect->current.blur;
+}
+
+void wsm_surface_effect_get_blur_region(struct wsm_surface_effect *effect,
+                                        pixman_region32_t *region) {
+    if (effect->current.full_window_blur) {
+        pixman_region32_fini(region);
+        pixman_region32_init_rect(region, 0, 0,
+                                  effect->surface->current.width, effect->surface->current.height);
+        return;
+    }
+    pixman_region32_intersect_rect(region, &effect->current.blur_region, 0, 0,
+                                   effect->surface->current.width, effect->surface->current.height);
+}
+
+bool wsm_surface_effect_has_shape(struct wsm_surface_effect *effect) {
+    return effect && (effect->current.clip || effect_state_has_corners(&effect->current));
+}
+
+bool wsm_surface_effect_get_corners(struct wsm_surface_effect *effect,
+                                    float *radius, uint32_t *flags) {
+    if (!effect_state_has_corners(&effect->current)) {
+        return false;
+    }
+    *radius = effect->current.corner_radius;
+    *flags = effect->current.corner_flags;
+    return true;
+}
+
+bool wsm_surface_effect_get_clip_region(struct wsm_surface_effect *effect,
+                                        pixman_region32_t *region) {
+    if (!effect->current.clip) {
+        return false;
+    }
+    pixman_region32_copy(region, &effect->current.clip_region);
+    return true;
+}
+
+void wsm_surface_effect_cut_opaque(struct wsm_surface_effect *effect,
+                                   pixman_region32_t *region) {
+    struct wlr_surface *surface = effect->surface;
+    if (effect->current.clip) {
+        pixman_region32_intersect(region, region, &effect->current.clip_region);
+    }
+    if (effect_state_has_corners(&effect->current)) {
+        wsm_corner_subtract_opaque(effect->current.corner_radius, effect->current.corner_flags,
+                                   surface->current.width, surface->current.height, region);
+    }
+}
+
+static float outputs_max_scale(void) {
+    float scale = 1.0f;
+    struct wsm_scene *root = global_server.wsm_scene;
+    for (int i = 0; i < root->outputs->length; i++) {
+        struct wsm_output *output = root->outputs->items[i];
+        if (output->wlr_output->scale > scale) {
+            scale = output->wlr_output->scale;
+        }
+    }
+    return scale;
+}
+
+void wsm_surface_effect_update_shadow(struct wlr_surface *surface,
+                                      struct wlr_scene_tree *parent, const struct wlr_box *box) {
+    struct wsm_surface_effect *effect = wsm_surface_effect_from_surface(surface);
+    if (!effect || !effect->current.shadow) {
+        return;
+    }
+
+    struct wsm_shadow_params params = {
+        .radius = WSM_SHADOW_DEFAULT_RADIUS,
+        .spread = WSM_SHADOW_DEFAULT_SPREAD,
+        .scale = outputs_max_scale(),
+    };
+    memcpy(params.color, effect->current.shadow_color, sizeof(params.color));
+
+    if (effect->shadow && effect->shadow->tree->node.parent != parent) {
+        wsm_shadow_destroy(effect->shadow);
+    }
+    if (!effect->shadow) {
+        effect->shadow = wsm_shadow_create(parent, &params);
+        if (!effect->shadow) {
+            return;
+        }
+        effect->shadow_destroy.notify = handle_shadow_destroy;
+        wl_signal_add(&effect->shadow->tree->node.events.destroy, &effect->shadow_destroy);
+    } else {
+        wsm_shadow_set_params(effect->shadow, &params);
+    }
+    wsm_shadow_set_box(effect->shadow, box);
+}
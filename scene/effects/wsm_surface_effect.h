@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_SURFACE_EFFECT_H
+#define WSM_SURFACE_EFFECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pixman.h>
+#include <wayland-server-core.h>
+
+#include <wlr/util/addon.h>
+
+struct wlr_box;
+struct wlr_surface;
+struct wlr_scene_tree;
+struct wsm_server;
+struct wsm_shadow;
+
+/**
+ * @brief double-buffered effect settings of one surface.
+ *
+ * @details applied on surface_effect.commit, regions are in surface
+ * local coordinates.
+ */
+struct wsm_surface_effect_state {
+    bool blur;
+    bool full_window_blur;
+    pixman_region32_t blur_region;
+
+    float corner_radius;
+    uint32_t corner_flags; // enum surface_effect_rounded_corners_flag
+
+    bool clip;
+    pixman_region32_t clip_region;
+
+    bool shadow;
+    float shadow_color[4];
+};
+
+/**
+ * @brief server side of the surface_effect interface of wsm-effects.xml.
+ */
+struct wsm_surface_effect {
+    struct wl_resource *resource;
+    struct wlr_surface *surface;
+    struct wlr_addon addon;
+
+    struct wsm_surface_effect_state pending;
+    struct wsm_surface_effect_state current;
+
+    // Surface damage of the latest commit. Effects sampling what is below
+    // the surface use it to tell the surface's own updates apart from
+    // changes underneath.
+    pixman_region32_t content_damage;
+
+    struct wsm_shadow *shadow;
+
+    struct wl_listener surface_commit;
+    struct wl_listener shadow_destroy;
+};
+
+struct wsm_effects_manager {
+    struct wl_global *global;
+    struct wl_listener display_destroy;
+
+    // Number of surfaces with an effect, the renderer skips all effect
+    // lookups while it is zero.
+    int active_effects;
+};
+
+struct wsm_effects_manager *wsm_effects_manager_create(const struct wsm_server *server);
+struct wsm_surface_effect *wsm_surface_effect_from_surface(struct wlr_surface *surface);
+/**
+ * @brief whether any surface has an effect applied.
+ */
+bool wsm_surface_effects_active(void);
+bool wsm_surface_effect_is_active(struct wsm_surface_effect *effect);
+bool wsm_surface_effect_has_blur(struct wsm_surface_effect *effect);
+/**
+ * @brief whether the surface is clipped or has rounded corners.
+ */
+bool wsm_surface_effect_has_shape(struct wsm_surface_effect *effect);
+/**
+ * @brief blur region of the surface, in surface local coordinates.
+ */
+void wsm_surface_effect_get_blur_region(struct wsm_surface_effect *effect,
+                                        pixman_region32_t *region);
+/**
+ * @brief rounded corners of the surface, false if it has none.
+ */
+bool wsm_surface_effect_get_corners(struct wsm_surface_effect *effect,
+                                    float *radius, uint32_t *flags);
+/**
+ * @brief region the surface is clipped to, false if it is not clipped.
+ */
+bool wsm_surface_effect_get_clip_region(struct wsm_surface_effect *effect,
+                                        pixman_region32_t *region);
+/**
+ * @brief place the shadow of @p surface around @p box in @p parent.
+ *
+ * @details does nothing if the surface has no shadow. The shadow is put at
+ * the bottom of @p parent, @p box is in @p parent coordinates.
+ */
+void wsm_surface_effect_update_shadow(struct wlr_surface *surface,
+                                      struct wlr_scene_tree *parent, const struct wlr_box *box);
+/**
+ * @brief remove what clipping and rounding hide from the opaque
+ * @p region, in surface local coordinates.
+ */
+void wsm_surface_effect_cut_opaque(struct wsm_surface_effect *effect,
+                                   pixman_region32_t *region);
+
+#endif
@@ -29,6 +29,7 @@ THE SOFTWARE.
 #include "wsm_output.h"
 #include "wsm_workspace.h"
 #include "wsm_container.h"
+#include "wsm_node_descriptor.h"
 
 #include <wlr/types/wlr_scene.h>
 
@@ -55,6 +56,11 @@ const char *node_type_to_str(enum wsm_node_type type) {
 }
 
 void node_set_dirty(struct wsm_node *node) {
+    node_set_dirty_changes(node, WSM_NODE_CHANGE_ALL);
+}
+
+void node_set_dirty_changes(struct wsm_node *node, uint32_t changes) {
+    node->dirty_changes |= changes;
     if (node->dirty) {
         return;
     }
@@ -173,7 +179,7 @@ void scene_node_disown_children(struct wlr_scene_tree *tree) {
 
     struct wlr_scene_node *child, *tmp_child;
     wl_list_for_each_safe(child, tmp_child, &tree->children, link) {
-        wlr_scene_node_reparent(child, global_server.wsm_scene->staging);
+        wsm_scene_node_reparent(child, global_server.wsm_scene->staging);
     }
 }
 
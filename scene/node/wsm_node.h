@@ -29,6 +29,7 @@ THE SOFTWARE.
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <wayland-server-core.h>
 
@@ -48,6 +49,18 @@ enum wsm_node_type {
     N_CONTAINER,
 };
 
+/**
+ * @brief parts of a node's pending state that differ from the committed one
+ */
+enum wsm_node_change {
+    WSM_NODE_CHANGE_GEOMETRY = 1 << 0,
+    WSM_NODE_CHANGE_CHILDREN = 1 << 1, // children, workspaces or their order
+    WSM_NODE_CHANGE_FOCUS = 1 << 2,
+    WSM_NODE_CHANGE_BORDER = 1 << 3,
+    WSM_NODE_CHANGE_FULLSCREEN = 1 << 4,
+    WSM_NODE_CHANGE_ALL = (1 << 5) - 1,
+};
+
 struct wsm_node {
     enum wsm_node_type type;
     union {
@@ -60,8 +73,13 @@ struct wsm_node {
     size_t id;
     size_t ntxnrefs;
     struct wsm_transaction_instruction *instruction;
+    // Generation of the last transaction the node was added to, and its
+    // instruction there
+    uint64_t txn_generation;
+    struct wsm_transaction_instruction *txn_instruction;
     bool destroying;
     bool dirty;
+    uint32_t dirty_changes; // enum wsm_node_change, since the last commit
 
     struct {
         struct wl_signal destroy;
@@ -71,6 +89,14 @@ struct wsm_node {
 void node_init(struct wsm_node *node, enum wsm_node_type type, void *thing);
 const char *node_type_to_str(enum wsm_node_type type);
 void node_set_dirty(struct wsm_node *node);
+/**
+ * @brief queue @p node for the next transaction, only copying @p changes.
+ *
+ * @details node_set_dirty() marks every part as changed. Parts that are
+ * not marked keep their committed state, so @p changes has to cover
+ * everything that was modified.
+ */
+void node_set_dirty_changes(struct wsm_node *node, uint32_t changes);
 bool node_is_view(struct wsm_node *node);
 char *node_get_name(struct wsm_node *node);
 void node_get_box(struct wsm_node *node, struct wlr_box *box);
@@ -29,62 +29,94 @@ THE SOFTWARE.
 
 #include <wlr/types/wlr_scene.h>
 
-struct scene_descriptor {
-    void *data;
+// All descriptors of a node, found through the node's data field instead
+// of a scan of its addons. The addon only ties the table to the node's
+// lifetime.
+struct scene_descriptor_table {
+    uint32_t mask;
+    void *data[WSM_SCENE_DESC_COUNT];
     struct wlr_addon addon;
 };
 
-static void descriptor_destroy(struct scene_descriptor *desc) {
-    wlr_addon_finish(&desc->addon);
-    free(desc);
-}
-
 static void addon_handle_destroy(struct wlr_addon *addon) {
-    struct scene_descriptor *desc = wl_container_of(addon, desc, addon);
-    descriptor_destroy(desc);
+    struct scene_descriptor_table *table = wl_container_of(addon, table, addon);
+    wlr_addon_finish(&table->addon);
+    free(table);
 }
 
+// Starts above the zero of freshly allocated caches
+static uint64_t view_generation = 1;
+
 static const struct wlr_addon_interface addon_interface = {
     .name = "wsm_scene_descriptor",
     .destroy = addon_handle_destroy,
 };
 
-static struct scene_descriptor *scene_node_get_descriptor(
-    struct wlr_scene_node *node, enum wsm_scene_descriptor_type type) {
-    struct wlr_addon *addon = wlr_addon_find(&node->addons, (void *)type, &addon_interface);
-    if (!addon) {
-        return NULL;
-    }
-
-    struct scene_descriptor *desc = wl_container_of(addon, desc, addon);
-    return desc;
+static struct scene_descriptor_table *scene_node_get_table(struct wlr_scene_node *node) {
+    return node->data;
 }
 
 bool wsm_scene_descriptor_assign(struct wlr_scene_node *node,
                                  enum wsm_scene_descriptor_type type, void *data) {
-    struct scene_descriptor *desc = calloc(1, sizeof(*desc));
-    if (!desc) {
-        wsm_log(WSM_ERROR, "Could not allocate a scene descriptor");
-        return false;
+    struct scene_descriptor_table *table = scene_node_get_table(node);
+    if (!table) {
+        table = calloc(1, sizeof(*table));
+        if (!table) {
+            wsm_log(WSM_ERROR, "Could not allocate a scene descriptor");
+            return false;
+        }
+        wlr_addon_init(&table->addon, &node->addons, NULL, &addon_interface);
+        node->data = table;
     }
 
-    wlr_addon_init(&desc->addon, &node->addons, (void *)type, &addon_interface);
-    desc->data = data;
+    table->mask |= WSM_SCENE_DESC_BIT(type);
+    table->data[type] = data;
+    if (type == WSM_SCENE_DESC_VIEW) {
+        view_generation++;
+    }
     return true;
 }
 
 void *wsm_scene_descriptor_try_get(struct wlr_scene_node *node,
                                    enum wsm_scene_descriptor_type type) {
-    struct scene_descriptor *desc = scene_node_get_descriptor(node, type);
-    if (!desc) {
+    struct scene_descriptor_table *table = scene_node_get_table(node);
+    if (!table || !(table->mask & WSM_SCENE_DESC_BIT(type))) {
         return NULL;
     }
 
-    return desc->data;
+    return table->data[type];
 }
 
 void wsm_scene_descriptor_destroy(struct wlr_scene_node *node,
                                   enum wsm_scene_descriptor_type type) {
-    struct scene_descriptor *desc = scene_node_get_descriptor(node, type);
-    descriptor_destroy(desc);
+    struct scene_descriptor_table *table = scene_node_get_table(node);
+    if (!table) {
+        return;
+    }
+
+    table->mask &= ~WSM_SCENE_DESC_BIT(type);
+    table->data[type] = NULL;
+    if (type == WSM_SCENE_DESC_VIEW) {
+        view_generation++;
+    }
+}
+
+uint32_t wsm_scene_descriptor_mask(struct wlr_scene_node *node) {
+    struct scene_descriptor_table *table = scene_node_get_table(node);
+    return table ? table->mask : 0;
+}
+
+uint64_t wsm_scene_view_generation(void) {
+    return view_generation;
+}
+
+void wsm_scene_node_reparent(struct wlr_scene_node *node, struct wlr_scene_tree *new_parent) {
+    // Buffers below a view or a container find the same view wherever
+    // the node goes, views are never nested inside of other views
+    uint32_t keeps_view = WSM_SCENE_DESC_BIT(WSM_SCENE_DESC_VIEW) |
+                          WSM_SCENE_DESC_BIT(WSM_SCENE_DESC_CONTAINER);
+    if (node->parent != new_parent && !(wsm_scene_descriptor_mask(node) & keeps_view)) {
+        view_generation++;
+    }
+    wlr_scene_node_reparent(node, new_parent);
 }
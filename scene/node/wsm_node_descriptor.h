@@ -25,14 +25,17 @@ THE SOFTWARE.
 #ifndef WSM_NODE_DESCRIPTOR_H
 #define WSM_NODE_DESCRIPTOR_H
 
+#include <stdint.h>
+
 #include <wayland-server-core.h>
 
 struct wlr_scene_node;
+struct wlr_scene_tree;
 
 struct wsm_view;
 
 enum wsm_scene_descriptor_type {
-    WSM_SCENE_DESC_BUFFER_TIMER,
+    WSM_SCENE_DESC_BUFFER_FRAME,
     WSM_SCENE_DESC_NON_INTERACTIVE,
     WSM_SCENE_DESC_CONTAINER,
     WSM_SCENE_DESC_VIEW,
@@ -40,8 +43,20 @@ enum wsm_scene_descriptor_type {
     WSM_SCENE_DESC_XWAYLAND_UNMANAGED,
     WSM_SCENE_DESC_POPUP,
     WSM_SCENE_DESC_DRAG_ICON,
+    WSM_SCENE_DESC_LAYER_CACHE,
+    WSM_SCENE_DESC_EFFECT_WINDOW,
+    WSM_SCENE_DESC_ANIMATION,
+    WSM_SCENE_DESC_COUNT,
 };
 
+#define WSM_SCENE_DESC_BIT(type) (1u << (type))
+
+/**
+ * @brief attach @p data to @p node as its descriptor of @p type.
+ *
+ * @details descriptors are kept in one table per node, pointed to by the
+ * node's data field. Other code must not use wlr_scene_node.data.
+ */
 bool wsm_scene_descriptor_assign(struct wlr_scene_node *node,
                              enum wsm_scene_descriptor_type type, void *data);
 
@@ -51,4 +66,24 @@ void *wsm_scene_descriptor_try_get(struct wlr_scene_node *node,
 void wsm_scene_descriptor_destroy(struct wlr_scene_node *node,
                               enum wsm_scene_descriptor_type type);
 
+/**
+ * @brief WSM_SCENE_DESC_BIT() of every descriptor assigned to @p node.
+ */
+uint32_t wsm_scene_descriptor_mask(struct wlr_scene_node *node);
+
+/**
+ * @brief changes whenever a scene buffer may have moved to another view.
+ *
+ * @details bumped when a view descriptor is assigned or destroyed, and
+ * when a node carrying neither a view nor a container is reparented
+ * through wsm_scene_node_reparent().
+ */
+uint64_t wsm_scene_view_generation(void);
+
+/**
+ * @brief wlr_scene_node_reparent() keeping wsm_scene_view_generation() up
+ * to date, to be used for every reparent.
+ */
+void wsm_scene_node_reparent(struct wlr_scene_node *node, struct wlr_scene_tree *new_parent);
+
 #endif
@@ -85,6 +85,8 @@ struct text_buffer {
     struct wl_listener destroy;
 };
 
+static struct wsm_text_node_stats text_stats = {0};
+
 static int get_text_width(struct wsm_text_node *props) {
     int width = props->width;
     if (props->max_width >= 0) {
@@ -115,6 +117,7 @@ static void render_backing_buffer(struct text_buffer *buffer) {
         return;
     }
 
+    text_stats.misses++;
     float scale = buffer->scale;
     int width = ceil(buffer->props.width * scale);
     int height = ceil(buffer->props.height * scale);
@@ -278,6 +281,7 @@ struct wsm_text_node *wsm_text_node_create(struct wlr_scene_tree *parent, const
         return NULL;
     }
 
+    wsm_desktop_interface_wait_fonts(global_server.desktop_interface);
     buffer->props.height = font->font_height;
     buffer->props.pango_markup = pango_markup;
     memcpy(&buffer->props.color, color, sizeof(*color) * 4);
@@ -306,6 +310,7 @@ void wsm_text_node_set_color(struct wsm_text_node *node, float color[4]) {
 void wsm_text_node_set_text(struct wsm_text_node *node, char *text) {
     struct text_buffer *buffer = wl_container_of(node, buffer, props);
     if (strcmp(buffer->text, text) == 0) {
+        text_stats.hits++;
         return;
     }
 
@@ -324,6 +329,7 @@ void wsm_text_node_set_text(struct wsm_text_node *node, char *text) {
 void wsm_text_node_set_max_width(struct wsm_text_node *node, int max_width) {
     struct text_buffer *buffer = wl_container_of(node, buffer, props);
     if (max_width == buffer->props.max_width) {
+        text_stats.hits++;
         return;
     }
     buffer->props.max_width = max_width;
@@ -336,8 +342,13 @@ void wsm_text_node_set_max_width(struct wsm_text_node *node, int max_width) {
 void wsm_text_node_set_background(struct wsm_text_node *node, float background[4]) {
     struct text_buffer *buffer = wl_container_of(node, buffer, props);
     if (memcmp(&node->background, background, sizeof(*background) * 4) == 0) {
+        text_stats.hits++;
         return;
     }
     memcpy(&node->background, background, sizeof(*background) * 4);
     render_backing_buffer(buffer);
 }
+
+const struct wsm_text_node_stats *wsm_text_node_get_stats(void) {
+    return &text_stats;
+}
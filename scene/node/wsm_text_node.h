@@ -26,6 +26,7 @@ THE SOFTWARE.
 #define WSM_TEXT_NODE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct wlr_scene_node;
 struct wlr_scene_tree;
@@ -44,11 +45,20 @@ struct wsm_text_node {
     struct wlr_scene_node *node;
 };
 
+/**
+ * @brief hits are updates that left the text unchanged, misses re-rendered it.
+ */
+struct wsm_text_node_stats {
+    uint64_t hits;
+    uint64_t misses;
+};
+
 struct wsm_text_node *wsm_text_node_create(struct wlr_scene_tree *parent, const struct wsm_desktop_interface *font,
                                              char *text, float color[4], bool pango_markup);
 void wsm_text_node_set_color(struct wsm_text_node *node, float color[4]);
 void wsm_text_node_set_text(struct wsm_text_node *node, char *text);
 void wsm_text_node_set_max_width(struct wsm_text_node *node, int max_width);
 void wsm_text_node_set_background(struct wsm_text_node *node, float background[4]);
+const struct wsm_text_node_stats *wsm_text_node_get_stats(void);
 
 #endif
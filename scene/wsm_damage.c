@@ -0,0 +1,162 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_damage.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Pixman sorts rectangles in bands, neighbours in the array are the
+// ones worth merging
+#define MERGE_WINDOW 8
+// Merging can leave overlapping boxes which pixman splits again
+#define MERGE_ROUNDS 3
+
+static struct wsm_damage_stats damage_stats = {0};
+
+static int64_t box_area(const pixman_box32_t *box) {
+    return (int64_t)(box->x2 - box->x1) * (box->y2 - box->y1);
+}
+
+static pixman_box32_t box_union(const pixman_box32_t *a, const pixman_box32_t *b) {
+    return (pixman_box32_t){
+        .x1 = a->x1 < b->x1 ? a->x1 : b->x1,
+        .y1 = a->y1 < b->y1 ? a->y1 : b->y1,
+        .x2 = a->x2 > b->x2 ? a->x2 : b->x2,
+        .y2 = a->y2 > b->y2 ? a->y2 : b->y2,
+    };
+}
+
+// Area the bounding box of both boxes adds, negative if merged boxes
+// overlap
+static int64_t merge_waste(const pixman_box32_t *a, const pixman_box32_t *b,
+                           pixman_box32_t *merged) {
+    *merged = box_union(a, b);
+    return box_area(merged) - box_area(a) - box_area(b);
+}
+
+// Find the cheapest merge among neighbours, returns false if there is none
+// allowed by @max_waste (negative for any)
+static bool find_merge(pixman_box32_t *boxes, int len, float max_waste, int *first, int *second) {
+    bool found = false;
+    int64_t best = 0;
+    for (int i = 0; i < len; i++) {
+        for (int j = i + 1; j < len && j <= i + MERGE_WINDOW; j++) {
+            pixman_box32_t merged;
+            int64_t waste = merge_waste(&boxes[i], &boxes[j], &merged);
+            if (max_waste >= 0 && waste > max_waste * box_area(&merged)) {
+                continue;
+            }
+            if (!found || waste < best) {
+                found = true;
+                best = waste;
+                *first = i;
+                *second = j;
+            }
+        }
+    }
+    return found;
+}
+
+static int merge_boxes(pixman_box32_t *boxes, int len, int max_rects, float waste) {
+    int first, second;
+    while (len > 1) {
+        bool over_budget = len > max_rects;
+        if (!find_merge(boxes, len, over_budget ? -1 : waste, &first, &second)) {
+            break;
+        }
+        boxes[first] = box_union(&boxes[first], &boxes[second]);
+        boxes[second] = boxes[--len];
+    }
+    return len;
+}
+
+// Only grows, simplifying runs on every frame of every output
+static pixman_box32_t *scratch_boxes = NULL;
+static int scratch_capacity = 0;
+
+static bool reserve_boxes(int len) {
+    if (len <= scratch_capacity) {
+        return true;
+    }
+    pixman_box32_t *boxes = realloc(scratch_boxes, len * sizeof(pixman_box32_t));
+    if (!boxes) {
+        return false;
+    }
+    scratch_boxes = boxes;
+    scratch_capacity = len;
+    return true;
+}
+
+void wsm_damage_simplify(pixman_region32_t *region, int max_rects, float waste) {
+    int len = pixman_region32_n_rects(region);
+    damage_stats.regions++;
+    damage_stats.rects_before += len;
+    if (len > damage_stats.max_rects_before) {
+        damage_stats.max_rects_before = len;
+    }
+
+    if (max_rects <= 0 || len <= max_rects) {
+        damage_stats.rects_after += len;
+        return;
+    }
+    damage_stats.simplified++;
+
+    if (!reserve_boxes(len)) {
+        // Still within the damage, just not simplified as much
+        pixman_box32_t extents = *pixman_region32_extents(region);
+        pixman_region32_fini(region);
+        pixman_region32_init_with_extents(region, &extents);
+        damage_stats.rects_after += 1;
+        return;
+    }
+
+    for (int round = 0; round < MERGE_ROUNDS && len > max_rects; round++) {
+        int rects_len;
+        pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+        if (!reserve_boxes(rects_len)) {
+            break;
+        }
+        for (int i = 0; i < rects_len; i++) {
+            scratch_boxes[i] = rects[i];
+        }
+        len = merge_boxes(scratch_boxes, rects_len, max_rects, waste);
+
+        pixman_region32_fini(region);
+        pixman_region32_init_rects(region, scratch_boxes, len);
+        len = pixman_region32_n_rects(region);
+    }
+
+    if (len > max_rects) {
+        pixman_box32_t extents = *pixman_region32_extents(region);
+        pixman_region32_fini(region);
+        pixman_region32_init_with_extents(region, &extents);
+        len = 1;
+    }
+    damage_stats.rects_after += len;
+}
+
+const struct wsm_damage_stats *wsm_damage_get_stats(void) {
+    return &damage_stats;
+}
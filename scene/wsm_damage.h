@@ -0,0 +1,55 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_DAMAGE_H
+#define WSM_DAMAGE_H
+
+#include <stdint.h>
+
+#include <pixman.h>
+
+/**
+ * @brief rectangle counts of the damage seen by wsm_damage_simplify().
+ */
+struct wsm_damage_stats {
+    uint64_t regions;
+    uint64_t simplified; // regions over budget
+    uint64_t rects_before;
+    uint64_t rects_after;
+    int max_rects_before; // largest region seen
+};
+
+/**
+ * @brief merge @p region into at most @p max_rects rectangles.
+ *
+ * @details rectangles close to each other are replaced by their bounding
+ * box. Merges wasting at most @p waste of the merged area are always done,
+ * more wasteful ones only while the region is over budget. The region can
+ * only grow, so it stays valid as damage. A @p max_rects of 0 only records
+ * the statistics.
+ */
+void wsm_damage_simplify(pixman_region32_t *region, int max_rects, float waste);
+const struct wsm_damage_stats *wsm_damage_get_stats(void);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_frame_arena.h"
+#include "wsm_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <wlr/util/addon.h>
+#include <wlr/types/wlr_output.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+struct wsm_frame_arena {
+    struct wlr_addon addon;
+
+    struct arena_chunk *chunks; // the current chunk first
+    size_t frame_size; // bytes handed out this frame
+
+    pixman_region32_t **regions;
+    int regions_len; // initialized regions
+    int regions_capacity;
+    int regions_used;
+};
+
+static struct arena_chunk *arena_chunk_create(size_t size, struct arena_chunk *next) {
+    struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk) + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = next;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void arena_free_chunks(struct arena_chunk *chunk) {
+    while (chunk) {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+static void frame_arena_destroy(struct wsm_frame_arena *arena) {
+    arena_free_chunks(arena->chunks);
+    for (int i = 0; i < arena->regions_len; i++) {
+        pixman_region32_fini(arena->regions[i]);
+        free(arena->regions[i]);
+    }
+    free(arena->regions);
+    wlr_addon_finish(&arena->addon);
+    free(arena);
+}
+
+static void output_addon_destroy(struct wlr_addon *addon) {
+    struct wsm_frame_arena *arena = wl_container_of(addon, arena, addon);
+    frame_arena_destroy(arena);
+}
+
+static const struct wlr_addon_interface output_addon_impl = {
+    .name = "wsm_frame_arena",
+    .destroy = output_addon_destroy,
+};
+
+struct wsm_frame_arena *wsm_frame_arena_get(struct wlr_output *output) {
+    struct wlr_addon *addon = wlr_addon_find(&output->addons, &output_addon_impl,
+                                             &output_addon_impl);
+    if (addon) {
+        struct wsm_frame_arena *arena = wl_container_of(addon, arena, addon);
+        return arena;
+    }
+
+    struct wsm_frame_arena *arena = calloc(1, sizeof(struct wsm_frame_arena));
+    if (!wsm_assert(arena, "Could not create wsm_frame_arena: allocation failed!")) {
+        return NULL;
+    }
+    wlr_addon_init(&arena->addon, &output->addons, &output_addon_impl, &output_addon_impl);
+    return arena;
+}
+
+void wsm_frame_arena_reset(struct wsm_frame_arena *arena) {
+    // A frame that did not fit in one chunk gets a chunk holding all of it
+    if (arena->chunks && arena->chunks->next) {
+        struct arena_chunk *chunk = arena_chunk_create(arena->frame_size, NULL);
+        if (chunk) {
+            arena_free_chunks(arena->chunks);
+            arena->chunks = chunk;
+        }
+    }
+    for (struct arena_chunk *chunk = arena->chunks; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    arena->frame_size = 0;
+    arena->regions_used = 0;
+}
+
+void *wsm_frame_arena_alloc(struct wsm_frame_arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    struct arena_chunk *chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = arena_chunk_create(size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE,
+                                   arena->chunks);
+        if (!wsm_assert(chunk, "Could not grow wsm_frame_arena: allocation failed!")) {
+            return NULL;
+        }
+        arena->chunks = chunk;
+    }
+
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->frame_size += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+pixman_region32_t *wsm_frame_arena_region(struct wsm_frame_arena *arena) {
+    if (arena->regions_used < arena->regions_len) {
+        return arena->regions[arena->regions_used++];
+    }
+
+    if (arena->regions_len == arena->regions_capacity) {
+        int capacity = arena->regions_capacity ? arena->regions_capacity * 2 : 16;
+        pixman_region32_t **regions = realloc(arena->regions, capacity * sizeof(*regions));
+        if (!wsm_assert(regions, "Could not grow wsm_frame_arena regions: allocation failed!")) {
+            return NULL;
+        }
+        arena->regions = regions;
+        arena->regions_capacity = capacity;
+    }
+
+    // Regions are allocated one by one, pointers handed out stay valid
+    pixman_region32_t *region = malloc(sizeof(pixman_region32_t));
+    if (!wsm_assert(region, "Could not create arena region: allocation failed!")) {
+        return NULL;
+    }
+    pixman_region32_init(region);
+    arena->regions[arena->regions_len++] = region;
+    arena->regions_used++;
+    return region;
+}
+
+void wsm_frame_arena_save(struct wsm_frame_arena *arena, struct wsm_frame_arena_mark *mark) {
+    mark->chunk = arena->chunks;
+    mark->used = arena->chunks ? arena->chunks->used : 0;
+    mark->regions_used = arena->regions_used;
+}
+
+void wsm_frame_arena_restore(struct wsm_frame_arena *arena, const struct wsm_frame_arena_mark *mark) {
+    // Memory of chunks added since stays taken until the reset
+    if (arena->chunks && arena->chunks == mark->chunk) {
+        arena->chunks->used = mark->used;
+    }
+    arena->regions_used = mark->regions_used;
+}
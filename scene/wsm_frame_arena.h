@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_FRAME_ARENA_H
+#define WSM_FRAME_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pixman.h>
+
+struct wlr_output;
+
+struct wsm_frame_arena;
+
+struct wsm_frame_arena_mark {
+    void *chunk;
+    size_t used;
+    int regions_used;
+};
+
+/**
+ * @brief scratch memory of the frame being built for @p output.
+ *
+ * @details everything handed out is only valid until the next
+ * wsm_frame_arena_reset(). Memory is kept across frames, a repaint
+ * needing no more than the previous ones does not allocate.
+ */
+struct wsm_frame_arena *wsm_frame_arena_get(struct wlr_output *output);
+void wsm_frame_arena_reset(struct wsm_frame_arena *arena);
+/**
+ * @brief bump allocate @p size zeroed bytes.
+ */
+void *wsm_frame_arena_alloc(struct wsm_frame_arena *arena, size_t size);
+/**
+ * @brief region of the arena, with undefined contents.
+ *
+ * @details set it with an operation writing the whole region, like
+ * pixman_region32_copy(). Regions are only finished with the output, so
+ * the rectangle storage pixman allocated for one is kept for the
+ * following frames. pixman writes into that storage when a copy or an
+ * operation on other regions gives no more rectangles than it holds.
+ * Operations done in place allocate new storage. Results of one rectangle
+ * or none, like pixman_region32_clear() and pixman_region32_reset(), free
+ * it, as pixman keeps no storage for those.
+ */
+pixman_region32_t *wsm_frame_arena_region(struct wsm_frame_arena *arena);
+
+/**
+ * @brief hand what was taken since wsm_frame_arena_save() back to the arena.
+ *
+ * @details lets a function called for every node of the frame reuse the
+ * same scratch memory instead of growing the arena.
+ */
+void wsm_frame_arena_save(struct wsm_frame_arena *arena, struct wsm_frame_arena_mark *mark);
+void wsm_frame_arena_restore(struct wsm_frame_arena *arena, const struct wsm_frame_arena_mark *mark);
+
+/**
+ * @brief whether @p region is a single rectangle, its extents.
+ */
+static inline bool wsm_region_is_rect(const pixman_region32_t *region) {
+    return region->data == NULL;
+}
+
+/**
+ * @brief intersect @p region with a rectangle, skipping the generic pixman
+ * operation if @p region is a single rectangle.
+ *
+ * @details the result is then a single rectangle or empty, which frees the
+ * rectangle storage of @p dst just like the generic operation would.
+ */
+static inline void wsm_region_intersect_rect(pixman_region32_t *dst, pixman_region32_t *region,
+                                             int x, int y, int width, int height) {
+    if (!wsm_region_is_rect(region)) {
+        pixman_region32_intersect_rect(dst, region, x, y, width, height);
+        return;
+    }
+    pixman_box32_t box = {
+        .x1 = region->extents.x1 > x ? region->extents.x1 : x,
+        .y1 = region->extents.y1 > y ? region->extents.y1 : y,
+        .x2 = region->extents.x2 < x + width ? region->extents.x2 : x + width,
+        .y2 = region->extents.y2 < y + height ? region->extents.y2 : y + height,
+    };
+    if (box.x2 <= box.x1 || box.y2 <= box.y1) {
+        pixman_region32_clear(dst);
+        return;
+    }
+    pixman_region32_reset(dst, &box);
+}
+
+#endif
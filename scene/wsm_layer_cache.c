@@ -0,0 +1,273 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_layer_cache.h"
+#include "wsm_log.h"
+#include "node/wsm_node_descriptor.h"
+
+#include <stdlib.h>
+
+#include <drm_fourcc.h>
+
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_buffer.h>
+
+static struct wsm_layer_cache_stats layer_cache_stats = {0};
+static struct wl_list layer_cache_buffers = { // wsm_layer_cache_output::buffer_link
+    .prev = &layer_cache_buffers,
+    .next = &layer_cache_buffers,
+};
+static int layer_cache_buffer_count = 0;
+static uint64_t layer_cache_frame = 0;
+
+static void layer_cache_output_release(struct wsm_layer_cache_output *cache_output) {
+    if (cache_output->texture) {
+        wlr_texture_destroy(cache_output->texture);
+        cache_output->texture = NULL;
+    }
+    if (cache_output->buffer) {
+        wlr_buffer_drop(cache_output->buffer);
+        cache_output->buffer = NULL;
+        wl_list_remove(&cache_output->buffer_link);
+        layer_cache_buffer_count--;
+    }
+    cache_output->valid = false;
+}
+
+// Make room for one more buffer, false if every one is drawn this frame
+static bool layer_cache_evict(void) {
+    if (layer_cache_buffer_count < WSM_LAYER_CACHE_MAX_BUFFERS) {
+        return true;
+    }
+    struct wsm_layer_cache_output *oldest =
+        wl_container_of(layer_cache_buffers.prev, oldest, buffer_link);
+    if (oldest->last_frame == layer_cache_frame) {
+        return false;
+    }
+    layer_cache_output_release(oldest);
+    oldest->static_frames = 0;
+    return true;
+}
+
+static void layer_cache_output_destroy(struct wsm_layer_cache_output *cache_output) {
+    layer_cache_output_release(cache_output);
+    pixman_region32_fini(&cache_output->visible);
+    wl_list_remove(&cache_output->output_destroy.link);
+    wl_list_remove(&cache_output->link);
+    free(cache_output);
+}
+
+static void handle_output_destroy(struct wl_listener *listener, void *data) {
+    struct wsm_layer_cache_output *cache_output =
+        wl_container_of(listener, cache_output, output_destroy);
+    layer_cache_output_destroy(cache_output);
+}
+
+static void layer_cache_destroy(struct wsm_layer_cache *cache) {
+    struct wsm_layer_cache_output *cache_output, *tmp;
+    wl_list_for_each_safe(cache_output, tmp, &cache->outputs, link) {
+        layer_cache_output_destroy(cache_output);
+    }
+    wlr_addon_finish(&cache->addon);
+    free(cache);
+}
+
+static void tree_addon_destroy(struct wlr_addon *addon) {
+    // The descriptor table goes with the tree as well
+    struct wsm_layer_cache *cache = wl_container_of(addon, cache, addon);
+    layer_cache_destroy(cache);
+}
+
+static const struct wlr_addon_interface tree_addon_impl = {
+    .name = "wsm_layer_cache",
+    .destroy = tree_addon_destroy,
+};
+
+static struct wsm_layer_cache *layer_cache_from_node(struct wlr_scene_node *node) {
+    return wsm_scene_descriptor_try_get(node, WSM_SCENE_DESC_LAYER_CACHE);
+}
+
+void wsm_layer_cache_set_enabled(struct wlr_scene_tree *tree, bool enabled) {
+    struct wsm_layer_cache *cache = layer_cache_from_node(&tree->node);
+    if (!enabled) {
+        if (cache) {
+            wsm_scene_descriptor_destroy(&tree->node, WSM_SCENE_DESC_LAYER_CACHE);
+            layer_cache_destroy(cache);
+        }
+        return;
+    }
+    if (cache) {
+        return;
+    }
+
+    cache = calloc(1, sizeof(struct wsm_layer_cache));
+    if (!wsm_assert(cache, "Could not create wsm_layer_cache: allocation failed!")) {
+        return;
+    }
+    // Looked up through the descriptor table while building the render
+    // list, the addon only ties the cache to the tree
+    if (!wsm_scene_descriptor_assign(&tree->node, WSM_SCENE_DESC_LAYER_CACHE, cache)) {
+        free(cache);
+        return;
+    }
+    cache->tree = tree;
+    wl_list_init(&cache->outputs);
+    wlr_addon_init(&cache->addon, &tree->node.addons, &tree_addon_impl, &tree_addon_impl);
+}
+
+void wsm_layer_cache_set_bypassed(struct wlr_scene_tree *tree, bool bypassed) {
+    struct wsm_layer_cache *cache = layer_cache_from_node(&tree->node);
+    if (!cache || cache->bypassed == bypassed) {
+        return;
+    }
+    cache->bypassed = bypassed;
+
+    // Drawn afresh once the subtree settles again
+    struct wsm_layer_cache_output *cache_output;
+    wl_list_for_each(cache_output, &cache->outputs, link) {
+        wsm_layer_cache_output_invalidate(cache_output);
+    }
+}
+
+struct wsm_layer_cache *wsm_layer_cache_try_from_node(struct wlr_scene_node *node) {
+    struct wsm_layer_cache *cache = layer_cache_from_node(node);
+    return cache && !cache->bypassed ? cache : NULL;
+}
+
+void wsm_layer_caches_begin_frame(void) {
+    layer_cache_frame++;
+}
+
+struct wsm_layer_cache_output *wsm_layer_cache_get_output(struct wsm_layer_cache *cache,
+                                                          struct wlr_scene_output *scene_output) {
+    struct wsm_layer_cache_output *cache_output;
+    wl_list_for_each(cache_output, &cache->outputs, link) {
+        if (cache_output->scene_output == scene_output) {
+            return cache_output;
+        }
+    }
+
+    cache_output = calloc(1, sizeof(struct wsm_layer_cache_output));
+    if (!wsm_assert(cache_output, "Could not create wsm_layer_cache_output: allocation failed!")) {
+        return NULL;
+    }
+    cache_output->cache = cache;
+    cache_output->scene_output = scene_output;
+    pixman_region32_init(&cache_output->visible);
+    cache_output->output_destroy.notify = handle_output_destroy;
+    wl_signal_add(&scene_output->events.destroy, &cache_output->output_destroy);
+    wl_list_insert(&cache->outputs, &cache_output->link);
+    return cache_output;
+}
+
+bool wsm_layer_cache_output_update(struct wsm_layer_cache_output *cache_output,
+                                   uint64_t signature, const struct wlr_box *box) {
+    // Moving the whole subtree keeps its contents
+    if (cache_output->signature != signature ||
+        cache_output->box.width != box->width ||
+        cache_output->box.height != box->height) {
+        cache_output->signature = signature;
+        cache_output->static_frames = 0;
+        cache_output->valid = false;
+    } else if (cache_output->static_frames < WSM_LAYER_CACHE_STATIC_FRAMES) {
+        cache_output->static_frames++;
+    }
+    cache_output->box = *box;
+    cache_output->last_frame = layer_cache_frame;
+    if (cache_output->buffer) {
+        wl_list_remove(&cache_output->buffer_link);
+        wl_list_insert(&layer_cache_buffers, &cache_output->buffer_link);
+    }
+
+    if (cache_output->valid) {
+        layer_cache_stats.hits++;
+    } else {
+        layer_cache_stats.misses++;
+    }
+    return !cache_output->valid && wsm_layer_cache_output_ready(cache_output);
+}
+
+bool wsm_layer_cache_output_ready(struct wsm_layer_cache_output *cache_output) {
+    return cache_output->static_frames >= WSM_LAYER_CACHE_STATIC_FRAMES;
+}
+
+bool wsm_layer_cache_output_ensure_buffer(struct wsm_layer_cache_output *cache_output,
+                                          int width, int height) {
+    if (cache_output->buffer && cache_output->buffer->width == width &&
+        cache_output->buffer->height == height) {
+        return true;
+    }
+    layer_cache_output_release(cache_output);
+    if (!layer_cache_evict()) {
+        return false;
+    }
+
+    struct wlr_output *output = cache_output->scene_output->output;
+    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    struct wlr_drm_format format = {
+        .format = DRM_FORMAT_ARGB8888,
+        .len = 1,
+        .capacity = 1,
+        .modifiers = &modifier,
+    };
+    cache_output->buffer = wlr_allocator_create_buffer(output->allocator,
+                                                       width, height, &format);
+    if (!cache_output->buffer) {
+        wsm_log(WSM_DEBUG, "Could not allocate a %dx%d layer cache buffer", width, height);
+        return false;
+    }
+    wl_list_insert(&layer_cache_buffers, &cache_output->buffer_link);
+    layer_cache_buffer_count++;
+    cache_output->texture = wlr_texture_from_buffer(output->renderer, cache_output->buffer);
+    if (!cache_output->texture) {
+        layer_cache_output_release(cache_output);
+        return false;
+    }
+    return true;
+}
+
+void wsm_layer_cache_output_invalidate(struct wsm_layer_cache_output *cache_output) {
+    cache_output->valid = false;
+    cache_output->static_frames = 0;
+}
+
+// FNV-1a
+uint64_t wsm_layer_cache_signature(uint64_t signature, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    if (signature == 0) {
+        signature = 0xcbf29ce484222325ull;
+    }
+    for (size_t i = 0; i < size; i++) {
+        signature ^= bytes[i];
+        signature *= 0x100000001b3ull;
+    }
+    return signature;
+}
+
+const struct wsm_layer_cache_stats *wsm_layer_cache_get_stats(void) {
+    return &layer_cache_stats;
+}
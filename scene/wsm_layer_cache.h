@@ -0,0 +1,134 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_LAYER_CACHE_H
+#define WSM_LAYER_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pixman.h>
+#include <wayland-server-core.h>
+
+#include <wlr/util/box.h>
+#include <wlr/util/addon.h>
+
+// Frames a subtree has to stay unchanged before it is flattened
+#define WSM_LAYER_CACHE_STATIC_FRAMES 10
+// Flattened textures kept at once, the least recently drawn go first
+#define WSM_LAYER_CACHE_MAX_BUFFERS 32
+
+struct wlr_buffer;
+struct wlr_texture;
+struct wlr_scene_tree;
+struct wlr_scene_node;
+struct wlr_scene_output;
+
+/**
+ * @brief scene subtree that may be flattened into one texture per output.
+ */
+struct wsm_layer_cache {
+    struct wlr_scene_tree *tree;
+    struct wlr_addon addon;
+    bool bypassed;
+
+    struct wl_list outputs; // wsm_layer_cache_output::link
+};
+
+/**
+ * @brief flattened contents of a subtree on one output.
+ */
+struct wsm_layer_cache_output {
+    struct wsm_layer_cache *cache;
+    struct wlr_scene_output *scene_output;
+
+    struct wlr_box box; // layout coordinates
+    pixman_region32_t visible; // layout coordinates, union of the entries
+    uint64_t signature;
+    int static_frames;
+
+    struct wlr_buffer *buffer;
+    struct wlr_texture *texture;
+    bool valid;
+    uint64_t last_frame;
+
+    struct wl_listener output_destroy;
+    struct wl_list link;
+    struct wl_list buffer_link; // while it has a buffer, most recent first
+};
+
+/**
+ * @brief frames drawn from a valid cached texture, and frames that were not.
+ */
+struct wsm_layer_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/**
+ * @brief allow the entries of @p tree to be replaced by a cached texture.
+ *
+ * @details the outermost enabled ancestor wins when caches are nested.
+ */
+void wsm_layer_cache_set_enabled(struct wlr_scene_tree *tree, bool enabled);
+/**
+ * @brief draw the entries of @p tree one by one for now.
+ *
+ * @details unlike disabling the cache, its textures are kept to be
+ * redrawn in place once the bypass ends.
+ */
+void wsm_layer_cache_set_bypassed(struct wlr_scene_tree *tree, bool bypassed);
+/**
+ * @brief cache of @p node itself, NULL if it has none or it is bypassed.
+ */
+struct wsm_layer_cache *wsm_layer_cache_try_from_node(struct wlr_scene_node *node);
+/**
+ * @brief start drawing a frame, textures drawn in it are not evicted.
+ */
+void wsm_layer_caches_begin_frame(void);
+struct wsm_layer_cache_output *wsm_layer_cache_get_output(struct wsm_layer_cache *cache,
+                                                          struct wlr_scene_output *scene_output);
+/**
+ * @brief record the contents of the subtree for the current frame.
+ *
+ * @return true if the cached texture has to be (re)rendered before use
+ */
+bool wsm_layer_cache_output_update(struct wsm_layer_cache_output *cache_output,
+                                   uint64_t signature, const struct wlr_box *box);
+/**
+ * @brief whether the subtree has been static long enough to be flattened.
+ */
+bool wsm_layer_cache_output_ready(struct wsm_layer_cache_output *cache_output);
+/**
+ * @brief make sure a @p width x @p height buffer is there to render into.
+ */
+bool wsm_layer_cache_output_ensure_buffer(struct wsm_layer_cache_output *cache_output,
+                                          int width, int height);
+void wsm_layer_cache_output_invalidate(struct wsm_layer_cache_output *cache_output);
+
+uint64_t wsm_layer_cache_signature(uint64_t signature, const void *data, size_t size);
+const struct wsm_layer_cache_stats *wsm_layer_cache_get_stats(void);
+
+#endif
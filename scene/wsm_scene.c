@@ -23,7 +23,13 @@ THE SOFTWARE.
 */
 
 #include "wsm_log.h"
+#include "wsm_trace.h"
 #include "wsm_scene.h"
+#include "wsm_layer_cache.h"
+#include "wsm_tiled_render.h"
+#include "wsm_damage.h"
+#include "wsm_frame_arena.h"
+#include "wsm_config.h"
 #include "wsm_server.h"
 #include "wsm_seat.h"
 #include "wsm_output.h"
@@ -31,11 +37,19 @@ THE SOFTWARE.
 #include "wsm_common.h"
 #include "wsm_input_manager.h"
 #include "node/wsm_node_descriptor.h"
+#include "effects/wsm_effect.h"
+#include "effects/wsm_surface_effect.h"
+#include "effects/blur/wsm_gl_blur.h"
+#include "effects/scissors/wsm_gl_scissors.h"
+#include "effects/scissors/wsm_gl_scissors_base.h"
+#include "effects/shadow/wsm_shadow.h"
 #include "wsm_output_manager.h"
 #include "wsm_workspace.h"
 #include "wsm_arrange.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <assert.h>
 
 #include <drm_fourcc.h>
@@ -43,12 +57,15 @@ THE SOFTWARE.
 #include <wlr/util/log.h>
 #include <wlr/util/transform.h>
 #include <wlr/util/region.h>
+#include <wlr/render/pixman.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/types/wlr_output_layout.h>
 
 #define HIGHLIGHT_DAMAGE_FADEOUT_TIME 250
+// Highlight regions kept for reuse while damage highlighting is enabled
+#define HIGHLIGHT_REGION_POOL_SIZE 16
 
 struct render_data {
     enum wl_output_transform transform;
@@ -58,8 +75,19 @@ struct render_data {
 
     struct wlr_scene_output *output;
 
+    struct wlr_buffer *buffer;
     struct wlr_render_pass *render_pass;
+    const struct wlr_buffer_pass_options *pass_options;
+    const struct wlr_color_transform *color_transform;
     pixman_region32_t damage;
+    // Scratch memory of the frame
+    struct wsm_frame_arena *arena;
+
+    struct wsm_effect_output *effect_output;
+    struct wsm_effect_frame effect_frame;
+
+    // Render nodes regardless of what covers them, for offscreen layers
+    bool whole_nodes;
 };
 
 struct render_list_constructor_data {
@@ -68,13 +96,30 @@ struct render_list_constructor_data {
     bool calculate_visibility;
     bool highlight_transparent_region;
     bool fractional_scale;
+    struct wsm_effect_output *effect_output;
+    struct wsm_frame_arena *arena;
+    // Parts the scene culled below shaped surfaces which are not covered,
+    // NULL until a shaped surface is seen
+    pixman_region32_t *uncovered;
+    // Outermost layer cache of the tree being walked
+    struct wsm_layer_cache *layer;
+    bool has_layers;
+    // Pipeline effects enabled for the tree being walked
+    uint32_t effects;
 };
 
 struct render_list_entry {
     struct wlr_scene_node *node;
+    // node->visible, along with what shaped surfaces above don't cover
+    pixman_region32_t *visible;
     bool sent_dmabuf_feedback;
     bool highlight_transparent_region;
     int x, y;
+    struct wsm_surface_effect *effect;
+    uint32_t effects; // ids of pipeline effects enabled for the node
+    struct wsm_layer_cache *layer;
+    // Set when the entry stands for all entries of a flattened layer
+    struct wsm_layer_cache_output *layer_output;
 };
 
 struct highlight_region {
@@ -130,9 +175,9 @@ struct wsm_scene *wsm_scene_create(const struct wsm_server* server) {
     scene->output_layout = wlr_output_layout_create(server->wl_display);
     wl_list_init(&scene->all_outputs);
     wl_signal_init(&scene->events.new_node);
-    scene->outputs = create_list();
-    scene->non_desktop_outputs = create_list();
-    scene->scratchpad = create_list();
+    scene->outputs = create_indexed_list();
+    scene->non_desktop_outputs = create_indexed_list();
+    scene->scratchpad = create_indexed_list();
 
     return scene;
 }
@@ -210,48 +255,6 @@ static void scene_node_get_size(struct wlr_scene_node *node,
     }
 }
 
-typedef bool (*scene_node_box_iterator_func_t)(struct wlr_scene_node *node,
-                                               int sx, int sy, void *data);
-
-static bool _scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box,
-                                scene_node_box_iterator_func_t iterator, void *user_data, int lx, int ly) {
-    if (!node->enabled) {
-        return false;
-    }
-
-    switch (node->type) {
-    case WLR_SCENE_NODE_TREE:;
-        struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
-        struct wlr_scene_node *child;
-        wl_list_for_each_reverse(child, &scene_tree->children, link) {
-            if (_scene_nodes_in_box(child, box, iterator, user_data, lx + child->x, ly + child->y)) {
-                return true;
-            }
-        }
-        break;
-    case WLR_SCENE_NODE_RECT:
-    case WLR_SCENE_NODE_BUFFER:;
-        struct wlr_box node_box = { .x = lx, .y = ly };
-        scene_node_get_size(node, &node_box.width, &node_box.height);
-
-        if (wlr_box_intersection(&node_box, &node_box, box) &&
-            iterator(node, lx, ly, user_data)) {
-            return true;
-        }
-        break;
-    }
-
-    return false;
-}
-
-static bool scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box,
-                               scene_node_box_iterator_func_t iterator, void *user_data) {
-    int x, y;
-    wlr_scene_node_coords(node, &x, &y);
-
-    return _scene_nodes_in_box(node, box, iterator, user_data, x, y);
-}
-
 static bool scene_node_invisible(struct wlr_scene_node *node) {
     if (node->type == WLR_SCENE_NODE_TREE) {
         return true;
@@ -268,6 +271,113 @@ static bool scene_node_invisible(struct wlr_scene_node *node) {
     return false;
 }
 
+static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
+                                     struct wsm_surface_effect *effect, pixman_region32_t *opaque);
+
+static struct wsm_surface_effect *scene_node_surface_effect(struct wlr_scene_node *node) {
+    if (node->type != WLR_SCENE_NODE_BUFFER || !wsm_surface_effects_active()) {
+        return NULL;
+    }
+    struct wlr_scene_surface *scene_surface =
+        wlr_scene_surface_try_from_buffer(wlr_scene_buffer_from_node(node));
+    if (!scene_surface) {
+        return NULL;
+    }
+    struct wsm_surface_effect *effect =
+        wsm_surface_effect_from_surface(scene_surface->surface);
+    return wsm_surface_effect_is_active(effect) ? effect : NULL;
+}
+
+// Visible region of a node at @lx, @ly, given back what the scene culled
+// below the clipped or rounded parts of shaped surfaces above it
+static pixman_region32_t *scene_node_uncovered_visible(struct wlr_scene_node *node, int lx, int ly,
+                                                       struct render_list_constructor_data *data) {
+    if (!data->uncovered || !pixman_region32_not_empty(data->uncovered)) {
+        return &node->visible;
+    }
+    int width, height;
+    scene_node_get_size(node, &width, &height);
+    pixman_box32_t box = { .x1 = lx, .y1 = ly, .x2 = lx + width, .y2 = ly + height };
+    if (pixman_region32_contains_rectangle(data->uncovered, &box) == PIXMAN_REGION_OUT) {
+        return &node->visible;
+    }
+
+    pixman_region32_t *visible = wsm_frame_arena_region(data->arena);
+    if (!visible) {
+        return &node->visible;
+    }
+    pixman_region32_intersect_rect(visible, data->uncovered, lx, ly, width, height);
+    pixman_region32_union(visible, visible, &node->visible);
+    return visible;
+}
+
+// The scene culls below the whole opaque region of a buffer, or all of it
+// for opaque formats. Keep track of what shaped surfaces don't actually
+// cover, until a node below covers it.
+static void scene_node_update_uncovered(struct wlr_scene_node *node, int lx, int ly,
+                                        struct wsm_surface_effect *effect, pixman_region32_t *visible,
+                                        struct render_list_constructor_data *data) {
+    bool shaped = wsm_surface_effect_has_shape(effect);
+    if (!data->uncovered) {
+        if (!shaped) {
+            return;
+        }
+        data->uncovered = wsm_frame_arena_region(data->arena);
+        if (!data->uncovered) {
+            return;
+        }
+        pixman_region32_clear(data->uncovered);
+    }
+
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *opaque = wsm_frame_arena_region(data->arena);
+    pixman_region32_t *culled = wsm_frame_arena_region(data->arena);
+    if (!opaque || !culled) {
+        wsm_frame_arena_restore(data->arena, &mark);
+        return;
+    }
+    pixman_region32_clear(opaque);
+    scene_node_opaque_region(node, lx, ly, effect, opaque);
+    if (shaped) {
+        pixman_region32_clear(culled);
+        scene_node_opaque_region(node, lx, ly, NULL, culled);
+        pixman_region32_subtract(culled, culled, opaque);
+        pixman_region32_intersect(culled, culled, visible);
+        pixman_region32_union(data->uncovered, data->uncovered, culled);
+    }
+    pixman_region32_subtract(data->uncovered, data->uncovered, opaque);
+    wsm_frame_arena_restore(data->arena, &mark);
+}
+
+static struct wsm_effect *scene_corner_effect = NULL;
+static struct wsm_effect *scene_blur_effect = NULL;
+
+static uint32_t scene_effect_bit(struct wsm_effect *effect) {
+    return effect ? 1u << effect->id : 0;
+}
+
+// Pipeline effects applied to a node, the built-in ones follow the state
+// of the node's surface
+static uint32_t scene_node_effects(const struct render_list_constructor_data *data,
+                                   struct wsm_surface_effect *effect) {
+    if (!data->effect_output) {
+        return 0;
+    }
+    uint32_t effects = data->effects;
+    if (effect) {
+        float radius;
+        uint32_t flags;
+        if (wsm_surface_effect_get_corners(effect, &radius, &flags)) {
+            effects |= scene_effect_bit(scene_corner_effect);
+        }
+        if (wsm_surface_effect_has_blur(effect)) {
+            effects |= scene_effect_bit(scene_blur_effect);
+        }
+    }
+    return effects & wsm_effect_output_mask(data->effect_output);
+}
+
 static bool construct_render_list_iterator(struct wlr_scene_node *node,
                                            int lx, int ly, void *_data) {
     struct render_list_constructor_data *data = _data;
@@ -286,37 +396,88 @@ static bool construct_render_list_iterator(struct wlr_scene_node *node,
         float *black = (float[4]){ 0.f, 0.f, 0.f, 1.f };
 
         if (memcmp(rect->color, black, sizeof(float) * 4) == 0) {
+            scene_node_update_uncovered(node, lx, ly, NULL, &node->visible, data);
             return false;
         }
     }
 
-    pixman_region32_t intersection;
-    pixman_region32_init(&intersection);
-    pixman_region32_intersect_rect(&intersection, &node->visible,
-                                   data->box.x, data->box.y,
-                                   data->box.width, data->box.height);
-    if (!pixman_region32_not_empty(&intersection)) {
-        pixman_region32_fini(&intersection);
+    pixman_box32_t box = {
+        .x1 = data->box.x,
+        .y1 = data->box.y,
+        .x2 = data->box.x + data->box.width,
+        .y2 = data->box.y + data->box.height,
+    };
+    pixman_region32_t *visible = scene_node_uncovered_visible(node, lx, ly, data);
+    if (pixman_region32_contains_rectangle(visible, &box) == PIXMAN_REGION_OUT) {
         return false;
     }
 
-    pixman_region32_fini(&intersection);
-
     struct render_list_entry *entry = wl_array_add(data->render_list, sizeof(*entry));
     if (!entry) {
         return false;
     }
 
+    struct wsm_surface_effect *effect = scene_node_surface_effect(node);
     *entry = (struct render_list_entry){
         .node = node,
+        .visible = visible,
         .x = lx,
         .y = ly,
         .highlight_transparent_region = data->highlight_transparent_region,
+        .effect = effect,
+        .effects = scene_node_effects(data, effect),
+        .layer = data->layer,
     };
 
+    if (data->calculate_visibility) {
+        scene_node_update_uncovered(node, lx, ly, entry->effect, visible, data);
+    }
+
     return false;
 }
 
+static void construct_render_list(struct wlr_scene_node *node, int lx, int ly,
+                                  struct render_list_constructor_data *data) {
+    if (!node->enabled) {
+        return;
+    }
+
+    // Effects enabled for a tree apply to everything rendered inside of it
+    uint32_t parent_effects = data->effects;
+    if (data->effect_output) {
+        data->effects |= wsm_effect_node_effects(node);
+    }
+
+    switch (node->type) {
+    case WLR_SCENE_NODE_TREE:;
+        // Caches are taken from the walk down instead of looked up for
+        // every entry, the outermost one wins
+        struct wsm_layer_cache *parent_layer = data->layer;
+        if (!parent_layer) {
+            data->layer = wsm_layer_cache_try_from_node(node);
+            data->has_layers |= data->layer != NULL;
+        }
+
+        struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+        struct wlr_scene_node *child;
+        wl_list_for_each_reverse(child, &scene_tree->children, link) {
+            construct_render_list(child, lx + child->x, ly + child->y, data);
+        }
+        data->layer = parent_layer;
+        break;
+    case WLR_SCENE_NODE_RECT:
+    case WLR_SCENE_NODE_BUFFER:;
+        struct wlr_box node_box = { .x = lx, .y = ly };
+        scene_node_get_size(node, &node_box.width, &node_box.height);
+
+        if (wlr_box_intersection(&node_box, &node_box, &data->box)) {
+            construct_render_list_iterator(node, lx, ly, data);
+        }
+        break;
+    }
+    data->effects = parent_effects;
+}
+
 static bool array_realloc(struct wl_array *arr, size_t size) {
     // If the size is less than 1/4th of the allocation size, we shrink it.
     // 1/4th is picked to provide hysteresis, without which an array with size
@@ -386,13 +547,17 @@ static void output_state_apply_damage(const struct render_data *data,
                                       struct wlr_output_state *state) {
     struct wlr_scene_output *output = data->output;
 
-    pixman_region32_t frame_damage;
-    pixman_region32_init(&frame_damage);
-    pixman_region32_copy(&frame_damage, &output->damage_ring.current);
-    transform_output_damage(&frame_damage, data);
-    pixman_region32_union(&output->pending_commit_damage,
-                          &output->pending_commit_damage, &frame_damage);
-    pixman_region32_fini(&frame_damage);
+    pixman_region32_t *frame_damage = wsm_frame_arena_region(data->arena);
+    if (frame_damage) {
+        pixman_region32_copy(frame_damage, &output->damage_ring.current);
+        transform_output_damage(frame_damage, data);
+        pixman_region32_union(&output->pending_commit_damage,
+                              &output->pending_commit_damage, frame_damage);
+    } else {
+        pixman_region32_union_rect(&output->pending_commit_damage,
+                                   &output->pending_commit_damage, 0, 0,
+                                   data->output->output->width, data->output->output->height);
+    }
 
     wlr_output_state_set_damage(state, &output->pending_commit_damage);
 }
@@ -484,14 +649,44 @@ static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
     return true;
 }
 
+// Regions of the pool keep the rectangles pixman allocated for them
+static struct wl_list highlight_region_pool = {
+    &highlight_region_pool, &highlight_region_pool,
+};
+static int highlight_region_pool_len = 0;
+
+static struct highlight_region *highlight_region_create(void) {
+    if (highlight_region_pool_len > 0) {
+        struct highlight_region *damage =
+            wl_container_of(highlight_region_pool.next, damage, link);
+        wl_list_remove(&damage->link);
+        highlight_region_pool_len--;
+        return damage;
+    }
+
+    struct highlight_region *damage = calloc(1, sizeof(*damage));
+    if (damage) {
+        pixman_region32_init(&damage->region);
+    }
+    return damage;
+}
+
 static void highlight_region_destroy(struct highlight_region *damage) {
     wl_list_remove(&damage->link);
+    if (highlight_region_pool_len < HIGHLIGHT_REGION_POOL_SIZE) {
+        wl_list_insert(&highlight_region_pool, &damage->link);
+        highlight_region_pool_len++;
+        return;
+    }
     pixman_region32_fini(&damage->region);
     free(damage);
 }
 
+// Opaque region of the node at @x, @y. Without @effect this is what the
+// scene culls below the node, with it the clipped and rounded parts of the
+// surface are left out.
 static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
-                                     pixman_region32_t *opaque) {
+                                     struct wsm_surface_effect *effect, pixman_region32_t *opaque) {
     int width, height;
     scene_node_get_size(node, &width, &height);
 
@@ -514,13 +709,25 @@ static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
         if (!scene_buffer->buffer_is_opaque) {
             pixman_region32_copy(opaque, &scene_buffer->opaque_region);
             pixman_region32_intersect_rect(opaque, opaque, 0, 0, width, height);
-            pixman_region32_translate(opaque, x, y);
-            return;
+        } else {
+            pixman_region32_reset(opaque, &(pixman_box32_t){
+                                              .x2 = width,
+                                              .y2 = height,
+                                          });
+        }
+        if (wsm_surface_effect_has_shape(effect)) {
+            wsm_surface_effect_cut_opaque(effect, opaque);
         }
+        pixman_region32_translate(opaque, x, y);
+        return;
     }
 
-    pixman_region32_fini(opaque);
-    pixman_region32_init_rect(opaque, x, y, width, height);
+    pixman_region32_reset(opaque, &(pixman_box32_t){
+                                      .x1 = x,
+                                      .y1 = y,
+                                      .x2 = x + width,
+                                      .y2 = y + height,
+                                  });
 }
 
 static void scene_buffer_set_texture(struct wlr_scene_buffer *scene_buffer,
@@ -582,6 +789,13 @@ static struct wlr_texture *scene_buffer_get_texture(
         return client_buffer->texture;
     }
 
+    // Shadow slices all share the texture of their nine-slice buffer
+    struct wlr_texture *shadow_texture =
+        wsm_shadow_buffer_get_texture(scene_buffer->buffer, renderer);
+    if (shadow_texture != NULL) {
+        return shadow_texture;
+    }
+
     struct wlr_texture *texture =
         wlr_texture_from_buffer(renderer, scene_buffer->buffer);
     if (texture != NULL && scene_buffer->own_buffer) {
@@ -592,20 +806,433 @@ static struct wlr_texture *scene_buffer_get_texture(
     return texture;
 }
 
-static void scene_entry_render(struct render_list_entry *entry, const struct render_data *data) {
+// Blur region of an entry, in damage ring coordinates
+static void scene_entry_blur_region(struct render_list_entry *entry,
+                                    const struct render_data *data, pixman_region32_t *region) {
+    wsm_surface_effect_get_blur_region(entry->effect, region);
+    pixman_region32_translate(region, entry->x - data->logical.x,
+                              entry->y - data->logical.y);
+    scale_output_damage(region, data->scale);
+}
+
+static void scene_output_expand_effect_damage(const struct render_data *data,
+                                              struct render_list_entry *list_data, int list_len) {
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *region = wsm_frame_arena_region(data->arena);
+    pixman_region32_t *own_damage = wsm_frame_arena_region(data->arena);
+    if (!region || !own_damage) {
+        wsm_frame_arena_restore(data->arena, &mark);
+        return;
+    }
+
+    // Bottom to top, damage added for a lower node may invalidate the
+    // background of a node above it
+    for (int i = list_len - 1; i >= 0; i--) {
+        struct render_list_entry *entry = &list_data[i];
+        if (!wsm_surface_effect_has_blur(entry->effect)) {
+            continue;
+        }
+
+        scene_entry_blur_region(entry, data, region);
+        pixman_region32_copy(own_damage, &entry->effect->content_damage);
+        pixman_region32_translate(own_damage, entry->x - data->logical.x,
+                                  entry->y - data->logical.y);
+        scale_output_damage(own_damage, data->scale);
+        wsm_blur_expand_damage(data->output, entry->node, region, own_damage);
+    }
+
+    wsm_frame_arena_restore(data->arena, &mark);
+}
+
+static void scene_entry_render_blur(struct render_list_entry *entry,
+                                    struct render_data *data, const pixman_region32_t *clip) {
+    // The blur reads back the output buffer, which would apply the color
+    // transform twice
+    if (data->color_transform) {
+        return;
+    }
+
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *region = wsm_frame_arena_region(data->arena);
+    if (!region) {
+        return;
+    }
+    scene_entry_blur_region(entry, data, region);
+    transform_output_damage(region, data);
+
+    struct wsm_blur_render_data blur = {
+        .output = data->output,
+        .buffer = data->buffer,
+        .pass = data->render_pass,
+        .pass_options = data->pass_options,
+    };
+    wsm_blur_render(&blur, entry->node, region, clip);
+    data->render_pass = blur.pass;
+    wsm_frame_arena_restore(data->arena, &mark);
+}
+
+// Restrict @region to the clip region of the entry's surface, in output
+// coordinates before the output transform
+static void scene_entry_clip(struct render_list_entry *entry,
+                             const struct render_data *data, pixman_region32_t *region) {
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *clip = wsm_frame_arena_region(data->arena);
+    if (clip && wsm_surface_effect_get_clip_region(entry->effect, clip)) {
+        pixman_region32_translate(clip, entry->x - data->logical.x,
+                                  entry->y - data->logical.y);
+        scale_output_damage(clip, data->scale);
+        pixman_region32_intersect(region, region, clip);
+    }
+    wsm_frame_arena_restore(data->arena, &mark);
+}
+
+static struct wsm_corner_mask *scene_entry_corner_mask(struct render_list_entry *entry,
+                                                       const struct render_data *data) {
+    float radius;
+    uint32_t flags;
+    if (!wsm_surface_effect_get_corners(entry->effect, &radius, &flags)) {
+        return NULL;
+    }
+    return wsm_corner_mask_get(radius, flags, data->scale);
+}
+
+struct corner_band_data {
+    const struct render_data *data;
+    const struct wlr_render_texture_options *options;
+};
+
+static void render_corner_band(const pixman_region32_t *region, float alpha, void *_data) {
+    struct corner_band_data *band = _data;
+
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(band->data->arena, &mark);
+    pixman_region32_t *clip = wsm_frame_arena_region(band->data->arena);
+    if (!clip) {
+        return;
+    }
+    pixman_region32_copy(clip, (pixman_region32_t *)region);
+    transform_output_damage(clip, band->data);
+
+    struct wlr_render_texture_options options = *band->options;
+    alpha *= options.alpha ? *options.alpha : 1.0f;
+    options.alpha = &alpha;
+    options.clip = clip;
+    options.blend_mode = WLR_RENDER_BLEND_MODE_PREMULTIPLIED;
+    wlr_render_pass_add_texture(band->data->render_pass, &options);
+
+    wsm_frame_arena_restore(band->data->arena, &mark);
+}
+
+// Window handed to the effect pipeline by scene_entry_render()
+struct scene_effect_window {
+    struct wsm_effect_window base;
+    struct render_list_entry *entry;
+
+    // Rounded corners, cut from the clip before the window is drawn and
+    // drawn with the alpha of their mask afterwards
+    struct wsm_corner_mask *corner_mask;
+    struct wlr_box corner_box;
+    pixman_region32_t *corner_region;
+
+    // How the buffer of the window was drawn, NULL if it was not
+    const struct wlr_render_texture_options *texture_options;
+};
+
+// The built-in effects are only ever run by scene_entry_render(), which
+// hands them the frame of its render data
+static struct render_data *scene_effect_render_data(struct wsm_effect_frame *frame) {
+    struct render_data *data = wl_container_of(frame, data, effect_frame);
+    return data;
+}
+
+static void scene_corners_pre_render_window(struct wsm_effect *effect,
+                                            struct wsm_effect_frame *frame, struct wsm_effect_window *window) {
+    struct render_data *data = scene_effect_render_data(frame);
+    struct scene_effect_window *scene_window = wl_container_of(window, scene_window, base);
+    scene_window->corner_mask = scene_entry_corner_mask(scene_window->entry, data);
+    if (!scene_window->corner_mask) {
+        return;
+    }
+
+    scene_window->corner_box = window->box;
+    wsm_corner_mask_cut_box(scene_window->corner_mask, &scene_window->corner_box,
+                            scene_window->corner_region);
+    pixman_region32_intersect(scene_window->corner_region, scene_window->corner_region,
+                              window->clip);
+    pixman_region32_subtract(window->clip, window->clip, scene_window->corner_region);
+}
+
+static void scene_corners_render_window(struct wsm_effect *effect,
+                                        struct wsm_effect_frame *frame, struct wsm_effect_window *window) {
+    struct render_data *data = scene_effect_render_data(frame);
+    struct scene_effect_window *scene_window = wl_container_of(window, scene_window, base);
+    if (!scene_window->corner_mask || !scene_window->texture_options) {
+        return;
+    }
+
+    struct corner_band_data band_data = {
+        .data = data,
+        .options = scene_window->texture_options,
+    };
+    wsm_corner_mask_for_each_band(scene_window->corner_mask, &scene_window->corner_box,
+                                  scene_window->corner_region, render_corner_band, &band_data);
+}
+
+static const struct wsm_effect_impl scene_corner_effect_impl = {
+    .name = "rounded-corners",
+    .feature = WSM_EFFECT_RADIUS,
+    .pre_render_window = scene_corners_pre_render_window,
+    .render_window = scene_corners_render_window,
+};
+
+static void scene_blur_pre_render_window(struct wsm_effect *effect,
+                                         struct wsm_effect_frame *frame, struct wsm_effect_window *window) {
+    struct render_data *data = scene_effect_render_data(frame);
+    struct scene_effect_window *scene_window = wl_container_of(window, scene_window, base);
+
+    // Only the part of the window which is drawn shows the blur
+    pixman_region32_t *clip = wsm_frame_arena_region(data->arena);
+    if (!clip) {
+        return;
+    }
+    pixman_region32_copy(clip, window->clip);
+    transform_output_damage(clip, data);
+
+    data->render_pass = frame->pass;
+    scene_entry_render_blur(scene_window->entry, data, clip);
+    frame->pass = data->render_pass;
+}
+
+static const struct wsm_effect_impl scene_blur_effect_impl = {
+    .name = "blur",
+    .feature = WSM_EFFECT_BLUR,
+    .pre_render_window = scene_blur_pre_render_window,
+};
+
+void wsm_scene_output_add_effects(struct wlr_output *output) {
+    if (!scene_corner_effect) {
+        scene_corner_effect = wsm_effect_create(&scene_corner_effect_impl, NULL);
+    }
+    if (!scene_blur_effect) {
+        scene_blur_effect = wsm_effect_create(&scene_blur_effect_impl, NULL);
+    }
+
+    // Corners first, the blur is not drawn where they cut the window
+    if (scene_corner_effect) {
+        wsm_effect_output_add(output, scene_corner_effect);
+    }
+    if (scene_blur_effect) {
+        wsm_effect_output_add(output, scene_blur_effect);
+    }
+}
+
+// Box of an entry for the effect pipeline
+static void scene_entry_effect_window(struct render_list_entry *entry,
+                                      const struct render_data *data, struct wsm_effect_window *window) {
+    window->node = entry->node;
+    window->box = (struct wlr_box){
+        .x = entry->x - data->logical.x,
+        .y = entry->y - data->logical.y,
+    };
+    scene_node_get_size(entry->node, &window->box.width, &window->box.height);
+    scale_box(&window->box, data->scale);
+}
+
+static void scene_output_expand_pipeline_damage(const struct render_data *data,
+                                                struct render_list_entry *list_data, int list_len) {
+    pixman_region32_t *damage = &data->output->damage_ring.current;
+    for (int i = list_len - 1; i >= 0; i--) {
+        struct render_list_entry *entry = &list_data[i];
+        if (!entry->effects) {
+            continue;
+        }
+
+        struct wlr_box box = {
+            .x = entry->x - data->logical.x,
+            .y = entry->y - data->logical.y,
+        };
+        scene_node_get_size(entry->node, &box.width, &box.height);
+        scale_box(&box, data->scale);
+        wsm_effect_output_expand_damage(data->effect_output, entry->effects,
+                                        &box, data->scale, damage);
+    }
+}
+
+static void scene_entry_render_layer(struct render_list_entry *entry,
+                                    struct render_data *data) {
+    struct wsm_layer_cache_output *cache_output = entry->layer_output;
+
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *render_region = wsm_frame_arena_region(data->arena);
+    if (!render_region) {
+        return;
+    }
+    pixman_region32_copy(render_region, &cache_output->visible);
+    pixman_region32_translate(render_region, -data->logical.x, -data->logical.y);
+    scale_output_damage(render_region, data->scale);
+    pixman_region32_intersect(render_region, render_region, &data->damage);
+    if (!pixman_region32_not_empty(render_region)) {
+        wsm_frame_arena_restore(data->arena, &mark);
+        return;
+    }
+
+    struct wlr_box dst_box = {
+        .x = cache_output->box.x - data->logical.x,
+        .y = cache_output->box.y - data->logical.y,
+        .width = cache_output->box.width,
+        .height = cache_output->box.height,
+    };
+    scale_box(&dst_box, data->scale);
+    transform_output_box(&dst_box, data);
+    transform_output_damage(render_region, data);
+
+    wlr_render_pass_add_texture(data->render_pass, &(struct wlr_render_texture_options){
+                                                       .texture = cache_output->texture,
+                                                       .dst_box = dst_box,
+                                                       .transform = data->transform,
+                                                       .clip = render_region,
+                                                       .blend_mode = WLR_RENDER_BLEND_MODE_PREMULTIPLIED,
+                                                   });
+    wsm_frame_arena_restore(data->arena, &mark);
+}
+
+// Plain opaque rects (borders, titlebar and fullscreen backgrounds) are
+// drawn in batches, they need neither blending nor an opaque region
+static bool scene_entry_is_opaque_rect(struct render_list_entry *entry) {
+    if (entry->node->type != WLR_SCENE_NODE_RECT || entry->layer_output ||
+        entry->effect || entry->effects) {
+        return false;
+    }
+    struct wlr_scene_rect *scene_rect = wlr_scene_rect_from_node(entry->node);
+    return scene_rect->color[3] == 1.f;
+}
+
+static bool scene_entry_rect_batches_with(struct render_list_entry *entry,
+                                          struct render_list_entry *first) {
+    if (!scene_entry_is_opaque_rect(entry)) {
+        return false;
+    }
+    struct wlr_scene_rect *rect = wlr_scene_rect_from_node(entry->node);
+    struct wlr_scene_rect *first_rect = wlr_scene_rect_from_node(first->node);
+    return memcmp(rect->color, first_rect->color, sizeof(rect->color)) == 0;
+}
+
+// Draw @count adjacent opaque rects of the same color with a single rect
+static void scene_entries_render_rects(struct render_list_entry *entries, int count,
+                                       struct render_data *data) {
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *render_region = wsm_frame_arena_region(data->arena);
+    pixman_region32_t *entry_region = wsm_frame_arena_region(data->arena);
+    if (!render_region || !entry_region) {
+        wsm_frame_arena_restore(data->arena, &mark);
+        return;
+    }
+    pixman_region32_clear(render_region);
+
+    for (int i = 0; i < count; i++) {
+        struct render_list_entry *entry = &entries[i];
+        struct wlr_box box = {
+            .x = entry->x - data->logical.x,
+            .y = entry->y - data->logical.y,
+        };
+        scene_node_get_size(entry->node, &box.width, &box.height);
+        scale_box(&box, data->scale);
+
+        pixman_region32_copy(entry_region, entry->visible);
+        pixman_region32_translate(entry_region, -data->logical.x, -data->logical.y);
+        scale_output_damage(entry_region, data->scale);
+        wsm_region_intersect_rect(entry_region, entry_region,
+                                  box.x, box.y, box.width, box.height);
+        pixman_region32_union(render_region, render_region, entry_region);
+    }
+    pixman_region32_intersect(render_region, render_region, &data->damage);
+
+    if (pixman_region32_not_empty(render_region)) {
+        transform_output_damage(render_region, data);
+        struct wlr_scene_rect *scene_rect = wlr_scene_rect_from_node(entries[0].node);
+        wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
+                                                        .box = {
+                                                            .width = data->buffer->width,
+                                                            .height = data->buffer->height,
+                                                        },
+                                                        .color = {
+                                                            .r = scene_rect->color[0],
+                                                            .g = scene_rect->color[1],
+                                                            .b = scene_rect->color[2],
+                                                            .a = 1,
+                                                        },
+                                                        .clip = render_region,
+                                                        .blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+                                                    });
+    }
+
+    wsm_frame_arena_restore(data->arena, &mark);
+}
+
+static void scene_entry_render(struct render_list_entry *entry, struct render_data *data) {
+    WSM_TRACE_SCOPE("scene_entry_render");
     struct wlr_scene_node *node = entry->node;
 
-    pixman_region32_t render_region;
-    pixman_region32_init(&render_region);
-    pixman_region32_copy(&render_region, &node->visible);
-    pixman_region32_translate(&render_region, -data->logical.x, -data->logical.y);
-    scale_output_damage(&render_region, data->scale);
-    pixman_region32_intersect(&render_region, &render_region, &data->damage);
-    if (!pixman_region32_not_empty(&render_region)) {
-        pixman_region32_fini(&render_region);
+    if (entry->layer_output) {
+        scene_entry_render_layer(entry, data);
         return;
     }
 
+    // Everything taken from the arena is handed back for the next entry
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *render_region = wsm_frame_arena_region(data->arena);
+    pixman_region32_t *corner_region = wsm_frame_arena_region(data->arena);
+    pixman_region32_t *opaque = wsm_frame_arena_region(data->arena);
+    if (!render_region || !corner_region || !opaque) {
+        wsm_frame_arena_restore(data->arena, &mark);
+        return;
+    }
+
+    if (!data->whole_nodes && floor(data->scale) == data->scale &&
+        wsm_region_is_rect(entry->visible) && wsm_region_is_rect(&data->damage)) {
+        // Single rectangles on both sides, like most windows of a tiled
+        // layout: no need for the generic region operations
+        const pixman_box32_t *visible = &entry->visible->extents;
+        const pixman_box32_t *damage = &data->damage.extents;
+        pixman_box32_t box = {
+            .x1 = MAX((visible->x1 - data->logical.x) * (int)data->scale, damage->x1),
+            .y1 = MAX((visible->y1 - data->logical.y) * (int)data->scale, damage->y1),
+            .x2 = MIN((visible->x2 - data->logical.x) * (int)data->scale, damage->x2),
+            .y2 = MIN((visible->y2 - data->logical.y) * (int)data->scale, damage->y2),
+        };
+        if (box.x2 <= box.x1 || box.y2 <= box.y1) {
+            wsm_frame_arena_restore(data->arena, &mark);
+            return;
+        }
+        pixman_region32_reset(render_region, &box);
+    } else {
+        if (data->whole_nodes) {
+            int width, height;
+            scene_node_get_size(node, &width, &height);
+            pixman_region32_reset(render_region, &(pixman_box32_t){
+                                                     .x1 = entry->x,
+                                                     .y1 = entry->y,
+                                                     .x2 = entry->x + width,
+                                                     .y2 = entry->y + height,
+                                                 });
+        } else {
+            pixman_region32_copy(render_region, entry->visible);
+        }
+        pixman_region32_translate(render_region, -data->logical.x, -data->logical.y);
+        scale_output_damage(render_region, data->scale);
+        pixman_region32_intersect(render_region, render_region, &data->damage);
+        if (!pixman_region32_not_empty(render_region)) {
+            wsm_frame_arena_restore(data->arena, &mark);
+            return;
+        }
+    }
+
     int x = entry->x - data->logical.x;
     int y = entry->y - data->logical.y;
 
@@ -616,14 +1243,51 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
     scene_node_get_size(node, &dst_box.width, &dst_box.height);
     scale_box(&dst_box, data->scale);
 
-    pixman_region32_t opaque;
-    pixman_region32_init(&opaque);
-    scene_node_opaque_region(node, x, y, &opaque);
-    scale_output_damage(&opaque, data->scale);
-    pixman_region32_subtract(&opaque, &render_region, &opaque);
+    if (entry->effect) {
+        scene_entry_clip(entry, data, render_region);
+    }
+
+    // Effects like rounded corners cut what they draw themselves from the
+    // region, the rest of the surface keeps the usual opaque handling
+    pixman_region32_clear(corner_region);
+    struct scene_effect_window effect_window = {
+        .base = {
+            .node = node,
+            .box = dst_box,
+            .clip = render_region,
+        },
+        .entry = entry,
+        .corner_region = corner_region,
+    };
+    if (entry->effects) {
+        data->effect_frame.pass = data->render_pass;
+        wsm_effect_output_pre_render_window(data->effect_output, entry->effects,
+                                            &data->effect_frame, &effect_window.base);
+        data->render_pass = data->effect_frame.pass;
+        if (!data->render_pass) {
+            goto out;
+        }
+    }
 
+    pixman_region32_clear(opaque);
+    scene_node_opaque_region(node, x, y, entry->effect, opaque);
+    scale_output_damage(opaque, data->scale);
+    pixman_region32_subtract(opaque, render_region, opaque);
+
+    // The render hooks of the effects get the window before the output
+    // transform as well
+    pixman_region32_t *clip = render_region;
+    if (entry->effects) {
+        clip = wsm_frame_arena_region(data->arena);
+        if (!clip) {
+            goto out;
+        }
+        pixman_region32_copy(clip, render_region);
+    }
     transform_output_box(&dst_box, data);
-    transform_output_damage(&render_region, data);
+    transform_output_damage(clip, data);
+
+    struct wlr_render_texture_options texture_options;
 
     switch (node->type) {
     case WLR_SCENE_NODE_TREE:
@@ -640,7 +1304,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
                                                             .b = scene_rect->color[2],
                                                             .a = scene_rect->color[3],
                                                         },
-                                                        .clip = &render_region,
+                                                        .clip = clip,
                                                     });
         break;
     case WLR_SCENE_NODE_BUFFER:;
@@ -649,7 +1313,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
         struct wlr_texture *texture = scene_buffer_get_texture(scene_buffer,
                                                                data->output->output->renderer);
         if (texture == NULL) {
-            wlr_damage_ring_add(&data->output->damage_ring, &render_region);
+            wlr_damage_ring_add(&data->output->damage_ring, clip);
             break;
         }
 
@@ -657,17 +1321,19 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
             wlr_output_transform_invert(scene_buffer->transform);
         transform = wlr_output_transform_compose(transform, data->transform);
 
-        wlr_render_pass_add_texture(data->render_pass, &(struct wlr_render_texture_options) {
-                                                           .texture = texture,
-                                                           .src_box = scene_buffer->src_box,
-                                                           .dst_box = dst_box,
-                                                           .transform = transform,
-                                                           .clip = &render_region,
-                                                           .alpha = &scene_buffer->opacity,
-                                                           .filter_mode = scene_buffer->filter_mode,
-                                                           .blend_mode = pixman_region32_not_empty(&opaque) ?
-                                                                             WLR_RENDER_BLEND_MODE_PREMULTIPLIED : WLR_RENDER_BLEND_MODE_NONE,
-                                                       });
+        texture_options = (struct wlr_render_texture_options){
+            .texture = texture,
+            .src_box = scene_buffer->src_box,
+            .dst_box = dst_box,
+            .transform = transform,
+            .clip = clip,
+            .alpha = &scene_buffer->opacity,
+            .filter_mode = scene_buffer->filter_mode,
+            .blend_mode = pixman_region32_not_empty(opaque) ?
+                              WLR_RENDER_BLEND_MODE_PREMULTIPLIED : WLR_RENDER_BLEND_MODE_NONE,
+        };
+        wlr_render_pass_add_texture(data->render_pass, &texture_options);
+        effect_window.texture_options = &texture_options;
 
         struct wlr_scene_output_sample_event sample_event = {
             .output = data->output,
@@ -679,19 +1345,560 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
             wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
                                                                                           .box = dst_box,
                                                                                           .color = { .r = 0, .g = 0.3, .b = 0, .a = 0.3 },
-                                                                                          .clip = &opaque,
+                                                                                          .clip = opaque,
                                                                                           });
         }
 
         break;
     }
 
-    pixman_region32_fini(&opaque);
-    pixman_region32_fini(&render_region);
+    if (entry->effects && data->render_pass) {
+        data->effect_frame.pass = data->render_pass;
+        wsm_effect_output_render_window(data->effect_output, entry->effects,
+                                        &data->effect_frame, &effect_window.base);
+        data->render_pass = data->effect_frame.pass;
+    }
+
+out:
+    wsm_frame_arena_restore(data->arena, &mark);
+}
+
+static uint64_t scene_entry_signature(struct render_list_entry *entry,
+                                      const struct wlr_box *box, uint64_t signature) {
+    struct wlr_scene_node *node = entry->node;
+    int geometry[4] = { entry->x - box->x, entry->y - box->y };
+    scene_node_get_size(node, &geometry[2], &geometry[3]);
+    signature = wsm_layer_cache_signature(signature, &node, sizeof(node));
+    signature = wsm_layer_cache_signature(signature, geometry, sizeof(geometry));
+
+    if (node->type == WLR_SCENE_NODE_RECT) {
+        struct wlr_scene_rect *scene_rect = wlr_scene_rect_from_node(node);
+        return wsm_layer_cache_signature(signature, scene_rect->color, sizeof(scene_rect->color));
+    }
+
+    struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+    signature = wsm_layer_cache_signature(signature, &scene_buffer->buffer,
+                                          sizeof(scene_buffer->buffer));
+    signature = wsm_layer_cache_signature(signature, &scene_buffer->texture,
+                                          sizeof(scene_buffer->texture));
+    signature = wsm_layer_cache_signature(signature, &scene_buffer->opacity,
+                                          sizeof(scene_buffer->opacity));
+    signature = wsm_layer_cache_signature(signature, &scene_buffer->src_box,
+                                          sizeof(scene_buffer->src_box));
+    signature = wsm_layer_cache_signature(signature, &scene_buffer->transform,
+                                          sizeof(scene_buffer->transform));
+    signature = wsm_layer_cache_signature(signature, &scene_buffer->filter_mode,
+                                          sizeof(scene_buffer->filter_mode));
+
+    // Client buffers are updated in place, every commit counts as a change
+    struct wlr_scene_surface *scene_surface =
+        wlr_scene_surface_try_from_buffer(scene_buffer);
+    if (scene_surface) {
+        signature = wsm_layer_cache_signature(signature, &scene_surface->surface->current.seq,
+                                              sizeof(scene_surface->surface->current.seq));
+    }
+    return signature;
+}
+
+static bool scene_layer_cache_render(struct wsm_layer_cache_output *cache_output,
+                                     const struct render_data *data,
+                                     struct render_list_entry *entries, int count) {
+    struct wlr_box buffer_box = {
+        .width = cache_output->box.width,
+        .height = cache_output->box.height,
+    };
+    scale_box(&buffer_box, data->scale);
+    if (wlr_box_empty(&buffer_box) ||
+        !wsm_layer_cache_output_ensure_buffer(cache_output, buffer_box.width, buffer_box.height)) {
+        return false;
+    }
+
+    struct wlr_output *output = data->output->output;
+    struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(output->renderer,
+                                                                  cache_output->buffer, NULL);
+    if (!pass) {
+        return false;
+    }
+    wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+                                       .box = buffer_box,
+                                       .color = { 0, 0, 0, 0 },
+                                       .blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+                                   });
+
+    struct render_data layer_data = {
+        .transform = WL_OUTPUT_TRANSFORM_NORMAL,
+        .scale = data->scale,
+        .logical = cache_output->box,
+        .trans_width = buffer_box.width,
+        .trans_height = buffer_box.height,
+        .output = data->output,
+        .buffer = cache_output->buffer,
+        .render_pass = pass,
+        .arena = data->arena,
+        .whole_nodes = true,
+    };
+    pixman_region32_init_rect(&layer_data.damage, 0, 0, buffer_box.width, buffer_box.height);
+
+    for (int i = count - 1; i >= 0; i--) {
+        struct render_list_entry entry = entries[i];
+        entry.highlight_transparent_region = false;
+        scene_entry_render(&entry, &layer_data);
+    }
+    pixman_region32_fini(&layer_data.damage);
+
+    cache_output->valid = wlr_render_pass_submit(pass);
+    return cache_output->valid;
+}
+
+// Replace the entries of a static layer by its cached texture, written to
+// @dest. Returns false if the entries have to be rendered as they are.
+static bool scene_output_flatten_layer(const struct render_data *data,
+                                       struct wsm_layer_cache *cache, struct render_list_entry *entries,
+                                       int count, struct render_list_entry *dest) {
+    struct wsm_layer_cache_output *cache_output =
+        wsm_layer_cache_get_output(cache, data->output);
+    if (!cache_output) {
+        return false;
+    }
+
+    // A single entry gains nothing and may lose direct scan-out
+    bool cacheable = count > 1;
+    int x1 = INT_MAX, y1 = INT_MAX, x2 = INT_MIN, y2 = INT_MIN;
+    for (int i = 0; i < count; i++) {
+        struct render_list_entry *entry = &entries[i];
+        // Effects read back what is below the surface
+        if (entry->effect || entry->effects) {
+            cacheable = false;
+        }
+        int width, height;
+        scene_node_get_size(entry->node, &width, &height);
+        x1 = MIN(x1, entry->x);
+        y1 = MIN(y1, entry->y);
+        x2 = MAX(x2, entry->x + width);
+        y2 = MAX(y2, entry->y + height);
+    }
+    struct wlr_box box = { .x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1 };
+    if (!cacheable || !wlr_box_intersection(&box, &box, &data->logical)) {
+        wsm_layer_cache_output_invalidate(cache_output);
+        return false;
+    }
+
+    uint64_t signature = wsm_layer_cache_signature(0, &data->scale, sizeof(data->scale));
+    pixman_region32_clear(&cache_output->visible);
+    for (int i = 0; i < count; i++) {
+        signature = scene_entry_signature(&entries[i], &box, signature);
+        pixman_region32_union(&cache_output->visible, &cache_output->visible,
+                              entries[i].visible);
+    }
+
+    if (wsm_layer_cache_output_update(cache_output, signature, &box) &&
+        !scene_layer_cache_render(cache_output, data, entries, count)) {
+        wsm_layer_cache_output_invalidate(cache_output);
+        return false;
+    }
+    if (!cache_output->valid) {
+        return false;
+    }
+
+    // The buffers are still shown, even though not drawn one by one
+    for (int i = 0; i < count; i++) {
+        if (entries[i].node->type != WLR_SCENE_NODE_BUFFER) {
+            continue;
+        }
+        struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(entries[i].node);
+        struct wlr_scene_output_sample_event sample_event = {
+            .output = data->output,
+            .direct_scanout = false,
+        };
+        wl_signal_emit_mutable(&scene_buffer->events.output_sample, &sample_event);
+    }
+
+    *dest = (struct render_list_entry){
+        .node = &cache->tree->node,
+        .visible = &cache_output->visible,
+        .x = box.x,
+        .y = box.y,
+        .layer = cache,
+        .layer_output = cache_output,
+    };
+    return true;
+}
+
+static int scene_output_apply_layer_caches(const struct render_data *data,
+                                           struct render_list_entry *list_data, int list_len) {
+    int len = 0;
+    for (int i = 0; i < list_len;) {
+        struct wsm_layer_cache *cache = list_data[i].layer;
+        // Entries of a subtree are next to each other in the list
+        int end = i + 1;
+        while (cache && end < list_len && list_data[end].layer == cache) {
+            end++;
+        }
+
+        if (cache && scene_output_flatten_layer(data, cache, &list_data[i],
+                                                end - i, &list_data[len])) {
+            len++;
+        } else {
+            memmove(&list_data[len], &list_data[i], (end - i) * sizeof(*list_data));
+            len += end - i;
+        }
+        i = end;
+    }
+    return len;
+}
+
+// Damaged area not covered by opaque nodes, in buffer coordinates
+static void scene_output_background_region(const struct render_data *data,
+                                           struct render_list_entry *list_data, int list_len, pixman_region32_t *background) {
+    struct wlr_scene_output *scene_output = data->output;
+    pixman_region32_copy(background, &data->damage);
+
+    // Cull areas of the background that are occluded by opaque regions of
+    // scene nodes above. Those scene nodes will just render atop having us
+    // never see the background.
+    pixman_region32_t *opaque = wsm_frame_arena_region(data->arena);
+    if (scene_output->scene->calculate_visibility && opaque) {
+        for (int i = list_len - 1; i >= 0; i--) {
+            struct render_list_entry *entry = &list_data[i];
+
+            // We must only cull opaque regions that are visible by the node.
+            // The node's visibility will have the knowledge of a black rect
+            // that may have been omitted from the render list via the black
+            // rect optimization. In order to ensure we don't cull background
+            // rendering in that black rect region, consider the node's visibility.
+            pixman_region32_clear(opaque);
+            scene_node_opaque_region(entry->node, entry->x, entry->y, entry->effect, opaque);
+            pixman_region32_intersect(opaque, opaque, entry->visible);
+
+            pixman_region32_translate(opaque, -scene_output->x, -scene_output->y);
+            wlr_region_scale(opaque, opaque, data->scale);
+            pixman_region32_subtract(background, background, opaque);
+        }
+
+        if (floor(data->scale) != data->scale) {
+            wlr_region_expand(background, background, 1);
+
+            // reintersect with the damage because we never want to render
+            // outside of the damage region
+            pixman_region32_intersect(background, background, &data->damage);
+        }
+    }
+
+    transform_output_damage(background, data);
+}
+
+static struct wsm_tiled_renderer *tiled_renderer = NULL;
+
+static bool tiled_format_from_drm(uint32_t format, pixman_format_code_t *pixman_format) {
+    switch (format) {
+    case DRM_FORMAT_ARGB8888:
+        *pixman_format = PIXMAN_a8r8g8b8;
+        return true;
+    case DRM_FORMAT_XRGB8888:
+        *pixman_format = PIXMAN_x8r8g8b8;
+        return true;
+    case DRM_FORMAT_ABGR8888:
+        *pixman_format = PIXMAN_a8b8g8r8;
+        return true;
+    case DRM_FORMAT_XBGR8888:
+        *pixman_format = PIXMAN_x8b8g8r8;
+        return true;
+    }
+    return false;
+}
+
+// Buffers read by the workers, their data pointers are accessed from
+// before the layers are built until the composite is done
+struct tiled_sources {
+    struct wlr_buffer **buffers;
+    pixman_image_t **images;
+    int len;
+};
+
+static pixman_image_t *tiled_source_image(struct tiled_sources *sources,
+                                          struct wlr_buffer *buffer) {
+    // Shadow slices and the like share one buffer, which can only be
+    // accessed once at a time
+    for (int i = 0; i < sources->len; i++) {
+        if (sources->buffers[i] == buffer) {
+            return sources->images[i];
+        }
+    }
+
+    void *data;
+    uint32_t format;
+    size_t stride;
+    if (!wlr_buffer_begin_data_ptr_access(buffer, WLR_BUFFER_DATA_PTR_ACCESS_READ,
+                                          &data, &format, &stride)) {
+        return NULL;
+    }
+    pixman_format_code_t pixman_format;
+    pixman_image_t *image = NULL;
+    if (tiled_format_from_drm(format, &pixman_format)) {
+        image = pixman_image_create_bits(pixman_format, buffer->width, buffer->height,
+                                         data, stride);
+    }
+    if (!image) {
+        wlr_buffer_end_data_ptr_access(buffer);
+        return NULL;
+    }
+
+    sources->buffers[sources->len] = buffer;
+    sources->images[sources->len] = image;
+    sources->len++;
+    return image;
+}
+
+static void tiled_sources_release(struct tiled_sources *sources) {
+    for (int i = 0; i < sources->len; i++) {
+        pixman_image_unref(sources->images[i]);
+        wlr_buffer_end_data_ptr_access(sources->buffers[i]);
+    }
+    sources->len = 0;
+}
+
+// The buffer holding the pixels of a scene buffer, client buffers keep the
+// one the client attached as long as it exists
+static struct wlr_buffer *scene_buffer_source(struct wlr_scene_buffer *scene_buffer) {
+    struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(scene_buffer->buffer);
+    if (client_buffer) {
+        return client_buffer->source;
+    }
+    return scene_buffer->buffer;
+}
+
+static bool tiled_layer_set_source(struct wsm_tiled_layer *layer, struct tiled_sources *sources,
+                                   struct wlr_buffer *buffer, const struct wlr_fbox *src_box,
+                                   enum wlr_scale_filter_mode filter_mode) {
+    layer->image = buffer ? tiled_source_image(sources, buffer) : NULL;
+    if (!layer->image) {
+        return false;
+    }
+
+    struct wlr_fbox src = *src_box;
+    if (wlr_fbox_empty(&src)) {
+        src = (struct wlr_fbox){ .width = buffer->width, .height = buffer->height };
+    }
+
+    double scale_x = src.width / layer->box.width;
+    double scale_y = src.height / layer->box.height;
+    struct pixman_f_transform transform;
+    pixman_f_transform_init_scale(&transform, scale_x, scale_y);
+    pixman_f_transform_translate(&transform, NULL, src.x, src.y);
+    pixman_transform_from_pixman_f_transform(&layer->transform, &transform);
+    layer->filter = filter_mode == WLR_SCALE_FILTER_NEAREST ||
+                    (scale_x == 1.0 && scale_y == 1.0 && src.x == floor(src.x) && src.y == floor(src.y)) ?
+                        PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR;
+    return true;
+}
+
+// Same clip and blending as scene_entry_render(), returns false if the
+// entry is left out. Sets @failed if its pixels cannot be read.
+static bool scene_entry_tiled_layer(struct render_list_entry *entry, const struct render_data *data,
+                                    struct tiled_sources *sources, struct wsm_tiled_layer *layer,
+                                    bool *failed) {
+    struct wlr_scene_node *node = entry->node;
+    pixman_region32_init(&layer->clip);
+    pixman_region32_copy(&layer->clip, entry->visible);
+    pixman_region32_translate(&layer->clip, -data->logical.x, -data->logical.y);
+    scale_output_damage(&layer->clip, data->scale);
+    pixman_region32_intersect(&layer->clip, &layer->clip, &data->damage);
+
+    layer->box = (struct wlr_box){
+        .x = entry->x - data->logical.x,
+        .y = entry->y - data->logical.y,
+    };
+    if (entry->layer_output) {
+        layer->box.width = entry->layer_output->box.width;
+        layer->box.height = entry->layer_output->box.height;
+    } else {
+        scene_node_get_size(node, &layer->box.width, &layer->box.height);
+    }
+    scale_box(&layer->box, data->scale);
+    pixman_region32_intersect_rect(&layer->clip, &layer->clip, layer->box.x, layer->box.y,
+                                   layer->box.width, layer->box.height);
+    if (!pixman_region32_not_empty(&layer->clip) || wlr_box_empty(&layer->box)) {
+        pixman_region32_fini(&layer->clip);
+        return false;
+    }
+
+    layer->alpha = 0xffff;
+    layer->op = PIXMAN_OP_OVER;
+    if (entry->layer_output) {
+        if (!tiled_layer_set_source(layer, sources, entry->layer_output->buffer,
+                                    &(struct wlr_fbox){0}, WLR_SCALE_FILTER_BILINEAR)) {
+            *failed = true;
+            pixman_region32_fini(&layer->clip);
+            return false;
+        }
+        return true;
+    }
+
+    if (node->type == WLR_SCENE_NODE_RECT) {
+        struct wlr_scene_rect *scene_rect = wlr_scene_rect_from_node(node);
+        layer->color = (pixman_color_t){
+            .red = scene_rect->color[0] * 0xffff,
+            .green = scene_rect->color[1] * 0xffff,
+            .blue = scene_rect->color[2] * 0xffff,
+            .alpha = scene_rect->color[3] * 0xffff,
+        };
+        if (scene_rect->color[3] == 1.f) {
+            layer->op = PIXMAN_OP_SRC;
+        }
+        return true;
+    }
+
+    struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+    if (!tiled_layer_set_source(layer, sources, scene_buffer_source(scene_buffer),
+                                &scene_buffer->src_box, scene_buffer->filter_mode)) {
+        *failed = true;
+        pixman_region32_fini(&layer->clip);
+        return false;
+    }
+    layer->alpha = scene_buffer->opacity * 0xffff;
+
+    struct wsm_frame_arena_mark mark;
+    wsm_frame_arena_save(data->arena, &mark);
+    pixman_region32_t *opaque = wsm_frame_arena_region(data->arena);
+    if (opaque) {
+        pixman_region32_clear(opaque);
+        scene_node_opaque_region(node, entry->x - data->logical.x, entry->y - data->logical.y,
+                                 entry->effect, opaque);
+        scale_output_damage(opaque, data->scale);
+        pixman_region32_subtract(opaque, &layer->clip, opaque);
+        if (!pixman_region32_not_empty(opaque)) {
+            layer->op = PIXMAN_OP_SRC;
+        }
+    }
+    wsm_frame_arena_restore(data->arena, &mark);
+    return true;
+}
+
+static bool scene_entry_tiled_supported(struct render_list_entry *entry,
+                                        const struct render_data *data) {
+    if (entry->effect || entry->effects) {
+        return false;
+    }
+    if (entry->layer_output) {
+        return wlr_pixman_texture_get_image(entry->layer_output->texture) != NULL;
+    }
+    if (entry->node->type != WLR_SCENE_NODE_BUFFER) {
+        return true;
+    }
+
+    struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(entry->node);
+    if (scene_buffer->transform != WL_OUTPUT_TRANSFORM_NORMAL) {
+        return false;
+    }
+    struct wlr_texture *texture = scene_buffer_get_texture(scene_buffer,
+                                                           data->output->output->renderer);
+    return texture && wlr_pixman_texture_get_image(texture);
+}
+
+// Composite the render list on the CPU in parallel, outputs of the pixman
+// renderer only. The render pass begun afterwards only adds what is drawn
+// on top, like cursors.
+static bool scene_output_render_tiled(const struct render_data *data,
+                                      struct render_list_entry *list_data, int list_len,
+                                      pixman_region32_t *background) {
+    struct wlr_output *output = data->output->output;
+    if (global_config.cpu_render_threads == 0 || !wlr_renderer_is_pixman(output->renderer) ||
+        data->color_transform || wsm_effect_output_has_output_hooks(data->effect_output) ||
+        data->transform != WL_OUTPUT_TRANSFORM_NORMAL) {
+        return false;
+    }
+    for (int i = 0; i < list_len; i++) {
+        if (!scene_entry_tiled_supported(&list_data[i], data)) {
+            return false;
+        }
+    }
+
+    if (!tiled_renderer) {
+        tiled_renderer = wsm_tiled_renderer_create(global_config.cpu_render_threads);
+        if (!tiled_renderer) {
+            return false;
+        }
+    }
+
+    struct wlr_buffer *buffer = data->buffer;
+    struct wsm_tiled_target target = {
+        .width = buffer->width,
+        .height = buffer->height,
+    };
+    uint32_t format;
+    size_t stride;
+    if (!wlr_buffer_begin_data_ptr_access(buffer, WLR_BUFFER_DATA_PTR_ACCESS_WRITE,
+                                          &target.data, &format, &stride)) {
+        return false;
+    }
+    target.stride = stride;
+    if (!tiled_format_from_drm(format, &target.format)) {
+        wlr_buffer_end_data_ptr_access(buffer);
+        return false;
+    }
+
+    struct wsm_tiled_layer *layers = wsm_frame_arena_alloc(data->arena,
+                                                           (list_len + 1) * sizeof(struct wsm_tiled_layer));
+    struct tiled_sources sources = {
+        .buffers = wsm_frame_arena_alloc(data->arena, list_len * sizeof(struct wlr_buffer *)),
+        .images = wsm_frame_arena_alloc(data->arena, list_len * sizeof(pixman_image_t *)),
+    };
+    if (!layers || (list_len && (!sources.buffers || !sources.images))) {
+        wlr_buffer_end_data_ptr_access(buffer);
+        return false;
+    }
+
+    // Bottom first, starting with the background
+    int count = 0;
+    struct wsm_tiled_layer *layer = &layers[count++];
+    layer->op = PIXMAN_OP_SRC;
+    layer->color = (pixman_color_t){ .alpha = 0xffff };
+    pixman_region32_init(&layer->clip);
+    pixman_region32_copy(&layer->clip, background);
+    bool failed = false;
+    for (int i = list_len - 1; i >= 0 && !failed; i--) {
+        if (scene_entry_tiled_layer(&list_data[i], data, &sources, &layers[count], &failed)) {
+            count++;
+        }
+    }
+
+    if (!failed) {
+        wsm_tiled_render(tiled_renderer, &target, &data->damage, layers, count);
+    }
+    tiled_sources_release(&sources);
+    wlr_buffer_end_data_ptr_access(buffer);
+
+    for (int i = 0; i < count; i++) {
+        pixman_region32_fini(&layers[i].clip);
+    }
+    if (failed) {
+        // nothing was drawn yet, the render pass does it all
+        return false;
+    }
+
+    for (int i = 0; i < list_len; i++) {
+        struct render_list_entry *entry = &list_data[i];
+        if (entry->node->type != WLR_SCENE_NODE_BUFFER) {
+            continue;
+        }
+        struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(entry->node);
+        struct wlr_scene_output_sample_event sample_event = {
+            .output = data->output,
+            .direct_scanout = false,
+        };
+        wl_signal_emit_mutable(&scene_buffer->events.output_sample, &sample_event);
+    }
+    return true;
+}
+
+void wsm_scene_finish(void) {
+    wsm_tiled_renderer_destroy(tiled_renderer);
+    tiled_renderer = NULL;
 }
 
 bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
                                   struct wlr_output_state *state, const struct wlr_scene_output_state_options *options) {
+    WSM_TRACE_SCOPE("wsm_scene_output_build_state");
     struct wlr_scene_output_state_options default_options = {0};
     if (!options) {
         options = &default_options;
@@ -718,7 +1925,13 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
                                       .scale = output->scale,
                                       .logical = { .x = scene_output->x, .y = scene_output->y },
                                       .output = scene_output,
+                                      .effect_output = wsm_effect_output_get(scene_output->output),
+                                      .arena = wsm_frame_arena_get(scene_output->output),
                                       };
+    if (!render_data.arena) {
+        return false;
+    }
+    wsm_frame_arena_reset(render_data.arena);
 
     int resolution_width, resolution_height;
     output_pending_resolution(output, state,
@@ -754,15 +1967,30 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
         .calculate_visibility = scene_output->scene->calculate_visibility,
         .highlight_transparent_region = scene_output->scene->highlight_transparent_region,
         .fractional_scale = floor(render_data.scale) != render_data.scale,
+        .effect_output = render_data.effect_output,
+        .arena = render_data.arena,
     };
 
     list_con.render_list->size = 0;
-    scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
-                       construct_render_list_iterator, &list_con);
+    wsm_layer_caches_begin_frame();
+    struct wlr_scene_node *root = &scene_output->scene->tree.node;
+    int root_x, root_y;
+    wlr_scene_node_coords(root, &root_x, &root_y);
+    construct_render_list(root, root_x, root_y, &list_con);
     array_realloc(list_con.render_list, list_con.render_list->size);
 
     struct render_list_entry *list_data = list_con.render_list->data;
     int list_len = list_con.render_list->size / sizeof(*list_data);
+    // Before layer caches replace buffers, they all want frame done
+    for (int i = 0; i < list_len; i++) {
+        if (list_data[i].node->type == WLR_SCENE_NODE_BUFFER) {
+            wsm_output_track_buffer(wlr_scene_buffer_from_node(list_data[i].node));
+        }
+    }
+    if (list_con.has_layers) {
+        list_len = scene_output_apply_layer_caches(&render_data, list_data, list_len);
+        list_con.render_list->size = list_len * sizeof(*list_data);
+    }
 
     wlr_damage_ring_set_bounds(&scene_output->damage_ring,
                                render_data.trans_width, render_data.trans_height);
@@ -778,9 +2006,8 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
 
         // add the current frame's damage if there is damage
         if (pixman_region32_not_empty(&scene_output->damage_ring.current)) {
-            struct highlight_region *current_damage = calloc(1, sizeof(*current_damage));
+            struct highlight_region *current_damage = highlight_region_create();
             if (current_damage) {
-                pixman_region32_init(&current_damage->region);
                 pixman_region32_copy(&current_damage->region,
                                      &scene_output->damage_ring.current);
                 current_damage->when = now;
@@ -788,13 +2015,16 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
             }
         }
 
-        pixman_region32_t acc_damage;
-        pixman_region32_init(&acc_damage);
+        pixman_region32_t *acc_damage = wsm_frame_arena_region(render_data.arena);
+        if (!acc_damage) {
+            return false;
+        }
+        pixman_region32_clear(acc_damage);
         struct highlight_region *damage, *tmp_damage;
         wl_list_for_each_safe(damage, tmp_damage, regions, link) {
             // remove overlaping damage regions
-            pixman_region32_subtract(&damage->region, &damage->region, &acc_damage);
-            pixman_region32_union(&acc_damage, &acc_damage, &damage->region);
+            pixman_region32_subtract(&damage->region, &damage->region, acc_damage);
+            pixman_region32_union(acc_damage, acc_damage, &damage->region);
 
             // if this damage is too old or has nothing in it, get rid of it
             struct timespec time_diff;
@@ -805,10 +2035,20 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
             }
         }
 
-        wlr_damage_ring_add(&scene_output->damage_ring, &acc_damage);
-        pixman_region32_fini(&acc_damage);
+        wlr_damage_ring_add(&scene_output->damage_ring, acc_damage);
+    }
+
+    wsm_blur_begin_frame(scene_output);
+    if (wsm_surface_effects_active()) {
+        scene_output_expand_effect_damage(&render_data, list_data, list_len);
+    }
+    if (render_data.effect_output) {
+        scene_output_expand_pipeline_damage(&render_data, list_data, list_len);
     }
 
+    // Every rectangle of the damage is a clip rectangle for every entry
+    wsm_damage_simplify(&scene_output->damage_ring.current,
+                        global_config.damage_max_rects, global_config.damage_merge_waste);
     output_state_apply_damage(&render_data, state);
 
     // We only want to try direct scanout if:
@@ -860,69 +2100,89 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
         timer->pre_render_duration = timespec_to_nsec(&duration);
     }
 
-    struct wlr_render_pass *render_pass = wlr_renderer_begin_buffer_pass(output->renderer, buffer,
-                                                                         &(struct wlr_buffer_pass_options){
-                                                                             .timer = timer ? timer->render_timer : NULL,
-                                                                             .color_transform = options->color_transform,
-                                                                         });
-    if (render_pass == NULL) {
-        wlr_buffer_unlock(buffer);
-        return false;
-    }
-
-    render_data.render_pass = render_pass;
+    render_data.buffer = buffer;
+    render_data.color_transform = options->color_transform;
 
     pixman_region32_init(&render_data.damage);
     wlr_damage_ring_rotate_buffer(&scene_output->damage_ring, buffer,
                                   &render_data.damage);
+    // The damage of older buffers adds up
+    wsm_damage_simplify(&render_data.damage,
+                        global_config.damage_max_rects, global_config.damage_merge_waste);
+
+    pixman_region32_t *background = wsm_frame_arena_region(render_data.arena);
+    pixman_region32_t *effect_damage = wsm_frame_arena_region(render_data.arena);
+    if (!background || !effect_damage) {
+        pixman_region32_fini(&render_data.damage);
+        wlr_buffer_unlock(buffer);
+        return false;
+    }
+    scene_output_background_region(&render_data, list_data, list_len, background);
 
-    pixman_region32_t background;
-    pixman_region32_init(&background);
-    pixman_region32_copy(&background, &render_data.damage);
-
-    // Cull areas of the background that are occluded by opaque regions of
-    // scene nodes above. Those scene nodes will just render atop having us
-    // never see the background.
-    if (scene_output->scene->calculate_visibility) {
-        for (int i = list_len - 1; i >= 0; i--) {
-            struct render_list_entry *entry = &list_data[i];
-
-            // We must only cull opaque regions that are visible by the node.
-            // The node's visibility will have the knowledge of a black rect
-            // that may have been omitted from the render list via the black
-            // rect optimization. In order to ensure we don't cull background
-            // rendering in that black rect region, consider the node's visibility.
-            pixman_region32_t opaque;
-            pixman_region32_init(&opaque);
-            scene_node_opaque_region(entry->node, entry->x, entry->y, &opaque);
-            pixman_region32_intersect(&opaque, &opaque, &entry->node->visible);
-
-            pixman_region32_translate(&opaque, -scene_output->x, -scene_output->y);
-            wlr_region_scale(&opaque, &opaque, render_data.scale);
-            pixman_region32_subtract(&background, &background, &opaque);
-            pixman_region32_fini(&opaque);
-        }
-
-        if (floor(render_data.scale) != render_data.scale) {
-            wlr_region_expand(&background, &background, 1);
+    bool tiled = scene_output_render_tiled(&render_data, list_data, list_len, background);
 
-            // reintersect with the damage because we never want to render
-            // outside of the damage region
-            pixman_region32_intersect(&background, &background, &render_data.damage);
+    struct wlr_buffer_pass_options pass_options = {
+        .timer = timer ? timer->render_timer : NULL,
+        .color_transform = options->color_transform,
+    };
+    struct wlr_render_pass *render_pass = wlr_renderer_begin_buffer_pass(output->renderer, buffer,
+                                                                         &pass_options);
+    if (render_pass == NULL) {
+        pixman_region32_fini(&render_data.damage);
+        wlr_buffer_unlock(buffer);
+        wlr_damage_ring_add_whole(&scene_output->damage_ring);
+        return false;
+    }
+    render_data.render_pass = render_pass;
+    render_data.pass_options = &pass_options;
+
+    if (render_data.effect_output) {
+        pixman_region32_copy(effect_damage, &render_data.damage);
+        transform_output_damage(effect_damage, &render_data);
+        render_data.effect_frame = (struct wsm_effect_frame){
+            .output = scene_output,
+            .buffer = buffer,
+            .pass = render_pass,
+            .pass_options = &pass_options,
+            .damage = effect_damage,
+            .scale = render_data.scale,
+            .transform = render_data.transform,
+        };
+        wsm_effect_output_pre_render(render_data.effect_output, &render_data.effect_frame);
+        render_data.render_pass = render_data.effect_frame.pass;
+        if (!render_data.render_pass) {
+            goto render_failed;
         }
+        render_pass = render_data.render_pass;
     }
 
-    transform_output_damage(&background, &render_data);
-    wlr_render_pass_add_rect(render_pass, &(struct wlr_render_rect_options){
-                                                                            .box = { .width = buffer->width, .height = buffer->height },
-                                                                            .color = { .r = 0, .g = 0, .b = 0, .a = 1 },
-                                                                            .clip = &background,
-                                                                            });
-    pixman_region32_fini(&background);
+    if (!tiled) {
+        wlr_render_pass_add_rect(render_pass, &(struct wlr_render_rect_options){
+                                                  .box = { .width = buffer->width, .height = buffer->height },
+                                                  .color = { .r = 0, .g = 0, .b = 0, .a = 1 },
+                                                  .clip = background,
+                                              });
+    }
 
     for (int i = list_len - 1; i >= 0; i--) {
         struct render_list_entry *entry = &list_data[i];
-        scene_entry_render(entry, &render_data);
+        if (!tiled) {
+            if (scene_entry_is_opaque_rect(entry)) {
+                // Rects next to each other in the list can be merged without
+                // changing the stacking order
+                int last = i;
+                while (i > 0 && scene_entry_rect_batches_with(&list_data[i - 1], entry)) {
+                    i--;
+                }
+                scene_entries_render_rects(&list_data[i], last - i + 1, &render_data);
+                continue;
+            }
+
+            scene_entry_render(entry, &render_data);
+            if (!render_data.render_pass) {
+                goto render_failed;
+            }
+        }
 
         if (entry->node->type == WLR_SCENE_NODE_BUFFER) {
             struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(entry->node);
@@ -938,6 +2198,15 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
         }
     }
 
+    if (render_data.effect_output) {
+        render_data.effect_frame.pass = render_data.render_pass;
+        wsm_effect_output_render(render_data.effect_output, &render_data.effect_frame);
+        render_data.render_pass = render_data.effect_frame.pass;
+        if (!render_data.render_pass) {
+            goto render_failed;
+        }
+    }
+
     if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT) {
         struct highlight_region *damage;
         wl_list_for_each(damage, &scene_output->damage_highlight_regions, link) {
@@ -946,7 +2215,7 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
             int64_t time_diff_ms = timespec_to_msec(&time_diff);
             float alpha = 1.0 - (double)time_diff_ms / HIGHLIGHT_DAMAGE_FADEOUT_TIME;
 
-            wlr_render_pass_add_rect(render_pass, &(struct wlr_render_rect_options){
+            wlr_render_pass_add_rect(render_data.render_pass, &(struct wlr_render_rect_options){
                                                                                     .box = { .width = buffer->width, .height = buffer->height },
                                                                                     .color = { .r = alpha * 0.5, .g = 0, .b = 0, .a = alpha * 0.5 },
                                                                                     .clip = &damage->region,
@@ -954,11 +2223,11 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
         }
     }
 
-    wlr_output_add_software_cursors_to_render_pass(output, render_pass, &render_data.damage);
+    wlr_output_add_software_cursors_to_render_pass(output, render_data.render_pass, &render_data.damage);
 
     pixman_region32_fini(&render_data.damage);
 
-    if (!wlr_render_pass_submit(render_pass)) {
+    if (!wlr_render_pass_submit(render_data.render_pass)) {
         wlr_buffer_unlock(buffer);
 
         // if we failed to render the buffer, it will have undefined contents
@@ -967,10 +2236,34 @@ bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
         return false;
     }
 
+    if (render_data.effect_output) {
+        render_data.effect_frame.pass = NULL;
+        for (int i = list_len - 1; i >= 0; i--) {
+            struct render_list_entry *entry = &list_data[i];
+            if (!entry->effects) {
+                continue;
+            }
+            struct wsm_effect_window effect_window;
+            scene_entry_effect_window(entry, &render_data, &effect_window);
+            effect_window.clip = NULL;
+            wsm_effect_output_post_render_window(render_data.effect_output, entry->effects,
+                                                 &render_data.effect_frame, &effect_window);
+        }
+        wsm_effect_output_post_render(render_data.effect_output, &render_data.effect_frame);
+    }
+
     wlr_output_state_set_buffer(state, buffer);
     wlr_buffer_unlock(buffer);
 
     return true;
+
+render_failed:
+    // An effect or the blur could not restart the render pass, the buffer
+    // has undefined contents
+    pixman_region32_fini(&render_data.damage);
+    wlr_buffer_unlock(buffer);
+    wlr_damage_ring_add_whole(&scene_output->damage_ring);
+    return false;
 }
 
 void root_get_box(struct wsm_scene *root, struct wlr_box *box) {
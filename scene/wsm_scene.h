@@ -32,6 +32,7 @@ THE SOFTWARE.
 
 struct wlr_scene;
 struct wlr_scene_tree;
+struct wlr_output;
 struct wlr_scene_output;
 struct wlr_output_state;
 struct wlr_output_layout;
@@ -114,6 +115,14 @@ bool wsm_scene_output_commit(struct wlr_scene_output *scene_output,
 bool wsm_scene_output_build_state(struct wlr_scene_output *scene_output,
                                   struct wlr_output_state *state, const struct wlr_scene_output_state_options *options);
 void root_get_box(struct wsm_scene *root, struct wlr_box *box);
+/**
+ * @brief add the built-in rounded corner and blur effects to the output
+ */
+void wsm_scene_output_add_effects(struct wlr_output *output);
 void root_scratchpad_show(struct wsm_container *con);
+/**
+ * @brief stop the render worker threads, called once at shutdown
+ */
+void wsm_scene_finish(void);
 
 #endif
@@ -0,0 +1,301 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "wsm_tiled_render.h"
+#include "wsm_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Height of the bands workers pick up, small enough to balance the load
+// of a frame with little damage, large enough to keep the per-band
+// overhead low
+#define TILED_BAND_HEIGHT 64
+#define TILED_MAX_THREADS 64
+
+struct tiled_job {
+    const struct wsm_tiled_target *target;
+    const pixman_region32_t *damage;
+    struct wsm_tiled_layer *layers;
+    int count;
+    // Source and mask of each layer, one slice per thread
+    pixman_image_t **images;
+    atomic_int next_slice;
+
+    int y, bands;
+    atomic_int next_band;
+};
+
+struct wsm_tiled_renderer {
+    pthread_t *threads;
+    int thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+
+    // Kept across frames, only grows with the number of layers
+    pixman_image_t **images;
+    int images_capacity;
+
+    struct tiled_job *job;
+    uint64_t generation;
+    int busy;
+    bool stopping;
+};
+
+// Images keep state updated while compositing, every worker wraps the
+// pixels of the sources in images of its own
+static pixman_image_t *tiled_source(struct wsm_tiled_layer *layer) {
+    pixman_image_t *image = layer->image;
+    pixman_image_t *source = pixman_image_create_bits(pixman_image_get_format(image),
+                                                      pixman_image_get_width(image), pixman_image_get_height(image),
+                                                      pixman_image_get_data(image), pixman_image_get_stride(image));
+    if (!source) {
+        return NULL;
+    }
+    pixman_image_set_transform(source, &layer->transform);
+    pixman_image_set_filter(source, layer->filter, NULL, 0);
+    return source;
+}
+
+static void tiled_job_run(struct tiled_job *job) {
+    const struct wsm_tiled_target *target = job->target;
+    pixman_image_t *dst = pixman_image_create_bits(target->format, target->width,
+                                                   target->height, target->data, target->stride);
+    if (!dst) {
+        wsm_log(WSM_ERROR, "Could not set up tiled rendering: allocation failed!");
+        return;
+    }
+    // Source and mask of each layer, created on first use
+    int slice = atomic_fetch_add(&job->next_slice, 1);
+    pixman_image_t **images = &job->images[slice * job->count * 2];
+    memset(images, 0, job->count * 2 * sizeof(pixman_image_t *));
+
+    pixman_region32_t band, region;
+    pixman_region32_init(&band);
+    pixman_region32_init(&region);
+
+    for (;;) {
+        int index = atomic_fetch_add(&job->next_band, 1);
+        if (index >= job->bands) {
+            break;
+        }
+
+        pixman_region32_intersect_rect(&band, (pixman_region32_t *)job->damage, 0,
+                                       job->y + index * TILED_BAND_HEIGHT, target->width, TILED_BAND_HEIGHT);
+        if (!pixman_region32_not_empty(&band)) {
+            continue;
+        }
+
+        for (int i = 0; i < job->count; i++) {
+            struct wsm_tiled_layer *layer = &job->layers[i];
+            pixman_region32_intersect(&region, &layer->clip, &band);
+            int rects_len;
+            pixman_box32_t *rects = pixman_region32_rectangles(&region, &rects_len);
+            if (rects_len == 0) {
+                continue;
+            }
+
+            if (!layer->image) {
+                pixman_image_fill_boxes(layer->op, dst, &layer->color, rects_len, rects);
+                continue;
+            }
+
+            if (!images[i * 2]) {
+                images[i * 2] = tiled_source(layer);
+                if (!images[i * 2]) {
+                    continue;
+                }
+                if (layer->alpha != 0xffff) {
+                    pixman_color_t alpha = { .alpha = layer->alpha };
+                    images[i * 2 + 1] = pixman_image_create_solid_fill(&alpha);
+                }
+            }
+
+            for (int j = 0; j < rects_len; j++) {
+                pixman_box32_t *rect = &rects[j];
+                pixman_image_composite32(layer->op, images[i * 2], images[i * 2 + 1], dst,
+                                         rect->x1 - layer->box.x, rect->y1 - layer->box.y, 0, 0,
+                                         rect->x1, rect->y1, rect->x2 - rect->x1, rect->y2 - rect->y1);
+            }
+        }
+    }
+
+    pixman_region32_fini(&region);
+    pixman_region32_fini(&band);
+
+    for (int i = 0; i < job->count * 2; i++) {
+        if (images[i]) {
+            pixman_image_unref(images[i]);
+        }
+    }
+    pixman_image_unref(dst);
+}
+
+static void *tiled_worker(void *data) {
+    struct wsm_tiled_renderer *renderer = data;
+
+    // Signals are handled by the event loop of the main thread
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    uint64_t generation = 0;
+    pthread_mutex_lock(&renderer->lock);
+    for (;;) {
+        while (!renderer->stopping && renderer->generation == generation) {
+            pthread_cond_wait(&renderer->work, &renderer->lock);
+        }
+        if (renderer->stopping) {
+            break;
+        }
+        generation = renderer->generation;
+        struct tiled_job *job = renderer->job;
+        pthread_mutex_unlock(&renderer->lock);
+
+        tiled_job_run(job);
+
+        pthread_mutex_lock(&renderer->lock);
+        if (--renderer->busy == 0) {
+            pthread_cond_signal(&renderer->done);
+        }
+    }
+    pthread_mutex_unlock(&renderer->lock);
+    return NULL;
+}
+
+struct wsm_tiled_renderer *wsm_tiled_renderer_create(int threads) {
+    if (threads < 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > TILED_MAX_THREADS) {
+        threads = TILED_MAX_THREADS;
+    }
+
+    struct wsm_tiled_renderer *renderer = calloc(1, sizeof(struct wsm_tiled_renderer));
+    if (!wsm_assert(renderer, "Could not create wsm_tiled_renderer: allocation failed!")) {
+        return NULL;
+    }
+    pthread_mutex_init(&renderer->lock, NULL);
+    pthread_cond_init(&renderer->work, NULL);
+    pthread_cond_init(&renderer->done, NULL);
+
+    // The calling thread is one of the workers
+    if (threads > 1) {
+        renderer->threads = calloc(threads - 1, sizeof(pthread_t));
+        if (!wsm_assert(renderer->threads, "Could not create tiled render threads: allocation failed!")) {
+            wsm_tiled_renderer_destroy(renderer);
+            return NULL;
+        }
+    }
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&renderer->threads[i], NULL, tiled_worker, renderer) != 0) {
+            wsm_log(WSM_ERROR, "Could not start tiled render thread %d", i);
+            break;
+        }
+        renderer->thread_count++;
+    }
+
+    wsm_log(WSM_INFO, "Tiled CPU rendering with %d threads", renderer->thread_count + 1);
+    return renderer;
+}
+
+void wsm_tiled_renderer_destroy(struct wsm_tiled_renderer *renderer) {
+    if (!renderer) {
+        return;
+    }
+
+    pthread_mutex_lock(&renderer->lock);
+    renderer->stopping = true;
+    pthread_cond_broadcast(&renderer->work);
+    pthread_mutex_unlock(&renderer->lock);
+    for (int i = 0; i < renderer->thread_count; i++) {
+        pthread_join(renderer->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&renderer->done);
+    pthread_cond_destroy(&renderer->work);
+    pthread_mutex_destroy(&renderer->lock);
+    free(renderer->images);
+    free(renderer->threads);
+    free(renderer);
+}
+
+void wsm_tiled_render(struct wsm_tiled_renderer *renderer, const struct wsm_tiled_target *target,
+                      const pixman_region32_t *damage, struct wsm_tiled_layer *layers, int count) {
+    pixman_box32_t *extents = pixman_region32_extents((pixman_region32_t *)damage);
+    if (extents->y2 <= extents->y1 || count == 0) {
+        return;
+    }
+
+    int needed = (renderer->thread_count + 1) * count * 2;
+    if (needed > renderer->images_capacity) {
+        pixman_image_t **images = realloc(renderer->images, needed * sizeof(pixman_image_t *));
+        if (!images) {
+            wsm_log(WSM_ERROR, "Could not set up tiled rendering: allocation failed!");
+            return;
+        }
+        renderer->images = images;
+        renderer->images_capacity = needed;
+    }
+
+    struct tiled_job job = {
+        .target = target,
+        .damage = damage,
+        .layers = layers,
+        .count = count,
+        .images = renderer->images,
+        .y = extents->y1,
+        .bands = (extents->y2 - extents->y1 + TILED_BAND_HEIGHT - 1) / TILED_BAND_HEIGHT,
+    };
+    atomic_init(&job.next_slice, 0);
+    atomic_init(&job.next_band, 0);
+
+    // Not worth waking up the pool for a single band
+    int workers = job.bands > 1 ? renderer->thread_count : 0;
+    if (workers > 0) {
+        pthread_mutex_lock(&renderer->lock);
+        renderer->job = &job;
+        renderer->generation++;
+        renderer->busy = workers;
+        pthread_cond_broadcast(&renderer->work);
+        pthread_mutex_unlock(&renderer->lock);
+    }
+
+    tiled_job_run(&job);
+
+    if (workers > 0) {
+        pthread_mutex_lock(&renderer->lock);
+        while (renderer->busy > 0) {
+            pthread_cond_wait(&renderer->done, &renderer->lock);
+        }
+        renderer->job = NULL;
+        pthread_mutex_unlock(&renderer->lock);
+    }
+}
@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2024 YaoBing Xiao
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef WSM_TILED_RENDER_H
+#define WSM_TILED_RENDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pixman.h>
+
+#include <wlr/util/box.h>
+
+struct wsm_tiled_renderer;
+
+/**
+ * @brief one render list entry composited on the CPU.
+ */
+struct wsm_tiled_layer {
+    pixman_image_t *image; // source, NULL to fill with color
+    pixman_color_t color;
+    pixman_op_t op;
+    pixman_filter_t filter;
+    pixman_transform_t transform; // destination to source, relative to box
+    uint16_t alpha;
+    struct wlr_box box; // destination
+    pixman_region32_t clip; // destination
+};
+
+/**
+ * @brief memory of the buffer being rendered.
+ */
+struct wsm_tiled_target {
+    void *data;
+    pixman_format_code_t format;
+    int width, height;
+    int stride;
+};
+
+/**
+ * @brief create a pool of @p threads workers, -1 for one per core.
+ *
+ * @details the calling thread always takes part in the rendering, the pool
+ * only holds the additional workers.
+ */
+struct wsm_tiled_renderer *wsm_tiled_renderer_create(int threads);
+void wsm_tiled_renderer_destroy(struct wsm_tiled_renderer *renderer);
+/**
+ * @brief composite @p layers, bottom first, within @p damage.
+ *
+ * @details the damage is split into bands rendered in parallel, every
+ * worker renders all layers of the bands it picks up.
+ */
+void wsm_tiled_render(struct wsm_tiled_renderer *renderer, const struct wsm_tiled_target *target,
+                      const pixman_region32_t *damage, struct wsm_tiled_layer *layers, int count);
+
+#endif
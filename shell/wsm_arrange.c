@@ -23,6 +23,8 @@ THE SOFTWARE.
 */
 
 #include "wsm_log.h"
+#include "wsm_trace.h"
+#include "wsm_list.h"
 #include "wsm_view.h"
 #include "wsm_scene.h"
 #include "wsm_server.h"
@@ -41,6 +43,51 @@ THE SOFTWARE.
 
 #include <wlr/types/wlr_scene.h>
 
+// Number of scene graph mutations issued by the arrange code since the last
+// call to arrange_take_scene_mutations().
+static size_t scene_mutations = 0;
+
+// wlroots already ignores redundant updates, but every arrange pass touches
+// each node, so filter the no-ops here to keep them out of the counters.
+static void arrange_node_set_position(struct wlr_scene_node *node, int x, int y) {
+    if (node->x == x && node->y == y) {
+        return;
+    }
+    wlr_scene_node_set_position(node, x, y);
+    scene_mutations++;
+}
+
+static void arrange_node_set_enabled(struct wlr_scene_node *node, bool enabled) {
+    if (node->enabled == enabled) {
+        return;
+    }
+    wlr_scene_node_set_enabled(node, enabled);
+    scene_mutations++;
+}
+
+static void arrange_node_reparent(struct wlr_scene_node *node,
+                                  struct wlr_scene_tree *new_parent) {
+    if (node->parent == new_parent) {
+        return;
+    }
+    wsm_scene_node_reparent(node, new_parent);
+    scene_mutations++;
+}
+
+static void arrange_rect_set_size(struct wlr_scene_rect *rect, int width, int height) {
+    if (rect->width == width && rect->height == height) {
+        return;
+    }
+    wlr_scene_rect_set_size(rect, width, height);
+    scene_mutations++;
+}
+
+size_t arrange_take_scene_mutations(void) {
+    size_t count = scene_mutations;
+    scene_mutations = 0;
+    return count;
+}
+
 void arrange_root_auto(void) {
     struct wlr_box layout_box;
     wlr_output_layout_get_box(global_server.wsm_scene->output_layout, NULL, &layout_box);
@@ -64,22 +111,49 @@ void arrange_root_auto(void) {
     }
 }
 
-void arrange_root_scene(struct wsm_scene *root) {
+static void arrange_root_layers(struct wsm_scene *root) {
     struct wsm_container *fs = root->fullscreen_global;
 
-    wlr_scene_node_set_enabled(&root->layers.shell_background->node, !fs);
-    wlr_scene_node_set_enabled(&root->layers.shell_bottom->node, !fs);
-    wlr_scene_node_set_enabled(&root->layers.tiling->node, !fs);
-    wlr_scene_node_set_enabled(&root->layers.floating->node, !fs);
-    wlr_scene_node_set_enabled(&root->layers.shell_top->node, !fs);
-    wlr_scene_node_set_enabled(&root->layers.fullscreen->node, !fs);
+    arrange_node_set_enabled(&root->layers.shell_background->node, !fs);
+    arrange_node_set_enabled(&root->layers.shell_bottom->node, !fs);
+    arrange_node_set_enabled(&root->layers.tiling->node, !fs);
+    arrange_node_set_enabled(&root->layers.floating->node, !fs);
+    arrange_node_set_enabled(&root->layers.shell_top->node, !fs);
+    arrange_node_set_enabled(&root->layers.fullscreen->node, !fs);
 
     // hide all contents in the scratchpad
     for (int i = 0; i < root->scratchpad->length; i++) {
         struct wsm_container *con = root->scratchpad->items[i];
 
-        wlr_scene_node_set_enabled(&con->scene_tree->node, false);
+        arrange_node_set_enabled(&con->scene_tree->node, false);
     }
+}
+
+static void arrange_output_layers(struct wsm_scene *root, struct wsm_output *output) {
+    wlr_scene_output_set_position(output->scene_output, output->lx, output->ly);
+
+    arrange_node_reparent(&output->layers.shell_background->node, root->layers.shell_background);
+    arrange_node_reparent(&output->layers.shell_bottom->node, root->layers.shell_bottom);
+    arrange_node_reparent(&output->layers.tiling->node, root->layers.tiling);
+    arrange_node_reparent(&output->layers.shell_top->node, root->layers.shell_top);
+    arrange_node_reparent(&output->layers.shell_overlay->node, root->layers.shell_overlay);
+    arrange_node_reparent(&output->layers.fullscreen->node, root->layers.fullscreen);
+    arrange_node_reparent(&output->layers.session_lock->node, root->layers.session_lock);
+
+    arrange_node_set_position(&output->layers.shell_background->node, output->lx, output->ly);
+    arrange_node_set_position(&output->layers.shell_bottom->node, output->lx, output->ly);
+    arrange_node_set_position(&output->layers.tiling->node, output->lx, output->ly);
+    arrange_node_set_position(&output->layers.fullscreen->node, output->lx, output->ly);
+    arrange_node_set_position(&output->layers.shell_top->node, output->lx, output->ly);
+    arrange_node_set_position(&output->layers.shell_overlay->node, output->lx, output->ly);
+    arrange_node_set_position(&output->layers.session_lock->node, output->lx, output->ly);
+}
+
+void arrange_root_scene(struct wsm_scene *root) {
+    WSM_TRACE_SCOPE("arrange_root_scene");
+    struct wsm_container *fs = root->fullscreen_global;
+
+    arrange_root_layers(root);
 
     if (fs) {
         for (int i = 0; i < root->outputs->length; i++) {
@@ -97,28 +171,77 @@ void arrange_root_scene(struct wsm_scene *root) {
         for (int i = 0; i < root->outputs->length; i++) {
             struct wsm_output *output = root->outputs->items[i];
 
-            wlr_scene_output_set_position(output->scene_output, output->lx, output->ly);
+            arrange_output_layers(root, output);
+            arrange_output_width_size(output, output->width, output->height);
+        }
+    }
+
+    wsm_arrange_popups(root->layers.popup);
+}
+
+static void arrange_output_workspace(struct wsm_output *output,
+                                     struct wsm_workspace *child, int width, int height);
+static void arrange_floater(struct wsm_workspace *ws, struct wsm_container *floater);
 
-            wlr_scene_node_reparent(&output->layers.shell_background->node, root->layers.shell_background);
-            wlr_scene_node_reparent(&output->layers.shell_bottom->node, root->layers.shell_bottom);
-            wlr_scene_node_reparent(&output->layers.tiling->node, root->layers.tiling);
-            wlr_scene_node_reparent(&output->layers.shell_top->node, root->layers.shell_top);
-            wlr_scene_node_reparent(&output->layers.shell_overlay->node, root->layers.shell_overlay);
-            wlr_scene_node_reparent(&output->layers.fullscreen->node, root->layers.fullscreen);
-            wlr_scene_node_reparent(&output->layers.session_lock->node, root->layers.session_lock);
+// Same as arranging the workspace of @floater, restricted to its subtree
+static void arrange_floater_dirty(struct wsm_container *floater) {
+    struct wsm_workspace *ws = floater->current.workspace;
+    if (floater->node.destroying || !ws || !ws->current.output) {
+        return;
+    }
 
-            wlr_scene_node_set_position(&output->layers.shell_background->node, output->lx, output->ly);
-            wlr_scene_node_set_position(&output->layers.shell_bottom->node, output->lx, output->ly);
-            wlr_scene_node_set_position(&output->layers.tiling->node, output->lx, output->ly);
-            wlr_scene_node_set_position(&output->layers.fullscreen->node, output->lx, output->ly);
-            wlr_scene_node_set_position(&output->layers.shell_top->node, output->lx, output->ly);
-            wlr_scene_node_set_position(&output->layers.shell_overlay->node, output->lx, output->ly);
-            wlr_scene_node_set_position(&output->layers.session_lock->node, output->lx, output->ly);
+    bool activated = ws->current.output->current.active_workspace == ws;
+    arrange_node_reparent(&floater->scene_tree->node, global_server.wsm_scene->layers.floating);
+    arrange_node_set_enabled(&floater->scene_tree->node, activated);
+    if (activated) {
+        arrange_floater(ws, floater);
+    }
+}
 
+void arrange_root_scene_dirty(struct wsm_scene *root, struct wsm_list *outputs,
+                              struct wsm_list *workspaces, struct wsm_list *containers) {
+    if (root->fullscreen_global) {
+        // a global fullscreen container covers every output
+        arrange_root_scene(root);
+        return;
+    }
+
+    arrange_root_layers(root);
+
+    for (int i = 0; i < root->outputs->length; i++) {
+        struct wsm_output *output = root->outputs->items[i];
+
+        if (list_contains(outputs, output)) {
+            arrange_output_layers(root, output);
             arrange_output_width_size(output, output->width, output->height);
+            continue;
+        }
+
+        bool layers_arranged = false;
+        for (int j = 0; j < output->current.workspaces->length; j++) {
+            struct wsm_workspace *ws = output->current.workspaces->items[j];
+            if (!list_contains(workspaces, ws)) {
+                continue;
+            }
+            if (!layers_arranged) {
+                arrange_output_layers(root, output);
+                layers_arranged = true;
+            }
+            arrange_output_workspace(output, ws, output->width, output->height);
         }
     }
 
+    for (int i = 0; i < containers->length; i++) {
+        struct wsm_container *floater = containers->items[i];
+        struct wsm_workspace *ws = floater->current.workspace;
+        if (ws && (list_contains(workspaces, ws) ||
+                   list_contains(outputs, ws->current.output))) {
+            // already arranged with its workspace
+            continue;
+        }
+        arrange_floater_dirty(floater);
+    }
+
     wsm_arrange_popups(root->layers.popup);
 }
 
@@ -137,54 +260,58 @@ void wsm_arrange_output_auto(struct wsm_output *output) {
     }
 }
 
-void arrange_output_width_size(struct wsm_output *output, int width, int height) {
-    for (int i = 0; i < output->current.workspaces->length; i++) {
-        struct wsm_workspace *child = output->current.workspaces->items[i];
+static void arrange_output_workspace(struct wsm_output *output,
+                                     struct wsm_workspace *child, int width, int height) {
+    bool activated = output->current.active_workspace == child;
 
-        bool activated = output->current.active_workspace == child;
+    arrange_node_reparent(&child->layers.non_fullscreen->node, output->layers.tiling);
+    arrange_node_reparent(&child->layers.fullscreen->node, output->layers.fullscreen);
 
-        wlr_scene_node_reparent(&child->layers.non_fullscreen->node, output->layers.tiling);
-        wlr_scene_node_reparent(&child->layers.fullscreen->node, output->layers.fullscreen);
+    for (int i = 0; i < child->current.floating->length; i++) {
+        struct wsm_container *floater = child->current.floating->items[i];
+        arrange_node_reparent(&floater->scene_tree->node, global_server.wsm_scene->layers.floating);
+        arrange_node_set_enabled(&floater->scene_tree->node, activated);
+    }
 
-        for (int i = 0; i < child->current.floating->length; i++) {
-            struct wsm_container *floater = child->current.floating->items[i];
-            wlr_scene_node_reparent(&floater->scene_tree->node, global_server.wsm_scene->layers.floating);
-            wlr_scene_node_set_enabled(&floater->scene_tree->node, activated);
-        }
+    if (activated) {
+        struct wsm_container *fs = child->current.fullscreen;
+        arrange_node_set_enabled(&child->layers.non_fullscreen->node, !fs);
+        arrange_node_set_enabled(&child->layers.fullscreen->node, fs);
 
-        if (activated) {
-            struct wsm_container *fs = child->current.fullscreen;
-            wlr_scene_node_set_enabled(&child->layers.non_fullscreen->node, !fs);
-            wlr_scene_node_set_enabled(&child->layers.fullscreen->node, fs);
+        arrange_workspace_floating(child);
 
-            arrange_workspace_floating(child);
+        arrange_node_set_enabled(&output->layers.shell_background->node, !fs);
+        arrange_node_set_enabled(&output->layers.shell_bottom->node, !fs);
+        arrange_node_set_enabled(&output->layers.fullscreen->node, fs);
 
-            wlr_scene_node_set_enabled(&output->layers.shell_background->node, !fs);
-            wlr_scene_node_set_enabled(&output->layers.shell_bottom->node, !fs);
-            wlr_scene_node_set_enabled(&output->layers.fullscreen->node, fs);
+        if (fs) {
+            arrange_rect_set_size(output->fullscreen_background, width, height);
 
-            if (fs) {
-                wlr_scene_rect_set_size(output->fullscreen_background, width, height);
+            wsm_arrange_fullscreen(child->layers.fullscreen, fs, child,
+                                   width, height);
+        } else {
+            struct wlr_box *area = &output->usable_area;
+            struct side_gaps *gaps = &child->current_gaps;
 
-                wsm_arrange_fullscreen(child->layers.fullscreen, fs, child,
-                                       width, height);
-            } else {
-                struct wlr_box *area = &output->usable_area;
-                struct side_gaps *gaps = &child->current_gaps;
+            arrange_node_set_position(&child->layers.non_fullscreen->node,
+                                     gaps->left + area->x, gaps->top + area->y);
 
-                wlr_scene_node_set_position(&child->layers.non_fullscreen->node,
-                                            gaps->left + area->x, gaps->top + area->y);
+            arrange_workspace_tiling(child,
+                                     area->width - gaps->left - gaps->right,
+                                     area->height - gaps->top - gaps->bottom);
+        }
+    } else {
+        arrange_node_set_enabled(&child->layers.non_fullscreen->node, false);
+        arrange_node_set_enabled(&child->layers.fullscreen->node, false);
 
-                arrange_workspace_tiling(child,
-                                         area->width - gaps->left - gaps->right,
-                                         area->height - gaps->top - gaps->bottom);
-            }
-        } else {
-            wlr_scene_node_set_enabled(&child->layers.non_fullscreen->node, false);
-            wlr_scene_node_set_enabled(&child->layers.fullscreen->node, false);
+        disable_workspace(child);
+    }
+}
 
-            disable_workspace(child);
-        }
+void arrange_output_width_size(struct wsm_output *output, int width, int height) {
+    for (int i = 0; i < output->current.workspaces->length; i++) {
+        struct wsm_workspace *child = output->current.workspaces->items[i];
+        arrange_output_workspace(output, child, width, height);
     }
 }
 
@@ -273,7 +400,7 @@ void wsm_arrange_popups(struct wlr_scene_tree *popups) {
 
         int lx, ly;
         wlr_scene_node_coords(popup->relative, &lx, &ly);
-        wlr_scene_node_set_position(node, lx, ly);
+        arrange_node_set_position(node, lx, ly);
     }
 }
 
@@ -369,9 +496,9 @@ void container_arrange_title_bar_node(struct wsm_container *con) {
         alloc_width = MAX(alloc_width, 0);
 
         wsm_text_node_set_max_width(node, alloc_width);
-        wlr_scene_node_set_position(node->node,
-                                    h_padding, ((height - node->height) >> 1) + get_max_thickness(con->pending)
-                                                                         * con->pending.border_top);
+        arrange_node_set_position(node->node,
+                                 h_padding, ((height - node->height) >> 1) + get_max_thickness(con->pending)
+                                                                      * con->pending.border_top);
         pixman_region32_union_rect(&text_area, &text_area,
                                    node->node->x, node->node->y, alloc_width, node->height);
     }
@@ -382,9 +509,9 @@ void container_arrange_title_bar_node(struct wsm_container *con) {
         return;
     }
 
-    wlr_scene_node_set_position(&con->title_bar->background->node, 0, get_max_thickness(con->pending)
-                                                                         * con->pending.border_top);
-    wlr_scene_rect_set_size(con->title_bar->background, width, height);
+    arrange_node_set_position(&con->title_bar->background->node, 0, get_max_thickness(con->pending)
+                                                                      * con->pending.border_top);
+    arrange_rect_set_size(con->title_bar->background, width, height);
     if (!con->title_bar->icon && con->view && con->current.border == B_NORMAL) {
         const char *app_id = view_get_app_id(con->view);
         char *icon_path = find_app_icon_frome_app_id(global_server.desktop_interface, app_id);
@@ -398,9 +525,9 @@ void container_arrange_title_bar_node(struct wsm_container *con) {
     if (con->title_bar->icon) {
         int size = height - global_config.titlebar_v_padding;
         wsm_image_node_set_size(con->title_bar->icon, size, size);
-        wlr_scene_node_set_position(con->title_bar->icon->node, ((height - size) >> 1),
-                                    ((height - size) >> 1) + get_max_thickness(con->pending)
-                                                                 * con->pending.border_top);
+        arrange_node_set_position(con->title_bar->icon->node, ((height - size) >> 1),
+                                 ((height - size) >> 1) + get_max_thickness(con->pending)
+                                                              * con->pending.border_top);
     }
 
     container_update(con);
@@ -411,12 +538,12 @@ void wsm_arrange_title_bar(struct wsm_container *con,
     container_update(con);
 
     bool has_title_bar = height > 0;
-    wlr_scene_node_set_enabled(&con->title_bar->tree->node, has_title_bar && con->view->enabled);
+    arrange_node_set_enabled(&con->title_bar->tree->node, has_title_bar && con->view->enabled);
     if (!has_title_bar) {
         return;
     }
 
-    wlr_scene_node_set_position(&con->title_bar->tree->node, x, y);
+    arrange_node_set_position(&con->title_bar->tree->node, x, y);
 
     con->title_width = width;
     container_arrange_title_bar_node(con);
@@ -430,20 +557,20 @@ void wsm_arrange_fullscreen(struct wlr_scene_tree *tree,
         fs_node = &fs->view->scene_tree->node;
 
         // if we only care about the view, disable any decorations
-        wlr_scene_node_set_enabled(&fs->scene_tree->node, false);
+        arrange_node_set_enabled(&fs->scene_tree->node, false);
     } else {
         fs_node = &fs->scene_tree->node;
         wsm_arrange_container_with_title_bar(fs, width, height, true, 0);
     }
 
-    wlr_scene_node_reparent(fs_node, tree);
+    arrange_node_reparent(fs_node, tree);
     wlr_scene_node_lower_to_bottom(fs_node);
-    wlr_scene_node_set_position(fs_node, 0, 0);
+    arrange_node_set_position(fs_node, 0, 0);
 }
 
 void wsm_arrange_container_with_title_bar(struct wsm_container *con,
                                int width, int height, bool title_bar, int gaps) {
-    wlr_scene_node_set_enabled(&con->scene_tree->node, true);
+    arrange_node_set_enabled(&con->scene_tree->node, true);
 
     if (con->output_handler) {
         wlr_scene_buffer_set_dest_size(con->output_handler, width, height);
@@ -477,30 +604,30 @@ void wsm_arrange_container_with_title_bar(struct wsm_container *con,
         int border_right = con->current.border_right ? border_width : 0;
         int page_top = con->current.border_top ? border_width : 0;
 
-        wlr_scene_rect_set_size(con->sensing.top, width, page_top);
-        wlr_scene_rect_set_size(con->sensing.bottom, width, border_bottom);
-        wlr_scene_rect_set_size(con->sensing.left,
-                                border_left, height - border_bottom - page_top);
-        wlr_scene_rect_set_size(con->sensing.right,
-                                border_right, height - border_bottom - page_top);
-
-        wlr_scene_node_set_position(&con->sensing.top->node, 0, 0);
-        wlr_scene_node_set_position(&con->sensing.bottom->node,
-                                    0, height - border_bottom);
-        wlr_scene_node_set_position(&con->sensing.left->node,
-                                    0, page_top);
-        wlr_scene_node_set_position(&con->sensing.right->node,
-                                    width - border_right, page_top);
+        arrange_rect_set_size(con->sensing.top, width, page_top);
+        arrange_rect_set_size(con->sensing.bottom, width, border_bottom);
+        arrange_rect_set_size(con->sensing.left,
+                              border_left, height - border_bottom - page_top);
+        arrange_rect_set_size(con->sensing.right,
+                              border_right, height - border_bottom - page_top);
+
+        arrange_node_set_position(&con->sensing.top->node, 0, 0);
+        arrange_node_set_position(&con->sensing.bottom->node,
+                                 0, height - border_bottom);
+        arrange_node_set_position(&con->sensing.left->node,
+                                 0, page_top);
+        arrange_node_set_position(&con->sensing.right->node,
+                                 width - border_right, page_top);
 
         // make sure to reparent, it's possible that the client just came out of
         // fullscreen mode where the parent of the surface is not the container
-        wlr_scene_node_reparent(&con->view->scene_tree->node, con->content_tree);
-        wlr_scene_node_set_position(&con->view->scene_tree->node,
-                                    border_left, border_top);
+        arrange_node_reparent(&con->view->scene_tree->node, con->content_tree);
+        arrange_node_set_position(&con->view->scene_tree->node,
+                                 border_left, border_top);
     } else {
         // make sure to disable the title bar if the parent is not managing it
         if (title_bar) {
-            wlr_scene_node_set_enabled(&con->title_bar->tree->node, false);
+            arrange_node_set_enabled(&con->title_bar->tree->node, false);
         }
 
         arrange_children_with_titlebar(con->current.layout, con->current.children,
@@ -529,9 +656,9 @@ void arrange_children_with_titlebar(enum wsm_container_layout layout, struct wsm
         bool activated = child == active;
 
         wsm_arrange_title_bar(child, 0, y + title_height, width, title_bar_height);
-        wlr_scene_node_set_enabled(&child->sensing.tree->node, activated);
-        wlr_scene_node_set_position(&child->scene_tree->node, 0, title_height);
-        wlr_scene_node_reparent(&child->scene_tree->node, content);
+        arrange_node_set_enabled(&child->sensing.tree->node, activated);
+        arrange_node_set_position(&child->scene_tree->node, 0, title_height);
+        arrange_node_reparent(&child->scene_tree->node, content);
 
         if (activated) {
             wsm_arrange_container_with_title_bar(child, width, height - title_height,
@@ -551,37 +678,41 @@ void arrange_workspace_tiling(struct wsm_workspace *ws,
                                    width, height, ws->gaps_inner);
 }
 
-void arrange_workspace_floating(struct wsm_workspace *ws) {
-    for (int i = 0; i < ws->current.floating->length; i++) {
-        struct wsm_container *floater = ws->current.floating->items[i];
-        struct wlr_scene_tree *layer = global_server.wsm_scene->layers.floating;
+static void arrange_floater(struct wsm_workspace *ws, struct wsm_container *floater) {
+    struct wlr_scene_tree *layer = global_server.wsm_scene->layers.floating;
 
-        if (floater->current.fullscreen_mode != FULLSCREEN_NONE) {
-            continue;
+    if (floater->current.fullscreen_mode != FULLSCREEN_NONE) {
+        return;
+    }
+
+    if (global_server.wsm_scene->fullscreen_global) {
+        if (container_is_transient_for(floater, global_server.wsm_scene->fullscreen_global)) {
+            layer = global_server.wsm_scene->layers.fullscreen_global;
         }
+    } else {
+        for (int i = 0; i < global_server.wsm_scene->outputs->length; i++) {
+            struct wsm_output *output = global_server.wsm_scene->outputs->items[i];
+            struct wsm_workspace *active = output->current.active_workspace;
 
-        if (global_server.wsm_scene->fullscreen_global) {
-            if (container_is_transient_for(floater, global_server.wsm_scene->fullscreen_global)) {
-                layer = global_server.wsm_scene->layers.fullscreen_global;
-            }
-        } else {
-            for (int i = 0; i < global_server.wsm_scene->outputs->length; i++) {
-                struct wsm_output *output = global_server.wsm_scene->outputs->items[i];
-                struct wsm_workspace *active = output->current.active_workspace;
-
-                if (active && active->fullscreen &&
-                    container_is_transient_for(floater, active->fullscreen)) {
-                    layer = global_server.wsm_scene->layers.fullscreen;
-                }
+            if (active && active->fullscreen &&
+                container_is_transient_for(floater, active->fullscreen)) {
+                layer = global_server.wsm_scene->layers.fullscreen;
             }
         }
+    }
 
-        wlr_scene_node_reparent(&floater->scene_tree->node, layer);
-        wlr_scene_node_set_position(&floater->scene_tree->node,
-                                    floater->current.x, floater->current.y);
-        wlr_scene_node_set_enabled(&floater->scene_tree->node, true);
+    arrange_node_reparent(&floater->scene_tree->node, layer);
+    arrange_node_set_position(&floater->scene_tree->node,
+                             floater->current.x, floater->current.y);
+    arrange_node_set_enabled(&floater->scene_tree->node, true);
 
-        wsm_arrange_container_with_title_bar(floater, floater->current.width, floater->current.height,
-                                             true, ws->gaps_inner);
+    wsm_arrange_container_with_title_bar(floater, floater->current.width, floater->current.height,
+                                         true, ws->gaps_inner);
+}
+
+void arrange_workspace_floating(struct wsm_workspace *ws) {
+    for (int i = 0; i < ws->current.floating->length; i++) {
+        struct wsm_container *floater = ws->current.floating->items[i];
+        arrange_floater(ws, floater);
     }
 }
@@ -34,6 +34,18 @@ struct wsm_workspace;
 
 void arrange_root_auto(void);
 void arrange_root_scene(struct wsm_scene *root);
+/**
+ * @brief re-arrange only the scene of the given outputs, workspaces and
+ * floating containers
+ *
+ * @details every workspace of a listed output is arranged, a listed
+ * workspace is arranged on its own and a listed floating container only
+ * gets its own subtree arranged. Falls back to arrange_root_scene() while
+ * a global fullscreen container is active.
+ */
+void arrange_root_scene_dirty(struct wsm_scene *root, struct wsm_list *outputs,
+                              struct wsm_list *workspaces, struct wsm_list *containers);
+size_t arrange_take_scene_mutations(void);
 void wsm_arrange_output_auto(struct wsm_output *output);
 void arrange_output_width_size(struct wsm_output *output, int width, int height);
 void wsm_arrange_workspace_auto(struct wsm_workspace *workspace);
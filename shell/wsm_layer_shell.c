@@ -35,6 +35,7 @@ THE SOFTWARE.
 #include "wsm_workspace.h"
 #include "wsm_layer_popup.h"
 #include "node/wsm_node_descriptor.h"
+#include "wsm_layer_cache.h"
 
 #include <stdlib.h>
 
@@ -110,7 +111,7 @@ static void handle_surface_commit(struct wl_listener *listener, void *data) {
         enum zwlr_layer_shell_v1_layer layer_type = layer_surface->current.layer;
         struct wlr_scene_tree *output_layer = wsm_layer_get_scene(
             surface->output, layer_type);
-        wlr_scene_node_reparent(&surface->scene->tree->node, output_layer);
+        wsm_scene_node_reparent(&surface->scene->tree->node, output_layer);
     }
 
     if (layer_surface->initial_commit || committed || layer_surface->surface->mapped != surface->mapped) {
@@ -306,6 +307,8 @@ void handle_layer_shell_surface(struct wl_listener *listener, void *data) {
     }
 
     surface->output = output;
+    // Panels and docks are mostly static
+    wsm_layer_cache_set_enabled(scene_surface->tree, true);
 
     // now that the surface's output is known, we can advertise its scale
     wlr_fractional_scale_v1_notify_scale(surface->layer_surface->surface,
@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "wsm_xdg_popup.h"
 #include "wsm_server.h"
 #include "wsm_log.h"
+#include "wsm_trace.h"
 #include "wsm_view.h"
 #include "wsm_seat.h"
 #include "wsm_scene.h"
@@ -55,7 +56,7 @@ THE SOFTWARE.
 #include <wlr/types/wlr_foreign_toplevel_management_v1.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 
-#define WSM_XDG_SHELL_VERSION 5
+#define WSM_XDG_SHELL_VERSION 6
 #define CONFIGURE_TIMEOUT_MS 100
 
 static struct wsm_xdg_shell_view *xdg_shell_view_from_view(
@@ -110,6 +111,13 @@ static void set_activated(struct wsm_view *view, bool activated) {
     wlr_xdg_toplevel_set_activated(view->wlr_xdg_toplevel, activated);
 }
 
+static void set_suspended(struct wsm_view *view, bool suspended) {
+    if (xdg_shell_view_from_view(view) == NULL) {
+        return;
+    }
+    wlr_xdg_toplevel_set_suspended(view->wlr_xdg_toplevel, suspended);
+}
+
 static void set_tiled(struct wsm_view *view, bool tiled) {
     if (xdg_shell_view_from_view(view) == NULL) {
         return;
@@ -207,6 +215,7 @@ static const struct wsm_view_impl view_impl = {
     .set_tiled = set_tiled,
     .set_fullscreen = set_fullscreen,
     .set_resizing = set_resizing,
+    .set_suspended = set_suspended,
     .wants_floating = wants_floating,
     .is_transient_for = is_transient_for,
     .maximize = _maximize,
@@ -217,6 +226,7 @@ static const struct wsm_view_impl view_impl = {
 };
 
 static void handle_commit(struct wl_listener *listener, void *data) {
+    WSM_TRACE_SCOPE("xdg_shell_commit");
     struct wsm_xdg_shell_view *xdg_shell_view =
         wl_container_of(listener, xdg_shell_view, commit);
     struct wsm_view *view = &xdg_shell_view->view;
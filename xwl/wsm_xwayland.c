@@ -27,6 +27,7 @@ THE SOFTWARE.
 #if HAVE_XWAYLAND
 #include "wsm_server.h"
 #include "wsm_log.h"
+#include "wsm_trace.h"
 #include "wsm_view.h"
 #include "wsm_output.h"
 #include "wsm_scene.h"
@@ -504,6 +505,7 @@ static const struct wsm_view_impl view_impl = {
 };
 
 static void handle_commit(struct wl_listener *listener, void *data) {
+    WSM_TRACE_SCOPE("xwayland_commit");
     struct wsm_xwayland_view *xwayland_view =
         wl_container_of(listener, xwayland_view, commit);
     struct wsm_view *view = &xwayland_view->view;